@@ -69,6 +69,26 @@ VExportDialog::VExportDialog(VNotebook *p_notebook,
             this, [this](const QString &p_log) {
                 appendLogLine(p_log);
             });
+    connect(m_exporter, &VExporter::noteExported,
+            this, [this](const VFile *p_file, const QString &p_outputFile, bool p_succeeded) {
+                if (p_succeeded) {
+                    appendLogLine(tr("Note %1 exported to %2.").arg(p_file->fetchPath())
+                                                               .arg(p_outputFile));
+                } else {
+                    appendLogLine(tr("Fail to export note %1.").arg(p_file->fetchPath()));
+                }
+            });
+    connect(m_exporter, &VExporter::progressChanged,
+            this, [this](int p_finished, int p_total, qint64 p_remainingMSecs) {
+                m_proBar->setRange(0, p_total);
+                m_proBar->setValue(p_finished);
+                if (p_remainingMSecs < 0) {
+                    m_proBar->setFormat("%v/%m");
+                } else {
+                    QString remaining = QTime(0, 0).addMSecs(p_remainingMSecs).toString("hh:mm:ss");
+                    m_proBar->setFormat(tr("%v/%m, %1 left").arg(remaining));
+                }
+            });
 
     initUIFields(p_renderer);
 
@@ -397,8 +417,14 @@ QWidget *VExportDialog::setupGeneralAdvancedSettings()
     m_subfolderCB = new QCheckBox(tr("Process subfolders"));
     m_subfolderCB->setToolTip(tr("Process subfolders recursively"));
 
+    // Incremental export.
+    m_incrementalCB = new QCheckBox(tr("Incremental export"));
+    m_incrementalCB->setToolTip(tr("Skip notes unchanged since last export to the output folder "
+                                   "and remove outputs of deleted notes"));
+
     QFormLayout *advLayout = new QFormLayout();
     advLayout->addRow(m_subfolderCB);
+    advLayout->addRow(m_incrementalCB);
 
     advLayout->setContentsMargins(0, 0, 0, 0);
 
@@ -433,6 +459,8 @@ void VExportDialog::initUIFields(MarkdownConverterType p_renderer)
 
     m_subfolderCB->setChecked(s_opt.m_processSubfolders);
 
+    m_incrementalCB->setChecked(s_opt.m_incremental);
+
     // Export format.
     m_formatCB->addItem(tr("Markdown"), (int)ExportFormat::Markdown);
     m_formatCB->addItem(tr("HTML"), (int)ExportFormat::HTML);
@@ -562,6 +590,7 @@ void VExportDialog::startExport()
     }
 
     m_exportBtn->setEnabled(false);
+    m_proBar->setRange(0, 0);
     m_proBar->show();
     m_askedToStop = false;
     m_exporter->setAskedToStop(false);
@@ -581,6 +610,7 @@ void VExportDialog::startExport()
                          renderStyle,
                          renderCodeBlockStyle,
                          m_subfolderCB->isChecked(),
+                         m_incrementalCB->isChecked(),
                          ExportPDFOption(&m_pageLayout,
                                          m_wkhtmltopdfCB->isChecked(),
                                          QDir::toNativeSeparators(m_wkPathEdit->text()),
@@ -607,6 +637,13 @@ void VExportDialog::startExport()
                                             m_customFolderSepEdit->text(),
                                             m_customTargetFileNameEdit->text()));
 
+    // Only formats with one output file per note could be exported incrementally.
+    if (s_opt.m_format != ExportFormat::PDF
+        && s_opt.m_format != ExportFormat::HTML
+        && (s_opt.m_format != ExportFormat::Custom || s_opt.m_customOpt.m_allInOne)) {
+        s_opt.m_incremental = false;
+    }
+
     m_consoleEdit->clear();
     appendLogLine(tr("Export to %1.").arg(outputFolder));
 
@@ -699,33 +736,13 @@ void VExportDialog::startExport()
             ret = doExportCustomAllInOne(files, s_opt, outputFolder, &msg);
         }
     } else {
-        switch (s_opt.m_source) {
-        case ExportSource::CurrentNote:
-        {
-            QStringList files;
-            ret = doExport(m_file, s_opt, outputFolder, &msg, &files);
-            if (ret == 1 && s_opt.m_format == ExportFormat::HTML) {
-                Q_ASSERT(files.size() == 1);
-                m_exportedFile = files.first();
-            }
-
-            break;
-        }
-
-        case ExportSource::CurrentFolder:
-            ret = doExport(m_directory, s_opt, outputFolder, &msg);
-            break;
-
-        case ExportSource::CurrentNotebook:
-            ret = doExport(m_notebook, s_opt, outputFolder, &msg);
-            break;
-
-        case ExportSource::Cart:
-            ret = doExport(m_cart, s_opt, outputFolder, &msg);
-            break;
-
-        default:
-            break;
+        QStringList files;
+        ret = doExportSource(s_opt, outputFolder, &msg, &files);
+        if (s_opt.m_source == ExportSource::CurrentNote
+            && ret == 1
+            && s_opt.m_format == ExportFormat::HTML) {
+            Q_ASSERT(files.size() == 1);
+            m_exportedFile = files.first();
         }
     }
 
@@ -829,6 +846,109 @@ void VExportDialog::appendLogLine(const QString &p_text)
     QCoreApplication::sendPostedEvents();
 }
 
+int VExportDialog::doExportSource(const ExportOption &p_opt,
+                                  const QString &p_outputFolder,
+                                  QString *p_errMsg,
+                                  QList<QString> *p_outputFiles)
+{
+    int ret = 0;
+    switch (p_opt.m_source) {
+    case ExportSource::CurrentNote:
+        ret = doExport(m_file, p_opt, p_outputFolder, p_errMsg, p_outputFiles);
+        break;
+
+    case ExportSource::CurrentFolder:
+        ret = doExport(m_directory, p_opt, p_outputFolder, p_errMsg, p_outputFiles);
+        break;
+
+    case ExportSource::CurrentNotebook:
+        ret = doExport(m_notebook, p_opt, p_outputFolder, p_errMsg, p_outputFiles);
+        break;
+
+    case ExportSource::Cart:
+        ret = doExport(m_cart, p_opt, p_outputFolder, p_errMsg, p_outputFiles);
+        break;
+
+    default:
+        break;
+    }
+
+    ret += exportPendingJobs(p_opt, p_outputFolder, p_errMsg, p_outputFiles);
+    return ret;
+}
+
+int VExportDialog::exportPendingJobs(const ExportOption &p_opt,
+                                     const QString &p_outputFolder,
+                                     QString *p_errMsg,
+                                     QList<QString> *p_outputFiles)
+{
+    int ret = 0;
+    if (!m_exportJobs.isEmpty()) {
+        ret = m_exporter->exportInBatch(m_exportJobs, p_opt, p_outputFolder, p_errMsg);
+
+        if (p_outputFiles) {
+            for (auto const & job : m_exportJobs) {
+                if (job.m_succeeded) {
+                    p_outputFiles->append(job.m_outputFile);
+                }
+            }
+        }
+
+        m_exportJobs.clear();
+        m_pendingOutputFiles.clear();
+    }
+
+    // Subfolders are added before their parents.
+    for (auto dir : m_dirsToClose) {
+        dir->close();
+    }
+
+    m_dirsToClose.clear();
+
+    for (auto notebook : m_notebooksToClose) {
+        notebook->close();
+    }
+
+    m_notebooksToClose.clear();
+
+    return ret;
+}
+
+QString VExportDialog::reserveOutputFile(const ExportOption &p_opt,
+                                         const QString &p_folder,
+                                         const QString &p_fileName)
+{
+    // Output files of pending jobs do not exist yet.
+    QFileInfo fi(p_fileName);
+    QString name = p_opt.m_incremental ? p_fileName
+                                       : VUtils::getFileNameWithSequence(p_folder, p_fileName);
+    int seq = 1;
+    while (m_pendingOutputFiles.contains(QDir(p_folder).filePath(name))) {
+        name = QString("%1_%2.%3").arg(fi.completeBaseName())
+                                  .arg(QString::number(seq++), 3, '0')
+                                  .arg(fi.suffix());
+        if (!p_opt.m_incremental) {
+            name = VUtils::getFileNameWithSequence(p_folder, name);
+        }
+    }
+
+    QString path = QDir(p_folder).filePath(name);
+    m_pendingOutputFiles.insert(path);
+    return path;
+}
+
+QString VExportDialog::outputDirName(const ExportOption &p_opt,
+                                     const QString &p_folder,
+                                     const QString &p_name) const
+{
+    if (p_opt.m_incremental) {
+        // Reuse the folder of last export.
+        return p_name;
+    }
+
+    return VUtils::getDirNameWithSequence(p_folder, p_name);
+}
+
 int VExportDialog::doExport(VFile *p_file,
                             const ExportOption &p_opt,
                             const QString &p_outputFolder,
@@ -882,8 +1002,7 @@ int VExportDialog::doExport(VDirectory *p_directory,
 
     int ret = 0;
 
-    QString folderName = VUtils::getDirNameWithSequence(p_outputFolder,
-                                                        p_directory->getName());
+    QString folderName = outputDirName(p_opt, p_outputFolder, p_directory->getName());
     QString outputPath = QDir(p_outputFolder).filePath(folderName);
     if (!VUtils::makePath(outputPath)) {
         LOGERR(tr("Fail to create directory %1.").arg(outputPath));
@@ -912,7 +1031,8 @@ int VExportDialog::doExport(VDirectory *p_directory,
 
 exit:
     if (!opened) {
-        p_directory->close();
+        // Notes of it may be pending in m_exportJobs.
+        m_dirsToClose.append(p_directory);
     }
 
     return ret;
@@ -934,8 +1054,7 @@ int VExportDialog::doExport(VNotebook *p_notebook,
 
     int ret = 0;
 
-    QString folderName = VUtils::getDirNameWithSequence(p_outputFolder,
-                                                        p_notebook->getName());
+    QString folderName = outputDirName(p_opt, p_outputFolder, p_notebook->getName());
     QString outputPath = QDir(p_outputFolder).filePath(folderName);
     if (!VUtils::makePath(outputPath)) {
         LOGERR(tr("Fail to create directory %1.").arg(outputPath));
@@ -953,7 +1072,7 @@ int VExportDialog::doExport(VNotebook *p_notebook,
 
 exit:
     if (!opened) {
-        p_notebook->close();
+        m_notebooksToClose.append(p_notebook);
     }
 
     return ret;
@@ -1063,7 +1182,7 @@ int VExportDialog::doExportPDF(VFile *p_file,
                                QString *p_errMsg,
                                QList<QString> *p_outputFiles)
 {
-    Q_UNUSED(p_opt);
+    Q_UNUSED(p_outputFiles);
 
     QString srcFilePath(p_file->fetchPath());
 
@@ -1079,21 +1198,13 @@ int VExportDialog::doExportPDF(VFile *p_file,
 
     // Get output file.
     QString suffix = ".pdf";
-    QString name = VUtils::getFileNameWithSequence(p_outputFolder,
-                                                   QFileInfo(p_file->getName()).completeBaseName() + suffix);
-    QString outputPath = QDir(p_outputFolder).filePath(name);
-
-    if (m_exporter->exportPDF(p_file, p_opt, outputPath, p_errMsg)) {
-        if (p_outputFiles) {
-            p_outputFiles->append(outputPath);
-        }
+    QString outputPath = reserveOutputFile(p_opt,
+                                           p_outputFolder,
+                                           QFileInfo(p_file->getName()).completeBaseName() + suffix);
 
-        appendLogLine(tr("Note %1 exported to %2.").arg(srcFilePath).arg(outputPath));
-        return 1;
-    } else {
-        appendLogLine(tr("Fail to export note %1.").arg(srcFilePath));
-        return 0;
-    }
+    // It will be exported and counted by exportPendingJobs().
+    m_exportJobs.append(ExportJob(p_file, outputPath));
+    return 0;
 }
 
 int VExportDialog::doExportHTML(VFile *p_file,
@@ -1102,7 +1213,7 @@ int VExportDialog::doExportHTML(VFile *p_file,
                                 QString *p_errMsg,
                                 QList<QString> *p_outputFiles)
 {
-    Q_UNUSED(p_opt);
+    Q_UNUSED(p_outputFiles);
 
     QString srcFilePath(p_file->fetchPath());
 
@@ -1118,21 +1229,13 @@ int VExportDialog::doExportHTML(VFile *p_file,
 
     // Get output file.
     QString suffix = p_opt.m_htmlOpt.m_mimeHTML ? ".mht" : ".html";
-    QString name = VUtils::getFileNameWithSequence(p_outputFolder,
-                                                   QFileInfo(p_file->getName()).completeBaseName() + suffix);
-    QString outputPath = QDir(p_outputFolder).filePath(name);
-
-    if (m_exporter->exportHTML(p_file, p_opt, outputPath, p_errMsg)) {
-        if (p_outputFiles) {
-            p_outputFiles->append(outputPath);
-        }
+    QString outputPath = reserveOutputFile(p_opt,
+                                           p_outputFolder,
+                                           QFileInfo(p_file->getName()).completeBaseName() + suffix);
 
-        appendLogLine(tr("Note %1 exported to %2.").arg(srcFilePath).arg(outputPath));
-        return 1;
-    } else {
-        appendLogLine(tr("Fail to export note %1.").arg(srcFilePath));
-        return 0;
-    }
+    // It will be exported and counted by exportPendingJobs().
+    m_exportJobs.append(ExportJob(p_file, outputPath));
+    return 0;
 }
 
 int VExportDialog::doExportCustom(VFile *p_file,
@@ -1141,7 +1244,7 @@ int VExportDialog::doExportCustom(VFile *p_file,
                                   QString *p_errMsg,
                                   QList<QString> *p_outputFiles)
 {
-    Q_UNUSED(p_opt);
+    Q_UNUSED(p_outputFiles);
 
     QString srcFilePath(p_file->fetchPath());
 
@@ -1157,21 +1260,13 @@ int VExportDialog::doExportCustom(VFile *p_file,
 
     // Get output file.
     QString suffix = "." + p_opt.m_customOpt.m_outputSuffix;
-    QString name = VUtils::getFileNameWithSequence(p_outputFolder,
-                                                   QFileInfo(p_file->getName()).completeBaseName() + suffix);
-    QString outputPath = QDir(p_outputFolder).filePath(name);
-
-    if (m_exporter->exportCustom(p_file, p_opt, outputPath, p_errMsg)) {
-        if (p_outputFiles) {
-            p_outputFiles->append(outputPath);
-        }
+    QString outputPath = reserveOutputFile(p_opt,
+                                           p_outputFolder,
+                                           QFileInfo(p_file->getName()).completeBaseName() + suffix);
 
-        appendLogLine(tr("Note %1 exported to %2.").arg(srcFilePath).arg(outputPath));
-        return 1;
-    } else {
-        appendLogLine(tr("Fail to export note %1.").arg(srcFilePath));
-        return 0;
-    }
+    // It will be exported and counted by exportPendingJobs().
+    m_exportJobs.append(ExportJob(p_file, outputPath));
+    return 0;
 }
 
 bool VExportDialog::checkUserAction()
@@ -1218,16 +1313,19 @@ void VExportDialog::handleCurrentFormatChanged(int p_index)
     bool htmlEnabled = false;
     bool pdfTitleNameEnabled = false;
     bool customEnabled = false;
+    bool incrementalEnabled = false;
 
     if (p_index >= 0) {
         switch (currentFormat()) {
         case ExportFormat::PDF:
             pdfEnabled = true;
+            incrementalEnabled = true;
             m_wkhtmltopdfCB->setEnabled(true);
             break;
 
         case ExportFormat::HTML:
             htmlEnabled = true;
+            incrementalEnabled = true;
             break;
 
         case ExportFormat::OnePDF:
@@ -1239,6 +1337,7 @@ void VExportDialog::handleCurrentFormatChanged(int p_index)
 
         case ExportFormat::Custom:
             customEnabled = true;
+            incrementalEnabled = true;
             break;
 
         default:
@@ -1249,6 +1348,7 @@ void VExportDialog::handleCurrentFormatChanged(int p_index)
     m_pdfSettings->setVisible(pdfEnabled);
     m_htmlSettings->setVisible(htmlEnabled);
     m_customSettings->setVisible(customEnabled);
+    m_incrementalCB->setVisible(incrementalEnabled);
 
     m_wkTitleEdit->setEnabled(pdfTitleNameEnabled);
     m_wkTargetFileNameEdit->setEnabled(pdfTitleNameEnabled);
@@ -1441,30 +1541,10 @@ int VExportDialog::outputAsHTML(const QString &p_outputFolder,
                                 QString *p_errMsg,
                                 QList<QString> *p_outputFiles)
 {
-    int ret = 0;
     ExportFormat fmt = s_opt.m_format;
     s_opt.m_format = ExportFormat::HTML;
-    switch (s_opt.m_source) {
-    case ExportSource::CurrentNote:
-        ret = doExport(m_file, s_opt, p_outputFolder, p_errMsg, p_outputFiles);
-        break;
-
-    case ExportSource::CurrentFolder:
-        ret = doExport(m_directory, s_opt, p_outputFolder, p_errMsg, p_outputFiles);
-        break;
-
-    case ExportSource::CurrentNotebook:
-        ret = doExport(m_notebook, s_opt, p_outputFolder, p_errMsg, p_outputFiles);
-        break;
-
-    case ExportSource::Cart:
-        ret = doExport(m_cart, s_opt, p_outputFolder, p_errMsg, p_outputFiles);
-        break;
-
-    default:
-        break;
-    }
-
+    Q_ASSERT(!s_opt.m_incremental);
+    int ret = doExportSource(s_opt, p_outputFolder, p_errMsg, p_outputFiles);
     s_opt.m_format = fmt;
 
     return ret;
@@ -4,6 +4,7 @@
 #include <QDialog>
 #include <QPageLayout>
 #include <QList>
+#include <QSet>
 #include <QComboBox>
 
 #include "vconstants.h"
@@ -224,7 +225,8 @@ struct ExportOption
         : m_source(ExportSource::CurrentNote),
           m_format(ExportFormat::Markdown),
           m_renderer(MarkdownConverterType::MarkdownIt),
-          m_processSubfolders(true)
+          m_processSubfolders(true),
+          m_incremental(false)
     {
     }
 
@@ -235,6 +237,7 @@ struct ExportOption
                  const QString &p_renderStyle,
                  const QString &p_renderCodeBlockStyle,
                  bool p_processSubfolders,
+                 bool p_incremental,
                  const ExportPDFOption &p_pdfOpt,
                  const ExportHTMLOption &p_htmlOpt,
                  const ExportCustomOption &p_customOpt)
@@ -245,6 +248,7 @@ struct ExportOption
           m_renderStyle(p_renderStyle),
           m_renderCodeBlockStyle(p_renderCodeBlockStyle),
           m_processSubfolders(p_processSubfolders),
+          m_incremental(p_incremental),
           m_pdfOpt(p_pdfOpt),
           m_htmlOpt(p_htmlOpt),
           m_customOpt(p_customOpt)
@@ -264,6 +268,10 @@ struct ExportOption
     // Whether process subfolders recursively when source is CurrentFolder.
     bool m_processSubfolders;
 
+    // Whether skip notes unchanged since last export to the same folder.
+    // Only for formats with one output file per note.
+    bool m_incremental;
+
     ExportPDFOption m_pdfOpt;
 
     ExportHTMLOption m_htmlOpt;
@@ -272,6 +280,25 @@ struct ExportOption
 };
 
 
+// A note to export and its output file.
+struct ExportJob
+{
+    ExportJob(VFile *p_file = NULL, const QString &p_outputFile = QString())
+        : m_file(p_file),
+          m_outputFile(p_outputFile),
+          m_succeeded(false)
+    {
+    }
+
+    VFile *m_file;
+
+    QString m_outputFile;
+
+    // Set by VExporter::exportInBatch().
+    bool m_succeeded;
+};
+
+
 class VExportDialog : public QDialog
 {
     Q_OBJECT
@@ -315,6 +342,33 @@ private:
 
     void appendLogLine(const QString &p_text);
 
+    // Export the notes of @p_opt.m_source.
+    // Return number of files exported.
+    int doExportSource(const ExportOption &p_opt,
+                       const QString &p_outputFolder,
+                       QString *p_errMsg = NULL,
+                       QList<QString> *p_outputFiles = NULL);
+
+    // Export the collected jobs in a batch and close the folders opened for them.
+    // @p_outputFolder: the folder holding all the outputs.
+    // Return number of files exported.
+    int exportPendingJobs(const ExportOption &p_opt,
+                          const QString &p_outputFolder,
+                          QString *p_errMsg = NULL,
+                          QList<QString> *p_outputFiles = NULL);
+
+    // Get an output file path in @p_folder not taken by pending jobs.
+    // Existing files are also avoided unless @p_opt is incremental, in which
+    // case a note is always exported to the same file.
+    QString reserveOutputFile(const ExportOption &p_opt,
+                              const QString &p_folder,
+                              const QString &p_fileName);
+
+    // Get the name of the output folder of @p_name in @p_folder.
+    QString outputDirName(const ExportOption &p_opt,
+                          const QString &p_folder,
+                          const QString &p_name) const;
+
     // Return number of files exported.
     int doExport(VFile *p_file,
                  const ExportOption &p_opt,
@@ -460,6 +514,8 @@ private:
 
     QCheckBox *m_subfolderCB;
 
+    QCheckBox *m_incrementalCB;
+
     QComboBox *m_customSrcFormatCB;
 
     VLineEdit *m_customSuffixEdit;
@@ -495,6 +551,17 @@ private:
     // Exporter used to export PDF and HTML.
     VExporter *m_exporter;
 
+    // Notes collected to be exported by @m_exporter in a batch.
+    QList<ExportJob> m_exportJobs;
+
+    // Output files of @m_exportJobs.
+    QSet<QString> m_pendingOutputFiles;
+
+    // Folders and notebooks to close after @m_exportJobs are done.
+    QList<VDirectory *> m_dirsToClose;
+
+    QList<VNotebook *> m_notebooksToClose;
+
     // Last exproted file path.
     QString m_exportedFile;
 
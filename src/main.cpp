@@ -17,11 +17,39 @@
 #include "vconfigmanager.h"
 #include "vpalette.h"
 #include "vapplication.h"
+#include "vcodeblockhighlightcache.h"
+#include "vpreviewimagecache.h"
+#include "vimagethumbnailcache.h"
+#include "vrenderresultcache.h"
+#include "vplantumlprocesspool.h"
+#include "vrenderscheduler.h"
+#include "vwebviewpool.h"
+#include "vheadlessexporter.h"
+#include "vdirectoryconfigcache.h"
+#include "utils/vwebutils.h"
 
 VConfigManager *g_config;
 
 VPalette *g_palette;
 
+VCodeBlockHighlightCache *g_codeBlockHighlightCache;
+
+VPreviewImageCache *g_previewImageCache;
+
+VImageThumbnailCache *g_imageThumbnailCache;
+
+VRenderResultCache *g_renderResultCache;
+
+VPlantUMLProcessPool *g_plantUMLProcessPool;
+
+VRenderScheduler *g_renderScheduler;
+
+VWebViewPool *g_webViewPool;
+
+VDirectoryConfigCache *g_dirConfigCache;
+
+extern VWebUtils *g_webUtils;
+
 #if defined(QT_NO_DEBUG)
 // 5MB log size.
 #define MAX_LOG_SIZE 5 * 1024 * 1024
@@ -125,13 +153,22 @@ int main(int argc, char *argv[])
 #else
     bool allowMultiInstances = false;
 #endif
+    // --export-html <note or folder> <output folder>: export without the main window.
+    int exportHtmlArg = -1;
     for (int i = 1; i < argc; ++i) {
         if (!qstrcmp(argv[i], "-m")) {
             allowMultiInstances = true;
-            break;
+        } else if (!qstrcmp(argv[i], "--export-html") && i + 2 < argc) {
+            exportHtmlArg = i;
+            allowMultiInstances = true;
         }
     }
 
+    if (exportHtmlArg > -1 && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        // No display is needed.
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     VSingleInstanceGuard guard;
     bool canRun = true;
     if (!allowMultiInstances) {
@@ -262,6 +299,47 @@ int main(int argc, char *argv[])
     VPalette palette(g_config->getThemeFile());
     g_palette = &palette;
 
+    if (exportHtmlArg > -1) {
+        VWebUtils webUtils;
+        webUtils.init();
+        g_webUtils = &webUtils;
+
+        QString input = QString::fromLocal8Bit(argv[exportHtmlArg + 1]);
+        QString output = QString::fromLocal8Bit(argv[exportHtmlArg + 2]);
+        VHeadlessExporter exporter;
+        int ret = exporter.exportHtml(input, output, ExportHTMLOption());
+        return (ret < 0 || exporter.getNumOfFailed() > 0) ? 1 : 0;
+    }
+
+    // Must outlive all the editors.
+    VCodeBlockHighlightCache codeBlockHighlightCache(QDir(g_config->getCacheConfigFolder()).filePath("codeblock_highlight.cache"),
+                                                     g_config->getCodeBlockHighlightCacheSize() * 1024);
+    g_codeBlockHighlightCache = &codeBlockHighlightCache;
+
+    // Cost of QCache is an int.
+    VPreviewImageCache previewImageCache(qMin(g_config->getPreviewDownloadCacheSize(), 1024) * 1024 * 1024);
+    g_previewImageCache = &previewImageCache;
+
+    VImageThumbnailCache imageThumbnailCache(QDir(g_config->getCacheConfigFolder()).filePath("thumbnails"),
+                                             (qint64)g_config->getPreviewThumbnailCacheSize() * 1024 * 1024);
+    g_imageThumbnailCache = &imageThumbnailCache;
+
+    VRenderResultCache renderResultCache(QDir(g_config->getCacheConfigFolder()).filePath("render_results"),
+                                         (qint64)g_config->getRenderResultCacheSize() * 1024 * 1024);
+    g_renderResultCache = &renderResultCache;
+
+    VDirectoryConfigCache dirConfigCache(QDir(g_config->getCacheConfigFolder()).filePath("dir_snapshots"));
+    g_dirConfigCache = &dirConfigCache;
+
+    VPlantUMLProcessPool plantUMLProcessPool(g_config->getPlantUMLProcessPoolSize());
+    g_plantUMLProcessPool = &plantUMLProcessPool;
+
+    VRenderScheduler renderScheduler;
+    g_renderScheduler = &renderScheduler;
+
+    VWebViewPool webViewPool(g_config->getWebViewPoolSize());
+    g_webViewPool = &webViewPool;
+
     VMainWindow w(&guard);
     app.setWindow(&w);
     QString style = palette.fetchQtStyleSheet();
@@ -142,9 +142,14 @@ var mdHasTocSection = function(markdown) {
     return n != -1;
 };
 
-var markdownToHtml = function(markdown, needToc) {
+// @keepAnchors, do not reset the anchor names when rendering a part of the text,
+// which will be renumbered by renumberTextSectionAnchors().
+var markdownToHtml = function(markdown, needToc, keepAnchors) {
     toc = [];
-    nameCounter = 0;
+    if (!keepAnchors) {
+        nameCounter = 0;
+    }
+
     var html = mdit.render(markdown);
     if (needToc) {
         return html.replace(/<p>\[TOC\]<\/p>/ig, '<div class="vnote-toc"></div>');
@@ -163,6 +168,7 @@ var updateText = function(text) {
     // There is at least one async job for MathJax.
     asyncJobsCount = 1;
     metaDataText = null;
+    textSections = [];
 
     var needToc = mdHasTocSection(text);
     var html = markdownToHtml(text, needToc);
@@ -183,31 +189,261 @@ var updateText = function(text) {
     // If you add new logics after handling MathJax, please pay attention to
     // finishLoading logic.
     if (VEnableMathjax) {
-        var texToRender = document.getElementsByClassName('tex-to-render');
-        var nrTex = texToRender.length;
-        if (nrTex == 0) {
+        typesetMathJax(Array.from(document.getElementsByClassName('tex-to-render')));
+    } else {
+        finishOneAsyncJob();
+    }
+};
+
+var typesetMathJax = function(eles) {
+    if (eles.length == 0) {
+        finishOneAsyncJob();
+        return;
+    }
+
+    MathJax.texReset();
+    MathJax
+        .typesetPromise(eles)
+        .then(postProcessMathJax)
+        .catch(function (err) {
+            content.setLog("err: " + err);
             finishOneAsyncJob();
-            return;
+        });
+};
+
+// Sections of the content in order, each rendered from one text block.
+// A section starts with a comment node as marker and ends before the next one,
+// since the post-processing may replace the top-level nodes.
+// { id, marker, toc, headings }
+var textSections = [];
+
+var VTextSectionMarkerPrefix = 'vnote-section-';
+
+var findTextSection = function(id) {
+    for (var i = 0; i < textSections.length; ++i) {
+        if (textSections[i].id == id) {
+            return i;
         }
+    }
 
-        var eles = [];
-        for (var i = 0; i < nrTex; ++i) {
-            eles.push(texToRender[i]);
+    return -1;
+};
+
+var removeTextSection = function(idx) {
+    var marker = textSections[idx].marker;
+    var nextMarker = idx < textSections.length - 1 ? textSections[idx + 1].marker : null;
+    var node = marker.nextSibling;
+    while (node && node != nextMarker) {
+        var next = node.nextSibling;
+        contentDiv.removeChild(node);
+        node = next;
+    }
+
+    contentDiv.removeChild(marker);
+    textSections.splice(idx, 1);
+};
+
+// Name the anchors of the headings in order as a full render does, so links
+// to the headings and the outline still work after the sections changed.
+var renumberTextSectionAnchors = function() {
+    nameCounter = 0;
+    for (var i = 0; i < textSections.length; ++i) {
+        var sec = textSections[i];
+        for (var j = 0; j < sec.toc.length; ++j) {
+            var anchor = 'toc_' + nameCounter++;
+            sec.toc[j].anchor = anchor;
+
+            var heading = sec.headings[j];
+            if (heading) {
+                heading.id = anchor;
+                var link = heading.querySelector('a.vnote-anchor');
+                if (link) {
+                    link.setAttribute('href', '#' + anchor);
+                }
+            }
         }
+    }
+};
 
-        MathJax.texReset();
-        MathJax
-            .typesetPromise(eles)
-            .then(postProcessMathJax)
-            .catch(function (err) {
-                content.setLog("err: " + err);
-                finishOneAsyncJob();
-            });
+// Patch the content with the changed text blocks.
+// @removedIds, ids of the sections to remove;
+// @addedIds and @addedTexts, the text blocks to render as new sections;
+// @beforeId, id of the section to insert the new sections before, -1 to append.
+var updateTextBlocks = function(removedIds, addedIds, addedTexts, beforeId) {
+    startFreshRender();
+
+    // There is at least one async job for MathJax.
+    asyncJobsCount = 1;
+    metaDataText = null;
+
+    // The content is not rendered by text blocks.
+    if (textSections.length == 0) {
+        contentDiv.innerHTML = '';
+    }
+
+    for (var i = 0; i < removedIds.length; ++i) {
+        var idx = findTextSection(removedIds[i]);
+        if (idx != -1) {
+            removeTextSection(idx);
+        }
+    }
+
+    var insertIdx = findTextSection(beforeId);
+    if (insertIdx == -1) {
+        insertIdx = textSections.length;
+    }
+
+    // Render the new sections in a container so the post-processing will only
+    // touch them. It needs to be in the page for the graphs.
+    var container = document.createElement('div');
+    contentDiv.insertBefore(container,
+                            insertIdx < textSections.length ? textSections[insertIdx].marker : null);
+
+    var needToc = false;
+    var sections = [];
+    for (var i = 0; i < addedIds.length; ++i) {
+        var sectionNeedToc = mdHasTocSection(addedTexts[i]);
+        needToc = needToc || sectionNeedToc;
+
+        var html = markdownToHtml(addedTexts[i], sectionNeedToc, true);
+
+        var marker = document.createComment(VTextSectionMarkerPrefix + addedIds[i]);
+        container.appendChild(marker);
+        container.insertAdjacentHTML('beforeend', html);
+
+        // The front matter could only be in the first block.
+        handleMetaData(marker);
+
+        // Anchors of the headings will be renumbered in the whole content.
+        var headings = [];
+        for (var j = 0; j < toc.length; ++j) {
+            headings.push(container.querySelector('[id="' + toc[j].anchor + '"]'));
+        }
+
+        sections.push({ id: addedIds[i], marker: marker, toc: toc, headings: headings });
+    }
+
+    insertImageCaption(container);
+    setupImageView(container);
+    renderMermaid('lang-mermaid', container);
+    renderFlowchart(['lang-flowchart', 'lang-flow'], container);
+    renderWavedrom('lang-wavedrom', container);
+    renderPlantUML('lang-puml', container);
+    renderGraphviz('lang-dot', container);
+    addClassToCodeBlock(container);
+    addCopyButtonToCodeBlock(container);
+    renderCodeBlockLineNumber(container);
+
+    var texToRender = VEnableMathjax ? Array.from(container.getElementsByClassName('tex-to-render')) : [];
+
+    while (container.firstChild) {
+        contentDiv.insertBefore(container.firstChild, container);
+    }
+
+    contentDiv.removeChild(container);
+
+    Array.prototype.splice.apply(textSections, [insertIdx, 0].concat(sections));
+
+    renumberTextSectionAnchors();
+
+    // Outline of the whole content.
+    toc = [];
+    for (var i = 0; i < textSections.length; ++i) {
+        toc = toc.concat(textSections[i].toc);
+    }
+
+    handleToc(needToc);
+
+    // If you add new logics after handling MathJax, please pay attention to
+    // finishLoading logic.
+    if (VEnableMathjax) {
+        // Forget the math typeset before, whose nodes may have been removed.
+        if (typeof MathJax.typesetClear == 'function') {
+            MathJax.typesetClear();
+        }
+
+        typesetMathJax(texToRender);
     } else {
         finishOneAsyncJob();
     }
 };
 
+// Show the HTML generated by Hoedown natively for large notes.
+var updateNativeHtml = function(html) {
+    startFreshRender();
+
+    // There is at least one async job for MathJax.
+    asyncJobsCount = 1;
+    metaDataText = null;
+    textSections = [];
+
+    contentDiv.innerHTML = html;
+    adaptNativeHtml();
+    insertImageCaption();
+    setupImageView();
+    renderMermaid('lang-mermaid');
+    renderFlowchart(['lang-flowchart', 'lang-flow']);
+    renderWavedrom('lang-wavedrom');
+    renderPlantUML('lang-puml');
+    renderGraphviz('lang-dot');
+    addClassToCodeBlock();
+    addCopyButtonToCodeBlock();
+    renderCodeBlockLineNumber();
+
+    // If you add new logics after handling MathJax, please pay attention to
+    // finishLoading logic.
+    // Hoedown keeps the math as is.
+    if (VEnableMathjax) {
+        typesetMathJax([contentDiv]);
+    } else {
+        finishOneAsyncJob();
+    }
+};
+
+// Make the HTML of Hoedown look like the one of Markdown-it, including the
+// language classes, highlights and the heading anchors.
+var adaptNativeHtml = function() {
+    var codes = contentDiv.getElementsByTagName('code');
+    for (var i = 0; i < codes.length; ++i) {
+        var code = codes[i];
+        if (code.parentElement.tagName.toLowerCase() != 'pre') {
+            continue;
+        }
+
+        var lang = null;
+        for (var j = 0; j < code.classList.length; ++j) {
+            if (code.classList[j].startsWith('language-')) {
+                lang = code.classList[j].substring(9);
+                break;
+            }
+        }
+
+        if (!lang) {
+            continue;
+        }
+
+        code.classList.add('lang-' + lang);
+        if (!specialCodeBlock(lang) && hljs.getLanguage(lang)) {
+            hljs.highlightBlock(code);
+        }
+    }
+
+    // Hoedown names the headings as toc_N, too.
+    var headers = contentDiv.querySelectorAll('h1, h2, h3, h4, h5, h6');
+    for (var i = 0; i < headers.length; ++i) {
+        var header = headers[i];
+        if (!header.id) {
+            continue;
+        }
+
+        var anchor = document.createElement('a');
+        anchor.classList.add('vnote-anchor');
+        anchor.setAttribute('href', '#' + header.id);
+        anchor.setAttribute('data-anchor-icon', '#');
+        header.appendChild(anchor);
+    }
+};
+
 var highlightText = function(text, id, timeStamp) {
     highlightSpecialBlocks = true;
     var html = mdit.render(text);
@@ -215,7 +451,7 @@ var highlightText = function(text, id, timeStamp) {
     content.highlightTextCB(html, id, timeStamp);
 };
 
-var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+var renderTextToHtml = function(text, inlineStyle) {
     var html = mdit.render(text);
     if (inlineStyle) {
         var container = textHtmlDiv;
@@ -224,11 +460,17 @@ var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
         container.innerHTML = "";
     }
 
+    return html;
+};
+
+var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+    var html = renderTextToHtml(text, inlineStyle);
     content.textToHtmlCB(identifier, id, timeStamp, html);
 };
 
 // Add a PRE containing metaDataText if it is not empty.
-var handleMetaData = function() {
+// @marker, the node to insert after, at the beginning of the content if not specified.
+var handleMetaData = function(marker) {
     if (!metaDataText || metaDataText.length == 0) {
         return;
     }
@@ -241,7 +483,12 @@ var handleMetaData = function() {
     code.innerHTML = text;
 
     pre.appendChild(code);
-    contentDiv.insertAdjacentElement('afterbegin', pre);
+    if (marker) {
+        marker.parentNode.insertBefore(pre, marker.nextSibling);
+        metaDataText = null;
+    } else {
+        contentDiv.insertAdjacentElement('afterbegin', pre);
+    }
 };
 
 var postProcessMathJaxWhenMathjaxReady = function() {
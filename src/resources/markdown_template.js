@@ -176,54 +176,117 @@ var mute = function(muted) {
     g_muteScroll = muted;
 };
 
-new QWebChannel(qt.webChannelTransport,
-    function(channel) {
-        content = channel.objects.content;
+// Pages loaded in advance call this once the objects are registered.
+var initWebChannel = function() {
+    if (channelInitialized) {
+        return;
+    }
 
-        content.requestScrollToAnchor.connect(scrollToAnchor);
+    new QWebChannel(qt.webChannelTransport,
+        function(channel) {
+            // A page loaded in advance has no object registered yet.
+            if (channelInitialized || !channel.objects.content) {
+                return;
+            }
 
-        content.requestMuted.connect(mute);
+            content = channel.objects.content;
 
-        if (typeof highlightText == "function") {
-            content.requestHighlightText.connect(highlightText);
-            content.noticeReadyToHighlightText();
-        }
+            content.requestScrollToAnchor.connect(scrollToAnchor);
 
-        if (typeof htmlToText == "function") {
-            content.requestHtmlToText.connect(htmlToText);
-        }
+            content.requestMuted.connect(mute);
 
-        if (typeof textToHtml == "function") {
-            content.requestTextToHtml.connect(textToHtml);
-            content.noticeReadyToTextToHtml();
-        }
+            if (typeof highlightText == "function") {
+                content.requestHighlightText.connect(highlightText);
+                content.noticeReadyToHighlightText();
+            }
 
-        if (typeof htmlContent == "function") {
-            content.requestHtmlContent.connect(htmlContent);
-        }
+            if (typeof htmlToText == "function") {
+                content.requestHtmlToText.connect(htmlToText);
+            }
 
-        content.plantUMLResultReady.connect(handlePlantUMLResult);
-        content.graphvizResultReady.connect(handleGraphvizResult);
+            if (typeof textToHtml == "function") {
+                content.requestTextToHtml.connect(textToHtml);
+                content.requestTextToHtmlBatch.connect(textToHtmlBatch);
+                content.noticeReadyToTextToHtml();
+            }
 
-        content.requestPreviewEnabled.connect(setPreviewEnabled);
+            if (typeof htmlContent == "function") {
+                content.requestHtmlContent.connect(htmlContent);
+            }
 
-        content.requestPreviewCodeBlock.connect(previewCodeBlock);
+            content.plantUMLResultReady.connect(handlePlantUMLResult);
+            content.graphvizResultReady.connect(handleGraphvizResult);
 
-        content.requestSetPreviewContent.connect(setPreviewContent);
-        content.requestPerformSmartLivePreview.connect(performSmartLivePreview);
+            content.requestPreviewEnabled.connect(setPreviewEnabled);
 
-        if (typeof updateHtml == "function") {
-            updateHtml(content.html);
-            content.htmlChanged.connect(updateHtml);
-        }
+            content.requestPreviewCodeBlock.connect(previewCodeBlock);
 
-        if (typeof updateText == "function") {
-            content.textChanged.connect(updateText);
-            content.updateText();
-        }
+            content.requestSetPreviewContent.connect(setPreviewContent);
+            content.requestPerformSmartLivePreview.connect(performSmartLivePreview);
 
-        channelInitialized = true;
-    });
+            setBaseUrl(content.baseUrl);
+            content.baseUrlChanged.connect(setBaseUrl);
+
+            if (typeof updateHtml == "function") {
+                updateHtml(content.html);
+                content.htmlChanged.connect(updateHtml);
+            }
+
+            if (typeof updateNativeHtml == "function" && !VAddTOC) {
+                content.requestUpdateNativeHtml.connect(updateNativeHtml);
+                content.noticeReadyToUpdateNativeHtml();
+            }
+
+            if (typeof updateText == "function") {
+                content.textChanged.connect(updateText);
+
+                if (typeof updateTextBlocks == "function" && !VAddTOC) {
+                    content.requestUpdateTextBlocks.connect(updateTextBlocks);
+                    content.noticeReadyToUpdateTextBlocks();
+                } else {
+                    content.updateText();
+                }
+            }
+
+            channelInitialized = true;
+        });
+};
+
+// Only one channel could be created on the transport, so pages loaded in
+// advance wait for the taker.
+if (typeof VPooledPage == "undefined") {
+    initWebChannel();
+}
+
+// Resolve relative links against @url instead of the URL of the page, which
+// may be loaded before knowing the note.
+var setBaseUrl = function(url) {
+    if (!url) {
+        return;
+    }
+
+    var base = document.querySelector('base');
+    if (!base) {
+        base = document.createElement('base');
+        document.head.appendChild(base);
+
+        // In-page anchors should not be resolved against the base URL.
+        document.addEventListener('click', function(e) {
+            var link = e.target.closest('a');
+            if (!link) {
+                return;
+            }
+
+            var href = link.getAttribute('href');
+            if (href && href.length > 1 && href.charAt(0) == '#') {
+                e.preventDefault();
+                scrollToAnchor(decodeURIComponent(href.substr(1)));
+            }
+        });
+    }
+
+    base.href = url;
+};
 
 var VHighlightedAnchorClass = 'highlighted-anchor';
 
@@ -611,13 +674,16 @@ document.onkeydown = function(e) {
 var mermaidIdx = 0;
 
 // @className, the class name of the mermaid code block, such as 'lang-mermaid'.
-var renderMermaid = function(className) {
+// @root, the element to render within, the whole document if not specified.
+var renderMermaid = function(className, root) {
     if (!VEnableMermaid) {
         return;
     }
 
-    var codes = document.getElementsByTagName('code');
-    mermaidIdx = 0;
+    var codes = (root || document).getElementsByTagName('code');
+    if (!root) {
+        mermaidIdx = 0;
+    }
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         if (code.classList.contains(className)) {
@@ -668,13 +734,15 @@ var renderMermaidOne = function(code) {
 var flowchartIdx = 0;
 
 // @className, the class name of the flowchart code block, such as 'lang-flowchart'.
-var renderFlowchart = function(classNames) {
+var renderFlowchart = function(classNames, root) {
     if (!VEnableFlowchart) {
         return;
     }
 
-    var codes = document.getElementsByTagName('code');
-    flowchartIdx = 0;
+    var codes = (root || document).getElementsByTagName('code');
+    if (!root) {
+        flowchartIdx = 0;
+    }
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         var matched = false;
@@ -733,13 +801,15 @@ var renderFlowchartOne = function(code) {
 
 var wavedromIdx = 0;
 
-var renderWavedrom = function(className) {
+var renderWavedrom = function(className, root) {
     if (!VEnableWavedrom) {
         return;
     }
 
-    var codes = document.getElementsByTagName('code');
-    wavedromIdx = 0;
+    var codes = (root || document).getElementsByTagName('code');
+    if (!root) {
+        wavedromIdx = 0;
+    }
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         if (code.classList.contains(className)) {
@@ -787,14 +857,17 @@ var plantUMLIdx = 0;
 var plantUMLCodeClass = 'plantuml_code_';
 
 // @className, the class name of the PlantUML code block, such as 'lang-puml'.
-var renderPlantUML = function(className) {
+var renderPlantUML = function(className, root) {
     if (VPlantUMLMode == 0) {
         return;
     }
 
-    plantUMLIdx = 0;
+    // Keep the index unique among the pending results when rendering a part.
+    if (!root) {
+        plantUMLIdx = 0;
+    }
 
-    var codes = document.getElementsByTagName('code');
+    var codes = (root || document).getElementsByTagName('code');
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         if (code.classList.contains(className)) {
@@ -836,14 +909,16 @@ var graphvizIdx = 0;
 var graphvizCodeClass = 'graphviz_code_';
 
 // @className, the class name of the Graghviz code block, such as 'lang-dot'.
-var renderGraphviz = function(className) {
+var renderGraphviz = function(className, root) {
     if (!VEnableGraphviz) {
         return;
     }
 
-    graphvizIdx = 0;
+    if (!root) {
+        graphvizIdx = 0;
+    }
 
-    var codes = document.getElementsByTagName('code');
+    var codes = (root || document).getElementsByTagName('code');
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         if (code.classList.contains(className)) {
@@ -920,12 +995,12 @@ var getImageType = function(img) {
 };
 
 // Center the image block and insert the alt text as caption.
-var insertImageCaption = function() {
+var insertImageCaption = function(root) {
     if (!VEnableImageCaption) {
         return;
     }
 
-    var imgs = document.getElementsByTagName('img');
+    var imgs = (root || document).getElementsByTagName('img');
     for (var i = 0; i < imgs.length; ++i) {
         var img = imgs[i];
 
@@ -1236,12 +1311,12 @@ var jumpTitle = function(forward, relativeLevel, repeat) {
     setTimeout("g_muteScroll = false", 100);
 };
 
-var renderCodeBlockLineNumber = function() {
+var renderCodeBlockLineNumber = function(root) {
     if (!VEnableHighlightLineNumber) {
         return;
     }
 
-    var codes = document.getElementsByTagName('code');
+    var codes = (root || document).getElementsByTagName('code');
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         var pare = code.parentElement;
@@ -1256,7 +1331,7 @@ var renderCodeBlockLineNumber = function() {
 
     if (VRenderer != 'marked') {
         // Delete the last extra row.
-        var tables = document.getElementsByTagName('table');
+        var tables = (root || document).getElementsByTagName('table');
         for (var i = 0; i < tables.length; ++i) {
             var table = tables[i];
             if (table.classList.contains("hljs-ln")) {
@@ -1267,8 +1342,8 @@ var renderCodeBlockLineNumber = function() {
     }
 };
 
-var addClassToCodeBlock = function() {
-    var codes = document.getElementsByTagName('code');
+var addClassToCodeBlock = function(root) {
+    var codes = (root || document).getElementsByTagName('code');
     var mathCodes = [];
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
@@ -1295,12 +1370,12 @@ var addClassToCodeBlock = function() {
     }
 };
 
-var addCopyButtonToCodeBlock = function() {
+var addCopyButtonToCodeBlock = function(root) {
     if (!VEnableCodeBlockCopyButton) {
         return;
     }
 
-    var codes = document.getElementsByClassName(hljsClass);
+    var codes = (root || document).getElementsByClassName(hljsClass);
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         var pare = code.parentElement;
@@ -1390,6 +1465,17 @@ var getHtmlWithInlineStyles = function(container) {
     return container.innerHTML;
 };
 
+// Convert @texts to HTML in one round-trip by renderTextToHtml() of the renderer.
+// @ids will be passed back as is.
+var textToHtmlBatch = function(identifier, timeStamp, ids, texts, inlineStyle) {
+    var htmls = [];
+    for (var i = 0; i < texts.length; ++i) {
+        htmls.push(renderTextToHtml(texts[i], inlineStyle));
+    }
+
+    content.textToHtmlBatchCB(identifier, timeStamp, ids, htmls);
+};
+
 // Will be called after MathJax rendering finished.
 // Make <pre><code>math</code></pre> to <p>math</p>
 var postProcessMathJax = function() {
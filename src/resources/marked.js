@@ -99,7 +99,7 @@ var highlightText = function(text, id, timeStamp) {
     content.highlightTextCB(html, id, timeStamp);
 }
 
-var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+var renderTextToHtml = function(text, inlineStyle) {
     var html = marked(text);
     if (inlineStyle) {
         var container = textHtmlDiv;
@@ -108,5 +108,10 @@ var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
         container.innerHTML = "";
     }
 
+    return html;
+}
+
+var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+    var html = renderTextToHtml(text, inlineStyle);
     content.textToHtmlCB(identifier, id, timeStamp, html);
 }
@@ -18,6 +18,7 @@ new QWebChannel(qt.webChannelTransport,
         content = channel.objects.content;
 
         content.requestPreviewMathJax.connect(previewMathJax);
+        content.requestPreviewMathJaxBatch.connect(previewMathJaxBatch);
         content.requestPreviewDiagram.connect(previewDiagram);
 
         channelInitialized = true;
@@ -36,12 +37,11 @@ var isEmptyMathJax = function(text) {
     return text.replace(/\$/g, '').trim().length == 0;
 };
 
-var previewMathJax = function(identifier, id, timeStamp, text, isHtml) {
-    timeStamps.set(identifier, timeStamp);
-
+// Create a <p> element to typeset from @text.
+// Return null if there is nothing to typeset.
+var createMathJaxElement = function(text, isHtml) {
     if (isEmptyMathJax(text)) {
-        content.mathjaxResultReady(identifier, id, timeStamp, 'png', '');
-        return;
+        return null;
     }
 
     var p = null;
@@ -60,6 +60,13 @@ var previewMathJax = function(identifier, id, timeStamp, text, isHtml) {
         p.textContent = text;
     }
 
+    return p;
+};
+
+var previewMathJax = function(identifier, id, timeStamp, text, isHtml) {
+    timeStamps.set(identifier, timeStamp);
+
+    var p = createMathJaxElement(text, isHtml);
     if (!p) {
         content.mathjaxResultReady(identifier, id, timeStamp, 'png', '');
         return;
@@ -106,6 +113,66 @@ var postProcessMathJax = function(identifier, id, timeStamp, container, isBlock)
     });
 };
 
+// Typeset all @texts in one pass and return the results in one call.
+var previewMathJaxBatch = function(identifier, timeStamp, ids, texts, isHtml) {
+    timeStamps.set(identifier, timeStamp);
+
+    var results = [];
+    var items = [];
+    for (var i = 0; i < texts.length; ++i) {
+        results.push('');
+
+        var p = createMathJaxElement(texts[i], isHtml);
+        if (p) {
+            contentDiv.appendChild(p);
+            items.push({ idx: i,
+                         container: p,
+                         isBlock: texts[i].indexOf('$$') !== -1
+                       });
+        }
+    }
+
+    var finishBatch = function() {
+        for (var j = 0; j < items.length; ++j) {
+            contentDiv.removeChild(items[j].container);
+        }
+
+        content.mathjaxBatchResultReady(identifier, timeStamp, ids, 'png', results);
+    };
+
+    if (items.length == 0) {
+        finishBatch();
+        return;
+    }
+
+    MathJax.texReset();
+    MathJax
+        .typesetPromise(items.map(function(item) { return item.container; }))
+        .then(function () {
+            // Convert one by one to bound the memory.
+            var chain = Promise.resolve();
+            items.forEach(function(item) {
+                chain = chain.then(function() {
+                    if (timeStamps.get(identifier) != timeStamp) {
+                        return;
+                    }
+
+                    var hei = item.container.clientHeight * 1.5 + (item.isBlock ? 20 : 5);
+                    return domtoimage.toPng(item.container, { height: hei }).then(function (dataUrl) {
+                        results[item.idx] = dataUrl.substring(dataUrl.indexOf(',') + 1);
+                    }).catch(function (err) {
+                        content.setLog("err: " + err);
+                    });
+                });
+            });
+
+            chain.then(finishBatch);
+        }).catch(function (err) {
+            content.setLog("err: " + err);
+            finishBatch();
+        });
+};
+
 var mermaidIdx = 0;
 
 var flowchartIdx = 0;
@@ -161,7 +161,7 @@ var highlightText = function(text, id, timeStamp) {
     content.highlightTextCB(html, id, timeStamp);
 }
 
-var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+var renderTextToHtml = function(text, inlineStyle) {
     var html = renderer.makeHtml(text);
 
     var parser = new DOMParser();
@@ -179,5 +179,10 @@ var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
         container.innerHTML = "";
     }
 
+    return html;
+}
+
+var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+    var html = renderTextToHtml(text, inlineStyle);
     content.textToHtmlCB(identifier, id, timeStamp, html);
 }
@@ -140,10 +140,10 @@ var initImageViewBox = function() {
 
 initImageViewBox();
 
-var setupImageView = function() {
+var setupImageView = function(root) {
     closeImageViewBox();
 
-    var imgs = document.getElementsByTagName('img');
+    var imgs = (root || document).getElementsByTagName('img');
     for (var i = 0; i < imgs.length; ++i) {
         if (imgs[i].id == 'image-view') {
             continue;
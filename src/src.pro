@@ -166,7 +166,19 @@ SOURCES += main.cpp\
     vtablehelper.cpp \
     vtable.cpp \
     dialog/vinserttabledialog.cpp \
-    utils/vSync.cpp
+    utils/vSync.cpp \
+    vcodeblocktokenizer.cpp \
+    vcodeblockhighlightcache.cpp \
+    vimagedecoder.cpp \
+    vpreviewimagecache.cpp \
+    vimagethumbnailcache.cpp \
+    vrenderresultcache.cpp \
+    vplantumlprocesspool.cpp \
+    vrenderscheduler.cpp \
+    vwebviewpool.cpp \
+    vheadlessexporter.cpp \
+    vexportresourcecache.cpp \
+    vdirectoryconfigcache.cpp
 
 HEADERS  += vmainwindow.h \
     vapplication.h \
@@ -315,7 +327,19 @@ HEADERS  += vmainwindow.h \
     vtablehelper.h \
     vtable.h \
     dialog/vinserttabledialog.h \
-    utils/vSync.h
+    utils/vSync.h \
+    vcodeblocktokenizer.h \
+    vcodeblockhighlightcache.h \
+    vimagedecoder.h \
+    vpreviewimagecache.h \
+    vimagethumbnailcache.h \
+    vrenderresultcache.h \
+    vplantumlprocesspool.h \
+    vrenderscheduler.h \
+    vwebviewpool.h \
+    vheadlessexporter.h \
+    vexportresourcecache.h \
+    vdirectoryconfigcache.h
 
 RESOURCES += \
     vnote.qrc \
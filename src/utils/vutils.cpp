@@ -1763,6 +1763,33 @@ QPixmap VUtils::svgToPixmap(const QByteArray &p_content,
     return pm;
 }
 
+QImage VUtils::svgToImage(const QByteArray &p_content,
+                          const QString &p_background,
+                          qreal p_factor)
+{
+    QSvgRenderer renderer(p_content);
+    QSize deSz = renderer.defaultSize();
+    if (p_factor > 0) {
+        deSz *= p_factor;
+    }
+
+    if (deSz.isEmpty()) {
+        return QImage();
+    }
+
+    QImage img(deSz, QImage::Format_ARGB32_Premultiplied);
+    if (p_background.isEmpty()) {
+        // Fill a transparent background to avoid glitchy preview.
+        img.fill(QColor(255, 255, 255, 0));
+    } else {
+        img.fill(QColor(p_background));
+    }
+
+    QPainter painter(&img);
+    renderer.render(&painter);
+    return img;
+}
+
 QString VUtils::fetchImageLinkUrlToPreview(const QString &p_text, int &p_width, int &p_height)
 {
     QRegExp regExp(VUtils::c_imageLinkRegExp);
@@ -1894,3 +1921,68 @@ void VUtils::prependDotIfRelative(QString &p_path)
         p_path.prepend("./");
     }
 }
+
+static bool isCJKScript(QChar::Script p_script)
+{
+    switch (p_script) {
+    case QChar::Script_Han:
+    case QChar::Script_Hiragana:
+    case QChar::Script_Katakana:
+    case QChar::Script_Hangul:
+    case QChar::Script_Bopomofo:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+void VUtils::countWords(const QString &p_text,
+                        int &p_wordCount,
+                        int &p_charWithoutSpacesCount)
+{
+    int wc = 0;
+    int cns = 0;
+    // Whether in a word of alphabetic chars.
+    bool inWord = false;
+
+    const int sz = p_text.size();
+    for (int i = 0; i < sz; ++i) {
+        QChar ch = p_text[i];
+        if (ch.isSpace()) {
+            inWord = false;
+            continue;
+        }
+
+        ++cns;
+
+        if (ch.unicode() < 128) {
+            if (!inWord) {
+                inWord = true;
+                ++wc;
+            }
+
+            continue;
+        }
+
+        uint ucs = ch.unicode();
+        if (ch.isHighSurrogate() && i + 1 < sz && p_text[i + 1].isLowSurrogate()) {
+            // One char in two code units.
+            ucs = QChar::surrogateToUcs4(ch, p_text[i + 1]);
+            ++i;
+        }
+
+        if (isCJKScript(QChar::script(ucs))) {
+            inWord = false;
+            ++wc;
+        } else if (QChar::isPunct(ucs) || QChar::isSymbol(ucs)) {
+            inWord = false;
+        } else if (!inWord) {
+            inWord = true;
+            ++wc;
+        }
+    }
+
+    p_wordCount = wc;
+    p_charWithoutSpacesCount = cns;
+}
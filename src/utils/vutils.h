@@ -367,6 +367,12 @@ public:
                                const QString &p_background,
                                qreal p_factor);
 
+    // Render SVG to image. Could be called in non-GUI threads.
+    // @p_factor: < 0 indicates no scaling.
+    static QImage svgToImage(const QByteArray &p_content,
+                             const QString &p_background,
+                             qreal p_factor);
+
     // Fetch the image link's URL if there is only one link.
     static QString fetchImageLinkUrlToPreview(const QString &p_text, int &p_width, int &p_height);
 
@@ -393,6 +399,13 @@ public:
 
     static void prependDotIfRelative(QString &p_path);
 
+    // Count words and chars without spaces of @p_text.
+    // A run of ASCII or other alphabetic chars is one word while each CJK char
+    // is one word. Non-ASCII punctuations count as chars but not words.
+    static void countWords(const QString &p_text,
+                           int &p_wordCount,
+                           int &p_charWithoutSpacesCount);
+
     // Regular expression for image link.
     // ![image title]( http://github.com/tamlok/vnote.jpg "alt text" =200x100)
     // Captured texts (need to be trimmed):
@@ -0,0 +1,216 @@
+#include "vcodeblockhighlightcache.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QSet>
+#include <QVector>
+#include <algorithm>
+
+#include "utils/vutils.h"
+
+// "VCBH".
+#define CACHE_FILE_MAGIC 0x56434248
+
+// Bump it when the highlight results change.
+#define CACHE_FILE_VERSION 2
+
+// Memory overhead of one entry besides the key and the units.
+#define ENTRY_OVERHEAD 64
+
+VCodeBlockHighlightCache::VCodeBlockHighlightCache(const QString &p_file, int p_maxSize)
+    : m_file(p_file),
+      m_cache(p_maxSize > 0 ? p_maxSize : 0),
+      m_clock(0),
+      m_hits(0),
+      m_misses(0)
+{
+    load();
+}
+
+VCodeBlockHighlightCache::~VCodeBlockHighlightCache()
+{
+    qInfo() << "code block highlight cache" << statistics();
+
+    save();
+}
+
+QByteArray VCodeBlockHighlightCache::hashKey(const QString &p_highlighter, const QString &p_text)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(p_highlighter.toUtf8());
+    hash.addData("\0", 1);
+    hash.addData(p_text.toUtf8());
+    return hash.result();
+}
+
+int VCodeBlockHighlightCache::cost(const QByteArray &p_key, const QVector<HLUnitPos> &p_units)
+{
+    // Style names are shared among units.
+    return ENTRY_OVERHEAD + p_key.size() + p_units.size() * sizeof(HLUnitPos);
+}
+
+bool VCodeBlockHighlightCache::find(const QString &p_highlighter,
+                                    const QString &p_text,
+                                    QVector<HLUnitPos> &p_units)
+{
+    Entry *entry = m_cache.object(hashKey(p_highlighter, p_text));
+    if (!entry) {
+        ++m_misses;
+        return false;
+    }
+
+    ++m_hits;
+    entry->m_lastUsed = ++m_clock;
+    p_units = entry->m_units;
+    return true;
+}
+
+// Share the same style name strings among all the cached units.
+static void internStyles(QVector<HLUnitPos> &p_units)
+{
+    static QSet<QString> styles;
+    for (auto &unit : p_units) {
+        auto it = styles.constFind(unit.m_style);
+        if (it == styles.constEnd()) {
+            styles.insert(unit.m_style);
+        } else {
+            unit.m_style = *it;
+        }
+    }
+}
+
+void VCodeBlockHighlightCache::insert(const QString &p_highlighter,
+                                      const QString &p_text,
+                                      const QVector<HLUnitPos> &p_units)
+{
+    if (m_cache.maxCost() <= 0) {
+        return;
+    }
+
+    insertEntry(hashKey(p_highlighter, p_text), p_units);
+}
+
+void VCodeBlockHighlightCache::insertEntry(const QByteArray &p_key, QVector<HLUnitPos> p_units)
+{
+    Entry *entry = new Entry();
+    entry->m_units = p_units;
+    entry->m_lastUsed = ++m_clock;
+    internStyles(entry->m_units);
+
+    // QCache takes the ownership even if it fails.
+    m_cache.insert(p_key, entry, cost(p_key, entry->m_units));
+}
+
+void VCodeBlockHighlightCache::clear()
+{
+    m_cache.clear();
+    m_hits = m_misses = 0;
+}
+
+void VCodeBlockHighlightCache::load()
+{
+    if (m_file.isEmpty() || m_cache.maxCost() <= 0) {
+        return;
+    }
+
+    QFile file(m_file);
+    if (!file.exists()) {
+        return;
+    }
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "fail to open code block highlight cache" << m_file;
+        return;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_9);
+
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if (magic != CACHE_FILE_MAGIC || version != CACHE_FILE_VERSION) {
+        qDebug() << "abandon obsolete code block highlight cache" << m_file;
+        return;
+    }
+
+    for (quint32 i = 0; i < count; ++i) {
+        QByteArray key;
+        quint32 nrUnits = 0;
+        in >> key >> nrUnits;
+
+        QVector<HLUnitPos> units;
+        units.reserve(nrUnits);
+        for (quint32 j = 0; j < nrUnits; ++j) {
+            qint32 pos = 0, len = 0;
+            QString style;
+            in >> pos >> len >> style;
+            units.append(HLUnitPos(pos, len, style));
+        }
+
+        if (in.status() != QDataStream::Ok) {
+            qWarning() << "corrupted code block highlight cache" << m_file;
+            m_cache.clear();
+            return;
+        }
+
+        // Entries are saved from the least recently used one.
+        insertEntry(key, units);
+    }
+
+    qDebug() << "code block highlight cache loaded" << m_cache.size() << m_cache.totalCost();
+}
+
+bool VCodeBlockHighlightCache::save() const
+{
+    if (m_file.isEmpty()) {
+        return false;
+    }
+
+    if (!VUtils::makePath(QFileInfo(m_file).path())) {
+        qWarning() << "fail to create folder for code block highlight cache" << m_file;
+        return false;
+    }
+
+    QFile file(m_file);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "fail to save code block highlight cache" << m_file;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_9);
+
+    // Save from the least recently used one so the order is kept when loaded.
+    QList<QByteArray> keys = m_cache.keys();
+    std::sort(keys.begin(), keys.end(), [this](const QByteArray &p_a, const QByteArray &p_b) {
+        return m_cache.object(p_a)->m_lastUsed < m_cache.object(p_b)->m_lastUsed;
+    });
+
+    out << quint32(CACHE_FILE_MAGIC) << quint32(CACHE_FILE_VERSION) << quint32(keys.size());
+    for (auto const &key : keys) {
+        const Entry *entry = m_cache.object(key);
+        Q_ASSERT(entry);
+        out << key << quint32(entry->m_units.size());
+        for (auto const &unit : entry->m_units) {
+            out << qint32(unit.m_position) << qint32(unit.m_length) << unit.m_style;
+        }
+    }
+
+    return out.status() == QDataStream::Ok;
+}
+
+QString VCodeBlockHighlightCache::statistics() const
+{
+    unsigned long long total = m_hits + m_misses;
+    double hitRate = total > 0 ? m_hits * 100.0 / total : 0;
+    return QString("entries %1 memory %2/%3 KB hits %4 misses %5 hit rate %6%")
+                  .arg(m_cache.size())
+                  .arg(m_cache.totalCost() / 1024)
+                  .arg(m_cache.maxCost() / 1024)
+                  .arg(m_hits)
+                  .arg(m_misses)
+                  .arg(hitRate, 0, 'f', 1);
+}
@@ -0,0 +1,68 @@
+#ifndef VCODEBLOCKHIGHLIGHTCACHE_H
+#define VCODEBLOCKHIGHLIGHTCACHE_H
+
+#include <QCache>
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "markdownhighlighterdata.h"
+
+// Size-bounded LRU cache of code block highlight results shared by all the
+// editors, keyed by the hash of the highlighter id and the code block text.
+// Positions of the units are relative to the start of the code block.
+class VCodeBlockHighlightCache
+{
+public:
+    // @p_file: file to load from and save to;
+    // @p_maxSize: max size in bytes;
+    VCodeBlockHighlightCache(const QString &p_file, int p_maxSize);
+
+    ~VCodeBlockHighlightCache();
+
+    // @p_highlighter: id of the highlighter and its style producing the units.
+    // Return true and set @p_units if hit.
+    bool find(const QString &p_highlighter,
+              const QString &p_text,
+              QVector<HLUnitPos> &p_units);
+
+    void insert(const QString &p_highlighter,
+                const QString &p_text,
+                const QVector<HLUnitPos> &p_units);
+
+    void clear();
+
+    bool save() const;
+
+    // Memory usage and hit rate for the log.
+    QString statistics() const;
+
+private:
+    struct Entry
+    {
+        QVector<HLUnitPos> m_units;
+
+        // Value of m_clock when last used. Used to save entries in LRU order.
+        unsigned long long m_lastUsed;
+    };
+
+    void load();
+
+    void insertEntry(const QByteArray &p_key, QVector<HLUnitPos> p_units);
+
+    static QByteArray hashKey(const QString &p_highlighter, const QString &p_text);
+
+    static int cost(const QByteArray &p_key, const QVector<HLUnitPos> &p_units);
+
+    QString m_file;
+
+    QCache<QByteArray, Entry> m_cache;
+
+    unsigned long long m_clock;
+
+    unsigned long long m_hits;
+
+    unsigned long long m_misses;
+};
+
+#endif // VCODEBLOCKHIGHLIGHTCACHE_H
@@ -6,6 +6,12 @@
 #include "vdocument.h"
 #include "utils/vutils.h"
 #include "pegmarkdownhighlighter.h"
+#include "vcodeblocktokenizer.h"
+#include "vcodeblockhighlightcache.h"
+
+extern VConfigManager *g_config;
+
+extern VCodeBlockHighlightCache *g_codeBlockHighlightCache;
 
 VCodeBlockHighlightHelper::VCodeBlockHighlightHelper(PegMarkdownHighlighter *p_highlighter,
                                                      VDocument *p_vdoc,
@@ -14,12 +20,15 @@ VCodeBlockHighlightHelper::VCodeBlockHighlightHelper(PegMarkdownHighlighter *p_h
       m_highlighter(p_highlighter),
       m_vdocument(p_vdoc),
       m_type(p_type),
+      m_tokenizer(new VCodeBlockTokenizer(this)),
       m_timeStamp(0)
 {
     connect(m_highlighter, &PegMarkdownHighlighter::codeBlocksUpdated,
             this, &VCodeBlockHighlightHelper::handleCodeBlocksUpdated);
     connect(m_vdocument, &VDocument::textHighlighted,
             this, &VCodeBlockHighlightHelper::handleTextHighlightResult);
+    connect(m_tokenizer, &VCodeBlockTokenizer::tokenizeFinished,
+            this, &VCodeBlockHighlightHelper::handleTokenizeResult);
 
     // Web side is ready for code block highlight.
     connect(m_vdocument, &VDocument::readyToHighlightText,
@@ -62,7 +71,14 @@ QString VCodeBlockHighlightHelper::unindentCodeBlock(const QString &p_text)
 void VCodeBlockHighlightHelper::handleCodeBlocksUpdated(TimeStamp p_timeStamp,
                                                         const QVector<VCodeBlock> &p_codeBlocks)
 {
-    if (!m_vdocument->isReadyToHighlight()) {
+    bool webReady = m_vdocument->isReadyToHighlight();
+    bool nativeEnabled = g_config->getEnableNativeCodeBlockHighlight();
+    if (!webReady && !nativeEnabled) {
+        // Code blocks will be highlighted again once the web side is ready.
+        if (!p_codeBlocks.isEmpty()) {
+            m_vdocument->requestWebSide();
+        }
+
         // Immediately return empty results.
         QVector<HLUnitPos> emptyRes;
         for (int i = 0; i < p_codeBlocks.size(); ++i) {
@@ -74,19 +90,50 @@ void VCodeBlockHighlightHelper::handleCodeBlocksUpdated(TimeStamp p_timeStamp,
 
     m_timeStamp = p_timeStamp;
     m_codeBlocks = p_codeBlocks;
+
+    QVector<VCodeBlockTokenizeJob> jobs;
+    QVector<HLUnitPos> cachedUnits;
     for (int i = 0; i < m_codeBlocks.size(); ++i) {
         const VCodeBlock &block = m_codeBlocks[i];
-        auto it = m_cache.find(block.m_text);
-        if (it != m_cache.end()) {
+        bool native = nativeEnabled && VCodeBlockTokenizer::isLanguageSupported(block.m_lang);
+        if (g_codeBlockHighlightCache->find(highlighterId(native), block.m_text, cachedUnits)) {
             // Hit cache.
             qDebug() << "code block highlight hit cache" << p_timeStamp << i;
-            it.value().m_timeStamp = p_timeStamp;
-            updateHighlightResults(p_timeStamp, block.m_startPos, it.value().m_units);
-        } else {
+            updateHighlightResults(p_timeStamp, block.m_startPos, cachedUnits);
+        } else if (native) {
+            jobs.append(VCodeBlockTokenizeJob(i, block.m_lang, block.m_text));
+        } else if (webReady) {
             QString unindentedText = unindentCodeBlock(block.m_text);
             m_vdocument->highlightTextAsync(unindentedText, i, p_timeStamp);
+        } else {
+            m_vdocument->requestWebSide();
+            updateHighlightResults(p_timeStamp, 0, QVector<HLUnitPos>());
         }
     }
+
+    // Always called to cancel obsolete jobs.
+    m_tokenizer->tokenizeAsync(p_timeStamp, jobs);
+}
+
+QString VCodeBlockHighlightHelper::highlighterId(bool p_native)
+{
+    return QString("%1:%2").arg(p_native ? "native" : "web")
+                           .arg(g_config->getCodeBlockCssStyle());
+}
+
+void VCodeBlockHighlightHelper::handleTokenizeResult(TimeStamp p_timeStamp,
+                                                     int p_id,
+                                                     const QVector<HLUnitPos> &p_units)
+{
+    // Abandon obsolete result.
+    if (m_timeStamp != p_timeStamp) {
+        return;
+    }
+
+    const VCodeBlock &block = m_codeBlocks.at(p_id);
+    g_codeBlockHighlightCache->insert(highlighterId(true), block.m_text, p_units);
+
+    updateHighlightResults(p_timeStamp, block.m_startPos, p_units);
 }
 
 void VCodeBlockHighlightHelper::handleTextHighlightResult(const QString &p_html,
@@ -223,8 +270,11 @@ exit:
         hlUnits.clear();
     }
 
-    // Add it to cache.
-    addToHighlightCache(text, p_timeStamp, hlUnits);
+    // Add it to cache. An empty result may be caused by a web side not fully
+    // loaded or a failure, so it is not cached and will be retried.
+    if (!hlUnits.isEmpty()) {
+        g_codeBlockHighlightCache->insert(highlighterId(false), text, hlUnits);
+    }
 
     updateHighlightResults(p_timeStamp, startPos, hlUnits);
 }
@@ -284,24 +334,3 @@ bool VCodeBlockHighlightHelper::parseSpanElement(QXmlStreamReader &p_xml,
     }
     return false;
 }
-
-void VCodeBlockHighlightHelper::addToHighlightCache(const QString &p_text,
-                                                    TimeStamp p_timeStamp,
-                                                    const QVector<HLUnitPos> &p_units)
-{
-    const int c_maxEntries = 100;
-    const TimeStamp c_maxTimeStampSpan = 3;
-    if (m_cache.size() >= c_maxEntries) {
-        // Remove the oldest one.
-        TimeStamp ts = p_timeStamp - c_maxTimeStampSpan;
-        for (auto it = m_cache.begin(); it != m_cache.end();) {
-            if (it.value().m_timeStamp < ts) {
-                it = m_cache.erase(it);
-            } else {
-                ++it;
-            }
-        }
-    }
-
-    m_cache.insert(p_text, HLResult(p_timeStamp, p_units));
-}
@@ -5,12 +5,12 @@
 #include <QVector>
 #include <QAtomicInteger>
 #include <QXmlStreamReader>
-#include <QHash>
 
 #include "vconfigmanager.h"
 
 class VDocument;
 class PegMarkdownHighlighter;
+class VCodeBlockTokenizer;
 
 class VCodeBlockHighlightHelper : public QObject
 {
@@ -31,24 +31,12 @@ private slots:
 
     void handleTextHighlightResult(const QString &p_html, int p_id, unsigned long long p_timeStamp);
 
-private:
-    struct HLResult
-    {
-        HLResult()
-            : m_timeStamp(0)
-        {
-        }
-
-        HLResult(TimeStamp p_timeStamp, const QVector<HLUnitPos> &p_units)
-            : m_timeStamp(p_timeStamp),
-              m_units(p_units)
-        {
-        }
+    void handleTokenizeResult(TimeStamp p_timeStamp, int p_id, const QVector<HLUnitPos> &p_units);
 
-        TimeStamp m_timeStamp;
-
-        QVector<HLUnitPos> m_units;
-    };
+private:
+    // Id of the highlighter and its style for the highlight cache.
+    // @p_native: whether highlighted by the native tokenizer or the web side.
+    static QString highlighterId(bool p_native);
 
     void parseHighlightResult(TimeStamp p_timeStamp, int p_idx, const QString &p_html);
 
@@ -61,21 +49,17 @@ private:
 
     void updateHighlightResults(TimeStamp p_timeStamp, int p_startPos, QVector<HLUnitPos> p_units);
 
-    void addToHighlightCache(const QString &p_text,
-                             TimeStamp p_timeStamp,
-                             const QVector<HLUnitPos> &p_units);
-
     PegMarkdownHighlighter *m_highlighter;
     VDocument *m_vdocument;
     MarkdownConverterType m_type;
 
+    // Native highlighter for common languages.
+    // Other languages fall back to highlight.js in the web side.
+    VCodeBlockTokenizer *m_tokenizer;
+
     TimeStamp m_timeStamp;
 
     QVector<VCodeBlock> m_codeBlocks;
-
-    // Cache for highlight result, using the code block text as key.
-    // The HLResult has relative position only.
-    QHash<QString, HLResult> m_cache;
 };
 
 #endif // VCODEBLOCKHIGHLIGHTHELPER_H
@@ -0,0 +1,814 @@
+#include "vcodeblocktokenizer.h"
+
+#include <QDebug>
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
+
+// Max number of worker threads to tokenize code blocks.
+#define MAX_NUM_OF_THREADS 4
+
+static const QString c_keywordStyle = "hljs-keyword";
+static const QString c_typeStyle = "hljs-type";
+static const QString c_builtInStyle = "hljs-built_in";
+static const QString c_literalStyle = "hljs-literal";
+static const QString c_titleStyle = "hljs-title";
+static const QString c_stringStyle = "hljs-string";
+static const QString c_numberStyle = "hljs-number";
+static const QString c_commentStyle = "hljs-comment";
+static const QString c_metaStyle = "hljs-meta";
+static const QString c_variableStyle = "hljs-variable";
+static const QString c_attrStyle = "hljs-attr";
+
+// Lexical rules of one language.
+struct LanguageSpec
+{
+    LanguageSpec()
+        : m_tripleQuoteString(false),
+          m_preprocessor(false),
+          m_decorator(false),
+          m_shellVariable(false),
+          m_hashCommentNeedsSpace(false),
+          m_dollarInIdentifier(false),
+          m_caseInsensitive(false),
+          m_jsonKey(false),
+          m_yamlKey(false)
+    {
+    }
+
+    QSet<QString> m_keywords;
+
+    QSet<QString> m_types;
+
+    QSet<QString> m_builtIns;
+
+    QSet<QString> m_literals;
+
+    // Keywords followed by a title, such as "class" and "def".
+    QSet<QString> m_titleKeywords;
+
+    QStringList m_lineComments;
+
+    QString m_blockCommentStart;
+
+    QString m_blockCommentEnd;
+
+    // Quotes of strings within one line.
+    QString m_quotes;
+
+    // Quotes of strings which could span multiple lines.
+    QString m_multiLineQuotes;
+
+    // Python """ and ''' strings.
+    bool m_tripleQuoteString;
+
+    // C/C++ # directives.
+    bool m_preprocessor;
+
+    // Python @decorator.
+    bool m_decorator;
+
+    // Shell $VAR and VAR=.
+    bool m_shellVariable;
+
+    // # starts a comment only at the start of a word.
+    bool m_hashCommentNeedsSpace;
+
+    bool m_dollarInIdentifier;
+
+    bool m_caseInsensitive;
+
+    // Strings followed by : are keys.
+    bool m_jsonKey;
+
+    // key: at the start of a line.
+    bool m_yamlKey;
+};
+
+static void addWords(QSet<QString> &p_set, const char *p_words)
+{
+    const QStringList words = QString(p_words).split(' ', QString::SkipEmptyParts);
+    for (auto const &word : words) {
+        p_set.insert(word);
+    }
+}
+
+static QSharedPointer<LanguageSpec> cLanguageSpec(bool p_cpp)
+{
+    QSharedPointer<LanguageSpec> spec(new LanguageSpec());
+    addWords(spec->m_keywords,
+             "auto break case const continue default do else enum extern for goto if "
+             "inline register restrict return sizeof static struct switch typedef union "
+             "volatile while _Alignas _Alignof _Atomic _Bool _Complex _Generic _Imaginary "
+             "_Noreturn _Static_assert _Thread_local");
+    addWords(spec->m_types,
+             "char double float int long short signed unsigned void bool size_t ssize_t "
+             "ptrdiff_t int8_t int16_t int32_t int64_t uint8_t uint16_t uint32_t uint64_t "
+             "intptr_t uintptr_t wchar_t FILE");
+    addWords(spec->m_literals, "NULL true false");
+    addWords(spec->m_builtIns,
+             "printf fprintf sprintf snprintf scanf malloc calloc realloc free memcpy "
+             "memset memmove memcmp strlen strcmp strncmp strcpy strncpy strcat fopen "
+             "fclose assert");
+    addWords(spec->m_titleKeywords, "struct enum union");
+
+    if (p_cpp) {
+        addWords(spec->m_keywords,
+                 "alignas alignof and and_eq asm bitand bitor catch class compl concept "
+                 "const_cast constexpr consteval constinit co_await co_return co_yield "
+                 "decltype delete dynamic_cast explicit export final friend mutable "
+                 "namespace new noexcept not not_eq operator or or_eq override private "
+                 "protected public reinterpret_cast requires static_assert static_cast "
+                 "template this thread_local throw try typeid typename using virtual "
+                 "xor xor_eq");
+        addWords(spec->m_types,
+                 "char8_t char16_t char32_t string wstring vector map set list deque "
+                 "unordered_map unordered_set shared_ptr unique_ptr weak_ptr");
+        addWords(spec->m_literals, "nullptr");
+        addWords(spec->m_builtIns,
+                 "std cout cin cerr clog endl move forward make_shared make_unique");
+        addWords(spec->m_titleKeywords, "class namespace");
+    }
+
+    spec->m_lineComments << "//";
+    spec->m_blockCommentStart = "/*";
+    spec->m_blockCommentEnd = "*/";
+    spec->m_quotes = "\"'";
+    spec->m_preprocessor = true;
+    return spec;
+}
+
+static QSharedPointer<LanguageSpec> pythonLanguageSpec()
+{
+    QSharedPointer<LanguageSpec> spec(new LanguageSpec());
+    addWords(spec->m_keywords,
+             "and as assert async await break class continue def del elif else except "
+             "finally for from global if import in is lambda nonlocal not or pass raise "
+             "return try while with yield");
+    addWords(spec->m_literals, "True False None Ellipsis NotImplemented");
+    addWords(spec->m_builtIns,
+             "print len range open int str float list dict set tuple bool bytes type "
+             "isinstance issubclass super object enumerate zip map filter sorted reversed "
+             "min max sum abs any all iter next repr input getattr setattr hasattr");
+    addWords(spec->m_titleKeywords, "def class");
+    spec->m_lineComments << "#";
+    spec->m_quotes = "\"'";
+    spec->m_tripleQuoteString = true;
+    spec->m_decorator = true;
+    return spec;
+}
+
+static QSharedPointer<LanguageSpec> javaScriptLanguageSpec()
+{
+    QSharedPointer<LanguageSpec> spec(new LanguageSpec());
+    addWords(spec->m_keywords,
+             "as async await break case catch class const continue debugger default "
+             "delete do else export extends finally for from function get if import in "
+             "instanceof let new of return set static super switch this throw try typeof "
+             "var void while with yield");
+    addWords(spec->m_literals, "true false null undefined NaN Infinity");
+    addWords(spec->m_builtIns,
+             "Array Boolean Date Error Function JSON Math Map Number Object Promise Proxy "
+             "Reflect RegExp Set String Symbol WeakMap WeakSet console window document "
+             "require module exports parseInt parseFloat setTimeout setInterval "
+             "clearTimeout clearInterval");
+    addWords(spec->m_titleKeywords, "function class");
+    spec->m_lineComments << "//";
+    spec->m_blockCommentStart = "/*";
+    spec->m_blockCommentEnd = "*/";
+    spec->m_quotes = "\"'";
+    spec->m_multiLineQuotes = "`";
+    spec->m_dollarInIdentifier = true;
+    return spec;
+}
+
+static QSharedPointer<LanguageSpec> shellLanguageSpec()
+{
+    QSharedPointer<LanguageSpec> spec(new LanguageSpec());
+    addWords(spec->m_keywords,
+             "if then else elif fi for while until do done case esac in function select "
+             "time return break continue exit local export readonly declare unset shift "
+             "source alias");
+    addWords(spec->m_literals, "true false");
+    addWords(spec->m_builtIns,
+             "echo printf cd pwd read test eval exec set trap wait kill cat grep sed awk "
+             "ls mkdir rm cp mv chmod chown sudo make git find xargs sort uniq head tail "
+             "tr cut curl wget tar");
+    addWords(spec->m_titleKeywords, "function");
+    spec->m_lineComments << "#";
+    spec->m_multiLineQuotes = "\"'";
+    spec->m_shellVariable = true;
+    spec->m_hashCommentNeedsSpace = true;
+    return spec;
+}
+
+static QSharedPointer<LanguageSpec> jsonLanguageSpec()
+{
+    QSharedPointer<LanguageSpec> spec(new LanguageSpec());
+    addWords(spec->m_literals, "true false null");
+    spec->m_quotes = "\"";
+    spec->m_jsonKey = true;
+    return spec;
+}
+
+static QSharedPointer<LanguageSpec> yamlLanguageSpec()
+{
+    QSharedPointer<LanguageSpec> spec(new LanguageSpec());
+    addWords(spec->m_literals, "true false yes no on off null True False Yes No On Off Null");
+    spec->m_lineComments << "#";
+    spec->m_quotes = "\"'";
+    spec->m_hashCommentNeedsSpace = true;
+    spec->m_yamlKey = true;
+    return spec;
+}
+
+static QSharedPointer<LanguageSpec> sqlLanguageSpec()
+{
+    QSharedPointer<LanguageSpec> spec(new LanguageSpec());
+    addWords(spec->m_keywords,
+             "select from where and or not insert into values update set delete create "
+             "table drop alter add column index view primary key foreign references join "
+             "inner left right outer full cross on as group by order having limit offset "
+             "union all distinct case when then else end is in like between exists begin "
+             "commit rollback transaction database if default unique constraint check "
+             "returning with desc asc");
+    addWords(spec->m_types,
+             "int integer bigint smallint tinyint decimal numeric float real double char "
+             "varchar text date time timestamp datetime boolean blob serial");
+    addWords(spec->m_literals, "null true false");
+    addWords(spec->m_builtIns,
+             "count sum avg min max coalesce now cast upper lower length substring round");
+    spec->m_lineComments << "--";
+    spec->m_blockCommentStart = "/*";
+    spec->m_blockCommentEnd = "*/";
+    spec->m_quotes = "'\"";
+    spec->m_caseInsensitive = true;
+    return spec;
+}
+
+typedef QHash<QString, QSharedPointer<LanguageSpec>> LanguageSpecHash;
+
+static LanguageSpecHash initLanguageSpecs()
+{
+    LanguageSpecHash specs;
+
+    auto c = cLanguageSpec(false);
+    for (auto const &lang : { "c", "h" }) {
+        specs.insert(lang, c);
+    }
+
+    auto cpp = cLanguageSpec(true);
+    for (auto const &lang : { "cpp", "c++", "cc", "cxx", "hpp", "hxx", "h++" }) {
+        specs.insert(lang, cpp);
+    }
+
+    auto python = pythonLanguageSpec();
+    for (auto const &lang : { "python", "py", "python3", "gyp" }) {
+        specs.insert(lang, python);
+    }
+
+    auto js = javaScriptLanguageSpec();
+    for (auto const &lang : { "javascript", "js", "jsx", "mjs" }) {
+        specs.insert(lang, js);
+    }
+
+    auto shell = shellLanguageSpec();
+    for (auto const &lang : { "bash", "sh", "shell", "zsh" }) {
+        specs.insert(lang, shell);
+    }
+
+    specs.insert("json", jsonLanguageSpec());
+
+    auto yaml = yamlLanguageSpec();
+    for (auto const &lang : { "yaml", "yml" }) {
+        specs.insert(lang, yaml);
+    }
+
+    specs.insert("sql", sqlLanguageSpec());
+
+    return specs;
+}
+
+// Initialized once and then read-only, so it is safe to access from workers.
+static const LanguageSpecHash &languageSpecs()
+{
+    static const LanguageSpecHash specs = initLanguageSpecs();
+    return specs;
+}
+
+// Get the language name from the info string of the fence, such as
+// "cpp" from "C++ {.numberLines}".
+static QString normalizeLanguage(const QString &p_lang)
+{
+    QString lang = p_lang.trimmed().toLower();
+    int idx = 0;
+    while (idx < lang.size()
+           && !lang[idx].isSpace()
+           && lang[idx] != '{'
+           && lang[idx] != ',') {
+        ++idx;
+    }
+
+    return lang.left(idx);
+}
+
+static const LanguageSpec *findLanguageSpec(const QString &p_lang)
+{
+    const LanguageSpecHash &specs = languageSpecs();
+    auto it = specs.find(normalizeLanguage(p_lang));
+    if (it == specs.end()) {
+        return NULL;
+    }
+
+    return it.value().data();
+}
+
+static void appendUnit(QVector<HLUnitPos> &p_units, int p_start, int p_end, const QString &p_style)
+{
+    if (p_end > p_start) {
+        p_units.append(HLUnitPos(p_start, p_end - p_start, p_style));
+    }
+}
+
+// Whether @p_str is at @p_pos of @p_text and ends before @p_end.
+static bool matchAt(const QString &p_text, int p_pos, int p_end, const QString &p_str)
+{
+    if (p_str.isEmpty() || p_pos + p_str.size() > p_end) {
+        return false;
+    }
+
+    return p_text.midRef(p_pos, p_str.size()) == p_str;
+}
+
+// Return the index of the '\n' ending the line at @p_pos, or @p_end.
+static int lineEnd(const QString &p_text, int p_pos, int p_end)
+{
+    int idx = p_text.indexOf('\n', p_pos);
+    if (idx == -1 || idx > p_end) {
+        idx = p_end;
+    }
+
+    return idx;
+}
+
+static bool isIdentifierStart(const QChar &p_ch, const LanguageSpec *p_spec)
+{
+    return p_ch.isLetter()
+           || p_ch == '_'
+           || (p_spec->m_dollarInIdentifier && p_ch == '$');
+}
+
+static bool isIdentifierChar(const QChar &p_ch, const LanguageSpec *p_spec)
+{
+    return p_ch.isLetterOrNumber()
+           || p_ch == '_'
+           || (p_spec->m_dollarInIdentifier && p_ch == '$');
+}
+
+// Try to match a YAML "key:" at @p_pos, which is the first non-space character
+// of a line. Returns the end of the key or -1. @p_keyStart will be set to the
+// start of the key after skipping the sequence markers.
+static int matchYamlKey(const QString &p_text, int p_pos, int p_end, int &p_keyStart)
+{
+    int idx = p_pos;
+    while (idx + 1 < p_end && p_text[idx] == '-' && p_text[idx + 1] == ' ') {
+        idx += 2;
+        while (idx < p_end && p_text[idx] == ' ') {
+            ++idx;
+        }
+    }
+
+    if (idx >= p_end) {
+        return -1;
+    }
+
+    QChar first = p_text[idx];
+    if (first == '"' || first == '\'' || first == '[' || first == '{' || first == '#') {
+        return -1;
+    }
+
+    p_keyStart = idx;
+    for (; idx < p_end; ++idx) {
+        QChar ch = p_text[idx];
+        if (ch == '\n' || ch == '#') {
+            break;
+        }
+
+        if (ch == ':'
+            && (idx + 1 == p_end || p_text[idx + 1] == ' ' || p_text[idx + 1] == '\n')) {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+QVector<HLUnitPos> VCodeBlockTokenizer::tokenize(const QString &p_lang,
+                                                 const QString &p_text,
+                                                 const QAtomicInt &p_stop)
+{
+    QVector<HLUnitPos> units;
+    const LanguageSpec *spec = findLanguageSpec(p_lang);
+    if (!spec) {
+        return units;
+    }
+
+    // Skip the start fence.
+    int pos = p_text.indexOf('\n');
+    if (pos == -1) {
+        return units;
+    }
+
+    ++pos;
+
+    // Skip the end fence.
+    const int end = p_text.lastIndexOf('\n');
+    if (end < pos) {
+        return units;
+    }
+
+    // Only spaces before current position within current line.
+    bool atLineStart = true;
+
+    // Previous identifier is a keyword followed by a title.
+    bool expectTitle = false;
+
+    int i = pos;
+    while (i < end) {
+        const QChar ch = p_text[i];
+        if (ch == '\n') {
+            if (p_stop.load() == 1) {
+                units.clear();
+                return units;
+            }
+
+            atLineStart = true;
+            expectTitle = false;
+            ++i;
+            continue;
+        }
+
+        if (ch.isSpace()) {
+            ++i;
+            continue;
+        }
+
+        const bool lineStart = atLineStart;
+        atLineStart = false;
+
+        if (spec->m_yamlKey && lineStart) {
+            if ((matchAt(p_text, i, end, "---") || matchAt(p_text, i, end, "..."))
+                && lineEnd(p_text, i, end) == i + 3) {
+                appendUnit(units, i, i + 3, c_metaStyle);
+                i += 3;
+                continue;
+            }
+
+            int keyStart = i;
+            int keyEnd = matchYamlKey(p_text, i, end, keyStart);
+            if (keyEnd != -1) {
+                appendUnit(units, keyStart, keyEnd, c_attrStyle);
+                i = keyEnd + 1;
+                continue;
+            }
+        }
+
+        // Shell variables.
+        if (spec->m_shellVariable && ch == '$' && i + 1 < end) {
+            const QChar next = p_text[i + 1];
+            int varEnd = -1;
+            if (next == '{') {
+                varEnd = p_text.indexOf('}', i + 2);
+                if (varEnd == -1 || varEnd > lineEnd(p_text, i, end)) {
+                    varEnd = i + 2;
+                } else {
+                    ++varEnd;
+                }
+            } else if (isIdentifierStart(next, spec)) {
+                varEnd = i + 2;
+                while (varEnd < end && isIdentifierChar(p_text[varEnd], spec)) {
+                    ++varEnd;
+                }
+            } else if (next.isDigit() || QString("#?@*!$-_").contains(next)) {
+                varEnd = i + 2;
+            }
+
+            if (varEnd != -1) {
+                appendUnit(units, i, varEnd, c_variableStyle);
+                i = varEnd;
+                expectTitle = false;
+                continue;
+            }
+        }
+
+        // Line comment.
+        bool isComment = false;
+        for (auto const &mark : spec->m_lineComments) {
+            if (matchAt(p_text, i, end, mark)) {
+                isComment = !spec->m_hashCommentNeedsSpace || p_text[i - 1].isSpace();
+                break;
+            }
+        }
+
+        if (isComment) {
+            int commentEnd = lineEnd(p_text, i, end);
+            appendUnit(units, i, commentEnd, c_commentStyle);
+            i = commentEnd;
+            continue;
+        }
+
+        // Block comment.
+        if (matchAt(p_text, i, end, spec->m_blockCommentStart)) {
+            int commentEnd = p_text.indexOf(spec->m_blockCommentEnd,
+                                            i + spec->m_blockCommentStart.size());
+            if (commentEnd == -1 || commentEnd + spec->m_blockCommentEnd.size() > end) {
+                commentEnd = end;
+            } else {
+                commentEnd += spec->m_blockCommentEnd.size();
+            }
+
+            appendUnit(units, i, commentEnd, c_commentStyle);
+            i = commentEnd;
+            continue;
+        }
+
+        // Preprocessor directive, including the continued lines.
+        if (spec->m_preprocessor && lineStart && ch == '#') {
+            int metaEnd = lineEnd(p_text, i, end);
+            while (metaEnd < end && p_text[metaEnd - 1] == '\\') {
+                metaEnd = lineEnd(p_text, metaEnd + 1, end);
+            }
+
+            appendUnit(units, i, metaEnd, c_metaStyle);
+            i = metaEnd;
+            continue;
+        }
+
+        // Decorator.
+        if (spec->m_decorator && lineStart && ch == '@') {
+            int metaEnd = i + 1;
+            while (metaEnd < end
+                   && (isIdentifierChar(p_text[metaEnd], spec) || p_text[metaEnd] == '.')) {
+                ++metaEnd;
+            }
+
+            appendUnit(units, i, metaEnd, c_metaStyle);
+            i = metaEnd;
+            continue;
+        }
+
+        // Triple-quoted string.
+        if (spec->m_tripleQuoteString && (ch == '"' || ch == '\'')) {
+            const QString quotes(3, ch);
+            if (matchAt(p_text, i, end, quotes)) {
+                int strEnd = p_text.indexOf(quotes, i + 3);
+                if (strEnd == -1 || strEnd + 3 > end) {
+                    strEnd = end;
+                } else {
+                    strEnd += 3;
+                }
+
+                appendUnit(units, i, strEnd, c_stringStyle);
+                i = strEnd;
+                continue;
+            }
+        }
+
+        // String.
+        const bool multiLine = spec->m_multiLineQuotes.contains(ch);
+        if (multiLine || spec->m_quotes.contains(ch)) {
+            int strEnd = i + 1;
+            while (strEnd < end) {
+                const QChar sch = p_text[strEnd];
+                if (sch == '\\') {
+                    strEnd += 2;
+                    continue;
+                }
+
+                ++strEnd;
+                if (sch == ch || (sch == '\n' && !multiLine)) {
+                    break;
+                }
+            }
+
+            if (strEnd > end) {
+                strEnd = end;
+            }
+
+            const QString *style = &c_stringStyle;
+            if (spec->m_jsonKey) {
+                int idx = strEnd;
+                while (idx < end && (p_text[idx] == ' ' || p_text[idx] == '\t')) {
+                    ++idx;
+                }
+
+                if (idx < end && p_text[idx] == ':') {
+                    style = &c_attrStyle;
+                }
+            }
+
+            appendUnit(units, i, strEnd, *style);
+            i = strEnd;
+            expectTitle = false;
+            continue;
+        }
+
+        // Number.
+        if (ch.isDigit() || (ch == '.' && i + 1 < end && p_text[i + 1].isDigit())) {
+            const bool isHex = ch == '0'
+                               && i + 1 < end
+                               && (p_text[i + 1] == 'x' || p_text[i + 1] == 'X');
+            int numEnd = i + 1;
+            while (numEnd < end) {
+                const QChar nch = p_text[numEnd];
+                if (nch.isLetterOrNumber() || nch == '.' || nch == '_') {
+                    ++numEnd;
+                } else if ((nch == '+' || nch == '-')
+                           && !isHex
+                           && (p_text[numEnd - 1] == 'e' || p_text[numEnd - 1] == 'E')) {
+                    ++numEnd;
+                } else {
+                    break;
+                }
+            }
+
+            appendUnit(units, i, numEnd, c_numberStyle);
+            i = numEnd;
+            expectTitle = false;
+            continue;
+        }
+
+        // Identifier.
+        if (isIdentifierStart(ch, spec)) {
+            int wordEnd = i + 1;
+            while (wordEnd < end && isIdentifierChar(p_text[wordEnd], spec)) {
+                ++wordEnd;
+            }
+
+            // Members after '.' are never keywords.
+            if (i > pos && p_text[i - 1] == '.') {
+                i = wordEnd;
+                expectTitle = false;
+                continue;
+            }
+
+            QString word = p_text.mid(i, wordEnd - i);
+            if (spec->m_caseInsensitive) {
+                word = word.toLower();
+            }
+
+            const QString *style = NULL;
+            if (expectTitle) {
+                style = &c_titleStyle;
+            } else if (spec->m_keywords.contains(word)) {
+                style = &c_keywordStyle;
+            } else if (spec->m_types.contains(word)) {
+                style = &c_typeStyle;
+            } else if (spec->m_literals.contains(word)) {
+                style = &c_literalStyle;
+            } else if (spec->m_builtIns.contains(word)) {
+                style = &c_builtInStyle;
+            } else if (spec->m_shellVariable && wordEnd < end && p_text[wordEnd] == '=') {
+                style = &c_variableStyle;
+            }
+
+            if (style) {
+                appendUnit(units, i, wordEnd, *style);
+            }
+
+            expectTitle = !expectTitle && spec->m_titleKeywords.contains(word);
+            i = wordEnd;
+            continue;
+        }
+
+        // Punctuation.
+        expectTitle = false;
+        ++i;
+    }
+
+    return units;
+}
+
+bool VCodeBlockTokenizer::isLanguageSupported(const QString &p_lang)
+{
+    return findLanguageSpec(p_lang) != NULL;
+}
+
+
+VCodeBlockTokenizerWorker::VCodeBlockTokenizerWorker(QObject *p_parent)
+    : QThread(p_parent),
+      m_stop(0),
+      m_timeStamp(0)
+{
+}
+
+void VCodeBlockTokenizerWorker::setData(TimeStamp p_timeStamp,
+                                        const QVector<VCodeBlockTokenizeJob> &p_jobs)
+{
+    m_timeStamp = p_timeStamp;
+    m_jobs = p_jobs;
+}
+
+void VCodeBlockTokenizerWorker::stop()
+{
+    m_stop.store(1);
+}
+
+void VCodeBlockTokenizerWorker::run()
+{
+    m_results.clear();
+    m_results.reserve(m_jobs.size());
+    for (auto const &job : m_jobs) {
+        if (isAskedToStop()) {
+            return;
+        }
+
+        VCodeBlockTokenizeResult res;
+        res.m_id = job.m_id;
+        res.m_units = VCodeBlockTokenizer::tokenize(job.m_lang, job.m_text, m_stop);
+        m_results.append(res);
+    }
+}
+
+
+VCodeBlockTokenizer::VCodeBlockTokenizer(QObject *p_parent)
+    : QObject(p_parent)
+{
+}
+
+VCodeBlockTokenizer::~VCodeBlockTokenizer()
+{
+    for (auto const & th : m_workers) {
+        th->stop();
+    }
+
+    for (auto const & th : m_workers) {
+        th->wait();
+        delete th;
+    }
+
+    m_workers.clear();
+}
+
+void VCodeBlockTokenizer::stopAllWorkers()
+{
+    for (auto const & th : m_workers) {
+        th->stop();
+    }
+}
+
+void VCodeBlockTokenizer::tokenizeAsync(TimeStamp p_timeStamp,
+                                        const QVector<VCodeBlockTokenizeJob> &p_jobs)
+{
+    // Results of obsolete workers will be abandoned.
+    stopAllWorkers();
+
+    if (p_jobs.isEmpty()) {
+        return;
+    }
+
+    int numThread = qMin(QThread::idealThreadCount(), MAX_NUM_OF_THREADS);
+    if (numThread < 1) {
+        numThread = 1;
+    }
+
+    if (p_jobs.size() < numThread) {
+        numThread = p_jobs.size();
+    }
+
+    // Distribute the jobs in turn so large blocks in a row will not land in
+    // the same worker.
+    QVector<QVector<VCodeBlockTokenizeJob>> slices(numThread);
+    for (int i = 0; i < p_jobs.size(); ++i) {
+        slices[i % numThread].append(p_jobs[i]);
+    }
+
+    for (int i = 0; i < numThread; ++i) {
+        VCodeBlockTokenizerWorker *th = new VCodeBlockTokenizerWorker(this);
+        th->setData(p_timeStamp, slices[i]);
+        connect(th, &VCodeBlockTokenizerWorker::finished,
+                this, &VCodeBlockTokenizer::handleWorkerFinished);
+
+        m_workers.append(th);
+        th->start();
+    }
+
+    qDebug() << "schedule code block tokenizing" << p_timeStamp << p_jobs.size() << numThread;
+}
+
+void VCodeBlockTokenizer::handleWorkerFinished()
+{
+    VCodeBlockTokenizerWorker *th = static_cast<VCodeBlockTokenizerWorker *>(sender());
+    m_workers.removeOne(th);
+
+    if (!th->isAskedToStop()) {
+        TimeStamp timeStamp = th->timeStamp();
+        const QVector<VCodeBlockTokenizeResult> &results = th->results();
+        for (auto const &res : results) {
+            emit tokenizeFinished(timeStamp, res.m_id, res.m_units);
+        }
+    }
+
+    th->deleteLater();
+}
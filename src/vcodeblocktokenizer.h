@@ -0,0 +1,119 @@
+#ifndef VCODEBLOCKTOKENIZER_H
+#define VCODEBLOCKTOKENIZER_H
+
+#include <QObject>
+#include <QThread>
+#include <QAtomicInt>
+#include <QVector>
+
+#include "vconstants.h"
+#include "markdownhighlighterdata.h"
+
+// One fenced code block to tokenize.
+struct VCodeBlockTokenizeJob
+{
+    VCodeBlockTokenizeJob()
+        : m_id(-1)
+    {
+    }
+
+    VCodeBlockTokenizeJob(int p_id, const QString &p_lang, const QString &p_text)
+        : m_id(p_id),
+          m_lang(p_lang),
+          m_text(p_text)
+    {
+    }
+
+    int m_id;
+
+    QString m_lang;
+
+    // Text of the fenced code block, including the fences.
+    QString m_text;
+};
+
+struct VCodeBlockTokenizeResult
+{
+    int m_id;
+
+    // Positions are relative to the start of the code block text.
+    QVector<HLUnitPos> m_units;
+};
+
+class VCodeBlockTokenizerWorker : public QThread
+{
+    Q_OBJECT
+public:
+    explicit VCodeBlockTokenizerWorker(QObject *p_parent = nullptr);
+
+    void setData(TimeStamp p_timeStamp, const QVector<VCodeBlockTokenizeJob> &p_jobs);
+
+    TimeStamp timeStamp() const
+    {
+        return m_timeStamp;
+    }
+
+    bool isAskedToStop() const
+    {
+        return m_stop.load() == 1;
+    }
+
+    const QVector<VCodeBlockTokenizeResult> &results() const
+    {
+        return m_results;
+    }
+
+public slots:
+    void stop();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QAtomicInt m_stop;
+
+    TimeStamp m_timeStamp;
+
+    QVector<VCodeBlockTokenizeJob> m_jobs;
+
+    QVector<VCodeBlockTokenizeResult> m_results;
+};
+
+
+// Native highlighter for fenced code blocks of common languages.
+// It produces the same hljs-* style names as highlight.js so the code block
+// styles of the editor style apply as is.
+class VCodeBlockTokenizer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VCodeBlockTokenizer(QObject *p_parent = nullptr);
+
+    ~VCodeBlockTokenizer();
+
+    // Tokenize @p_jobs in worker threads.
+    // Jobs of previous time stamp will be cancelled.
+    void tokenizeAsync(TimeStamp p_timeStamp, const QVector<VCodeBlockTokenizeJob> &p_jobs);
+
+    // Whether @p_lang (the info string of the fence) is supported natively.
+    static bool isLanguageSupported(const QString &p_lang);
+
+    // @p_text: text of the fenced code block, including the fences.
+    // Returns highlight units with position relative to @p_text.
+    static QVector<HLUnitPos> tokenize(const QString &p_lang,
+                                       const QString &p_text,
+                                       const QAtomicInt &p_stop);
+
+signals:
+    void tokenizeFinished(TimeStamp p_timeStamp, int p_id, const QVector<HLUnitPos> &p_units);
+
+private slots:
+    void handleWorkerFinished();
+
+private:
+    void stopAllWorkers();
+
+    QVector<VCodeBlockTokenizerWorker *> m_workers;
+};
+
+#endif // VCODEBLOCKTOKENIZER_H
@@ -46,6 +46,8 @@ const QString VConfigManager::c_snippetConfigFolder = QString("snippets");
 
 const QString VConfigManager::c_resourceConfigFolder = QString("resources");
 
+const QString VConfigManager::c_cacheConfigFolder = QString("cache");
+
 const QString VConfigManager::c_warningTextStyle = QString("color: #C9302C; font: bold");
 
 const QString VConfigManager::c_dataTextStyle = QString("font: bold");
@@ -245,6 +247,16 @@ void VConfigManager::initialize()
     m_markdownItOpt = MarkdownitOption::fromConfig(getConfigFromSettings("web",
                                                                          "markdownit_opt").toStringList());
 
+    m_nativeRenderSize = getConfigFromSettings("web", "native_render_size").toInt();
+
+    m_webViewPoolSize = getConfigFromSettings("web", "web_view_pool_size").toInt();
+
+    m_exportPages = getConfigFromSettings("export", "export_pages").toInt();
+
+    m_wkhtmltopdfProcesses = getConfigFromSettings("export", "wkhtmltopdf_processes").toInt();
+
+    m_pdfMergeCommand = getConfigFromSettings("export", "pdf_merge_command").toString();
+
     m_recycleBinFolder = getConfigFromSettings("global",
                                                "recycle_bin_folder").toString();
 
@@ -319,6 +331,8 @@ void VConfigManager::initialize()
 
     m_plantUMLCmd = getConfigFromSettings("web", "plantuml_cmd").toString();
 
+    m_plantUMLProcessPoolSize = getConfigFromSettings("web", "plantuml_process_pool_size").toInt();
+
     m_enableGraphviz = getConfigFromSettings("global", "enable_graphviz").toBool();
     m_graphvizDot = getConfigFromSettings("web", "graphviz_dot").toString();
 
@@ -406,6 +420,26 @@ void VConfigManager::initEditorConfigs()
     m_enableSmartTable = getConfigFromSettings(section, "enable_smart_table").toBool();
 
     m_tableFormatIntervalMS = getConfigFromSettings(section, "table_format_interval").toInt();
+
+    m_enableNativeCodeBlockHighlight = getConfigFromSettings(section,
+                                                             "enable_native_code_block_highlight").toBool();
+
+    m_codeBlockHighlightCacheSize = getConfigFromSettings(section,
+                                                          "code_block_highlight_cache_size").toInt();
+
+    m_enableLazyLayout = getConfigFromSettings(section, "enable_lazy_layout").toBool();
+
+    m_previewImageCacheSize = getConfigFromSettings(section,
+                                                    "preview_image_cache_size").toInt();
+
+    m_previewThumbnailCacheSize = getConfigFromSettings(section,
+                                                        "preview_thumbnail_cache_size").toInt();
+
+    m_renderResultCacheSize = getConfigFromSettings(section,
+                                                    "render_result_cache_size").toInt();
+
+    m_previewDownloadCacheSize = getConfigFromSettings(section,
+                                                       "preview_download_cache_size").toInt();
 }
 
 void VConfigManager::initMarkdownConfigs()
@@ -920,6 +954,12 @@ QString VConfigManager::getResourceConfigFolder() const
     return QDir(getConfigFolder()).filePath(c_resourceConfigFolder);
 }
 
+const QString &VConfigManager::getCacheConfigFolder() const
+{
+    static QString path = QDir(getConfigFolder()).filePath(c_cacheConfigFolder);
+    return path;
+}
+
 const QString &VConfigManager::getCommonCssUrl() const
 {
     static QString cssPath;
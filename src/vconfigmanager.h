@@ -99,6 +99,9 @@ public:
 
     static bool deleteDirectoryConfig(const QString &path);
 
+    // Path of the config json file of directory @p_path.
+    static QString fetchDirConfigFilePath(const QString &p_path);
+
     // Get the path of the folder used to store default notebook.
     static QString getVnoteNotebookFolderPath();
 
@@ -392,6 +395,16 @@ public:
     const MarkdownitOption &getMarkdownitOption() const;
     void setMarkdownitOption(const MarkdownitOption &p_opt);
 
+    int getNativeRenderSize() const;
+
+    int getWebViewPoolSize() const;
+
+    int getExportPages() const;
+
+    int getWkhtmltopdfProcesses() const;
+
+    const QString &getPdfMergeCommand() const;
+
     const QString &getRecycleBinFolder() const;
 
     const QString &getRecycleBinFolderExt() const;
@@ -480,6 +493,9 @@ public:
     // Get the folder c_resourceConfigFolder in the config folder.
     QString getResourceConfigFolder() const;
 
+    // Get the folder c_cacheConfigFolder in the config folder.
+    const QString &getCacheConfigFolder() const;
+
     const QString &getCommonCssUrl() const;
 
     // All the editor styles.
@@ -576,6 +592,8 @@ public:
     const QStringList &getPlantUMLArgs() const;
     const QString &getPlantUMLCmd() const;
 
+    int getPlantUMLProcessPoolSize() const;
+
     const QString &getGraphvizDot() const;
     void setGraphvizDot(const QString &p_dotPath);
 
@@ -646,6 +664,25 @@ public:
 
     int getTableFormatInterval() const;
 
+    bool getEnableNativeCodeBlockHighlight() const;
+
+    // In KB.
+    int getCodeBlockHighlightCacheSize() const;
+
+    bool getEnableLazyLayout() const;
+
+    // In MB.
+    int getPreviewImageCacheSize() const;
+
+    // In MB.
+    int getPreviewThumbnailCacheSize() const;
+
+    // In MB.
+    int getRenderResultCacheSize() const;
+
+    // In MB.
+    int getPreviewDownloadCacheSize() const;
+
     bool getEnableCodeBlockCopyButton() const;
     void setEnableCodeBlockCopyButton(bool p_enabled);
 
@@ -763,8 +800,6 @@ private:
 
     void updateMarkdownEditStyle();
 
-    static QString fetchDirConfigFilePath(const QString &p_path);
-
     // Read the [shortcuts] section in settings to init m_shortcuts.
     // Will remove invalid config items.
     // First read the config in default settings;
@@ -1035,6 +1070,21 @@ private:
     // Markdown-it option.
     MarkdownitOption m_markdownItOpt;
 
+    // Render notes larger than this size (KB) natively in read mode.
+    int m_nativeRenderSize;
+
+    // Number of idle web views kept in advance.
+    int m_webViewPoolSize;
+
+    // Number of notes exported concurrently.
+    int m_exportPages;
+
+    // Number of wkhtmltopdf processes to export all notes in one PDF.
+    int m_wkhtmltopdfProcesses;
+
+    // Command to merge PDF chunks.
+    QString m_pdfMergeCommand;
+
     // Default name of the recycle bin folder of notebook.
     QString m_recycleBinFolder;
 
@@ -1136,6 +1186,9 @@ private:
 
     QString m_plantUMLCmd;
 
+    // Max number of long-lived local PlantUML processes.
+    int m_plantUMLProcessPoolSize;
+
     // Github image hosting.
     QString m_githubPersonalAccessToken;
     QString m_githubReposName;
@@ -1237,6 +1290,27 @@ private:
     // Interval (milliseconds) to format table.
     int m_tableFormatIntervalMS;
 
+    // Whether highlight code blocks of common languages natively in edit mode.
+    bool m_enableNativeCodeBlockHighlight;
+
+    // Max size (KB) of the code block highlight cache.
+    int m_codeBlockHighlightCacheSize;
+
+    // Whether layout blocks out of the viewport lazily with estimated heights.
+    bool m_enableLazyLayout;
+
+    // Max size (MB) of the in-place preview images of one editor.
+    int m_previewImageCacheSize;
+
+    // Max size (MB) of the thumbnails of preview images on disk.
+    int m_previewThumbnailCacheSize;
+
+    // Max size (MB) of the rendered results of code blocks on disk.
+    int m_renderResultCacheSize;
+
+    // Max size (MB) of the downloaded data of in-place preview images in memory.
+    int m_previewDownloadCacheSize;
+
     // Whether enable copy button in code block in read mode.
     bool m_enableCodeBlockCopyButton;
 
@@ -1291,6 +1365,9 @@ private:
 
     // The folder name of resource files.
     static const QString c_resourceConfigFolder;
+
+    // The folder name of cache files.
+    static const QString c_cacheConfigFolder;
 };
 
 
@@ -2320,6 +2397,31 @@ inline void VConfigManager::setMarkdownitOption(const MarkdownitOption &p_opt)
     setConfigToSettings("web", "markdownit_opt", m_markdownItOpt.toConfig());
 }
 
+inline int VConfigManager::getNativeRenderSize() const
+{
+    return m_nativeRenderSize;
+}
+
+inline int VConfigManager::getWebViewPoolSize() const
+{
+    return m_webViewPoolSize;
+}
+
+inline int VConfigManager::getExportPages() const
+{
+    return m_exportPages;
+}
+
+inline int VConfigManager::getWkhtmltopdfProcesses() const
+{
+    return m_wkhtmltopdfProcesses;
+}
+
+inline const QString &VConfigManager::getPdfMergeCommand() const
+{
+    return m_pdfMergeCommand;
+}
+
 inline const QString &VConfigManager::getRecycleBinFolder() const
 {
     return m_recycleBinFolder;
@@ -2722,6 +2824,11 @@ inline const QString &VConfigManager::getPlantUMLCmd() const
     return m_plantUMLCmd;
 }
 
+inline int VConfigManager::getPlantUMLProcessPoolSize() const
+{
+    return m_plantUMLProcessPoolSize;
+}
+
 inline const QString &VConfigManager::getGraphvizDot() const
 {
     return m_graphvizDot;
@@ -3077,6 +3184,41 @@ inline int VConfigManager::getTableFormatInterval() const
     return m_tableFormatIntervalMS;
 }
 
+inline bool VConfigManager::getEnableNativeCodeBlockHighlight() const
+{
+    return m_enableNativeCodeBlockHighlight;
+}
+
+inline int VConfigManager::getCodeBlockHighlightCacheSize() const
+{
+    return m_codeBlockHighlightCacheSize;
+}
+
+inline bool VConfigManager::getEnableLazyLayout() const
+{
+    return m_enableLazyLayout;
+}
+
+inline int VConfigManager::getPreviewImageCacheSize() const
+{
+    return m_previewImageCacheSize;
+}
+
+inline int VConfigManager::getPreviewThumbnailCacheSize() const
+{
+    return m_previewThumbnailCacheSize;
+}
+
+inline int VConfigManager::getRenderResultCacheSize() const
+{
+    return m_renderResultCacheSize;
+}
+
+inline int VConfigManager::getPreviewDownloadCacheSize() const
+{
+    return m_previewDownloadCacheSize;
+}
+
 inline bool VConfigManager::getEnableCodeBlockCopyButton() const
 {
     return m_enableCodeBlockCopyButton;
@@ -6,9 +6,12 @@
 #include "vconfigmanager.h"
 #include "vnotefile.h"
 #include "utils/vutils.h"
+#include "vdirectoryconfigcache.h"
 
 extern VConfigManager *g_config;
 
+extern VDirectoryConfigCache *g_dirConfigCache;
+
 VDirectory::VDirectory(VNotebook *p_notebook,
                        VDirectory *p_parent,
                        const QString &p_name,
@@ -31,7 +34,8 @@ bool VDirectory::open()
     V_ASSERT(m_subDirs.isEmpty() && m_files.isEmpty());
 
     QString path = fetchPath();
-    QJsonObject configJson = VConfigManager::readDirectoryConfig(path);
+    QJsonObject configJson = g_dirConfigCache->readDirectoryConfig(m_notebook->getPath(),
+                                                                   fetchRelativePath());
     if (configJson.isEmpty()) {
         qWarning() << "invalid directory configuration in path" << path;
         return false;
@@ -0,0 +1,285 @@
+#include "vdirectoryconfigcache.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTimer>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QCryptographicHash>
+
+#include "vconfigmanager.h"
+#include "vconstants.h"
+#include "utils/vutils.h"
+
+// Bump it when the format of the snapshot changes.
+#define SNAPSHOT_VERSION 1
+
+// Wait for more stale entries before rebuilding (ms).
+#define REBUILD_DELAY 3000
+
+static const QString c_version = "version";
+static const QString c_dirs = "dirs";
+static const QString c_modifiedTime = "mtime";
+static const QString c_size = "size";
+static const QString c_config = "config";
+
+// Return the entry of directory @p_path. Reuse @p_entry if the configuration
+// file is unchanged, otherwise read it from disk.
+// Return an empty object if there is no valid configuration.
+static QJsonObject validEntry(const QString &p_path, const QJsonObject &p_entry, bool &p_hit)
+{
+    p_hit = false;
+
+    QFileInfo fi(VConfigManager::fetchDirConfigFilePath(p_path));
+    if (!fi.exists()) {
+        return QJsonObject();
+    }
+
+    double modifiedTime = (double)fi.lastModified().toMSecsSinceEpoch();
+    double size = (double)fi.size();
+    if (!p_entry.isEmpty()
+        && p_entry.value(c_modifiedTime).toDouble() == modifiedTime
+        && p_entry.value(c_size).toDouble() == size) {
+        p_hit = true;
+        return p_entry;
+    }
+
+    QJsonObject config = VConfigManager::readDirectoryConfig(p_path);
+    if (config.isEmpty()) {
+        return QJsonObject();
+    }
+
+    QJsonObject entry;
+    entry[c_modifiedTime] = modifiedTime;
+    entry[c_size] = size;
+    entry[c_config] = config;
+    return entry;
+}
+
+static QString directoryPath(const QString &p_notebookPath, const QString &p_relativePath)
+{
+    if (p_relativePath.isEmpty()) {
+        return p_notebookPath;
+    }
+
+    return QDir(p_notebookPath).filePath(p_relativePath);
+}
+
+VDirectoryConfigCache::VDirectoryConfigCache(const QString &p_folder, QObject *p_parent)
+    : QObject(p_parent),
+      m_folder(p_folder),
+      m_hits(0),
+      m_misses(0),
+      m_rebuilds(0)
+{
+    m_rebuildTimer = new QTimer(this);
+    m_rebuildTimer->setSingleShot(true);
+    m_rebuildTimer->setInterval(REBUILD_DELAY);
+    connect(m_rebuildTimer, &QTimer::timeout,
+            this, &VDirectoryConfigCache::rebuildStaleSnapshots);
+}
+
+VDirectoryConfigCache::~VDirectoryConfigCache()
+{
+    qInfo() << "directory config cache" << statistics();
+
+    for (auto snapshot : m_snapshots) {
+        if (snapshot->m_worker) {
+            snapshot->m_worker->disconnect(this);
+            snapshot->m_worker->wait();
+            delete snapshot->m_worker;
+        }
+
+        delete snapshot;
+    }
+
+    m_snapshots.clear();
+}
+
+QString VDirectoryConfigCache::snapshotFilePath(const QString &p_notebookPath) const
+{
+    QByteArray hash = QCryptographicHash::hash(p_notebookPath.toUtf8(),
+                                               QCryptographicHash::Sha1);
+    return QDir(m_folder).filePath(QString::fromLatin1(hash.toHex()) + ".snapshot");
+}
+
+VDirectoryConfigCache::Snapshot *VDirectoryConfigCache::getSnapshot(const QString &p_notebookPath)
+{
+    auto it = m_snapshots.find(p_notebookPath);
+    if (it != m_snapshots.end()) {
+        return it.value();
+    }
+
+    Snapshot *snapshot = new Snapshot();
+    m_snapshots.insert(p_notebookPath, snapshot);
+
+    QFile file(snapshotFilePath(p_notebookPath));
+    if (file.open(QIODevice::ReadOnly)) {
+        QJsonObject root = QJsonDocument::fromBinaryData(file.readAll()).object();
+        if (root.value(c_version).toInt() == SNAPSHOT_VERSION) {
+            snapshot->m_dirs = root.value(c_dirs).toObject();
+        }
+
+        qDebug() << "load directory config snapshot of" << p_notebookPath
+                 << snapshot->m_dirs.size() << "directories";
+    }
+
+    return snapshot;
+}
+
+QJsonObject VDirectoryConfigCache::readDirectoryConfig(const QString &p_notebookPath,
+                                                       const QString &p_relativePath)
+{
+    Snapshot *snapshot = getSnapshot(p_notebookPath);
+
+    QJsonObject oldEntry = snapshot->m_updates.value(p_relativePath);
+    if (oldEntry.isEmpty()) {
+        oldEntry = snapshot->m_dirs.value(p_relativePath).toObject();
+    }
+
+    bool hit = false;
+    QJsonObject entry = validEntry(directoryPath(p_notebookPath, p_relativePath),
+                                   oldEntry,
+                                   hit);
+    if (hit) {
+        ++m_hits;
+    } else {
+        ++m_misses;
+        if (!entry.isEmpty()) {
+            snapshot->m_updates.insert(p_relativePath, entry);
+        }
+
+        snapshot->m_stale = true;
+        m_rebuildTimer->start();
+    }
+
+    return entry.value(c_config).toObject();
+}
+
+void VDirectoryConfigCache::rebuildStaleSnapshots()
+{
+    if (!VUtils::makePath(m_folder)) {
+        qWarning() << "fail to create directory config snapshot folder" << m_folder;
+        return;
+    }
+
+    for (auto it = m_snapshots.begin(); it != m_snapshots.end(); ++it) {
+        Snapshot *snapshot = it.value();
+        if (!snapshot->m_stale || snapshot->m_worker) {
+            // A running worker will pick it up when finished.
+            continue;
+        }
+
+        // Entries read since then are passed to the worker.
+        for (auto uit = snapshot->m_updates.constBegin();
+             uit != snapshot->m_updates.constEnd();
+             ++uit) {
+            snapshot->m_dirs.insert(uit.key(), uit.value());
+        }
+
+        snapshot->m_updates.clear();
+        snapshot->m_stale = false;
+
+        snapshot->m_worker = new VDirectorySnapshotWorker(it.key(),
+                                                          snapshot->m_dirs,
+                                                          snapshotFilePath(it.key()),
+                                                          this);
+        connect(snapshot->m_worker, &QThread::finished,
+                this, &VDirectoryConfigCache::handleWorkerFinished);
+        snapshot->m_worker->start();
+        ++m_rebuilds;
+    }
+}
+
+void VDirectoryConfigCache::handleWorkerFinished()
+{
+    VDirectorySnapshotWorker *worker = static_cast<VDirectorySnapshotWorker *>(sender());
+    Snapshot *snapshot = m_snapshots.value(worker->notebookPath(), NULL);
+    Q_ASSERT(snapshot && snapshot->m_worker == worker);
+    snapshot->m_worker = NULL;
+
+    if (worker->succeeded()) {
+        snapshot->m_dirs = worker->dirs();
+        qDebug() << "directory config snapshot of" << worker->notebookPath()
+                 << "rebuilt with" << snapshot->m_dirs.size() << "directories";
+    }
+
+    worker->deleteLater();
+
+    if (snapshot->m_stale) {
+        m_rebuildTimer->start();
+    }
+}
+
+QString VDirectoryConfigCache::statistics() const
+{
+    unsigned long long total = m_hits + m_misses;
+    double hitRate = total > 0 ? m_hits * 100.0 / total : 0;
+    return QString("notebooks %1 hits %2 misses %3 hit rate %4% rebuilds %5")
+                  .arg(m_snapshots.size())
+                  .arg(m_hits)
+                  .arg(m_misses)
+                  .arg(hitRate, 0, 'f', 1)
+                  .arg(m_rebuilds);
+}
+
+VDirectorySnapshotWorker::VDirectorySnapshotWorker(const QString &p_notebookPath,
+                                                   const QJsonObject &p_dirs,
+                                                   const QString &p_file,
+                                                   QObject *p_parent)
+    : QThread(p_parent),
+      m_notebookPath(p_notebookPath),
+      m_oldDirs(p_dirs),
+      m_file(p_file),
+      m_succeeded(false)
+{
+}
+
+void VDirectorySnapshotWorker::run()
+{
+    // Only directories reachable from the root are kept, so entries of deleted
+    // directories are dropped.
+    QStringList dirs;
+    dirs << QString();
+    while (!dirs.isEmpty()) {
+        QString relativePath = dirs.takeFirst();
+
+        bool hit = false;
+        QJsonObject entry = validEntry(directoryPath(m_notebookPath, relativePath),
+                                       m_oldDirs.value(relativePath).toObject(),
+                                       hit);
+        if (entry.isEmpty()) {
+            continue;
+        }
+
+        m_dirs.insert(relativePath, entry);
+
+        QJsonArray subDirs = entry.value(c_config).toObject()
+                                  .value(DirConfig::c_subDirectories).toArray();
+        for (int i = 0; i < subDirs.size(); ++i) {
+            QString name = subDirs[i].toObject().value(DirConfig::c_name).toString();
+            if (!name.isEmpty()) {
+                dirs << QDir(relativePath).filePath(name);
+            }
+        }
+    }
+
+    m_oldDirs = QJsonObject();
+
+    QJsonObject root;
+    root[c_version] = SNAPSHOT_VERSION;
+    root[c_dirs] = m_dirs;
+
+    QSaveFile file(m_file);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to write directory config snapshot" << m_file;
+        return;
+    }
+
+    file.write(QJsonDocument(root).toBinaryData());
+    m_succeeded = file.commit();
+}
@@ -0,0 +1,120 @@
+#ifndef VDIRECTORYCONFIGCACHE_H
+#define VDIRECTORYCONFIGCACHE_H
+
+#include <QObject>
+#include <QThread>
+#include <QHash>
+#include <QString>
+#include <QJsonObject>
+
+class QTimer;
+class VDirectorySnapshotWorker;
+
+// Per-notebook snapshot of the configurations of all the directories, kept in
+// the cache folder as binary JSON, so opening a directory only needs to stat
+// its configuration file instead of reading and parsing it.
+// An entry is valid while the modified time and size of the configuration file
+// are unchanged. When stale entries are found, the snapshot is rebuilt by
+// walking the notebook in a background thread.
+class VDirectoryConfigCache : public QObject
+{
+    Q_OBJECT
+public:
+    // @p_folder: folder to hold the snapshot files.
+    explicit VDirectoryConfigCache(const QString &p_folder, QObject *p_parent = nullptr);
+
+    ~VDirectoryConfigCache();
+
+    // Read the configuration of directory @p_relativePath of notebook
+    // @p_notebookPath like VConfigManager::readDirectoryConfig().
+    QJsonObject readDirectoryConfig(const QString &p_notebookPath,
+                                    const QString &p_relativePath);
+
+    // Hit rate for the log.
+    QString statistics() const;
+
+private slots:
+    void rebuildStaleSnapshots();
+
+    void handleWorkerFinished();
+
+private:
+    struct Snapshot
+    {
+        Snapshot()
+            : m_worker(NULL),
+              m_stale(false)
+        {
+        }
+
+        // Entries by relative path of the directory.
+        QJsonObject m_dirs;
+
+        // Entries read from disk since last rebuild.
+        QHash<QString, QJsonObject> m_updates;
+
+        VDirectorySnapshotWorker *m_worker;
+
+        bool m_stale;
+    };
+
+    Snapshot *getSnapshot(const QString &p_notebookPath);
+
+    QString snapshotFilePath(const QString &p_notebookPath) const;
+
+    QString m_folder;
+
+    // Snapshots by notebook path.
+    QHash<QString, Snapshot *> m_snapshots;
+
+    QTimer *m_rebuildTimer;
+
+    unsigned long long m_hits;
+
+    unsigned long long m_misses;
+
+    unsigned long long m_rebuilds;
+};
+
+// Walk a notebook from its root directory and write a fresh snapshot.
+class VDirectorySnapshotWorker : public QThread
+{
+    Q_OBJECT
+public:
+    // @p_dirs: entries of the current snapshot, reused if still valid.
+    VDirectorySnapshotWorker(const QString &p_notebookPath,
+                             const QJsonObject &p_dirs,
+                             const QString &p_file,
+                             QObject *p_parent = nullptr);
+
+    const QString &notebookPath() const
+    {
+        return m_notebookPath;
+    }
+
+    bool succeeded() const
+    {
+        return m_succeeded;
+    }
+
+    const QJsonObject &dirs() const
+    {
+        return m_dirs;
+    }
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QString m_notebookPath;
+
+    QJsonObject m_oldDirs;
+
+    QString m_file;
+
+    bool m_succeeded;
+
+    QJsonObject m_dirs;
+};
+
+#endif // VDIRECTORYCONFIGCACHE_H
@@ -1,29 +1,347 @@
 #include "vdocument.h"
 
 #include <QDebug>
+#include <QRegExp>
 
 #include "vfile.h"
 #include "vplantumlhelper.h"
 #include "vgraphvizhelper.h"
+#include "vmarkdownconverter.h"
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
 
 VDocument::VDocument(const VFile *v_file, QObject *p_parent)
     : QObject(p_parent),
       m_file(v_file),
       m_readyToHighlight(false),
+      m_readyToTextToHtml(false),
       m_plantUMLHelper(NULL),
       m_graphvizHelper(NULL),
       m_nextID(0),
-      m_webViewMuted(false)
+      m_webViewMuted(false),
+      m_readyToUpdateTextBlocks(false),
+      m_nextTextBlockID(0),
+      m_readyToUpdateNativeHtml(false),
+      m_nativeRenderEnabled(false),
+      m_nativeRenderWorker(NULL),
+      m_nativeRenderPending(false),
+      m_nativeRenderTimeStamp(0)
+{
+}
+
+VDocument::~VDocument()
 {
+    stopNativeRender();
+
+    if (m_nativeRenderWorker) {
+        m_nativeRenderWorker->wait();
+        delete m_nativeRenderWorker;
+        m_nativeRenderWorker = NULL;
+    }
 }
 
 void VDocument::updateText()
 {
     if (m_file) {
-        emit textChanged(m_file->getContent());
+        const QString &text = m_file->getContent();
+        if (useNativeRender(text)) {
+            renderNatively(text);
+            return;
+        }
+
+        // Results of native render will be abandoned.
+        stopNativeRender();
+
+        if (m_readyToUpdateTextBlocks) {
+            updateTextBlocks(text);
+        } else {
+            emit textChanged(text);
+        }
+    }
+}
+
+void VDocument::noticeReadyToUpdateNativeHtml()
+{
+    m_readyToUpdateNativeHtml = true;
+}
+
+bool VDocument::useNativeRender(const QString &p_text) const
+{
+    if (!m_nativeRenderEnabled || !m_readyToUpdateNativeHtml) {
+        return false;
+    }
+
+    int threshold = g_config->getNativeRenderSize();
+    return threshold > 0 && p_text.size() > threshold * 1024;
+}
+
+void VDocument::stopNativeRender()
+{
+    if (m_nativeRenderWorker) {
+        m_nativeRenderWorker->stop();
+    }
+
+    m_nativeRenderPending = false;
+    m_nativeRenderPendingText.clear();
+}
+
+void VDocument::renderNatively(const QString &p_text)
+{
+    if (m_nativeRenderWorker) {
+        // Hoedown could not be interrupted, so only the latest text is rendered
+        // after the running one finishes, whose result will be abandoned.
+        m_nativeRenderWorker->stop();
+        m_nativeRenderPending = true;
+        m_nativeRenderPendingText = p_text;
+        return;
+    }
+
+    m_nativeRenderWorker = new VMarkdownConverterWorker(this);
+    m_nativeRenderWorker->setData(++m_nativeRenderTimeStamp,
+                                  p_text,
+                                  g_config->getMarkdownExtensions());
+    connect(m_nativeRenderWorker, &VMarkdownConverterWorker::finished,
+            this, &VDocument::handleNativeRenderFinished);
+    m_nativeRenderWorker->start();
+}
+
+void VDocument::handleNativeRenderFinished()
+{
+    VMarkdownConverterWorker *th = static_cast<VMarkdownConverterWorker *>(sender());
+    Q_ASSERT(th == m_nativeRenderWorker);
+    m_nativeRenderWorker = NULL;
+
+    if (!th->isAskedToStop()) {
+        // The web side will replace all the text blocks.
+        m_textBlocks.clear();
+
+        emit requestUpdateNativeHtml(th->html());
+
+        // The web side will not report the TOC of the native HTML.
+        setToc(th->toc(), 1);
+    }
+
+    th->deleteLater();
+
+    if (m_nativeRenderPending) {
+        QString text = m_nativeRenderPendingText;
+        m_nativeRenderPending = false;
+        m_nativeRenderPendingText.clear();
+        renderNatively(text);
     }
 }
 
+void VDocument::noticeReadyToUpdateTextBlocks()
+{
+    m_readyToUpdateTextBlocks = true;
+    m_textBlocks.clear();
+
+    updateText();
+}
+
+void VDocument::updateTextBlocks(const QString &p_text)
+{
+    const QStringList texts = splitTextBlocks(p_text);
+    const int oldSize = m_textBlocks.size();
+    const int newSize = texts.size();
+
+    // Only the range between the common prefix and suffix is changed.
+    int prefix = 0;
+    while (prefix < oldSize
+           && prefix < newSize
+           && m_textBlocks[prefix].m_text == texts[prefix]) {
+        ++prefix;
+    }
+
+    int suffix = 0;
+    while (suffix < oldSize - prefix
+           && suffix < newSize - prefix
+           && m_textBlocks[oldSize - 1 - suffix].m_text == texts[newSize - 1 - suffix]) {
+        ++suffix;
+    }
+
+    QVariantList removedIds;
+    for (int i = prefix; i < oldSize - suffix; ++i) {
+        removedIds.append(m_textBlocks[i].m_id);
+    }
+
+    QVector<TextBlock> addedBlocks;
+    QVariantList addedIds;
+    QStringList addedTexts;
+    for (int i = prefix; i < newSize - suffix; ++i) {
+        addedBlocks.append(TextBlock(m_nextTextBlockID++, texts[i]));
+        addedIds.append(addedBlocks.last().m_id);
+        addedTexts.append(texts[i]);
+    }
+
+    int beforeId = suffix > 0 ? m_textBlocks[oldSize - suffix].m_id : -1;
+
+    m_textBlocks.remove(prefix, oldSize - suffix - prefix);
+    for (int i = 0; i < addedBlocks.size(); ++i) {
+        m_textBlocks.insert(prefix + i, addedBlocks[i]);
+    }
+
+    qDebug() << "update text blocks" << removedIds.size() << "removed" << addedIds.size() << "added";
+
+    // Emit even if nothing changed since the web side will finish logics.
+    emit requestUpdateTextBlocks(removedIds, addedIds, addedTexts, beforeId);
+}
+
+// Return the change of the depth of the HTML elements by tags in @p_line.
+// Inline code and escaped brackets are skipped. Void and self-closing tags do
+// not change the depth.
+static int htmlTagDepthDelta(const QString &p_line)
+{
+    static QRegExp codeReg("`+[^`]*`+");
+    static QRegExp tagReg("<(/?)([a-zA-Z][a-zA-Z0-9-]*)(\\s[^<>]*)?>");
+    static const QStringList voidTags = { "area", "base", "br", "col", "embed", "hr",
+                                          "img", "input", "link", "meta", "param",
+                                          "source", "track", "wbr" };
+
+    if (!p_line.contains('<')) {
+        return 0;
+    }
+
+    QString line(p_line);
+    line.remove(codeReg);
+    line.remove("\\<");
+
+    int delta = 0;
+    int pos = 0;
+    while ((pos = tagReg.indexIn(line, pos)) != -1) {
+        pos += tagReg.matchedLength();
+
+        if (!tagReg.cap(1).isEmpty()) {
+            --delta;
+        } else if (!tagReg.cap(3).endsWith('/')
+                   && !voidTags.contains(tagReg.cap(2).toLower())) {
+            ++delta;
+        }
+    }
+
+    return delta;
+}
+
+QStringList VDocument::splitTextBlocks(const QString &p_text)
+{
+    // Definitions, the TOC and numbered equations make the rendering of a block
+    // depend on the others, so render the whole text as one block.
+    static QRegExp globalReg("(^|\\n) {0,3}\\[[^\\]\\n]+\\]:"
+                             "|(^|\\n)\\[toc\\]"
+                             "|\\\\(begin\\{(equation|align|gather|multline|flalign|alignat)|label\\{|eqref\\{|ref\\{)",
+                             Qt::CaseInsensitive);
+    if (p_text.isEmpty() || globalReg.indexIn(p_text) != -1) {
+        return QStringList(p_text);
+    }
+
+    static QRegExp fenceReg("^ {0,3}(`{3,}|~{3,})");
+    static QRegExp listReg("^([-*+]|\\d{1,9}[.)])(\\s|$)");
+
+    // HTML blocks of type 1 to 5 of CommonMark, which end at their own marks.
+    static QRegExp rawHtmlReg("^ {0,3}<(script|pre|style|textarea)(?=\\s|>|$)",
+                              Qt::CaseInsensitive);
+    static QRegExp specialHtmlReg("^ {0,3}<(!--|\\?|!\\[CDATA\\[|![a-zA-Z])");
+
+    QStringList blocks;
+    QString block;
+
+    // Closing mark of the fenced code block, math block, HTML block or front matter
+    // the current line is in.
+    QString closing;
+
+    // Depth of the HTML elements not closed yet. Other HTML blocks end at a
+    // blank line, but the elements they open may wrap the following blocks.
+    int htmlDepth = 0;
+
+    bool prevBlank = false;
+    const QStringList lines = p_text.split('\n');
+    for (int i = 0; i < lines.size(); ++i) {
+        const QString &line = lines[i];
+        const QString trimmed = line.trimmed();
+
+        if (closing.isEmpty()) {
+            if (prevBlank
+                && htmlDepth == 0
+                && !trimmed.isEmpty()
+                && !line[0].isSpace()
+                && listReg.indexIn(line) == -1
+                && !block.isEmpty()) {
+                blocks.append(block);
+                block.clear();
+            }
+
+            int openingEnd = -1;
+            if (i == 0 && trimmed == "---") {
+                closing = "---";
+            } else if (fenceReg.indexIn(line) != -1) {
+                closing = fenceReg.cap(1);
+            } else if (trimmed.startsWith("$$") && trimmed.count("$$") == 1) {
+                closing = "$$";
+            } else if (rawHtmlReg.indexIn(line) != -1) {
+                closing = QString("</%1>").arg(rawHtmlReg.cap(1).toLower());
+                openingEnd = rawHtmlReg.matchedLength();
+            } else if (specialHtmlReg.indexIn(line) != -1) {
+                const QString tag = specialHtmlReg.cap(1);
+                if (tag == "!--") {
+                    closing = "-->";
+                } else if (tag == "?") {
+                    closing = "?>";
+                } else if (tag == "![CDATA[") {
+                    closing = "]]>";
+                } else {
+                    closing = ">";
+                }
+
+                openingEnd = specialHtmlReg.matchedLength();
+            } else {
+                htmlDepth += htmlTagDepthDelta(line);
+                if (htmlDepth < 0) {
+                    // Closing an element which is not opened at the start of a
+                    // line, such as by a tag across lines.
+                    return QStringList(p_text);
+                }
+            }
+
+            if (openingEnd != -1 && line.indexOf(closing, openingEnd, Qt::CaseInsensitive) != -1) {
+                closing.clear();
+            }
+        } else if (closing[0] == '`' || closing[0] == '~') {
+            if (trimmed.startsWith(closing) && trimmed.count(closing[0]) == trimmed.size()) {
+                closing.clear();
+            }
+        } else if (closing == "---") {
+            if (trimmed == "---" || trimmed == "...") {
+                closing.clear();
+            }
+        } else if (closing == "$$") {
+            if (trimmed.contains("$$")) {
+                closing.clear();
+            }
+        } else if (line.contains(closing, Qt::CaseInsensitive)) {
+            closing.clear();
+        }
+
+        block += line;
+        if (i < lines.size() - 1) {
+            block += '\n';
+        }
+
+        prevBlank = trimmed.isEmpty();
+    }
+
+    if (htmlDepth > 0) {
+        // Could not tell where the HTML elements end.
+        return QStringList(p_text);
+    }
+
+    if (!block.isEmpty()) {
+        blocks.append(block);
+    }
+
+    return blocks;
+}
+
 void VDocument::setToc(const QString &toc, int /* baseLevel */)
 {
     if (toc == m_toc) {
@@ -64,6 +382,16 @@ void VDocument::setHtml(const QString &html)
     emit htmlChanged(m_html);
 }
 
+void VDocument::setBaseUrl(const QString &p_url)
+{
+    if (p_url == m_baseUrl) {
+        return;
+    }
+
+    m_baseUrl = p_url;
+    emit baseUrlChanged(m_baseUrl);
+}
+
 void VDocument::setLog(const QString &p_log)
 {
     qDebug() << "JS:" << p_log;
@@ -93,6 +421,15 @@ void VDocument::textToHtmlAsync(int p_identitifer,
     emit requestTextToHtml(p_identitifer, p_id, p_timeStamp, p_text, p_inlineStyle);
 }
 
+void VDocument::textToHtmlBatchAsync(int p_identitifer,
+                                     int p_timeStamp,
+                                     const QVariantList &p_ids,
+                                     const QStringList &p_texts,
+                                     bool p_inlineStyle)
+{
+    emit requestTextToHtmlBatch(p_identitifer, p_timeStamp, p_ids, p_texts, p_inlineStyle);
+}
+
 void VDocument::htmlToTextAsync(int p_identitifer,
                                 int p_id,
                                 int p_timeStamp,
@@ -111,6 +448,14 @@ void VDocument::textToHtmlCB(int p_identitifer, int p_id, int p_timeStamp, const
     emit textToHtmlFinished(p_identitifer, p_id, p_timeStamp, p_html);
 }
 
+void VDocument::textToHtmlBatchCB(int p_identitifer,
+                                  int p_timeStamp,
+                                  const QVariantList &p_ids,
+                                  const QStringList &p_htmls)
+{
+    emit textToHtmlBatchFinished(p_identitifer, p_timeStamp, p_ids, p_htmls);
+}
+
 void VDocument::htmlToTextCB(int p_identitifer, int p_id, int p_timeStamp, const QString &p_text)
 {
     emit htmlToTextFinished(p_identitifer, p_id, p_timeStamp, p_text);
@@ -125,6 +470,12 @@ void VDocument::noticeReadyToHighlightText()
 void VDocument::noticeReadyToTextToHtml()
 {
     m_readyToTextToHtml = true;
+    emit readyToTextToHtml();
+}
+
+void VDocument::requestWebSide()
+{
+    emit webSideRequested();
 }
 
 void VDocument::setFile(const VFile *p_file)
@@ -3,10 +3,15 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QVariantList>
+#include <QVector>
 
 #include "vwordcountinfo.h"
+#include "vconstants.h"
 
 class VFile;
+class VMarkdownConverterWorker;
 class VPlantUMLHelper;
 class VGraphvizHelper;
 
@@ -16,11 +21,14 @@ class VDocument : public QObject
     Q_PROPERTY(QString text MEMBER m_text NOTIFY textChanged)
     Q_PROPERTY(QString toc MEMBER m_toc NOTIFY tocChanged)
     Q_PROPERTY(QString html MEMBER m_html NOTIFY htmlChanged)
+    Q_PROPERTY(QString baseUrl MEMBER m_baseUrl NOTIFY baseUrlChanged)
 
 public:
     // @p_file could be NULL.
     VDocument(const VFile *p_file, QObject *p_parent = 0);
 
+    ~VDocument();
+
     QString getToc();
 
     // Scroll to @anchor in the web.
@@ -29,6 +37,10 @@ public:
 
     void setHtml(const QString &html);
 
+    // Set the URL to resolve relative links against if the page is loaded
+    // with a different base URL.
+    void setBaseUrl(const QString &p_url);
+
     // Request to highlight a segment text.
     // Use p_id to identify the result.
     void highlightTextAsync(const QString &p_text, int p_id, unsigned long long p_timeStamp);
@@ -40,6 +52,14 @@ public:
                          const QString &p_text,
                          bool p_inlineStyle);
 
+    // Request to convert @p_texts to HTML in one round-trip.
+    // @p_ids will be passed back as is.
+    void textToHtmlBatchAsync(int p_identitifer,
+                              int p_timeStamp,
+                              const QVariantList &p_ids,
+                              const QStringList &p_texts,
+                              bool p_inlineStyle);
+
     // Request to convert @p_html to Markdown text.
     void htmlToTextAsync(int p_identitifer,
                          int p_id,
@@ -54,6 +74,9 @@ public:
 
     bool isReadyToTextToHtml() const;
 
+    // Ask the owner to set up the web side, which is created on demand.
+    void requestWebSide();
+
     // Request to get the HTML content.
     void getHtmlContentAsync();
 
@@ -77,6 +100,11 @@ public:
 
     void muteWebView(bool p_muted);
 
+    // Render large notes natively in a background thread when the web side
+    // supports it. Disabled by default since the HTML generated by hoedown
+    // lacks the features of the web side, such as diagrams.
+    void setNativeRenderEnabled(bool p_enabled);
+
     void performSmartLivePreview(const QString &p_lang,
                                  const QString &p_text,
                                  const QString &p_hints,
@@ -99,12 +127,25 @@ public slots:
     void keyPressEvent(int p_key, bool p_ctrl, bool p_shift, bool p_meta);
     void updateText();
 
+    // The web side could patch the content by text blocks.
+    // The content of the web side is cleared and will be updated entirely.
+    void noticeReadyToUpdateTextBlocks();
+
+    // The web side could show HTML generated natively.
+    void noticeReadyToUpdateNativeHtml();
+
     void highlightTextCB(const QString &p_html, int p_id, unsigned long long p_timeStamp);
 
     void noticeReadyToHighlightText();
 
     void textToHtmlCB(int p_identitifer, int p_id, int p_timeStamp, const QString &p_html);
 
+    // @p_htmls are aligned with @p_ids.
+    void textToHtmlBatchCB(int p_identitifer,
+                           int p_timeStamp,
+                           const QVariantList &p_ids,
+                           const QStringList &p_htmls);
+
     void htmlToTextCB(int p_identitifer, int p_id, int p_timeStamp, const QString &p_text);
 
     void noticeReadyToTextToHtml();
@@ -134,6 +175,13 @@ signals:
 
     void tocChanged(const QString &toc);
 
+    // Remove the sections of @p_removedIds and insert sections rendered from
+    // @p_addedTexts before section @p_beforeId (-1 to append).
+    void requestUpdateTextBlocks(const QVariantList &p_removedIds,
+                                 const QVariantList &p_addedIds,
+                                 const QStringList &p_addedTexts,
+                                 int p_beforeId);
+
     void requestScrollToAnchor(const QString &anchor);
 
     // @anchor is the id of that anchor, without '#'.
@@ -141,6 +189,11 @@ signals:
 
     void htmlChanged(const QString &html);
 
+    void baseUrlChanged(const QString &p_url);
+
+    // Show @p_html generated natively instead of rendering the text.
+    void requestUpdateNativeHtml(const QString &p_html);
+
     void keyPressed(int p_key, bool p_ctrl, bool p_shift, bool p_meta);
 
     void requestHighlightText(const QString &p_text, int p_id, unsigned long long p_timeStamp);
@@ -149,6 +202,10 @@ signals:
 
     void readyToHighlightText();
 
+    void readyToTextToHtml();
+
+    void webSideRequested();
+
     void logicsFinished();
 
     void requestTextToHtml(int p_identitifer,
@@ -157,6 +214,12 @@ signals:
                            const QString &p_text,
                            bool p_inlineStyle);
 
+    void requestTextToHtmlBatch(int p_identitifer,
+                                int p_timeStamp,
+                                const QVariantList &p_ids,
+                                const QStringList &p_texts,
+                                bool p_inlineStyle);
+
     void requestHtmlToText(int p_identitifer,
                            int p_id,
                            int p_timeStamp,
@@ -164,6 +227,11 @@ signals:
 
     void textToHtmlFinished(int p_identitifer, int p_id, int p_timeStamp, const QString &p_html);
 
+    void textToHtmlBatchFinished(int p_identitifer,
+                                 int p_timeStamp,
+                                 const QVariantList &p_ids,
+                                 const QStringList &p_htmls);
+
     void htmlToTextFinished(int p_identitifer, int p_id, int p_timeStamp, const QString &p_text);
 
     void requestHtmlContent();
@@ -202,7 +270,44 @@ signals:
                                         const QString &p_hints,
                                         bool p_isRegex);
 
+private slots:
+    void handleNativeRenderFinished();
+
 private:
+    struct TextBlock
+    {
+        TextBlock()
+            : m_id(-1)
+        {
+        }
+
+        TextBlock(int p_id, const QString &p_text)
+            : m_id(p_id),
+              m_text(p_text)
+        {
+        }
+
+        int m_id;
+
+        QString m_text;
+    };
+
+    // Send only the changed text blocks to the web side.
+    void updateTextBlocks(const QString &p_text);
+
+    // Split @p_text into blocks which could be rendered independently.
+    static QStringList splitTextBlocks(const QString &p_text);
+
+    // Whether render @p_text by hoedown instead of in the web side.
+    bool useNativeRender(const QString &p_text) const;
+
+    // Generate the HTML in a background thread and push it to the web side.
+    // At most one worker runs at a time.
+    void renderNatively(const QString &p_text);
+
+    // Abandon the running render and the pending text.
+    void stopNativeRender();
+
     QString m_toc;
     QString m_header;
 
@@ -212,6 +317,9 @@ private:
     // When using Hoedown, m_html will contain the html content.
     QString m_html;
 
+    // Empty if it is the base URL of the page.
+    QString m_baseUrl;
+
     const VFile *m_file;
 
     // Whether the web side is ready to handle highlight text request.
@@ -230,6 +338,28 @@ private:
 
     // Whether propogate signals from web view.
     bool m_webViewMuted;
+
+    // Whether the web side supports updating by text blocks.
+    bool m_readyToUpdateTextBlocks;
+
+    // Text blocks shown in the web side.
+    QVector<TextBlock> m_textBlocks;
+
+    int m_nextTextBlockID;
+
+    // Whether the web side supports HTML generated natively.
+    bool m_readyToUpdateNativeHtml;
+
+    bool m_nativeRenderEnabled;
+
+    VMarkdownConverterWorker *m_nativeRenderWorker;
+
+    // Whether to render m_nativeRenderPendingText once the worker finishes.
+    bool m_nativeRenderPending;
+
+    QString m_nativeRenderPendingText;
+
+    TimeStamp m_nativeRenderTimeStamp;
 };
 
 inline bool VDocument::isReadyToHighlight() const
@@ -257,4 +387,9 @@ inline void VDocument::muteWebView(bool p_muted)
     m_webViewMuted = p_muted;
     emit requestMuted(m_webViewMuted);
 }
+
+inline void VDocument::setNativeRenderEnabled(bool p_enabled)
+{
+    m_nativeRenderEnabled = p_enabled;
+}
 #endif // VDOCUMENT_H
@@ -9,9 +9,23 @@
 #include <QTemporaryDir>
 #include <QScopedPointer>
 #include <QCoreApplication>
+#include <QTimer>
+#include <QEventLoop>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCryptographicHash>
+#include <QSet>
+#include <QMap>
+#include <QFile>
+#include <QDir>
+
+#include <climits>
+#include <functional>
 
 #include "vconfigmanager.h"
 #include "vfile.h"
+#include "vnotefile.h"
+#include "vnotebook.h"
 #include "vwebview.h"
 #include "utils/vutils.h"
 #include "vpreviewpage.h"
@@ -24,12 +38,51 @@ extern VConfigManager *g_config;
 
 extern VWebUtils *g_webUtils;
 
+// Fail a note if one step of it takes longer than this (ms).
+#define NOTE_STEP_TIMEOUT 300000
+
+// Manifest of incremental export in the output folder.
+#define EXPORT_MANIFEST_FILE "vnote_export.json"
+
+#define EXPORT_MANIFEST_VERSION 3
+
+// Max size of embedded resources kept during an export.
+#define RESOURCE_CACHE_SIZE 64 * 1024 * 1024
+
+// Kill wkhtmltopdf rendering a PDF chunk if it takes longer than this for each
+// note of the chunk (ms).
+#define PDF_CHUNK_NOTE_TIMEOUT 60000
+
+#define PDFINFO_TIMEOUT 30000
+
 VExporter::VExporter(QWidget *p_parent)
     : QObject(p_parent),
-      m_webViewer(NULL),
-      m_state(ExportState::Idle),
-      m_askedToStop(false)
+      m_resourceCache(RESOURCE_CACHE_SIZE),
+      m_askedToStop(false),
+      m_jobs(NULL),
+      m_errMsg(NULL),
+      m_nrJobs(0),
+      m_nrFinished(0),
+      m_nrSucceeded(0),
+      m_batchLoop(NULL)
+{
+    // All the export pages use the default profile.
+    connect(QWebEngineProfile::defaultProfile(), &QWebEngineProfile::downloadRequested,
+            this, &VExporter::handleDownloadRequested);
+}
+
+VExporter::~VExporter()
+{
+    Q_ASSERT(m_workers.isEmpty());
+}
+
+void VExporter::setAskedToStop(bool p_askedToStop)
 {
+    m_askedToStop = p_askedToStop;
+
+    if (m_askedToStop && m_batchLoop) {
+        m_batchLoop->quit();
+    }
 }
 
 static QString marginToStrMM(qreal p_margin)
@@ -39,6 +92,8 @@ static QString marginToStrMM(qreal p_margin)
 
 void VExporter::prepareExport(const ExportOption &p_opt)
 {
+    m_resourceCache.clear();
+
     bool isPdf = p_opt.m_format == ExportFormat::PDF
                  || p_opt.m_format == ExportFormat::OnePDF
                  || (p_opt.m_format == ExportFormat::Custom
@@ -128,20 +183,25 @@ void VExporter::prepareWKArguments(const ExportPDFOption &p_opt)
     }
 }
 
-bool VExporter::exportPDF(VFile *p_file,
-                          const ExportOption &p_opt,
-                          const QString &p_outputFile,
-                          QString *p_errMsg)
+static QString combineArgs(QStringList &p_args)
 {
-    return exportViaWebView(p_file, p_opt, p_outputFile, p_errMsg);
-}
+    QString str;
+    for (const QString &arg : p_args) {
+        QString tmp;
+        if (arg.contains(' ')) {
+            tmp = '"' + arg + '"';
+        } else {
+            tmp = arg;
+        }
 
-bool VExporter::exportHTML(VFile *p_file,
-                           const ExportOption &p_opt,
-                           const QString &p_outputFile,
-                           QString *p_errMsg)
-{
-    return exportViaWebView(p_file, p_opt, p_outputFile, p_errMsg);
+        if (str.isEmpty()) {
+            str = tmp;
+        } else {
+            str = str + ' ' + tmp;
+        }
+    }
+
+    return str;
 }
 
 static void replaceArgument(QString &p_cmd, const QString &p_arg, const QString &p_val)
@@ -175,6 +235,44 @@ static void replaceArgument(QString &p_cmd, const QString &p_arg, const QString
     }
 }
 
+// Get the number of pages from the progress output of wkhtmltopdf, such as
+// "Page 3 of 12".
+// Return -1 if not found, such as when run with --quiet.
+static int wkPageCount(const QByteArray &p_output)
+{
+    QRegExp reg("Page\\s+\\d+\\s+of\\s+(\\d+)");
+    QString output = QString::fromLocal8Bit(p_output);
+    int cnt = -1;
+    int pos = 0;
+    while ((pos = reg.indexIn(output, pos)) != -1) {
+        cnt = reg.cap(1).toInt();
+        pos += reg.matchedLength();
+    }
+
+    return cnt;
+}
+
+// Get the number of pages of PDF @p_file by pdfinfo of poppler.
+// Return -1 if failed.
+static int pdfinfoPageCount(const QString &p_file)
+{
+    QProcess process;
+    process.start("pdfinfo", QStringList() << QDir::toNativeSeparators(p_file));
+    if (!process.waitForFinished(PDFINFO_TIMEOUT)
+        || process.exitStatus() != QProcess::NormalExit
+        || process.exitCode() != 0) {
+        process.kill();
+        return -1;
+    }
+
+    QRegExp reg("(^|\\n)Pages:\\s*(\\d+)");
+    if (reg.indexIn(QString::fromLocal8Bit(process.readAllStandardOutput())) == -1) {
+        return -1;
+    }
+
+    return reg.cap(2).toInt();
+}
+
 static QString evaluateCommand(const ExportCustomOption &p_opt,
                                const QString &p_input,
                                const QString &p_inputFolder,
@@ -190,413 +288,845 @@ static QString evaluateCommand(const ExportCustomOption &p_opt,
     return cmd;
 }
 
-bool VExporter::exportCustom(VFile *p_file,
+// Evaluate the custom command with @p_files as input and @p_output as output.
+static QString evaluateCommand(const ExportCustomOption &p_opt,
+                               const QList<QString> &p_files,
+                               const QString &p_output)
+{
+    QString input;
+    QString inputFolder;
+    for (auto const & it : p_files) {
+        if (!input.isEmpty()) {
+            input += " ";
+        }
+
+        if (!inputFolder.isEmpty()) {
+            inputFolder += p_opt.m_folderSep;
+        }
+
+        QString tmp = QDir::toNativeSeparators(it);
+        input += ("\"" + tmp + "\"");
+        inputFolder += ("\"" + VUtils::basePathFromPath(tmp) + "\"");
+    }
+
+    return evaluateCommand(p_opt, input, inputFolder, p_output);
+}
+
+int VExporter::exportInBatch(QList<ExportJob> &p_jobs,
                              const ExportOption &p_opt,
-                             const QString &p_outputFile,
+                             const QString &p_outputFolder,
                              QString *p_errMsg)
 {
-    const ExportCustomOption &customOpt = p_opt.m_customOpt;
-    if (customOpt.m_srcFormat == ExportCustomOption::Markdown) {
-        // Use Markdown file as input.
-        QList<QString> files;
-        files.append(QDir::toNativeSeparators(p_file->fetchPath()));
-        return convertFilesViaCustom(files, p_outputFile, customOpt, p_errMsg);
+    Q_ASSERT(!m_batchLoop);
+    if (p_jobs.isEmpty()) {
+        return 0;
+    }
+
+    m_opt = p_opt;
+    m_jobs = &p_jobs;
+    m_errMsg = p_errMsg;
+    m_nrFinished = 0;
+    m_nrSucceeded = 0;
+    m_batchTimer.start();
+
+    m_queue.clear();
+
+    QString optHash;
+    Manifest manifest;
+    QVector<QString> hashes;
+    if (m_opt.m_incremental) {
+        optHash = optionsHash();
+        int nrSkipped = queueChangedJobs(p_outputFolder, optHash, manifest, hashes);
+        if (nrSkipped > 0) {
+            emit outputLog(tr("%1 notes unchanged since last export are skipped.").arg(nrSkipped));
+        }
     } else {
-        return exportViaWebView(p_file, p_opt, p_outputFile, p_errMsg);
+        for (int i = 0; i < p_jobs.size(); ++i) {
+            m_queue.append(i);
+        }
     }
+
+    m_nrJobs = m_queue.size();
+    if (m_nrJobs > 0) {
+        runQueuedJobs();
+    }
+
+    if (m_opt.m_incremental) {
+        QDir dir(p_outputFolder);
+        for (int i = 0; i < p_jobs.size(); ++i) {
+            const ExportJob &job = p_jobs[i];
+            if (job.m_succeeded && !hashes[i].isEmpty()) {
+                ManifestEntry &entry = manifest[job.m_file->fetchPath()];
+                entry.m_output = dir.relativeFilePath(job.m_outputFile);
+                entry.m_hash = hashes[i];
+                entry.m_optionsHash = optHash;
+                entry.m_root = noteRoot(job.m_file);
+            }
+        }
+
+        if (!writeManifest(p_outputFolder, manifest)) {
+            VUtils::addErrMsg(p_errMsg,
+                              tr("Fail to write the manifest of incremental export to %1.").arg(p_outputFolder));
+        }
+    }
+
+    m_jobs = NULL;
+    m_errMsg = NULL;
+
+    return m_nrSucceeded;
 }
 
-void VExporter::initWebViewer(VFile *p_file, const ExportOption &p_opt)
+void VExporter::runQueuedJobs()
 {
-    Q_ASSERT(!m_webViewer);
+    int nrWorkers = qBound(1, g_config->getExportPages(), m_nrJobs);
+    for (int i = 0; i < nrWorkers; ++i) {
+        Worker *worker = new Worker();
+        worker->m_timer = new QTimer(this);
+        worker->m_timer->setSingleShot(true);
+        worker->m_timer->setInterval(NOTE_STEP_TIMEOUT);
+        connect(worker->m_timer, &QTimer::timeout,
+                this, [this, worker]() {
+                    if (worker->m_jobIdx == -1) {
+                        return;
+                    }
+
+                    const ExportJob &job = m_jobs->at(worker->m_jobIdx);
+                    emit outputLog(tr("Timed out exporting note %1.").arg(job.m_file->fetchPath()));
+                    finishNote(worker, false);
+                });
 
-    m_webViewer = new VWebView(p_file, static_cast<QWidget *>(parent()));
-    m_webViewer->hide();
+        m_workers.append(worker);
+    }
 
-    VPreviewPage *page = new VPreviewPage(m_webViewer);
-    m_webViewer->setPage(page);
-    connect(page, &VPreviewPage::loadFinished,
-            this, &VExporter::handleLoadFinished);
-    connect(page->profile(), &QWebEngineProfile::downloadRequested,
-            this, &VExporter::handleDownloadRequested);
+    QEventLoop loop;
+    m_batchLoop = &loop;
 
-    m_webDocument = new VDocument(p_file, m_webViewer);
-    connect(m_webDocument, &VDocument::logicsFinished,
-            this, &VExporter::handleLogicsFinished);
+    emit progressChanged(0, m_nrJobs, -1);
 
-    QWebChannel *channel = new QWebChannel(m_webViewer);
-    channel->registerObject(QStringLiteral("content"), m_webDocument);
-    page->setWebChannel(channel);
+    dispatch();
 
-    // Need to generate HTML using Hoedown.
-    if (p_opt.m_renderer == MarkdownConverterType::Hoedown) {
-        VMarkdownConverter mdConverter;
-        QString toc;
-        QString html = mdConverter.generateHtml(p_file->getContent(),
-                                                g_config->getMarkdownExtensions(),
-                                                toc);
-        bool isPdf = p_opt.m_format == ExportFormat::PDF
-                     || p_opt.m_format == ExportFormat::OnePDF;
-        bool extraToc = isPdf
-                        && !p_opt.m_pdfOpt.m_wkhtmltopdf
-                        && p_opt.m_pdfOpt.m_enableTableOfContents;
-        if (extraToc && !toc.isEmpty()) {
-            // Add toc to html.
-            QString div = "<div class=\"vnote-toc\">" + toc + "</div>\n";
-            html = div + html;
-        }
+    // Jobs may all fail to start.
+    if (m_nrFinished < m_nrJobs && !m_askedToStop) {
+        loop.exec();
+    }
 
-        m_webDocument->setHtml(html);
+    m_batchLoop = NULL;
+
+    for (auto worker : m_workers) {
+        resetWorker(worker);
+        delete worker->m_timer;
+        delete worker;
     }
 
-    m_baseUrl = p_file->getBaseUrl();
-    m_webViewer->setHtml(m_htmlTemplate, m_baseUrl);
+    m_workers.clear();
+
+    qInfo() << "exported" << m_nrSucceeded << "of" << m_nrJobs << "notes by"
+            << nrWorkers << "pages in" << m_batchTimer.elapsed() << "ms";
+    qInfo() << "export resource cache" << m_resourceCache.statistics();
 }
 
-void VExporter::handleLogicsFinished()
+int VExporter::queueChangedJobs(const QString &p_folder,
+                                const QString &p_optionsHash,
+                                Manifest &p_manifest,
+                                QVector<QString> &p_hashes)
 {
-    Q_ASSERT(!(m_noteState & NoteState::WebLogicsReady));
-    m_noteState = NoteState(m_noteState | NoteState::WebLogicsReady);
+    readManifest(p_folder, p_manifest);
+
+    // Remove outputs of deleted notes.
+    for (auto it = p_manifest.begin(); it != p_manifest.end();) {
+        if (QFileInfo::exists(it.key())) {
+            ++it;
+            continue;
+        }
+
+        // The notebook may be unmounted for now. Keep the entry.
+        const QString &root = it.value().m_root;
+        if (root.isEmpty() || !QFileInfo(root).isDir()) {
+            ++it;
+            continue;
+        }
+
+        QString output = manifestOutputPath(p_folder, it.value().m_output);
+        if (output.isEmpty()) {
+            qWarning() << "skip removing invalid output" << it.value().m_output
+                       << "of deleted note" << it.key();
+        } else {
+            removeOutput(output);
+            emit outputLog(tr("Remove %1 of deleted note %2.").arg(output).arg(it.key()));
+        }
+
+        it = p_manifest.erase(it);
+    }
+
+    QSet<QString> outputs;
+    for (auto const & job : *m_jobs) {
+        outputs.insert(QDir::cleanPath(job.m_outputFile));
+    }
+
+    int nrSkipped = 0;
+    p_hashes.resize(m_jobs->size());
+    for (int i = 0; i < m_jobs->size(); ++i) {
+        ExportJob &job = (*m_jobs)[i];
+        p_hashes[i] = noteHash(job.m_file);
+
+        auto it = p_manifest.find(job.m_file->fetchPath());
+        if (it != p_manifest.end()) {
+            QString lastOutput = manifestOutputPath(p_folder, it.value().m_output);
+            if (!lastOutput.isEmpty()
+                && lastOutput == QDir::cleanPath(job.m_outputFile)
+                && it.value().m_hash == p_hashes[i]
+                && it.value().m_optionsHash == p_optionsHash
+                && !p_hashes[i].isEmpty()
+                && QFileInfo::exists(lastOutput)) {
+                job.m_succeeded = true;
+                ++nrSkipped;
+                continue;
+            }
+
+            // The output may be taken by another note now.
+            if (!lastOutput.isEmpty() && !outputs.contains(lastOutput)) {
+                removeOutput(lastOutput);
+            }
+
+            // Will be added back once exported.
+            p_manifest.erase(it);
+        }
+
+        m_queue.append(i);
+    }
+
+    return nrSkipped;
 }
 
-void VExporter::handleLoadFinished(bool p_ok)
+bool VExporter::readManifest(const QString &p_folder, Manifest &p_manifest) const
 {
-    Q_ASSERT(!(m_noteState & NoteState::WebLoadFinished));
-    m_noteState = NoteState(m_noteState | NoteState::WebLoadFinished);
+    QString filePath = QDir(p_folder).filePath(EXPORT_MANIFEST_FILE);
+    if (!QFileInfo::exists(filePath)) {
+        return false;
+    }
 
-    if (!p_ok) {
-        m_noteState = NoteState(m_noteState | NoteState::Failed);
+    QJsonObject json = VUtils::readJsonFromDisk(filePath);
+    if (json.value("version").toInt() != EXPORT_MANIFEST_VERSION) {
+        return false;
+    }
+
+    QJsonArray notes = json.value("notes").toArray();
+    for (int i = 0; i < notes.size(); ++i) {
+        QJsonObject note = notes[i].toObject();
+        ManifestEntry entry;
+        entry.m_output = note.value("output").toString();
+        entry.m_hash = note.value("hash").toString();
+        entry.m_optionsHash = note.value("options").toString();
+        entry.m_root = note.value("root").toString();
+        p_manifest.insert(note.value("path").toString(), entry);
     }
+
+    return true;
 }
 
-void VExporter::clearWebViewer()
+bool VExporter::writeManifest(const QString &p_folder, const Manifest &p_manifest) const
 {
-    // m_webDocument will be freeed by QObject.
-    delete m_webViewer;
-    m_webViewer = NULL;
-    m_webDocument = NULL;
-    m_baseUrl.clear();
+    QJsonArray notes;
+    for (auto it = p_manifest.constBegin(); it != p_manifest.constEnd(); ++it) {
+        QJsonObject note;
+        note["path"] = it.key();
+        note["output"] = it.value().m_output;
+        note["hash"] = it.value().m_hash;
+        note["options"] = it.value().m_optionsHash;
+        note["root"] = it.value().m_root;
+        notes.append(note);
+    }
+
+    QJsonObject json;
+    json["version"] = EXPORT_MANIFEST_VERSION;
+    json["notes"] = notes;
+
+    return VUtils::writeJsonToDisk(QDir(p_folder).filePath(EXPORT_MANIFEST_FILE), json);
 }
 
-bool VExporter::exportToPDF(VWebView *p_webViewer,
-                            const QString &p_filePath,
-                            const QPageLayout &p_layout)
+QString VExporter::optionsHash() const
 {
-    int pdfPrinted = 0;
-    p_webViewer->page()->printToPdf([&, this](const QByteArray &p_result) {
-        if (p_result.isEmpty() || this->m_state == ExportState::Cancelled) {
-            pdfPrinted = -1;
-            return;
-        }
+    QStringList opts;
+    opts << QString::number((int)m_opt.m_format)
+         << QString::number((int)m_opt.m_renderer)
+         << m_opt.m_renderBg
+         << m_opt.m_renderStyle
+         << m_opt.m_renderCodeBlockStyle;
+
+    const ExportPDFOption &pdfOpt = m_opt.m_pdfOpt;
+    QMarginsF marginsMM = m_pageLayout.margins(QPageLayout::Millimeter);
+    opts << m_pageLayout.pageSize().key()
+         << QString::number((int)m_pageLayout.orientation())
+         << QString("%1,%2,%3,%4").arg(marginsMM.left())
+                                  .arg(marginsMM.top())
+                                  .arg(marginsMM.right())
+                                  .arg(marginsMM.bottom())
+         << QString::number(pdfOpt.m_wkhtmltopdf)
+         << QString::number(pdfOpt.m_wkEnableBackground)
+         << QString::number(pdfOpt.m_enableTableOfContents)
+         << QString::number((int)pdfOpt.m_wkPageNumber)
+         << pdfOpt.m_wkExtraArgs;
+
+    const ExportHTMLOption &htmlOpt = m_opt.m_htmlOpt;
+    opts << QString::number(htmlOpt.m_embedCssStyle)
+         << QString::number(htmlOpt.m_completeHTML)
+         << QString::number(htmlOpt.m_embedImages)
+         << QString::number(htmlOpt.m_mimeHTML)
+         << QString::number(htmlOpt.m_outlinePanel);
+
+    const ExportCustomOption &customOpt = m_opt.m_customOpt;
+    opts << QString::number((int)customOpt.m_srcFormat)
+         << customOpt.m_outputSuffix
+         << customOpt.m_cmd
+         << customOpt.m_cssUrl
+         << customOpt.m_codeBlockCssUrl
+         << QString::number(customOpt.m_pdfLike);
+
+    // Templates hold the styles and the rendering options.
+    if (m_opt.m_format != ExportFormat::Custom
+        || customOpt.m_srcFormat == ExportCustomOption::HTML) {
+        opts << m_htmlTemplate << m_exportHtmlTemplate;
+    }
 
-        V_ASSERT(!p_filePath.isEmpty());
+    return QCryptographicHash::hash(opts.join('\n').toUtf8(), QCryptographicHash::Sha1).toHex();
+}
 
-        if (!VUtils::writeFileToDisk(p_filePath, p_result)) {
-            pdfPrinted = -1;
-            return;
-        }
+QString VExporter::noteHash(VFile *p_file)
+{
+    QFile file(p_file->fetchPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
 
-        pdfPrinted = 1;
-    }, p_layout);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(file.readAll());
+    file.close();
 
-    while (pdfPrinted == 0) {
-        VUtils::sleepWait(100);
+    auto addFileInfo = [&hash](const QString &p_path) {
+        QFileInfo info(p_path);
+        QString str = QString("%1|%2|%3\n").arg(info.absoluteFilePath())
+                                           .arg(info.size())
+                                           .arg(info.lastModified().toMSecsSinceEpoch());
+        hash.addData(str.toUtf8());
+    };
+
+    QVector<ImageLink> images = VUtils::fetchImagesFromMarkdownFile(p_file);
+    for (auto const & img : images) {
+        if (img.m_type & (ImageLink::LocalRelativeInternal
+                          | ImageLink::LocalRelativeExternal
+                          | ImageLink::LocalAbsolute)) {
+            addFileInfo(img.m_path);
+        }
+    }
 
-        if (m_state == ExportState::Cancelled) {
-            break;
+    if (p_file->getType() == FileType::Note) {
+        VNoteFile *noteFile = static_cast<VNoteFile *>(p_file);
+        if (!noteFile->getAttachmentFolder().isEmpty()) {
+            QDir attaDir(noteFile->fetchAttachmentFolderPath());
+            for (auto const & atta : noteFile->getAttachments()) {
+                addFileInfo(attaDir.filePath(atta.m_name));
+            }
         }
     }
 
-    return pdfPrinted == 1;
+    return hash.result().toHex();
 }
 
-bool VExporter::exportToPDFViaWK(VDocument *p_webDocument,
-                                 const ExportPDFOption &p_opt,
-                                 const QString &p_filePath,
-                                 QString *p_errMsg)
+QString VExporter::noteRoot(const VFile *p_file)
 {
-    int pdfExported = 0;
-
-    connect(p_webDocument, &VDocument::htmlContentFinished,
-            this, [&, this](const QString &p_headContent,
-                            const QString &p_styleContent,
-                            const QString &p_bodyContent) {
-                if (p_bodyContent.isEmpty() || this->m_state == ExportState::Cancelled) {
-                    pdfExported = -1;
-                    return;
-                }
+    if (p_file->getType() == FileType::Note) {
+        const VNotebook *notebook = static_cast<const VNoteFile *>(p_file)->getNotebook();
+        if (notebook) {
+            return notebook->getPath();
+        }
+    }
 
-                Q_ASSERT(!p_filePath.isEmpty());
+    return p_file->fetchBasePath();
+}
 
-                // Save HTML to a temp dir.
-                QTemporaryDir tmpDir;
-                if (!tmpDir.isValid()) {
-                    pdfExported = -1;
-                    return;
-                }
+QString VExporter::manifestOutputPath(const QString &p_folder, const QString &p_output)
+{
+    if (p_output.isEmpty() || QDir::isAbsolutePath(p_output)) {
+        return QString();
+    }
 
-                QString htmlPath = tmpDir.filePath("vnote_tmp.html");
-                QString title = p_webDocument->getFile()->getName();
-                title = QFileInfo(title).completeBaseName();
-                if (!outputToHTMLFile(htmlPath,
-                                      title,
-                                      p_headContent,
-                                      p_styleContent,
-                                      p_bodyContent,
-                                      true,
-                                      true,
-                                      false)) {
-                    pdfExported = -1;
-                    return;
-                }
+    QDir dir(p_folder);
+    QString folder = QDir::cleanPath(dir.absolutePath());
+    QString path = QDir::cleanPath(dir.absoluteFilePath(p_output));
+    if (!path.startsWith(folder + "/")) {
+        return QString();
+    }
 
-                // Convert via wkhtmltopdf.
-                QList<QString> files;
-                files.append(htmlPath);
-                if (!htmlsToPDFViaWK(files, p_filePath, p_opt, p_errMsg)) {
-                    pdfExported = -1;
-                } else {
-                    pdfExported = 1;
-                }
-            });
+    // Symbolic links may lead out of the folder.
+    QString canonicalFolder = QFileInfo(folder).canonicalFilePath();
+    QString canonicalParent = QFileInfo(QFileInfo(path).absolutePath()).canonicalFilePath();
+    if (canonicalFolder.isEmpty() || canonicalParent.isEmpty()) {
+        return QString();
+    }
 
-    p_webDocument->getHtmlContentAsync();
+    if (canonicalParent != canonicalFolder
+        && !canonicalParent.startsWith(canonicalFolder + "/")) {
+        return QString();
+    }
 
-    while (pdfExported == 0) {
-        VUtils::sleepWait(100);
+    return path;
+}
 
-        if (m_state == ExportState::Cancelled) {
-            break;
+void VExporter::removeOutput(const QString &p_file)
+{
+    QFile::remove(p_file);
+
+    // Resource folder of HTML created by outputToHTMLFile().
+    QFileInfo info(p_file);
+    if (info.suffix() == "html") {
+        QString resPath = QDir(info.absolutePath()).filePath(info.completeBaseName() + "_files");
+        QFileInfo resInfo(resPath);
+        if (resInfo.isSymLink()) {
+            // Do not follow it.
+            QFile::remove(resPath);
+        } else if (resInfo.isDir()) {
+            QDir(resPath).removeRecursively();
         }
     }
-
-    return pdfExported == 1;
 }
 
-bool VExporter::exportToCustom(VDocument *p_webDocument,
-                               const ExportCustomOption &p_opt,
-                               const QString &p_filePath,
-                               QString *p_errMsg)
+void VExporter::dispatch()
 {
-    int exported = 0;
-
-    connect(p_webDocument, &VDocument::htmlContentFinished,
-            this, [&, this](const QString &p_headContent,
-                            const QString &p_styleContent,
-                            const QString &p_bodyContent) {
-                if (p_bodyContent.isEmpty() || this->m_state == ExportState::Cancelled) {
-                    exported = -1;
-                    return;
-                }
-
-                Q_ASSERT(!p_filePath.isEmpty());
-
-                // Save HTML to a temp dir.
-                QTemporaryDir tmpDir;
-                if (!tmpDir.isValid()) {
-                    exported = -1;
-                    return;
-                }
+    for (auto worker : m_workers) {
+        while (worker->m_jobIdx == -1) {
+            if (m_askedToStop || m_queue.isEmpty()) {
+                return;
+            }
 
-                QString htmlPath = tmpDir.filePath("vnote_tmp.html");
-                QString title = p_webDocument->getFile()->getName();
-                title = QFileInfo(title).completeBaseName();
-                if (!outputToHTMLFile(htmlPath,
-                                      title,
-                                      p_headContent,
-                                      p_styleContent,
-                                      p_bodyContent,
-                                      true,
-                                      true,
-                                      false)) {
-                    exported = -1;
-                    return;
-                }
+            int idx = m_queue.takeFirst();
+            if (!startNote(worker, idx)) {
+                finishJob(idx, false);
+            }
+        }
+    }
+}
 
-                // Convert via custom command.
-                QList<QString> files;
-                files.append(htmlPath);
-                if (!convertFilesViaCustom(files, p_filePath, p_opt, p_errMsg)) {
-                    exported = -1;
-                } else {
-                    exported = 1;
-                }
-            });
+bool VExporter::startNote(Worker *p_worker, int p_idx)
+{
+    Q_ASSERT(p_worker->m_jobIdx == -1);
+    VFile *file = m_jobs->at(p_idx).m_file;
+    if (!file->isOpened()) {
+        if (!file->open()) {
+            return false;
+        }
 
-    p_webDocument->getHtmlContentAsync();
+        p_worker->m_fileOpened = true;
+    }
 
-    while (exported == 0) {
-        VUtils::sleepWait(100);
+    p_worker->m_jobIdx = p_idx;
+    p_worker->m_timer->start();
 
-        if (m_state == ExportState::Cancelled) {
-            break;
+    const ExportCustomOption &customOpt = m_opt.m_customOpt;
+    if (m_opt.m_format == ExportFormat::Custom
+        && customOpt.m_srcFormat == ExportCustomOption::Markdown) {
+        // Use Markdown file as input.
+        QList<QString> files;
+        files.append(QDir::toNativeSeparators(file->fetchPath()));
+        QString cmd = evaluateCommand(customOpt,
+                                      files,
+                                      QDir::toNativeSeparators(m_jobs->at(p_idx).m_outputFile));
+        QStringList args = VUtils::parseCombinedArgString(cmd);
+        if (args.isEmpty()) {
+            resetWorker(p_worker);
+            return false;
         }
+
+        p_worker->m_command = cmd;
+        startNoteProcess(p_worker, args.first(), args.mid(1));
+        return true;
     }
 
-    return exported == 1;
+    initWebViewer(p_worker, file);
+    return true;
 }
 
-bool VExporter::exportViaWebView(VFile *p_file,
-                                 const ExportOption &p_opt,
-                                 const QString &p_outputFile,
-                                 QString *p_errMsg)
+void VExporter::initWebViewer(Worker *p_worker, VFile *p_file)
 {
-    Q_UNUSED(p_errMsg);
+    Q_ASSERT(!p_worker->m_webViewer);
 
-    bool ret = false;
-
-    bool isOpened = p_file->isOpened();
-    if (!isOpened && !p_file->open()) {
-        goto exit;
-    }
+    int idx = p_worker->m_jobIdx;
 
-    Q_ASSERT(m_state == ExportState::Idle);
-    m_state = ExportState::Busy;
+    p_worker->m_webViewer = new VWebView(p_file, static_cast<QWidget *>(parent()));
+    p_worker->m_webViewer->hide();
 
-    clearNoteState();
+    VPreviewPage *page = new VPreviewPage(p_worker->m_webViewer);
+    p_worker->m_webViewer->setPage(page);
+    connect(page, &VPreviewPage::loadFinished,
+            this, [this, idx](bool p_ok) {
+                handleLoadFinished(idx, p_ok);
+            });
 
-    initWebViewer(p_file, p_opt);
+    p_worker->m_webDocument = new VDocument(p_file, p_worker->m_webViewer);
+    connect(p_worker->m_webDocument, &VDocument::logicsFinished,
+            this, [this, idx]() {
+                handleLogicsFinished(idx);
+            });
+    connect(p_worker->m_webDocument, &VDocument::htmlContentFinished,
+            this, [this, idx](const QString &p_headContent,
+                              const QString &p_styleContent,
+                              const QString &p_bodyContent) {
+                handleHtmlContentFinished(idx, p_headContent, p_styleContent, p_bodyContent);
+            });
 
-    while (!isNoteStateReady()) {
-        VUtils::sleepWait(100);
+    QWebChannel *channel = new QWebChannel(p_worker->m_webViewer);
+    channel->registerObject(QStringLiteral("content"), p_worker->m_webDocument);
+    page->setWebChannel(channel);
 
-        if (m_state == ExportState::Cancelled) {
-            goto exit;
+    // Need to generate HTML using Hoedown.
+    if (m_opt.m_renderer == MarkdownConverterType::Hoedown) {
+        VMarkdownConverter mdConverter;
+        QString toc;
+        QString html = mdConverter.generateHtml(p_file->getContent(),
+                                                g_config->getMarkdownExtensions(),
+                                                toc);
+        bool isPdf = m_opt.m_format == ExportFormat::PDF
+                     || m_opt.m_format == ExportFormat::OnePDF;
+        bool extraToc = isPdf
+                        && !m_opt.m_pdfOpt.m_wkhtmltopdf
+                        && m_opt.m_pdfOpt.m_enableTableOfContents;
+        if (extraToc && !toc.isEmpty()) {
+            // Add toc to html.
+            QString div = "<div class=\"vnote-toc\">" + toc + "</div>\n";
+            html = div + html;
         }
 
-        if (isNoteStateFailed()) {
-            m_state = ExportState::Failed;
-            goto exit;
-        }
+        p_worker->m_webDocument->setHtml(html);
+    }
 
-        if (m_askedToStop) {
-            m_state = ExportState::Cancelled;
-            goto exit;
-        }
+    p_worker->m_baseUrl = p_file->getBaseUrl();
+    p_worker->m_webViewer->setHtml(m_htmlTemplate, p_worker->m_baseUrl);
+}
+
+void VExporter::handleLoadFinished(int p_idx, bool p_ok)
+{
+    Worker *worker = findWorker(p_idx);
+    if (!worker) {
+        return;
+    }
+
+    if (!p_ok) {
+        finishNote(worker, false);
+        return;
     }
 
-    // Wait to ensure Web side is really ready.
-    VUtils::sleepWait(200);
+    Q_ASSERT(!(worker->m_noteState & NoteState::WebLoadFinished));
+    worker->m_noteState = NoteState(worker->m_noteState | NoteState::WebLoadFinished);
+    if (worker->m_noteState == NoteState::Ready) {
+        exportNote(worker);
+    }
+}
+
+void VExporter::handleLogicsFinished(int p_idx)
+{
+    Worker *worker = findWorker(p_idx);
+    if (!worker) {
+        return;
+    }
 
-    if (m_state == ExportState::Cancelled) {
-        goto exit;
+    Q_ASSERT(!(worker->m_noteState & NoteState::WebLogicsReady));
+    worker->m_noteState = NoteState(worker->m_noteState | NoteState::WebLogicsReady);
+    if (worker->m_noteState == NoteState::Ready) {
+        exportNote(worker);
     }
+}
+
+void VExporter::exportNote(Worker *p_worker)
+{
+    p_worker->m_timer->start();
 
-    {
+    int idx = p_worker->m_jobIdx;
+    const QString &outputFile = m_jobs->at(idx).m_outputFile;
+    Q_ASSERT(!outputFile.isEmpty());
 
-    bool exportRet = false;
-    switch (p_opt.m_format) {
+    switch (m_opt.m_format) {
     case ExportFormat::PDF:
         V_FALLTHROUGH;
     case ExportFormat::OnePDF:
-        if (p_opt.m_pdfOpt.m_wkhtmltopdf) {
-            exportRet = exportToPDFViaWK(m_webDocument,
-                                         p_opt.m_pdfOpt,
-                                         p_outputFile,
-                                         p_errMsg);
+        if (m_opt.m_pdfOpt.m_wkhtmltopdf) {
+            p_worker->m_webDocument->getHtmlContentAsync();
         } else {
-            exportRet = exportToPDF(m_webViewer,
-                                    p_outputFile,
-                                    m_pageLayout);
+            p_worker->m_webViewer->page()->printToPdf([this, idx, outputFile](const QByteArray &p_result) {
+                // It may be called with empty result when the page is freed.
+                Worker *worker = findWorker(idx);
+                if (!worker) {
+                    return;
+                }
+
+                finishNote(worker,
+                           !p_result.isEmpty() && VUtils::writeFileToDisk(outputFile, p_result));
+            }, m_pageLayout);
         }
 
         break;
 
     case ExportFormat::HTML:
-        if (p_opt.m_htmlOpt.m_mimeHTML) {
-            exportRet = exportToMHTML(m_webViewer,
-                                      p_opt.m_htmlOpt,
-                                      p_outputFile);
+        if (m_opt.m_htmlOpt.m_mimeHTML) {
+            // handleDownloadRequested() will find the worker by the file path.
+            p_worker->m_webViewer->page()->save(outputFile,
+                                                QWebEngineDownloadItem::MimeHtmlSaveFormat);
         } else {
-            exportRet = exportToHTML(m_webDocument,
-                                     p_opt.m_htmlOpt,
-                                     p_outputFile);
+            p_worker->m_webDocument->getHtmlContentAsync();
         }
 
         break;
 
     case ExportFormat::Custom:
-        exportRet = exportToCustom(m_webDocument,
-                                   p_opt.m_customOpt,
-                                   p_outputFile,
-                                   p_errMsg);
+        p_worker->m_webDocument->getHtmlContentAsync();
         break;
 
     default:
+        finishNote(p_worker, false);
         break;
     }
+}
+
+void VExporter::handleHtmlContentFinished(int p_idx,
+                                          const QString &p_headContent,
+                                          const QString &p_styleContent,
+                                          const QString &p_bodyContent)
+{
+    Worker *worker = findWorker(p_idx);
+    if (!worker) {
+        return;
+    }
 
-    clearNoteState();
+    if (p_bodyContent.isEmpty()) {
+        finishNote(worker, false);
+        return;
+    }
+
+    const ExportJob &job = m_jobs->at(p_idx);
+    QString title = QFileInfo(job.m_file->getName()).completeBaseName();
+
+    if (m_opt.m_format == ExportFormat::HTML) {
+        const ExportHTMLOption &opt = m_opt.m_htmlOpt;
+        bool ret = outputToHTMLFile(job.m_outputFile,
+                                    m_exportHtmlTemplate,
+                                    worker->m_baseUrl,
+                                    title,
+                                    p_headContent,
+                                    p_styleContent,
+                                    p_bodyContent,
+                                    opt.m_embedCssStyle,
+                                    opt.m_completeHTML,
+                                    opt.m_embedImages,
+                                    &m_resourceCache);
+        finishNote(worker, ret);
+        return;
+    }
+
+    // Save HTML to a temp dir as the input of wkhtmltopdf or the custom command.
+    worker->m_tmpDir.reset(new QTemporaryDir());
+    if (!worker->m_tmpDir->isValid()) {
+        finishNote(worker, false);
+        return;
+    }
 
-    if (!isOpened) {
-        p_file->close();
+    QString htmlPath = worker->m_tmpDir->filePath("vnote_tmp.html");
+    if (!outputToHTMLFile(htmlPath,
+                          m_exportHtmlTemplate,
+                          worker->m_baseUrl,
+                          title,
+                          p_headContent,
+                          p_styleContent,
+                          p_bodyContent,
+                          true,
+                          true,
+                          false,
+                          &m_resourceCache)) {
+        finishNote(worker, false);
+        return;
     }
 
-    if (exportRet) {
-        m_state = ExportState::Successful;
+    QList<QString> files;
+    files.append(htmlPath);
+    if (m_opt.m_format == ExportFormat::Custom) {
+        QString cmd = evaluateCommand(m_opt.m_customOpt,
+                                      files,
+                                      QDir::toNativeSeparators(job.m_outputFile));
+        QStringList args = VUtils::parseCombinedArgString(cmd);
+        if (args.isEmpty()) {
+            finishNote(worker, false);
+            return;
+        }
+
+        worker->m_command = cmd;
+        startNoteProcess(worker, args.first(), args.mid(1));
     } else {
-        m_state = ExportState::Failed;
+        QStringList args = wkArguments(files, job.m_outputFile);
+        worker->m_command = m_opt.m_pdfOpt.m_wkPath + " " + combineArgs(args);
+        startNoteProcess(worker, m_opt.m_pdfOpt.m_wkPath, args);
     }
+}
+
+void VExporter::startNoteProcess(Worker *p_worker,
+                                 const QString &p_program,
+                                 const QStringList &p_args)
+{
+    Q_ASSERT(!p_worker->m_process);
+
+    int idx = p_worker->m_jobIdx;
 
+    emit outputLog(p_worker->m_command);
+    qDebug() << "export cmd:" << p_worker->m_command;
+
+    p_worker->m_timer->start();
+
+    QProcess *process = new QProcess(this);
+    p_worker->m_process = process;
+    connect(process, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+            this, [this, idx](int p_exitCode, QProcess::ExitStatus p_exitStatus) {
+                handleNoteProcessExited(idx, p_exitStatus == QProcess::CrashExit ? -1 : p_exitCode);
+            });
+    connect(process, &QProcess::errorOccurred,
+            this, [this, idx, process](QProcess::ProcessError p_error) {
+                // finished() will not be emitted if it fails to start.
+                // Handle it later since it may be emitted within start().
+                if (p_error == QProcess::FailedToStart) {
+                    QTimer::singleShot(0, process, [this, idx]() {
+                        handleNoteProcessExited(idx, -2);
+                    });
+                }
+            });
+
+    process->start(p_program, p_args);
+}
+
+void VExporter::handleNoteProcessExited(int p_idx, int p_ret)
+{
+    Worker *worker = findWorker(p_idx);
+    if (!worker || !worker->m_process) {
+        return;
     }
 
-exit:
-    clearWebViewer();
+    QProcess *process = worker->m_process;
+    QByteArray outBa = process->readAllStandardOutput();
+    QByteArray errBa = process->readAllStandardError();
+    QString msg;
+    if (!outBa.isEmpty()) {
+        msg += QString::fromLocal8Bit(outBa);
+    }
 
-    if (m_state == ExportState::Successful) {
-        ret = true;
+    if (!errBa.isEmpty()) {
+        msg += QString::fromLocal8Bit(errBa);
     }
 
-    m_state = ExportState::Idle;
+    if (!msg.isEmpty()) {
+        emit outputLog(msg);
+    }
 
-    return ret;
+    qDebug() << "export cmd returned" << p_ret;
+
+    const QString &cmd = worker->m_command;
+    bool isCustom = m_opt.m_format == ExportFormat::Custom;
+    switch (p_ret) {
+    case -2:
+        VUtils::addErrMsg(m_errMsg,
+                          isCustom ? tr("Fail to start custom command (%1).").arg(cmd)
+                                   : tr("Fail to start wkhtmltopdf (%1).").arg(cmd));
+        break;
+
+    case -1:
+        VUtils::addErrMsg(m_errMsg,
+                          isCustom ? tr("Custom command crashed (%1).").arg(cmd)
+                                   : tr("wkhtmltopdf crashed (%1).").arg(cmd));
+        break;
+
+    default:
+        break;
+    }
+
+    finishNote(worker, p_ret == 0);
 }
 
-bool VExporter::exportToHTML(VDocument *p_webDocument,
-                             const ExportHTMLOption &p_opt,
-                             const QString &p_filePath)
+void VExporter::finishNote(Worker *p_worker, bool p_succeeded)
 {
-    int htmlExported = 0;
-
-    connect(p_webDocument, &VDocument::htmlContentFinished,
-            this, [&, this](const QString &p_headContent,
-                            const QString &p_styleContent,
-                            const QString &p_bodyContent) {
-                if (p_bodyContent.isEmpty() || this->m_state == ExportState::Cancelled) {
-                    htmlExported = -1;
-                    return;
-                }
+    int idx = p_worker->m_jobIdx;
+    Q_ASSERT(idx != -1);
 
-                Q_ASSERT(!p_filePath.isEmpty());
-
-                QString title = p_webDocument->getFile()->getName();
-                title = QFileInfo(title).completeBaseName();
-                if (!outputToHTMLFile(p_filePath,
-                                      title,
-                                      p_headContent,
-                                      p_styleContent,
-                                      p_bodyContent,
-                                      p_opt.m_embedCssStyle,
-                                      p_opt.m_completeHTML,
-                                      p_opt.m_embedImages)) {
-                    htmlExported = -1;
-                    return;
-                }
+    resetWorker(p_worker);
 
-                htmlExported = 1;
-            });
+    finishJob(idx, p_succeeded);
 
-    p_webDocument->getHtmlContentAsync();
+    if (m_batchLoop) {
+        dispatch();
+    }
+}
 
-    while (htmlExported == 0) {
-        VUtils::sleepWait(100);
+void VExporter::finishJob(int p_idx, bool p_succeeded)
+{
+    ExportJob &job = (*m_jobs)[p_idx];
+    job.m_succeeded = p_succeeded;
 
-        if (m_state == ExportState::Cancelled) {
-            break;
+    ++m_nrFinished;
+    if (p_succeeded) {
+        ++m_nrSucceeded;
+    }
+
+    emit noteExported(job.m_file, job.m_outputFile, p_succeeded);
+
+    int total = m_nrJobs;
+    qint64 remaining = m_batchTimer.elapsed() * (total - m_nrFinished) / m_nrFinished;
+    emit progressChanged(m_nrFinished, total, remaining);
+
+    if (m_nrFinished == total && m_batchLoop) {
+        m_batchLoop->quit();
+    }
+}
+
+void VExporter::resetWorker(Worker *p_worker)
+{
+    p_worker->m_timer->stop();
+
+    if (p_worker->m_webViewer) {
+        p_worker->m_webViewer->page()->disconnect(this);
+        p_worker->m_webDocument->disconnect(this);
+
+        // It may be called within the signals of the page.
+        // m_webDocument will be freeed by QObject.
+        p_worker->m_webViewer->deleteLater();
+        p_worker->m_webViewer = NULL;
+        p_worker->m_webDocument = NULL;
+    }
+
+    p_worker->m_baseUrl.clear();
+
+    if (p_worker->m_process) {
+        p_worker->m_process->disconnect(this);
+        if (p_worker->m_process->state() != QProcess::NotRunning) {
+            p_worker->m_process->kill();
+        }
+
+        p_worker->m_process->deleteLater();
+        p_worker->m_process = NULL;
+    }
+
+    p_worker->m_command.clear();
+    p_worker->m_tmpDir.reset();
+
+    if (p_worker->m_fileOpened) {
+        m_jobs->at(p_worker->m_jobIdx).m_file->close();
+        p_worker->m_fileOpened = false;
+    }
+
+    p_worker->m_noteState = NoteState::NotReady;
+    p_worker->m_jobIdx = -1;
+}
+
+VExporter::Worker *VExporter::findWorker(int p_idx) const
+{
+    for (auto worker : m_workers) {
+        if (worker->m_jobIdx == p_idx) {
+            return worker;
         }
     }
 
-    return htmlExported == 1;
+    return NULL;
 }
 
 bool VExporter::fixStyleResources(const QString &p_folder,
@@ -627,7 +1157,7 @@ bool VExporter::fixStyleResources(const QString &p_folder,
     return altered;
 }
 
-bool VExporter::embedStyleResources(QString &p_html)
+bool VExporter::embedStyleResources(QString &p_html, VExportResourceCache *p_cache)
 {
     bool altered = false;
     QRegExp reg("\\burl\\(\"((file|qrc):[^\"\\)]+)\"\\);");
@@ -639,7 +1169,7 @@ bool VExporter::embedStyleResources(QString &p_html)
             break;
         }
 
-        QString dataURI = g_webUtils->dataURI(QUrl(reg.cap(1)), false);
+        QString dataURI = QString::fromUtf8(p_cache->dataURI(QUrl(reg.cap(1)), false));
         if (dataURI.isEmpty()) {
             pos = idx + reg.matchedLength();
         } else {
@@ -695,42 +1225,48 @@ bool VExporter::fixBodyResources(const QUrl &p_baseUrl,
     return altered;
 }
 
-bool VExporter::embedBodyResources(const QUrl &p_baseUrl, QString &p_html)
+bool VExporter::embedBodyResources(const QUrl &p_baseUrl,
+                                   const QString &p_html,
+                                   QIODevice *p_out,
+                                   VExportResourceCache *p_cache)
 {
     bool altered = false;
     if (p_baseUrl.isEmpty()) {
+        p_out->write(p_html.toUtf8());
         return altered;
     }
 
     QRegExp reg("<img ([^>]*)src=\"([^\"]+)\"([^>]*)>");
 
+    // Content before @pos has been written.
     int pos = 0;
-    while (pos < p_html.size()) {
-        int idx = p_html.indexOf(reg, pos);
+    int searchPos = 0;
+    while (searchPos < p_html.size()) {
+        int idx = p_html.indexOf(reg, searchPos);
         if (idx == -1) {
             break;
         }
 
+        searchPos = idx + reg.matchedLength();
         if (reg.cap(2).isEmpty()) {
-            pos = idx + reg.matchedLength();
             continue;
         }
 
         QUrl srcUrl(p_baseUrl.resolved(reg.cap(2)));
-        QString dataURI = g_webUtils->dataURI(srcUrl);
+        QByteArray dataURI = p_cache->dataURI(srcUrl);
         if (dataURI.isEmpty()) {
-            pos = idx + reg.matchedLength();
-        } else {
-            // Replace the url string in html.
-            QString newUrl = QString("<img %1src='%2'%3>").arg(reg.cap(1))
-                                                          .arg(dataURI)
-                                                          .arg(reg.cap(3));
-            p_html.replace(idx, reg.matchedLength(), newUrl);
-            pos = idx + newUrl.size();
-            altered = true;
+            continue;
         }
+
+        p_out->write(p_html.midRef(pos, idx - pos).toUtf8());
+        p_out->write(QString("<img %1src='").arg(reg.cap(1)).toUtf8());
+        p_out->write(dataURI);
+        p_out->write(QString("'%1>").arg(reg.cap(3)).toUtf8());
+        pos = searchPos;
+        altered = true;
     }
 
+    p_out->write(p_html.midRef(pos).toUtf8());
     return altered;
 }
 
@@ -742,59 +1278,53 @@ QString VExporter::getResourceRelativePath(const QString &p_file)
     return "." + p_file.mid(idx2);
 }
 
-bool VExporter::exportToMHTML(VWebView *p_webViewer,
-                              const ExportHTMLOption &p_opt,
-                              const QString &p_filePath)
-{
-    Q_UNUSED(p_opt);
-
-    m_downloadState = QWebEngineDownloadItem::DownloadRequested;
-
-    p_webViewer->page()->save(p_filePath, QWebEngineDownloadItem::MimeHtmlSaveFormat);
-
-    while (m_downloadState == QWebEngineDownloadItem::DownloadRequested
-           || m_downloadState == QWebEngineDownloadItem::DownloadInProgress) {
-        VUtils::sleepWait(100);
-    }
-
-    return m_downloadState == QWebEngineDownloadItem::DownloadCompleted;
-}
-
 void VExporter::handleDownloadRequested(QWebEngineDownloadItem *p_item)
 {
-    if (p_item->savePageFormat() == QWebEngineDownloadItem::MimeHtmlSaveFormat) {
-        connect(p_item, &QWebEngineDownloadItem::stateChanged,
-                this, [this](QWebEngineDownloadItem::DownloadState p_state) {
-                    m_downloadState = p_state;
-                });
+    if (!m_jobs || p_item->savePageFormat() != QWebEngineDownloadItem::MimeHtmlSaveFormat) {
+        return;
     }
-}
 
-static QString combineArgs(QStringList &p_args)
-{
-    QString str;
-    for (const QString &arg : p_args) {
-        QString tmp;
-        if (arg.contains(' ')) {
-            tmp = '"' + arg + '"';
-        } else {
-            tmp = arg;
+    // Find the job by the file path to save.
+    QString path = QDir::cleanPath(QDir::fromNativeSeparators(p_item->path()));
+    int idx = -1;
+    for (auto worker : m_workers) {
+        if (worker->m_jobIdx != -1
+            && QDir::cleanPath(m_jobs->at(worker->m_jobIdx).m_outputFile) == path) {
+            idx = worker->m_jobIdx;
+            break;
         }
+    }
 
-        if (str.isEmpty()) {
-            str = tmp;
-        } else {
-            str = str + ' ' + tmp;
-        }
+    if (idx == -1) {
+        return;
     }
 
-    return str;
+    connect(p_item, &QWebEngineDownloadItem::stateChanged,
+            this, [this, idx](QWebEngineDownloadItem::DownloadState p_state) {
+                Worker *worker = findWorker(idx);
+                if (!worker) {
+                    return;
+                }
+
+                switch (p_state) {
+                case QWebEngineDownloadItem::DownloadCompleted:
+                    finishNote(worker, true);
+                    break;
+
+                case QWebEngineDownloadItem::DownloadCancelled:
+                    V_FALLTHROUGH;
+                case QWebEngineDownloadItem::DownloadInterrupted:
+                    finishNote(worker, false);
+                    break;
+
+                default:
+                    break;
+                }
+            });
 }
 
-bool VExporter::htmlsToPDFViaWK(const QList<QString> &p_htmlFiles,
-                                const QString &p_filePath,
-                                const ExportPDFOption &p_opt,
-                                QString *p_errMsg)
+QStringList VExporter::wkArguments(const QList<QString> &p_htmlFiles,
+                                   const QString &p_filePath) const
 {
     // Note: system's locale settings (Language for non-Unicode programs) is important to wkhtmltopdf.
     // Input file could be encoded via QUrl::fromLocalFile(p_htmlFile).toString(QUrl::EncodeUnicode) to
@@ -807,7 +1337,15 @@ bool VExporter::htmlsToPDFViaWK(const QList<QString> &p_htmlFiles,
     }
 
     args << QDir::toNativeSeparators(p_filePath);
+    return args;
+}
 
+bool VExporter::htmlsToPDFViaWK(const QList<QString> &p_htmlFiles,
+                                const QString &p_filePath,
+                                const ExportPDFOption &p_opt,
+                                QString *p_errMsg)
+{
+    QStringList args = wkArguments(p_htmlFiles, p_filePath);
     QString cmd = p_opt.m_wkPath + " " + combineArgs(args);
     emit outputLog(cmd);
     qDebug() << "wkhtmltopdf cmd:" << cmd;
@@ -833,32 +1371,313 @@ bool VExporter::htmlsToPDFViaWK(const QList<QString> &p_htmlFiles,
     return ret == 0;
 }
 
-bool VExporter::convertFilesViaCustom(const QList<QString> &p_files,
-                                      const QString &p_filePath,
-                                      const ExportCustomOption &p_opt,
-                                      QString *p_errMsg)
+bool VExporter::htmlsToPDFViaWKInChunks(const QList<QString> &p_htmlFiles,
+                                        const QString &p_filePath,
+                                        const ExportPDFOption &p_opt,
+                                        int p_nrChunks,
+                                        QString *p_errMsg)
 {
+    Q_ASSERT(p_nrChunks > 1 && p_nrChunks <= p_htmlFiles.size());
+    QTemporaryDir tmpDir;
+    if (!tmpDir.isValid()) {
+        VUtils::addErrMsg(p_errMsg, tr("Fail to create temporary directory to hold PDF chunks."));
+        return false;
+    }
+
+    // Split by the size of the files.
+    qint64 totalSize = 0;
+    QVector<qint64> sizes;
+    for (auto const & it : p_htmlFiles) {
+        qint64 sz = qMax(QFileInfo(it).size(), (qint64)1);
+        sizes.append(sz);
+        totalSize += sz;
+    }
+
+    QVector<PDFChunk> chunks(p_nrChunks);
+    int chunkIdx = 0;
+    qint64 size = 0;
+    for (int i = 0; i < p_htmlFiles.size(); ++i) {
+        chunks[chunkIdx].m_files.append(p_htmlFiles[i]);
+        size += sizes[i];
+
+        // Leave at least one file for each of the rest chunks.
+        int filesLeft = p_htmlFiles.size() - i - 1;
+        int chunksLeft = p_nrChunks - chunkIdx - 1;
+        if (chunksLeft > 0
+            && (size >= totalSize * (chunkIdx + 1) / p_nrChunks || filesLeft == chunksLeft)) {
+            ++chunkIdx;
+        }
+    }
+
+    for (int i = 0; i < chunks.size(); ++i) {
+        chunks[i].m_outputFile = tmpDir.filePath(QString("vnote_chunk_%1.pdf").arg(i));
+    }
+
+    int total = chunks.size() + 1;
+    emit outputLog(tr("Export to PDF in %1 chunks by wkhtmltopdf.").arg(chunks.size()));
+    emit outputLog(tr("Outlines are not generated when exporting in chunks since the PDF merge "
+                      "command may not keep them. Set wkhtmltopdf_processes to 1 for outlines."));
+
+    m_batchTimer.start();
+    if (!runPDFChunks(chunks, p_opt, total, p_errMsg)) {
+        return false;
+    }
+
+    // Merge the chunks in order.
     QString input;
-    QString inputFolder;
-    for (auto const & it : p_files) {
+    for (auto const & chunk : chunks) {
         if (!input.isEmpty()) {
             input += " ";
         }
 
-        if (!inputFolder.isEmpty()) {
-            inputFolder += p_opt.m_folderSep;
+        input += ("\"" + QDir::toNativeSeparators(chunk.m_outputFile) + "\"");
+    }
+
+    QString cmd(g_config->getPdfMergeCommand());
+    replaceArgument(cmd, "%0", input);
+    replaceArgument(cmd, "%1", "\"" + QDir::toNativeSeparators(p_filePath) + "\"");
+    emit outputLog(cmd);
+    qDebug() << "PDF merge cmd:" << cmd;
+    int ret = startProcess(cmd);
+    qDebug() << "PDF merge cmd returned" << ret;
+    if (m_askedToStop) {
+        return ret == 0;
+    }
+
+    switch (ret) {
+    case -2:
+        VUtils::addErrMsg(p_errMsg, tr("Fail to start PDF merge command (%1).").arg(cmd));
+        break;
+
+    case -1:
+        VUtils::addErrMsg(p_errMsg, tr("PDF merge command crashed (%1).").arg(cmd));
+        break;
+
+    default:
+        break;
+    }
+
+    emit progressChanged(total, total, 0);
+    qInfo() << "exported" << p_htmlFiles.size() << "notes in" << chunks.size()
+            << "PDF chunks in" << m_batchTimer.elapsed() << "ms";
+    return ret == 0;
+}
+
+bool VExporter::runPDFChunks(QVector<PDFChunk> &p_chunks,
+                             const ExportPDFOption &p_opt,
+                             int p_total,
+                             QString *p_errMsg)
+{
+    Q_ASSERT(!m_batchLoop);
+    QEventLoop loop;
+    m_batchLoop = &loop;
+
+    // Page numbers in the footer are rendered by wkhtmltopdf, so a chunk is
+    // started with its page offset once the chunks before it are counted, which
+    // wkhtmltopdf prints before printing the pages.
+    const bool pageNumber = p_opt.m_wkPageNumber != ExportPageNumber::None;
+
+    const int nrChunks = p_chunks.size();
+    QVector<QProcess *> processes(nrChunks, NULL);
+    QVector<QByteArray> outputs(nrChunks);
+    int nrStarted = 0;
+    int nrFinished = 0;
+    bool failed = false;
+
+    std::function<void()> startChunks;
+
+    auto chunkExited = [&](int p_idx, int p_ret) {
+        PDFChunk &chunk = p_chunks[p_idx];
+        if (chunk.m_finished) {
+            return;
         }
 
-        QString tmp = QDir::toNativeSeparators(it);
-        input += ("\"" + tmp + "\"");
-        inputFolder += ("\"" + VUtils::basePathFromPath(tmp) + "\"");
+        chunk.m_finished = true;
+        chunk.m_exitCode = p_ret;
+
+        outputs[p_idx] += processes[p_idx]->readAll();
+        if (p_ret == 0) {
+            if (chunk.m_nrPages <= 0) {
+                chunk.m_nrPages = wkPageCount(outputs[p_idx]);
+            }
+
+            // The last chunk needs no page count.
+            if (pageNumber && chunk.m_nrPages <= 0 && p_idx < nrChunks - 1) {
+                chunk.m_nrPages = pdfinfoPageCount(chunk.m_outputFile);
+                if (chunk.m_nrPages <= 0) {
+                    chunk.m_exitCode = -4;
+                    failed = true;
+                }
+            }
+
+            emit outputLog(tr("PDF chunk %1 rendered.").arg(p_idx));
+        } else {
+            failed = true;
+            emit outputLog(tr("Fail to render PDF chunk %1 (%2).").arg(p_idx).arg(p_ret));
+            if (!outputs[p_idx].isEmpty()) {
+                emit outputLog(QString::fromLocal8Bit(outputs[p_idx]));
+            }
+        }
+
+        outputs[p_idx].clear();
+
+        ++nrFinished;
+        qint64 elapsed = m_batchTimer.elapsed();
+        emit progressChanged(nrFinished, p_total, elapsed * (p_total - nrFinished) / nrFinished);
+
+        if (!failed) {
+            startChunks();
+        }
+
+        if (failed || nrFinished == nrChunks) {
+            loop.quit();
+        }
+    };
+
+    auto startChunk = [&](int p_idx) {
+        PDFChunk &chunk = p_chunks[p_idx];
+        QStringList args = wkArguments(chunk.m_files, chunk.m_outputFile);
+        args.prepend("--no-outline");
+        if (chunk.m_pageOffset > 0) {
+            args.prepend(QString::number(chunk.m_pageOffset));
+            args.prepend("--page-offset");
+        }
+
+        QString cmd = p_opt.m_wkPath + " " + combineArgs(args);
+        emit outputLog(cmd);
+        qDebug() << "wkhtmltopdf cmd:" << cmd;
+
+        QProcess *process = new QProcess(this);
+        process->setProcessChannelMode(QProcess::MergedChannels);
+        processes[p_idx] = process;
+        connect(process, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+                this, [&, p_idx](int p_exitCode, QProcess::ExitStatus p_exitStatus) {
+                    chunkExited(p_idx, p_exitStatus == QProcess::CrashExit ? -1 : p_exitCode);
+                });
+        connect(process, &QProcess::errorOccurred,
+                this, [&, p_idx, process](QProcess::ProcessError p_error) {
+                    // finished() will not be emitted if it fails to start.
+                    // Handle it later since it may be emitted within start().
+                    if (p_error == QProcess::FailedToStart) {
+                        QTimer::singleShot(0, process, [&, p_idx]() {
+                            chunkExited(p_idx, -2);
+                        });
+                    }
+                });
+
+        if (pageNumber) {
+            connect(process, &QProcess::readyRead,
+                    this, [&, p_idx, process]() {
+                        PDFChunk &chunk = p_chunks[p_idx];
+                        outputs[p_idx] += process->readAll();
+                        if (chunk.m_nrPages <= 0) {
+                            chunk.m_nrPages = wkPageCount(outputs[p_idx]);
+                            if (chunk.m_nrPages > 0) {
+                                startChunks();
+                            }
+                        }
+                    });
+        }
+
+        // Kill the process if it takes too long.
+        QTimer *timer = new QTimer(process);
+        timer->setSingleShot(true);
+        timer->setInterval((int)qMin((qint64)PDF_CHUNK_NOTE_TIMEOUT * chunk.m_files.size(),
+                                     (qint64)INT_MAX));
+        connect(timer, &QTimer::timeout,
+                this, [&, p_idx, process]() {
+                    chunkExited(p_idx, -3);
+                    process->kill();
+                });
+        timer->start();
+
+        process->start(p_opt.m_wkPath, args);
+    };
+
+    startChunks = [&]() {
+        while (nrStarted < nrChunks) {
+            int idx = nrStarted;
+            if (pageNumber && idx > 0) {
+                const PDFChunk &prev = p_chunks[idx - 1];
+                if (prev.m_nrPages <= 0) {
+                    break;
+                }
+
+                p_chunks[idx].m_pageOffset = prev.m_pageOffset + prev.m_nrPages;
+            }
+
+            startChunk(idx);
+            ++nrStarted;
+        }
+    };
+
+    if (!m_askedToStop) {
+        startChunks();
+        loop.exec();
+    }
+
+    m_batchLoop = NULL;
+
+    for (auto process : processes) {
+        if (!process) {
+            continue;
+        }
+
+        process->disconnect(this);
+        if (process->state() != QProcess::NotRunning) {
+            process->kill();
+            process->waitForFinished(1000);
+        }
+
+        delete process;
     }
 
-    QString output = QDir::toNativeSeparators(p_filePath);
+    if (m_askedToStop) {
+        return false;
+    }
+
+    for (int idx = 0; idx < nrChunks; ++idx) {
+        switch (p_chunks[idx].m_exitCode) {
+        case 0:
+            break;
+
+        case -2:
+            VUtils::addErrMsg(p_errMsg, tr("Fail to start wkhtmltopdf (%1).").arg(p_opt.m_wkPath));
+            return false;
+
+        case -1:
+            VUtils::addErrMsg(p_errMsg, tr("wkhtmltopdf crashed (%1).").arg(p_opt.m_wkPath));
+            return false;
+
+        case -3:
+            VUtils::addErrMsg(p_errMsg, tr("wkhtmltopdf timed out on PDF chunk %1.").arg(idx));
+            return false;
+
+        case -4:
+            VUtils::addErrMsg(p_errMsg,
+                              tr("Fail to count pages of PDF chunk %1. Do not pass --quiet "
+                                 "to wkhtmltopdf, or install pdfinfo.").arg(idx));
+            return false;
+
+        default:
+            VUtils::addErrMsg(p_errMsg, tr("wkhtmltopdf failed with %1 on PDF chunk %2.")
+                                          .arg(p_chunks[idx].m_exitCode)
+                                          .arg(idx));
+            return false;
+        }
+    }
+
+    return nrFinished == nrChunks;
+}
+
+bool VExporter::convertFilesViaCustom(const QList<QString> &p_files,
+                                      const QString &p_filePath,
+                                      const ExportCustomOption &p_opt,
+                                      QString *p_errMsg)
+{
     QString cmd = evaluateCommand(p_opt,
-                                  input,
-                                  inputFolder,
-                                  output);
+                                  p_files,
+                                  QDir::toNativeSeparators(p_filePath));
     emit outputLog(cmd);
     qDebug() << "custom cmd:" << cmd;
     int ret = startProcess(cmd);
@@ -888,7 +1707,21 @@ int VExporter::exportPDFInOne(const QList<QString> &p_htmlFiles,
                               const QString &p_outputFile,
                               QString *p_errMsg)
 {
-    if (!htmlsToPDFViaWK(p_htmlFiles, p_outputFile, p_opt.m_pdfOpt, p_errMsg)) {
+    int nrChunks = qMin(g_config->getWkhtmltopdfProcesses(), p_htmlFiles.size());
+    if (nrChunks > 1 && p_opt.m_pdfOpt.m_enableTableOfContents) {
+        // The table of contents page of a chunk covers only the chunk itself.
+        emit outputLog(tr("Use one wkhtmltopdf process since table of contents is enabled."));
+        nrChunks = 1;
+    }
+
+    bool ret;
+    if (nrChunks > 1) {
+        ret = htmlsToPDFViaWKInChunks(p_htmlFiles, p_outputFile, p_opt.m_pdfOpt, nrChunks, p_errMsg);
+    } else {
+        ret = htmlsToPDFViaWK(p_htmlFiles, p_outputFile, p_opt.m_pdfOpt, p_errMsg);
+    }
+
+    if (!ret) {
         return 0;
     }
 
@@ -980,13 +1813,16 @@ int VExporter::startProcess(const QString &p_cmd)
 }
 
 bool VExporter::outputToHTMLFile(const QString &p_file,
+                                 const QString &p_template,
+                                 const QUrl &p_baseUrl,
                                  const QString &p_title,
                                  const QString &p_headContent,
                                  const QString &p_styleContent,
                                  const QString &p_bodyContent,
                                  bool p_embedCssStyle,
                                  bool p_completeHTML,
-                                 bool p_embedImages)
+                                 bool p_embedImages,
+                                 VExportResourceCache *p_cache)
 {
     QFile file(p_file);
     if (!file.open(QFile::WriteOnly)) {
@@ -998,36 +1834,60 @@ bool VExporter::outputToHTMLFile(const QString &p_file,
 
     qDebug() << "HTML files folder" << resFolderPath;
 
-    QString html(m_exportHtmlTemplate);
+    QString title;
     if (!p_title.isEmpty()) {
-        html.replace(HtmlHolder::c_headTitleHolder,
-                     "<title>" + VUtils::escapeHtml(p_title) + "</title>");
+        title = "<title>" + VUtils::escapeHtml(p_title) + "</title>";
     }
 
-    if (!p_styleContent.isEmpty() && p_embedCssStyle) {
-        QString content(p_styleContent);
-        embedStyleResources(content);
-        html.replace(HtmlHolder::c_styleHolder, content);
+    QString style;
+    if (p_embedCssStyle) {
+        style = p_styleContent;
+        embedStyleResources(style, p_cache);
     }
 
-    if (!p_headContent.isEmpty()) {
-        html.replace(HtmlHolder::c_headHolder, p_headContent);
+    QString body(p_bodyContent);
+    bool embedBody = p_completeHTML && p_embedImages;
+    if (p_completeHTML && !p_embedImages) {
+        fixBodyResources(p_baseUrl, resFolderPath, body);
     }
 
-    if (p_completeHTML) {
-        QString content(p_bodyContent);
-        if (p_embedImages) {
-            embedBodyResources(m_baseUrl, content);
+    // Write the template piece by piece with the holders replaced, so the
+    // embedded resources are never concatenated into the whole HTML.
+    const int bodyIdx = 3;
+    const QString *holders[] = { &HtmlHolder::c_headTitleHolder,
+                                 &HtmlHolder::c_styleHolder,
+                                 &HtmlHolder::c_headHolder,
+                                 &HtmlHolder::c_bodyHolder };
+    const QString *contents[] = { &title, &style, &p_headContent, &body };
+
+    // Holders to replace by their positions. Body holder is always replaced.
+    QMap<int, int> holderPos;
+    for (int i = 0; i <= bodyIdx; ++i) {
+        if (i != bodyIdx && contents[i]->isEmpty()) {
+            continue;
+        }
+
+        int idx = p_template.indexOf(*holders[i]);
+        if (idx != -1) {
+            holderPos.insert(idx, i);
+        }
+    }
+
+    int pos = 0;
+    for (auto it = holderPos.constBegin(); it != holderPos.constEnd(); ++it) {
+        file.write(p_template.midRef(pos, it.key() - pos).toUtf8());
+
+        int i = it.value();
+        if (i == bodyIdx && embedBody) {
+            embedBodyResources(p_baseUrl, body, &file, p_cache);
         } else {
-            fixBodyResources(m_baseUrl, resFolderPath, content);
+            file.write(contents[i]->toUtf8());
         }
 
-        html.replace(HtmlHolder::c_bodyHolder, content);
-    } else {
-        html.replace(HtmlHolder::c_bodyHolder, p_bodyContent);
+        pos = it.key() + holders[i]->size();
     }
 
-    file.write(html.toUtf8());
+    file.write(p_template.midRef(pos).toUtf8());
     file.close();
 
     // Delete empty resource folder.
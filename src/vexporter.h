@@ -6,12 +6,22 @@
 #include <QUrl>
 #include <QWebEngineDownloadItem>
 #include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
 
 #include "dialog/vexportdialog.h"
+#include "vexportresourcecache.h"
 
 class QWidget;
 class VWebView;
 class VDocument;
+class QProcess;
+class QTimer;
+class QEventLoop;
+class QIODevice;
 
 class VExporter : public QObject
 {
@@ -19,21 +29,19 @@ class VExporter : public QObject
 public:
     explicit VExporter(QWidget *p_parent = nullptr);
 
-    void prepareExport(const ExportOption &p_opt);
-
-    bool exportPDF(VFile *p_file,
-                   const ExportOption &p_opt,
-                   const QString &p_outputFile,
-                   QString *p_errMsg = NULL);
+    ~VExporter();
 
-    bool exportHTML(VFile *p_file,
-                    const ExportOption &p_opt,
-                    const QString &p_outputFile,
-                    QString *p_errMsg = NULL);
+    void prepareExport(const ExportOption &p_opt);
 
-    bool exportCustom(VFile *p_file,
+    // Export @p_jobs as PDF, HTML or custom format.
+    // Up to export_pages notes are exported concurrently, each by an offscreen
+    // web page, and a failed note will not stop the others.
+    // @p_outputFolder: the folder holding all the outputs. For incremental export,
+    // a manifest is kept in it to skip notes unchanged since last export.
+    // Return the number of notes exported.
+    int exportInBatch(QList<ExportJob> &p_jobs,
                       const ExportOption &p_opt,
-                      const QString &p_outputFile,
+                      const QString &p_outputFolder,
                       QString *p_errMsg = NULL);
 
     int exportPDFInOne(const QList<QString> &p_htmlFiles,
@@ -48,80 +56,232 @@ public:
 
     void setAskedToStop(bool p_askedToStop);
 
+    // Fill @p_template with the contents and write it to @p_file.
+    // Resources of the body are copied to a "_files" folder besides @p_file
+    // unless @p_embedImages.
+    // @p_embedImages: embed <img> as data URI.
+    // @p_cache: cache of the embedded resources.
+    // It does not touch the web engine and could be called from any thread.
+    static bool outputToHTMLFile(const QString &p_file,
+                                 const QString &p_template,
+                                 const QUrl &p_baseUrl,
+                                 const QString &p_title,
+                                 const QString &p_headContent,
+                                 const QString &p_styleContent,
+                                 const QString &p_bodyContent,
+                                 bool p_embedCssStyle,
+                                 bool p_completeHTML,
+                                 bool p_embedImages,
+                                 VExportResourceCache *p_cache);
+
 signals:
     // Request to output log.
     void outputLog(const QString &p_log);
 
-private slots:
-    void handleLogicsFinished();
+    // Emitted when a note of the batch is finished.
+    void noteExported(const VFile *p_file, const QString &p_outputFile, bool p_succeeded);
 
-    void handleLoadFinished(bool p_ok);
+    // @p_remainingMSecs: estimated time to finish the batch, -1 if unknown.
+    void progressChanged(int p_finished, int p_total, qint64 p_remainingMSecs);
 
+private slots:
     void handleDownloadRequested(QWebEngineDownloadItem *p_item);
 
 private:
-    enum class ExportState
-    {
-        Idle = 0,
-        Cancelled,
-        Busy,
-        Failed,
-        Successful
-    };
-
-
     enum NoteState
     {
         NotReady = 0,
         WebLogicsReady = 0x1,
         WebLoadFinished = 0x2,
-        Ready = 0x3,
-        Failed = 0x4
+        Ready = 0x3
     };
 
+    // Some of the HTML files rendered to one PDF by a wkhtmltopdf process.
+    struct PDFChunk
+    {
+        PDFChunk()
+            : m_pageOffset(0),
+              m_nrPages(-1),
+              m_finished(false),
+              m_exitCode(0)
+        {
+        }
 
-    void initWebViewer(VFile *p_file, const ExportOption &p_opt);
+        QList<QString> m_files;
 
-    void clearWebViewer();
+        QString m_outputFile;
 
-    void clearNoteState();
+        // Number of pages before this chunk.
+        int m_pageOffset;
 
-    bool isNoteStateReady() const;
+        // Number of pages reported by wkhtmltopdf. -1 if unknown.
+        int m_nrPages;
 
-    bool isNoteStateFailed() const;
+        bool m_finished;
 
-    bool exportViaWebView(VFile *p_file,
-                          const ExportOption &p_opt,
-                          const QString &p_outputFile,
-                          QString *p_errMsg = NULL);
+        int m_exitCode;
+    };
 
-    bool exportToPDF(VWebView *p_webViewer,
-                     const QString &p_filePath,
-                     const QPageLayout &p_layout);
+    // An offscreen web page exporting one note at a time.
+    struct Worker
+    {
+        Worker()
+            : m_jobIdx(-1),
+              m_fileOpened(false),
+              m_noteState(NoteState::NotReady),
+              m_webViewer(NULL),
+              m_webDocument(NULL),
+              m_process(NULL),
+              m_timer(NULL)
+        {
+        }
 
-    bool exportToPDFViaWK(VDocument *p_webDocument,
-                          const ExportPDFOption &p_opt,
-                          const QString &p_filePath,
-                          QString *p_errMsg = NULL);
+        // Index of the job in progress, -1 if idle.
+        int m_jobIdx;
+
+        // Whether the note is opened by the worker.
+        bool m_fileOpened;
+
+        NoteState m_noteState;
+
+        // Will be allocated and free for each note.
+        VWebView *m_webViewer;
+
+        VDocument *m_webDocument;
+
+        // Base URL of VWebView.
+        QUrl m_baseUrl;
+
+        // wkhtmltopdf or the custom command.
+        QProcess *m_process;
+
+        // Command line of @m_process for the log.
+        QString m_command;
+
+        // Holding the HTML file as the input of @m_process.
+        QScopedPointer<QTemporaryDir> m_tmpDir;
+
+        // Fail the note if one step takes too long.
+        QTimer *m_timer;
+    };
+
+    // Export state of a note in the manifest.
+    struct ManifestEntry
+    {
+        // Output file relative to the output folder.
+        QString m_output;
+
+        // Hash of the note, its images and attachments.
+        QString m_hash;
+
+        // Hash of the options the output is exported with.
+        QString m_optionsHash;
+
+        // Root folder of the notebook of the note. A note is considered
+        // deleted only if its root folder is still there.
+        QString m_root;
+    };
+
+    // Manifest of incremental export, keyed by the path of the note.
+    typedef QHash<QString, ManifestEntry> Manifest;
+
+    // Queue the jobs of notes changed since last export to @p_folder and
+    // remove the outputs of deleted notes according to @p_manifest.
+    // @p_hashes will be set to the hashes of the notes.
+    // Return the number of jobs skipped.
+    int queueChangedJobs(const QString &p_folder,
+                         const QString &p_optionsHash,
+                         Manifest &p_manifest,
+                         QVector<QString> &p_hashes);
+
+    bool readManifest(const QString &p_folder, Manifest &p_manifest) const;
+
+    bool writeManifest(const QString &p_folder, const Manifest &p_manifest) const;
+
+    // Hash of the options and templates affecting the outputs.
+    QString optionsHash() const;
 
-    bool exportToCustom(VDocument *p_webDocument,
-                        const ExportCustomOption &p_opt,
-                        const QString &p_filePath,
-                        QString *p_errMsg = NULL);
+    // Images and attachments are identified by path, size and modified time.
+    static QString noteHash(VFile *p_file);
 
-    bool exportToHTML(VDocument *p_webDocument,
-                      const ExportHTMLOption &p_opt,
-                      const QString &p_filePath);
+    // Root folder of the notebook containing @p_file.
+    static QString noteRoot(const VFile *p_file);
 
-    bool exportToMHTML(VWebView *p_webViewer,
-                       const ExportHTMLOption &p_opt,
-                       const QString &p_filePath);
+    // Resolve output @p_output recorded in the manifest of @p_folder.
+    // Return empty if it lies outside @p_folder.
+    static QString manifestOutputPath(const QString &p_folder, const QString &p_output);
+
+    // Remove the output file @p_file and its resource folder.
+    void removeOutput(const QString &p_file);
+
+    // Run the jobs in @m_queue by a pool of workers until all finished or cancelled.
+    void runQueuedJobs();
+
+    // Start queued jobs on idle workers.
+    void dispatch();
+
+    // Return false if it fails to start.
+    bool startNote(Worker *p_worker, int p_idx);
+
+    void initWebViewer(Worker *p_worker, VFile *p_file);
+
+    void handleLoadFinished(int p_idx, bool p_ok);
+
+    void handleLogicsFinished(int p_idx);
+
+    // Output the note once the web side is ready.
+    void exportNote(Worker *p_worker);
+
+    void handleHtmlContentFinished(int p_idx,
+                                   const QString &p_headContent,
+                                   const QString &p_styleContent,
+                                   const QString &p_bodyContent);
+
+    // Run @p_program asynchronously to output the note of @p_worker.
+    void startNoteProcess(Worker *p_worker,
+                          const QString &p_program,
+                          const QStringList &p_args);
+
+    // @p_ret: -2 if it fails to start, -1 if it crashes, or the exit code.
+    void handleNoteProcessExited(int p_idx, int p_ret);
+
+    void finishNote(Worker *p_worker, bool p_succeeded);
+
+    // Count the result of job @p_idx and report the progress.
+    void finishJob(int p_idx, bool p_succeeded);
+
+    // Stop the work of @p_worker and free its web page.
+    void resetWorker(Worker *p_worker);
+
+    // Return the worker working on job @p_idx.
+    Worker *findWorker(int p_idx) const;
+
+    QStringList wkArguments(const QList<QString> &p_htmlFiles,
+                            const QString &p_filePath) const;
 
     bool htmlsToPDFViaWK(const QList<QString> &p_htmlFiles,
                          const QString &p_filePath,
                          const ExportPDFOption &p_opt,
                          QString *p_errMsg = NULL);
 
+    // Split @p_htmlFiles into @p_nrChunks chunks of similar size, render them
+    // by wkhtmltopdf processes in parallel and merge them in order by the
+    // merge command.
+    bool htmlsToPDFViaWKInChunks(const QList<QString> &p_htmlFiles,
+                                 const QString &p_filePath,
+                                 const ExportPDFOption &p_opt,
+                                 int p_nrChunks,
+                                 QString *p_errMsg = NULL);
+
+    // Render @p_chunks by wkhtmltopdf at the same time. With page numbers, a
+    // chunk is started once the pages of the chunks before it are counted.
+    // Processes taking too long are killed.
+    // @p_total: number of steps of the export for progress.
+    bool runPDFChunks(QVector<PDFChunk> &p_chunks,
+                      const ExportPDFOption &p_opt,
+                      int p_total,
+                      QString *p_errMsg);
+
     bool convertFilesViaCustom(const QList<QString> &p_files,
                                const QString &p_filePath,
                                const ExportCustomOption &p_opt,
@@ -133,16 +293,6 @@ private:
 
     int startProcess(const QString &p_cmd);
 
-    // @p_embedImages: embed <img> as data URI.
-    bool outputToHTMLFile(const QString &p_file,
-                          const QString &p_title,
-                          const QString &p_headContent,
-                          const QString &p_styleContent,
-                          const QString &p_bodyContent,
-                          bool p_embedCssStyle,
-                          bool p_completeHTML,
-                          bool p_embedImages);
-
     // Fix @p_html's resources like url("...") with "file" or "qrc" schema.
     // Copy the resource to @p_folder and fix the url string.
     static bool fixStyleResources(const QString &p_folder,
@@ -150,7 +300,7 @@ private:
 
     // Fix @p_html's resources like url("...") with "file" or "qrc" schema.
     // Embed the image data in data URIs.
-    static bool embedStyleResources(QString &p_html);
+    static bool embedStyleResources(QString &p_html, VExportResourceCache *p_cache);
 
     // Fix @p_html's resources like <img>.
     // Copy the resource to @p_folder and fix the url string.
@@ -158,56 +308,54 @@ private:
                                  const QString &p_folder,
                                  QString &p_html);
 
-    // Embed @p_html's resources like <img>.
-    static bool embedBodyResources(const QUrl &p_baseUrl, QString &p_html);
+    // Write @p_html to @p_out with resources like <img> embedded.
+    // Data URIs are written directly instead of being inserted into @p_html.
+    static bool embedBodyResources(const QUrl &p_baseUrl,
+                                   const QString &p_html,
+                                   QIODevice *p_out,
+                                   VExportResourceCache *p_cache);
 
     static QString getResourceRelativePath(const QString &p_file);
 
     QPageLayout m_pageLayout;
 
-    // Will be allocated and free for each conversion.
-    VWebView *m_webViewer;
-
-    VDocument *m_webDocument;
-
-    // Base URL of VWebView.
-    QUrl m_baseUrl;
-
     QString m_htmlTemplate;
 
     // Template to hold the export HTML result.
     QString m_exportHtmlTemplate;
 
-    NoteState m_noteState;
-
-    ExportState m_state;
-
-    // Download state used for MIME HTML.
-    QWebEngineDownloadItem::DownloadState m_downloadState;
-
     // Arguments for wkhtmltopdf.
     QStringList m_wkArgs;
 
+    // Resources embedded since last prepareExport().
+    VExportResourceCache m_resourceCache;
+
     bool m_askedToStop;
-};
 
-inline void VExporter::clearNoteState()
-{
-    m_noteState = NoteState::NotReady;
-}
+    // Option of current batch.
+    ExportOption m_opt;
 
-inline bool VExporter::isNoteStateReady() const
-{
-    return m_noteState == NoteState::Ready;
-}
+    // Jobs of current batch.
+    QList<ExportJob> *m_jobs;
 
-inline bool VExporter::isNoteStateFailed() const
-{
-    return m_noteState & NoteState::Failed;
-}
+    QString *m_errMsg;
 
-inline void VExporter::setAskedToStop(bool p_askedToStop)
-{
-    m_askedToStop = p_askedToStop;
-}
+    // Indexes of the jobs to start.
+    QList<int> m_queue;
+
+    // Number of jobs to run in current batch.
+    int m_nrJobs;
+
+    int m_nrFinished;
+
+    int m_nrSucceeded;
+
+    QList<Worker *> m_workers;
+
+    // Time elapsed of current batch.
+    QElapsedTimer m_batchTimer;
+
+    // Running until current batch is finished or cancelled.
+    QEventLoop *m_batchLoop;
+};
 #endif // VEXPORTER_H
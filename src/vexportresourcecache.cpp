@@ -0,0 +1,77 @@
+#include "vexportresourcecache.h"
+
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include "utils/vwebutils.h"
+
+extern VWebUtils *g_webUtils;
+
+VExportResourceCache::VExportResourceCache(int p_maxSize)
+    : m_uris(p_maxSize > 0 ? p_maxSize : 0),
+      m_hits(0),
+      m_misses(0)
+{
+}
+
+QString VExportResourceCache::canonicalUrl(const QUrl &p_url)
+{
+    if (p_url.isLocalFile()) {
+        QFileInfo fi(p_url.toLocalFile());
+        QString path = fi.canonicalFilePath();
+        if (path.isEmpty()) {
+            path = fi.absoluteFilePath();
+        }
+
+        return QUrl::fromLocalFile(path).toString();
+    }
+
+    return p_url.adjusted(QUrl::NormalizePathSegments | QUrl::RemoveFragment).toString();
+}
+
+QByteArray VExportResourceCache::dataURI(const QUrl &p_url, bool p_keepTitle)
+{
+    QString key = canonicalUrl(p_url);
+    if (!p_keepTitle) {
+        key.prepend("notitle|");
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        const QByteArray *uri = m_uris.object(key);
+        if (uri) {
+            ++m_hits;
+            return *uri;
+        }
+
+        ++m_misses;
+    }
+
+    // Read and encode it without the lock. Two threads may do it at the same
+    // time, which is rare and harmless.
+    QByteArray uri = g_webUtils->dataURI(p_url, p_keepTitle).toUtf8();
+
+    QMutexLocker locker(&m_mutex);
+    // Count failed ones as one byte to keep them too.
+    m_uris.insert(key, new QByteArray(uri), qMax(uri.size(), 1));
+    return uri;
+}
+
+void VExportResourceCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_uris.clear();
+}
+
+QString VExportResourceCache::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    unsigned long long total = m_hits + m_misses;
+    double hitRate = total > 0 ? m_hits * 100.0 / total : 0;
+    return QString("resources %1 memory %2 KB hits %3 misses %4 hit rate %5%")
+                  .arg(m_uris.size())
+                  .arg(m_uris.totalCost() / 1024)
+                  .arg(m_hits)
+                  .arg(m_misses)
+                  .arg(hitRate, 0, 'f', 1);
+}
@@ -0,0 +1,43 @@
+#ifndef VEXPORTRESOURCECACHE_H
+#define VEXPORTRESOURCECACHE_H
+
+#include <QCache>
+#include <QString>
+#include <QByteArray>
+#include <QMutex>
+#include <QUrl>
+
+// Cache of resources embedded in exported HTML during an export, keyed by the
+// canonical URL, so an image used many times is read and encoded only once.
+// It could be used by many threads.
+class VExportResourceCache
+{
+public:
+    // @p_maxSize: max size in bytes of the data URIs to keep.
+    explicit VExportResourceCache(int p_maxSize);
+
+    // Return the data URI of @p_url in UTF-8, or empty if it is not an image.
+    // Please use single quote to quote the URI.
+    QByteArray dataURI(const QUrl &p_url, bool p_keepTitle = true);
+
+    // Drop all the cached resources, which may have changed since last export.
+    void clear();
+
+    // Usage and hit rate for the log.
+    QString statistics() const;
+
+    // Key of @p_url shared by all the URLs referring to the same resource.
+    static QString canonicalUrl(const QUrl &p_url);
+
+private:
+    mutable QMutex m_mutex;
+
+    // Data URIs by canonical URL. Empty data for those failed to embed.
+    QCache<QString, QByteArray> m_uris;
+
+    unsigned long long m_hits;
+
+    unsigned long long m_misses;
+};
+
+#endif // VEXPORTRESOURCECACHE_H
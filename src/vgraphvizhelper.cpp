@@ -5,39 +5,38 @@
 
 #include "vconfigmanager.h"
 #include "utils/vprocessutils.h"
+#include "vrenderscheduler.h"
 
 extern VConfigManager *g_config;
 
-#define TaskIdProperty "GraphvizTaskId"
-#define TaskFormatProperty "GraphvizTaskFormat"
-#define TaskTimeStampProperty "GraphvizTaskTimeStamp"
+extern VRenderScheduler *g_renderScheduler;
 
 VGraphvizHelper::VGraphvizHelper(QObject *p_parent)
     : QObject(p_parent)
 {
     prepareCommand(m_program, m_args);
+
+    connect(g_renderScheduler, &VRenderScheduler::jobFinished,
+            this, &VGraphvizHelper::handleJobFinished);
 }
 
-void VGraphvizHelper::processAsync(int p_id, TimeStamp p_timeStamp, const QString &p_format, const QString &p_text)
+VGraphvizHelper::~VGraphvizHelper()
 {
-    QProcess *process = new QProcess(this);
-    process->setProperty(TaskIdProperty, p_id);
-    process->setProperty(TaskTimeStampProperty, p_timeStamp);
-    process->setProperty(TaskFormatProperty, p_format);
-    connect(process, SIGNAL(finished(int, QProcess::ExitStatus)),
-            this, SLOT(handleProcessFinished(int, QProcess::ExitStatus)));
+    g_renderScheduler->cancelAll(this);
+}
 
+void VGraphvizHelper::processAsync(int p_id, TimeStamp p_timeStamp, const QString &p_format, const QString &p_text)
+{
     QStringList args(m_args);
     args << ("-T" + p_format);
 
-    qDebug() << m_program << args;
-
-    process->start(m_program, args);
-    if (process->write(p_text.toUtf8()) == -1) {
-        qWarning() << "fail to write to QProcess:" << process->errorString();
-    }
-
-    process->closeWriteChannel();
+    g_renderScheduler->schedule(this,
+                                p_id,
+                                p_timeStamp,
+                                p_format,
+                                m_program,
+                                args,
+                                p_text.toUtf8());
 }
 
 void VGraphvizHelper::prepareCommand(QString &p_program, QStringList &p_args) const
@@ -52,16 +51,23 @@ void VGraphvizHelper::prepareCommand(QString &p_program, QStringList &p_args) co
     p_args.clear();
 }
 
-void VGraphvizHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus)
+void VGraphvizHelper::handleJobFinished(const QObject *p_owner,
+                                        int p_id,
+                                        TimeStamp p_timeStamp,
+                                        const QString &p_format,
+                                        int p_exitCode,
+                                        QProcess::ExitStatus p_exitStatus,
+                                        const QByteArray &p_out,
+                                        const QByteArray &p_err)
 {
-    QProcess *process = static_cast<QProcess *>(sender());
-    int id = process->property(TaskIdProperty).toInt();
-    QString format = process->property(TaskFormatProperty).toString();
-    TimeStamp timeStamp = process->property(TaskTimeStampProperty).toULongLong();
+    if (p_owner != this) {
+        return;
+    }
+
     qDebug() << QString("Graphviz finished: id %1 timestamp %2 format %3 exitcode %4 exitstatus %5")
-                       .arg(id)
-                       .arg(timeStamp)
-                       .arg(format)
+                       .arg(p_id)
+                       .arg(p_timeStamp)
+                       .arg(p_format)
                        .arg(p_exitCode)
                        .arg(p_exitStatus);
     bool failed = true;
@@ -70,20 +76,18 @@ void VGraphvizHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus
             qWarning() << "Graphviz fail" << p_exitCode;
         } else {
             failed = false;
-            QByteArray outBa = process->readAllStandardOutput();
-            if (format == "svg") {
-                emit resultReady(id, timeStamp, format, QString::fromLocal8Bit(outBa));
+            if (p_format == "svg") {
+                emit resultReady(p_id, p_timeStamp, p_format, QString::fromLocal8Bit(p_out));
             } else {
-                emit resultReady(id, timeStamp, format, QString::fromLocal8Bit(outBa.toBase64()));
+                emit resultReady(p_id, p_timeStamp, p_format, QString::fromLocal8Bit(p_out.toBase64()));
             }
         }
     } else {
         qWarning() << "fail to start Graphviz process" << p_exitCode << p_exitStatus;
     }
 
-    QByteArray errBa = process->readAllStandardError();
-    if (!errBa.isEmpty()) {
-        QString errStr(QString::fromLocal8Bit(errBa));
+    if (!p_err.isEmpty()) {
+        QString errStr(QString::fromLocal8Bit(p_err));
         if (failed) {
             qWarning() << "Graphviz stderr:" << errStr;
         } else {
@@ -92,10 +96,8 @@ void VGraphvizHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus
     }
 
     if (failed) {
-        emit resultReady(id, timeStamp, format, "");
+        emit resultReady(p_id, p_timeStamp, p_format, "");
     }
-
-    process->deleteLater();
 }
 
 bool VGraphvizHelper::testGraphviz(const QString &p_dot, QString &p_msg)
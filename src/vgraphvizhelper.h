@@ -14,6 +14,8 @@ class VGraphvizHelper : public QObject
 public:
     explicit VGraphvizHelper(QObject *p_parent = nullptr);
 
+    ~VGraphvizHelper();
+
     void processAsync(int p_id, TimeStamp p_timeStamp, const QString &p_format, const QString &p_text);
 
     static bool testGraphviz(const QString &p_dot, QString &p_msg);
@@ -24,7 +26,14 @@ signals:
     void resultReady(int p_id, TimeStamp p_timeStamp, const QString &p_format, const QString &p_result);
 
 private slots:
-    void handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus);
+    void handleJobFinished(const QObject *p_owner,
+                           int p_id,
+                           TimeStamp p_timeStamp,
+                           const QString &p_format,
+                           int p_exitCode,
+                           QProcess::ExitStatus p_exitStatus,
+                           const QByteArray &p_out,
+                           const QByteArray &p_err);
 
 private:
     void prepareCommand(QString &p_cmd, QStringList &p_args) const;
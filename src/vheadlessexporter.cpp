@@ -0,0 +1,208 @@
+#include "vheadlessexporter.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QUrl>
+#include <QRegExp>
+#include <QMutexLocker>
+
+#include "vconfigmanager.h"
+#include "vexporter.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+// Max size of embedded resources kept during an export.
+#define RESOURCE_CACHE_SIZE 64 * 1024 * 1024
+
+VHeadlessExporter::VHeadlessExporter()
+    : m_mdExtensions((hoedown_extensions)0),
+      m_resourceCache(RESOURCE_CACHE_SIZE),
+      m_nextJob(0),
+      m_nrSucceeded(0),
+      m_nrFailed(0)
+{
+}
+
+int VHeadlessExporter::exportHtml(const QString &p_path,
+                                  const QString &p_outputFolder,
+                                  const ExportHTMLOption &p_opt)
+{
+    m_opt = p_opt;
+    m_jobs.clear();
+    m_nextJob = 0;
+    m_nrSucceeded.store(0);
+    m_nrFailed.store(0);
+    m_resourceCache.clear();
+
+    QFileInfo info(p_path);
+    if (info.isDir()) {
+        collectJobs(info.absoluteFilePath(), p_outputFolder);
+    } else if (info.isFile()) {
+        addJob(info.absoluteFilePath(), p_outputFolder);
+    }
+
+    if (m_jobs.isEmpty()) {
+        qWarning() << "no note to export in" << p_path;
+        return -1;
+    }
+
+    // Everything shared by the workers is prepared here and read-only then.
+    m_template = VUtils::generateExportHtmlTemplate(g_config->getCurRenderBackgroundColor(),
+                                                    g_config->getEnableMathjax(),
+                                                    m_opt.m_outlinePanel);
+    m_styleContent = readStyle(g_config->getCssStyleUrl())
+                     + "\n"
+                     + readStyle(g_config->getCodeBlockCssStyleUrl());
+    m_mdExtensions = g_config->getMarkdownExtensions();
+
+    int nrThreads = qMin(qMax(QThread::idealThreadCount(), 1), m_jobs.size());
+    qInfo() << "export" << m_jobs.size() << "notes by" << nrThreads << "threads";
+
+    QList<VHeadlessExportWorker *> workers;
+    for (int i = 0; i < nrThreads; ++i) {
+        VHeadlessExportWorker *worker = new VHeadlessExportWorker(this);
+        workers.append(worker);
+        worker->start();
+    }
+
+    for (auto worker : workers) {
+        worker->wait();
+        delete worker;
+    }
+
+    qInfo() << "headless export finished, succeeded" << m_nrSucceeded.load()
+            << "failed" << m_nrFailed.load();
+    qInfo() << "export resource cache" << m_resourceCache.statistics();
+
+    return m_nrSucceeded.load();
+}
+
+void VHeadlessExporter::collectJobs(const QString &p_folder, const QString &p_outputFolder)
+{
+    QDir dir(p_folder);
+    QStringList files = dir.entryList(QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
+    for (auto const &file : files) {
+        addJob(dir.filePath(file), p_outputFolder);
+    }
+
+    QStringList subFolders = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (auto const &sub : subFolders) {
+        if (sub == g_config->getRecycleBinFolder()
+            || sub == g_config->getAttachmentFolder()) {
+            continue;
+        }
+
+        collectJobs(dir.filePath(sub), QDir(p_outputFolder).filePath(sub));
+    }
+}
+
+void VHeadlessExporter::addJob(const QString &p_file, const QString &p_outputFolder)
+{
+    if (VUtils::docTypeFromName(p_file) != DocType::Markdown) {
+        return;
+    }
+
+    // Create the folders here to avoid the race among workers.
+    if (!VUtils::makePath(p_outputFolder)) {
+        qWarning() << "fail to create output folder" << p_outputFolder;
+        ++m_nrFailed;
+        return;
+    }
+
+    Job job;
+    job.m_file = p_file;
+    job.m_outputFile = QDir(p_outputFolder).filePath(QFileInfo(p_file).completeBaseName() + ".html");
+    m_jobs.append(job);
+}
+
+bool VHeadlessExporter::takeJob(Job &p_job)
+{
+    QMutexLocker locker(&m_jobsMutex);
+    if (m_nextJob >= m_jobs.size()) {
+        return false;
+    }
+
+    p_job = m_jobs.at(m_nextJob++);
+    return true;
+}
+
+bool VHeadlessExporter::exportNote(VMarkdownConverter &p_converter, const Job &p_job)
+{
+    QString text = VUtils::readFileFromDisk(p_job.m_file);
+
+    QString toc;
+    QString body = p_converter.generateHtml(text, m_mdExtensions, toc);
+
+    QFileInfo info(p_job.m_file);
+    QUrl baseUrl = QUrl::fromLocalFile(info.absolutePath() + "/");
+    return VExporter::outputToHTMLFile(p_job.m_outputFile,
+                                       m_template,
+                                       baseUrl,
+                                       info.completeBaseName(),
+                                       QString(),
+                                       m_styleContent,
+                                       body,
+                                       m_opt.m_embedCssStyle,
+                                       m_opt.m_completeHTML,
+                                       m_opt.m_embedImages,
+                                       &m_resourceCache);
+}
+
+QString VHeadlessExporter::readStyle(const QString &p_url)
+{
+    if (p_url.isEmpty()) {
+        return QString();
+    }
+
+    QUrl url(p_url);
+    QString file;
+    if (url.scheme() == "qrc") {
+        file = ":" + url.path();
+    } else {
+        file = url.toLocalFile();
+    }
+
+    QString content = VUtils::readFileFromDisk(file);
+
+    // Resources will be embedded or copied only when referred by absolute url.
+    QRegExp reg("\\burl\\((['\"]?)([^'\"\\)]+)\\1\\)");
+    int pos = 0;
+    while ((pos = reg.indexIn(content, pos)) != -1) {
+        QUrl resUrl(reg.cap(2).trimmed());
+        if (!resUrl.isRelative()) {
+            pos += reg.matchedLength();
+            continue;
+        }
+
+        QString newUrl = QString("url(\"%1\")").arg(url.resolved(resUrl).toString());
+        content.replace(pos, reg.matchedLength(), newUrl);
+        pos += newUrl.size();
+    }
+
+    return content;
+}
+
+VHeadlessExportWorker::VHeadlessExportWorker(VHeadlessExporter *p_exporter, QObject *p_parent)
+    : QThread(p_parent),
+      m_exporter(p_exporter)
+{
+}
+
+void VHeadlessExportWorker::run()
+{
+    // Renderers could not be shared among threads.
+    VMarkdownConverter converter;
+
+    VHeadlessExporter::Job job;
+    while (m_exporter->takeJob(job)) {
+        if (m_exporter->exportNote(converter, job)) {
+            ++m_exporter->m_nrSucceeded;
+            qInfo() << "note" << job.m_file << "exported to" << job.m_outputFile;
+        } else {
+            ++m_exporter->m_nrFailed;
+            qWarning() << "fail to export note" << job.m_file;
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef VHEADLESSEXPORTER_H
+#define VHEADLESSEXPORTER_H
+
+#include <QString>
+#include <QList>
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include "dialog/vexportdialog.h"
+#include "vmarkdownconverter.h"
+#include "vexportresourcecache.h"
+
+// Export Markdown notes to HTML without the web engine, so it could run on a
+// headless box from the command line.
+// Notes are rendered by hoedown and written with the export template by a pool
+// of threads. Code blocks and diagrams are left as they are since they are
+// rendered by JavaScript in the read mode.
+class VHeadlessExporter
+{
+public:
+    VHeadlessExporter();
+
+    // Export @p_path, a note or a folder which will be walked recursively, to
+    // @p_outputFolder, keeping the structure of the folders.
+    // Return the number of notes exported, or -1 if no note is found.
+    int exportHtml(const QString &p_path,
+                   const QString &p_outputFolder,
+                   const ExportHTMLOption &p_opt);
+
+    int getNumOfFailed() const;
+
+private:
+    friend class VHeadlessExportWorker;
+
+    struct Job
+    {
+        QString m_file;
+
+        QString m_outputFile;
+    };
+
+    // Collect notes in @p_folder into m_jobs.
+    void collectJobs(const QString &p_folder, const QString &p_outputFolder);
+
+    void addJob(const QString &p_file, const QString &p_outputFolder);
+
+    // Return false if there is no more job.
+    bool takeJob(Job &p_job);
+
+    // Called from the worker threads.
+    bool exportNote(VMarkdownConverter &p_converter, const Job &p_job);
+
+    // Read the content of CSS @p_url and make its relative url() absolute.
+    static QString readStyle(const QString &p_url);
+
+    ExportHTMLOption m_opt;
+
+    QString m_template;
+
+    QString m_styleContent;
+
+    hoedown_extensions m_mdExtensions;
+
+    // Shared by all the workers.
+    VExportResourceCache m_resourceCache;
+
+    QMutex m_jobsMutex;
+
+    QList<Job> m_jobs;
+
+    int m_nextJob;
+
+    QAtomicInt m_nrSucceeded;
+
+    QAtomicInt m_nrFailed;
+};
+
+inline int VHeadlessExporter::getNumOfFailed() const
+{
+    return m_nrFailed.load();
+}
+
+// Take and export notes until the queue is empty.
+class VHeadlessExportWorker : public QThread
+{
+    Q_OBJECT
+public:
+    explicit VHeadlessExportWorker(VHeadlessExporter *p_exporter, QObject *p_parent = nullptr);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    VHeadlessExporter *m_exporter;
+};
+
+#endif // VHEADLESSEXPORTER_H
@@ -0,0 +1,283 @@
+#include "vimagedecoder.h"
+
+#include <QDebug>
+#include <QBuffer>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QSet>
+
+#include <algorithm>
+
+#include "vimagethumbnailcache.h"
+#include "utils/vutils.h"
+
+extern VImageThumbnailCache *g_imageThumbnailCache;
+
+// Max number of worker threads to decode images.
+#define MAX_NUM_OF_THREADS 4
+
+VImageDecoderWorker::VImageDecoderWorker(VImageDecoder *p_decoder)
+    : QThread(p_decoder),
+      m_stop(0),
+      m_decoder(p_decoder)
+{
+}
+
+void VImageDecoderWorker::stop()
+{
+    m_stop.store(1);
+}
+
+void VImageDecoderWorker::run()
+{
+    VImageDecodeJob job;
+    while (!isAskedToStop() && m_decoder->takeJob(job)) {
+        QImage image = VImageDecoder::decode(job);
+        if (isAskedToStop()) {
+            break;
+        }
+
+        emit imageDecoded(VImageDecoder::jobKey(job), job.m_name, image);
+    }
+}
+
+
+VImageDecoder::VImageDecoder(QObject *p_parent)
+    : QObject(p_parent)
+{
+}
+
+VImageDecoder::~VImageDecoder()
+{
+    cancel();
+
+    for (auto const & th : m_workers) {
+        th->stop();
+    }
+
+    for (auto const & th : m_workers) {
+        th->wait();
+        delete th;
+    }
+
+    m_workers.clear();
+}
+
+void VImageDecoder::decodeAsync(const QVector<VImageDecodeJob> &p_jobs)
+{
+    {
+    QMutexLocker locker(&m_mutex);
+    m_jobs.clear();
+    QSet<QString> names;
+    for (auto const &job : p_jobs) {
+        if (names.contains(job.m_name) || m_running.contains(jobKey(job))) {
+            continue;
+        }
+
+        names.insert(job.m_name);
+        m_jobs.append(job);
+    }
+
+    // Keep the order of jobs with the same priority.
+    std::stable_sort(m_jobs.begin(), m_jobs.end(),
+                     [](const VImageDecodeJob &p_a, const VImageDecodeJob &p_b) {
+                         return p_a.m_priority < p_b.m_priority;
+                     });
+
+    if (m_jobs.isEmpty()) {
+        return;
+    }
+    }
+
+    startWorkers();
+}
+
+void VImageDecoder::cancel()
+{
+    QMutexLocker locker(&m_mutex);
+    m_jobs.clear();
+}
+
+bool VImageDecoder::takeJob(VImageDecodeJob &p_job)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_jobs.isEmpty()) {
+        return false;
+    }
+
+    p_job = m_jobs.takeFirst();
+    m_running.insert(jobKey(p_job), p_job.m_name);
+    return true;
+}
+
+QString VImageDecoder::jobKey(const VImageDecodeJob &p_job)
+{
+    // Data is identified by its buffer, which is shared among the copies of
+    // the job, to avoid hashing it.
+    return QString("%1|%2|%3|%4|%5x%6|%7|%8|%9").arg(p_job.m_name)
+                                                .arg(p_job.m_path)
+                                                .arg((quintptr)p_job.m_data.constData())
+                                                .arg(p_job.m_data.size())
+                                                .arg(p_job.m_width)
+                                                .arg(p_job.m_height)
+                                                .arg(p_job.m_scaleFactor)
+                                                .arg(p_job.m_format)
+                                                .arg(p_job.m_background);
+}
+
+void VImageDecoder::startWorkers()
+{
+    if (m_workers.isEmpty()) {
+        int numThread = qMin(QThread::idealThreadCount(), MAX_NUM_OF_THREADS);
+        if (numThread < 1) {
+            numThread = 1;
+        }
+
+        for (int i = 0; i < numThread; ++i) {
+            VImageDecoderWorker *th = new VImageDecoderWorker(this);
+            connect(th, &VImageDecoderWorker::imageDecoded,
+                    this, &VImageDecoder::handleImageDecoded);
+            connect(th, &VImageDecoderWorker::finished,
+                    this, &VImageDecoder::handleWorkerFinished);
+            m_workers.append(th);
+        }
+    }
+
+    for (auto const & th : m_workers) {
+        if (!th->isRunning()) {
+            th->start();
+        }
+    }
+}
+
+void VImageDecoder::handleImageDecoded(const QString &p_key,
+                                       const QString &p_name,
+                                       const QImage &p_image)
+{
+    {
+    QMutexLocker locker(&m_mutex);
+    m_running.remove(p_key);
+
+    // Drop it if a job of the same image with other parameters is pending or
+    // running, which will emit the up-to-date result.
+    bool superseded = !m_running.key(p_name).isEmpty();
+    for (auto it = m_jobs.constBegin(); !superseded && it != m_jobs.constEnd(); ++it) {
+        superseded = it->m_name == p_name;
+    }
+
+    if (superseded) {
+        qDebug() << "drop superseded decoded image" << p_name;
+        return;
+    }
+    }
+
+    if (p_image.isNull()) {
+        qWarning() << "fail to decode image" << p_name;
+    }
+
+    emit imageDecoded(p_name, p_image);
+}
+
+void VImageDecoder::handleWorkerFinished()
+{
+    // A worker may quit right before new jobs arrive.
+    bool hasJobs = false;
+    {
+    QMutexLocker locker(&m_mutex);
+    hasJobs = !m_jobs.isEmpty();
+    }
+
+    VImageDecoderWorker *th = static_cast<VImageDecoderWorker *>(sender());
+    if (hasJobs && !th->isAskedToStop()) {
+        th->wait();
+        th->start();
+    }
+}
+
+QSize VImageDecoder::previewSize(const QSize &p_size,
+                                 int p_width,
+                                 int p_height,
+                                 qreal p_scaleFactor)
+{
+    if (!p_size.isValid() || p_size.isEmpty()) {
+        return p_size;
+    }
+
+    const qreal sf = p_scaleFactor;
+    if (p_width > 0) {
+        if (p_height > 0) {
+            return QSize(p_width * sf, p_height * sf);
+        } else {
+            int width = p_width * sf;
+            return QSize(width, qRound(p_size.height() * (qreal)width / p_size.width()));
+        }
+    } else if (p_height > 0) {
+        int height = p_height * sf;
+        return QSize(qRound(p_size.width() * (qreal)height / p_size.height()), height);
+    } else {
+        if (sf < 1.1) {
+            return p_size;
+        } else {
+            int width = p_size.width() * sf;
+            return QSize(width, qRound(p_size.height() * (qreal)width / p_size.width()));
+        }
+    }
+}
+
+QImage VImageDecoder::decode(const VImageDecodeJob &p_job)
+{
+    if (p_job.m_format == "svg") {
+        return VUtils::svgToImage(p_job.m_data, p_job.m_background, p_job.m_scaleFactor);
+    }
+
+    QBuffer buffer;
+    QImageReader reader;
+    if (p_job.m_data.isEmpty()) {
+        reader.setFileName(p_job.m_path);
+    } else {
+        buffer.setData(p_job.m_data);
+        buffer.open(QIODevice::ReadOnly);
+        reader.setDevice(&buffer);
+    }
+
+    reader.setDecideFormatFromContent(true);
+
+    // Let the handler decode at the target size directly if it could,
+    // such as JPEG and SVG.
+    QSize size = reader.size();
+    QSize targetSize = previewSize(size, p_job.m_width, p_job.m_height, p_job.m_scaleFactor);
+
+    // Try the thumbnail of large local images first.
+    bool needThumbnail = p_job.m_data.isEmpty()
+                         && g_imageThumbnailCache
+                         && g_imageThumbnailCache->needThumbnail(p_job.m_path, size, targetSize);
+    if (needThumbnail) {
+        QImage thumbnail = g_imageThumbnailCache->find(p_job.m_path, targetSize);
+        if (!thumbnail.isNull()) {
+            return thumbnail;
+        }
+    }
+
+    if (size.isValid() && targetSize != size) {
+        reader.setScaledSize(targetSize);
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "fail to read image" << p_job.m_name << reader.errorString();
+        return image;
+    }
+
+    if (needThumbnail) {
+        g_imageThumbnailCache->insert(p_job.m_path, image);
+    }
+
+    if (!size.isValid()) {
+        targetSize = previewSize(image.size(), p_job.m_width, p_job.m_height, p_job.m_scaleFactor);
+        if (targetSize != image.size()) {
+            image = image.scaled(targetSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+    }
+
+    return image;
+}
@@ -0,0 +1,138 @@
+#ifndef VIMAGEDECODER_H
+#define VIMAGEDECODER_H
+
+#include <QObject>
+#include <QThread>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QList>
+#include <QHash>
+#include <QVector>
+#include <QImage>
+#include <QSize>
+#include <QByteArray>
+
+// One image to decode.
+struct VImageDecodeJob
+{
+    VImageDecodeJob()
+        : m_width(-1),
+          m_height(-1),
+          m_scaleFactor(1),
+          m_priority(0)
+    {
+    }
+
+    // Name of the image in the resource manager.
+    QString m_name;
+
+    // Local file to decode. Used if @m_data is empty.
+    QString m_path;
+
+    // Encoded image data, such as downloaded one.
+    QByteArray m_data;
+
+    // "svg" to render @m_data by QSvgRenderer at @m_scaleFactor.
+    // Empty to decide from the content.
+    QString m_format;
+
+    // Background of rendered SVG. Transparent if empty.
+    QString m_background;
+
+    // Size specified by the image link, -1 for not specified.
+    int m_width;
+
+    int m_height;
+
+    qreal m_scaleFactor;
+
+    // Smaller one will be decoded first.
+    int m_priority;
+};
+
+class VImageDecoder;
+
+class VImageDecoderWorker : public QThread
+{
+    Q_OBJECT
+public:
+    explicit VImageDecoderWorker(VImageDecoder *p_decoder);
+
+    bool isAskedToStop() const
+    {
+        return m_stop.load() == 1;
+    }
+
+public slots:
+    void stop();
+
+signals:
+    // @p_key: key of the job.
+    void imageDecoded(const QString &p_key, const QString &p_name, const QImage &p_image);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QAtomicInt m_stop;
+
+    VImageDecoder *m_decoder;
+};
+
+
+// A pool of worker threads to decode images and scale them to the size to
+// display off the UI thread.
+class VImageDecoder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VImageDecoder(QObject *p_parent = nullptr);
+
+    ~VImageDecoder();
+
+    // Replace all the pending jobs with @p_jobs.
+    // Jobs being decoded with the same parameters will be skipped. Results of
+    // jobs superseded by a job of the same name will be dropped.
+    void decodeAsync(const QVector<VImageDecodeJob> &p_jobs);
+
+    // Cancel all the pending jobs.
+    void cancel();
+
+    // Take the next job to decode. Called by workers.
+    // Returns false if there is no job.
+    bool takeJob(VImageDecodeJob &p_job);
+
+    // Key of @p_job covering its name and all the parameters.
+    static QString jobKey(const VImageDecodeJob &p_job);
+
+    // Size to display an image of @p_size.
+    // @p_width and @p_height are the size specified by the image link.
+    static QSize previewSize(const QSize &p_size, int p_width, int p_height, qreal p_scaleFactor);
+
+    // Decode image of @p_job at the size to display.
+    static QImage decode(const VImageDecodeJob &p_job);
+
+signals:
+    // Emitted in the UI thread.
+    void imageDecoded(const QString &p_name, const QImage &p_image);
+
+private slots:
+    void handleImageDecoded(const QString &p_key, const QString &p_name, const QImage &p_image);
+
+    void handleWorkerFinished();
+
+private:
+    void startWorkers();
+
+    QVector<VImageDecoderWorker *> m_workers;
+
+    // Protect m_jobs and m_running.
+    QMutex m_mutex;
+
+    QList<VImageDecodeJob> m_jobs;
+
+    // Names of jobs being decoded by their keys.
+    QHash<QString, QString> m_running;
+};
+
+#endif // VIMAGEDECODER_H
@@ -1,14 +1,74 @@
 #include "vimageresourcemanager2.h"
 
+#include <QDebug>
+#include <QVector>
+#include <QPair>
+#include <QTimer>
+
+#include <algorithm>
+
+int VImageResourceManager2::s_count = 0;
+
+qint64 VImageResourceManager2::s_usage = 0;
+
+qint64 VImageResourceManager2::s_budget = 0;
+
+unsigned long long VImageResourceManager2::s_hits = 0;
+
+unsigned long long VImageResourceManager2::s_misses = 0;
+
+unsigned long long VImageResourceManager2::s_evictions = 0;
 
 VImageResourceManager2::VImageResourceManager2()
+    : QObject(),
+      m_viewportFirstBlock(-1),
+      m_viewportLastBlock(-1),
+      m_budget(0),
+      m_usage(0)
+{
+    m_requestTimer = new QTimer(this);
+    m_requestTimer->setSingleShot(true);
+    m_requestTimer->setInterval(0);
+    connect(m_requestTimer, &QTimer::timeout,
+            this, &VImageResourceManager2::emitPendingRequests);
+
+    ++s_count;
+}
+
+VImageResourceManager2::~VImageResourceManager2()
+{
+    clear();
+
+    setBudget(0);
+
+    --s_count;
+}
+
+qint64 VImageResourceManager2::imageBytes(const QPixmap &p_image)
+{
+    return (qint64)p_image.width() * p_image.height() * p_image.depth() / 8;
+}
+
+void VImageResourceManager2::updateUsage(qint64 p_delta)
 {
+    m_usage += p_delta;
+    s_usage += p_delta;
 }
 
 void VImageResourceManager2::addImage(const QString &p_name,
-                                      const QPixmap &p_image)
+                                      const QPixmap &p_image,
+                                      bool p_evictable)
 {
-    m_images.insert(p_name, p_image);
+    ImageEntry &entry = m_images[p_name];
+    updateUsage(imageBytes(p_image) - imageBytes(entry.m_image));
+
+    entry.m_image = p_image;
+    entry.m_size = p_image.size();
+    entry.m_evictable = p_evictable;
+
+    m_requested.remove(p_name);
+
+    evict();
 }
 
 bool VImageResourceManager2::contains(const QString &p_name) const
@@ -17,21 +77,163 @@ bool VImageResourceManager2::contains(const QString &p_name) const
 }
 
 const QPixmap *VImageResourceManager2::findImage(const QString &p_name) const
+{
+    auto it = m_images.find(p_name);
+    if (it == m_images.end()) {
+        return NULL;
+    }
+
+    const ImageEntry &entry = it.value();
+    if (entry.m_image.isNull()) {
+        ++s_misses;
+        if (!m_requested.contains(p_name)) {
+            // Do not trigger decoding and relayout while painting.
+            m_requested.insert(p_name);
+            m_pendingRequests.append(p_name);
+            m_requestTimer->start();
+        }
+
+        return NULL;
+    }
+
+    ++s_hits;
+    return &entry.m_image;
+}
+
+void VImageResourceManager2::emitPendingRequests()
+{
+    const QStringList names = m_pendingRequests;
+    m_pendingRequests.clear();
+    for (auto const &name : names) {
+        // It may be removed or added back since then.
+        if (m_requested.contains(name)) {
+            emit imageRequested(name);
+        }
+    }
+}
+
+void VImageResourceManager2::setImageBlock(const QString &p_name, int p_blockNumber)
+{
+    m_blocks.insert(p_name, p_blockNumber);
+}
+
+void VImageResourceManager2::setViewport(int p_firstBlock, int p_lastBlock)
+{
+    m_viewportFirstBlock = p_firstBlock;
+    m_viewportLastBlock = p_lastBlock;
+}
+
+int VImageResourceManager2::distanceToViewport(int p_blockNumber) const
+{
+    if (p_blockNumber < m_viewportFirstBlock) {
+        return m_viewportFirstBlock - p_blockNumber;
+    } else if (p_blockNumber > m_viewportLastBlock) {
+        return p_blockNumber - m_viewportLastBlock;
+    }
+
+    return 0;
+}
+
+QSize VImageResourceManager2::imageSize(const QString &p_name) const
 {
     auto it = m_images.find(p_name);
     if (it != m_images.end()) {
-        return &it.value();
+        return it.value().m_size;
     }
 
-    return NULL;
+    return QSize();
 }
 
 void VImageResourceManager2::clear()
 {
+    updateUsage(-m_usage);
     m_images.clear();
+    m_blocks.clear();
+    m_requested.clear();
+    m_pendingRequests.clear();
 }
 
 void VImageResourceManager2::removeImage(const QString &p_name)
 {
-    m_images.remove(p_name);
+    auto it = m_images.find(p_name);
+    if (it == m_images.end()) {
+        return;
+    }
+
+    updateUsage(-imageBytes(it.value().m_image));
+    m_images.erase(it);
+    m_blocks.remove(p_name);
+    m_requested.remove(p_name);
+}
+
+void VImageResourceManager2::setBudget(qint64 p_budget)
+{
+    if (p_budget < 0) {
+        p_budget = 0;
+    }
+
+    s_budget += p_budget - m_budget;
+    m_budget = p_budget;
+
+    evict();
+}
+
+void VImageResourceManager2::evict()
+{
+    if (m_budget <= 0 || m_usage <= m_budget) {
+        return;
+    }
+
+    // Farthest first.
+    QVector<QPair<int, QString>> candidates;
+    for (auto it = m_images.constBegin(); it != m_images.constEnd(); ++it) {
+        const ImageEntry &entry = it.value();
+        if (!entry.m_evictable || entry.m_image.isNull()) {
+            continue;
+        }
+
+        auto bit = m_blocks.constFind(it.key());
+        if (bit == m_blocks.constEnd()) {
+            // Not layouted yet. It may be about to be drawn.
+            continue;
+        }
+
+        int distance = distanceToViewport(bit.value());
+        if (distance > 0) {
+            candidates.append(qMakePair(-distance, it.key()));
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    for (auto const &can : candidates) {
+        if (m_usage <= m_budget) {
+            break;
+        }
+
+        ImageEntry &entry = m_images[can.second];
+        updateUsage(-imageBytes(entry.m_image));
+        entry.m_image = QPixmap();
+        ++s_evictions;
+
+        emit imageEvicted(can.second);
+    }
+
+    if (m_usage > m_budget) {
+        qDebug() << "image store exceeds budget with visible images" << m_usage << m_budget;
+    }
+}
+
+QString VImageResourceManager2::statistics()
+{
+    unsigned long long total = s_hits + s_misses;
+    double hitRate = total > 0 ? s_hits * 100.0 / total : 0;
+    return QString("stores %1 memory %2/%3 KB hits %4 misses %5 hit rate %6% evictions %7")
+                  .arg(s_count)
+                  .arg(s_usage / 1024)
+                  .arg(s_budget / 1024)
+                  .arg(s_hits)
+                  .arg(s_misses)
+                  .arg(hitRate, 0, 'f', 1)
+                  .arg(s_evictions);
 }
@@ -1,33 +1,132 @@
 #ifndef VIMAGERESOURCEMANAGER2_H
 #define VIMAGERESOURCEMANAGER2_H
 
+#include <QObject>
 #include <QHash>
+#include <QSet>
 #include <QString>
 #include <QPixmap>
+#include <QStringList>
 
+class QTimer;
 
-class VImageResourceManager2
+// Byte-budgeted store of the images to preview in one editor.
+// When the budget is exceeded, evictable images farthest from the viewport are
+// dropped, keeping only their sizes, and are requested again when they are
+// drawn. Images in the viewport or not layouted yet are never evicted.
+class VImageResourceManager2 : public QObject
 {
+    Q_OBJECT
 public:
     VImageResourceManager2();
 
+    ~VImageResourceManager2();
+
     // Add an image to the resource with @p_name as the key.
     // If @p_name already exists in the resources, it will update it.
-    void addImage(const QString &p_name, const QPixmap &p_image);
+    // @p_evictable: whether the image could be evicted and requested again.
+    void addImage(const QString &p_name, const QPixmap &p_image, bool p_evictable = false);
 
     // Remove image @p_name.
     void removeImage(const QString &p_name);
 
     // Whether the resources contains image with name @p_name.
+    // True even if the image is evicted.
     bool contains(const QString &p_name) const;
 
+    // Returns NULL if not exists or evicted.
+    // imageRequested() will be emitted later if it is evicted, so it is safe
+    // to call it while painting.
     const QPixmap *findImage(const QString &p_name) const;
 
+    // Image @p_name is layouted or drawn in block @p_blockNumber.
+    void setImageBlock(const QString &p_name, int p_blockNumber);
+
+    // Blocks [@p_firstBlock, @p_lastBlock] are in the viewport.
+    void setViewport(int p_firstBlock, int p_lastBlock);
+
+    // Size of image @p_name even if it is evicted.
+    QSize imageSize(const QString &p_name) const;
+
     void clear();
 
+    // In bytes. Non-positive for unlimited.
+    void setBudget(qint64 p_budget);
+
+    // Memory usage and hit rate of all the stores for the log.
+    static QString statistics();
+
+signals:
+    // Evicted image @p_name is needed again.
+    void imageRequested(const QString &p_name);
+
+    void imageEvicted(const QString &p_name);
+
+private slots:
+    // Emit imageRequested() for m_pendingRequests.
+    void emitPendingRequests();
+
 private:
+    struct ImageEntry
+    {
+        ImageEntry()
+            : m_evictable(false)
+        {
+        }
+
+        // Null if evicted.
+        QPixmap m_image;
+
+        QSize m_size;
+
+        bool m_evictable;
+    };
+
+    // Evict images farthest from the viewport until the usage is within the
+    // budget.
+    void evict();
+
+    // Distance in blocks from block @p_blockNumber to the viewport.
+    int distanceToViewport(int p_blockNumber) const;
+
+    void updateUsage(qint64 p_delta);
+
+    static qint64 imageBytes(const QPixmap &p_image);
+
     // All the images resources.
-    QHash<QString, QPixmap> m_images;
+    QHash<QString, ImageEntry> m_images;
+
+    // Block number of the images.
+    QHash<QString, int> m_blocks;
+
+    // Evicted images requested.
+    mutable QSet<QString> m_requested;
+
+    // Evicted images requested but not signaled yet.
+    mutable QStringList m_pendingRequests;
+
+    QTimer *m_requestTimer;
+
+    int m_viewportFirstBlock;
+
+    int m_viewportLastBlock;
+
+    qint64 m_budget;
+
+    qint64 m_usage;
+
+    // Statistics of all the stores.
+    static int s_count;
+
+    static qint64 s_usage;
+
+    static qint64 s_budget;
+
+    static unsigned long long s_hits;
+
+    static unsigned long long s_misses;
+
+    static unsigned long long s_evictions;
 };
 
 #endif // VIMAGERESOURCEMANAGER2_H
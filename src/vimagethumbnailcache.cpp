@@ -0,0 +1,281 @@
+#include "vimagethumbnailcache.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QFile>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QCryptographicHash>
+#include <QMutexLocker>
+#include <QVector>
+#include <QPair>
+
+#include <algorithm>
+
+// Only cache thumbnails of source files larger than this size (bytes).
+#define MIN_SOURCE_FILE_SIZE 256 * 1024
+
+// Only cache thumbnails at most this ratio of the source area.
+#define MAX_THUMBNAIL_AREA_RATIO 0.5
+
+// Thumbnails not written within this days are stale.
+#define STALE_THUMBNAIL_DAYS 30
+
+// Clean up to this ratio of the max size to avoid cleaning frequently.
+#define CLEAN_UP_SIZE_RATIO 0.8
+
+// Touch a hit thumbnail if not touched within this hours.
+#define TOUCH_THUMBNAIL_HOURS 24
+
+// Update the modified time of @p_file to mark it used.
+// QFile::setFileTime() needs Qt 5.10, so rewrite its last byte instead.
+static void touchFile(const QString &p_file)
+{
+    QFile file(p_file);
+    if (!file.open(QIODevice::ReadWrite) || file.size() == 0) {
+        return;
+    }
+
+    qint64 pos = file.size() - 1;
+    char ch = 0;
+    if (file.seek(pos) && file.getChar(&ch) && file.seek(pos)) {
+        file.putChar(ch);
+    }
+}
+
+VImageThumbnailCleaner::VImageThumbnailCleaner(VImageThumbnailCache *p_cache)
+    : QThread(p_cache),
+      m_stop(0),
+      m_cache(p_cache)
+{
+}
+
+void VImageThumbnailCleaner::stop()
+{
+    m_stop.store(1);
+}
+
+void VImageThumbnailCleaner::run()
+{
+    m_cache->cleanUp(this);
+}
+
+
+VImageThumbnailCache::VImageThumbnailCache(const QString &p_folder,
+                                           qint64 p_maxSize,
+                                           QObject *p_parent)
+    : QObject(p_parent),
+      m_folder(p_folder),
+      m_maxSize(p_maxSize),
+      m_cleaner(NULL),
+      m_size(0),
+      m_hits(0),
+      m_misses(0),
+      m_writes(0)
+{
+    if (m_maxSize <= 0) {
+        return;
+    }
+
+    if (!QDir().mkpath(m_folder)) {
+        qWarning() << "fail to create thumbnail cache folder" << m_folder;
+        m_maxSize = 0;
+        return;
+    }
+
+    m_cleaner = new VImageThumbnailCleaner(this);
+    startCleaner();
+}
+
+VImageThumbnailCache::~VImageThumbnailCache()
+{
+    qInfo() << "preview thumbnail cache" << statistics();
+
+    if (m_cleaner) {
+        m_cleaner->stop();
+        m_cleaner->wait();
+    }
+}
+
+QString VImageThumbnailCache::thumbnailFile(const QString &p_path, const QSize &p_size) const
+{
+    QFileInfo fi(p_path);
+    QString path = fi.canonicalFilePath();
+    if (path.isEmpty()) {
+        path = fi.absoluteFilePath();
+    }
+
+    QString key = QString("%1|%2|%3|%4x%5").arg(path)
+                                           .arg(fi.size())
+                                           .arg(fi.lastModified().toMSecsSinceEpoch())
+                                           .arg(p_size.width())
+                                           .arg(p_size.height());
+    QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1);
+    return QDir(m_folder).filePath(QString::fromLatin1(hash.toHex()));
+}
+
+bool VImageThumbnailCache::needThumbnail(const QString &p_path,
+                                         const QSize &p_origSize,
+                                         const QSize &p_size) const
+{
+    if (m_maxSize <= 0 || !p_origSize.isValid() || !p_size.isValid()) {
+        return false;
+    }
+
+    if ((qreal)p_size.width() * p_size.height()
+        > (qreal)p_origSize.width() * p_origSize.height() * MAX_THUMBNAIL_AREA_RATIO) {
+        return false;
+    }
+
+    return QFileInfo(p_path).size() >= MIN_SOURCE_FILE_SIZE;
+}
+
+QImage VImageThumbnailCache::find(const QString &p_path, const QSize &p_size)
+{
+    QImage image;
+    QString file = thumbnailFile(p_path, p_size);
+    QFileInfo fi(file);
+    if (fi.exists()) {
+        {
+        QImageReader reader(file);
+        reader.setDecideFormatFromContent(true);
+        image = reader.read();
+        }
+
+        if (image.size() != p_size) {
+            image = QImage();
+        } else if (fi.lastModified().secsTo(QDateTime::currentDateTime())
+                   > TOUCH_THUMBNAIL_HOURS * 3600) {
+            // The cleaner removes the least recently modified ones.
+            touchFile(file);
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (image.isNull()) {
+        ++m_misses;
+    } else {
+        ++m_hits;
+    }
+
+    return image;
+}
+
+void VImageThumbnailCache::insert(const QString &p_path, const QImage &p_image)
+{
+    if (m_maxSize <= 0 || p_image.isNull()) {
+        return;
+    }
+
+    // JPEG for opaque images which are mostly photos.
+    const QString fileName = thumbnailFile(p_path, p_image.size());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QImageWriter writer(&file, p_image.hasAlphaChannel() ? "png" : "jpg");
+    writer.setQuality(90);
+    if (!writer.write(p_image)) {
+        qWarning() << "fail to write thumbnail of" << p_path << writer.errorString();
+        file.cancelWriting();
+        return;
+    }
+
+    bool needClean = false;
+    {
+    // Commit and count it at once so the cleaner lists it only if counted.
+    QMutexLocker locker(&m_mutex);
+    qint64 oldSize = QFileInfo(fileName).size();
+    if (!file.commit()) {
+        qWarning() << "fail to write thumbnail of" << p_path << file.errorString();
+        return;
+    }
+
+    ++m_writes;
+    m_size += QFileInfo(fileName).size() - oldSize;
+    needClean = m_size > m_maxSize;
+    }
+
+    if (needClean) {
+        // Start it in the thread of the cache.
+        QMetaObject::invokeMethod(this, "startCleaner", Qt::QueuedConnection);
+    }
+}
+
+void VImageThumbnailCache::startCleaner()
+{
+    if (m_cleaner && !m_cleaner->isRunning()) {
+        m_cleaner->start(QThread::LowPriority);
+    }
+}
+
+void VImageThumbnailCache::cleanUp(const VImageThumbnailCleaner *p_cleaner)
+{
+    QDir dir(m_folder);
+    QFileInfoList files;
+    qint64 listedSize = 0;
+    {
+    // Thumbnails are committed under the lock, so those written from now on
+    // are not listed and are kept in m_size.
+    QMutexLocker locker(&m_mutex);
+    listedSize = m_size;
+    files = dir.entryInfoList(QDir::Files | QDir::NoDotAndDotDot);
+    }
+
+    QDateTime staleTime = QDateTime::currentDateTime().addDays(-STALE_THUMBNAIL_DAYS);
+    QVector<QPair<QDateTime, QFileInfo>> thumbnails;
+    qint64 size = 0;
+    for (auto const &fi : files) {
+        if (p_cleaner->isAskedToStop()) {
+            return;
+        }
+
+        if (fi.lastModified() < staleTime) {
+            dir.remove(fi.fileName());
+            continue;
+        }
+
+        thumbnails.append(qMakePair(fi.lastModified(), fi));
+        size += fi.size();
+    }
+
+    qint64 target = m_maxSize * CLEAN_UP_SIZE_RATIO;
+    if (size > target) {
+        std::sort(thumbnails.begin(), thumbnails.end(),
+                  [](const QPair<QDateTime, QFileInfo> &p_a, const QPair<QDateTime, QFileInfo> &p_b) {
+                      return p_a.first < p_b.first;
+                  });
+
+        for (auto const &th : thumbnails) {
+            if (size <= target || p_cleaner->isAskedToStop()) {
+                break;
+            }
+
+            if (dir.remove(th.second.fileName())) {
+                size -= th.second.size();
+            }
+        }
+    }
+
+    // Replace the size of the listed thumbnails with the scanned one.
+    QMutexLocker locker(&m_mutex);
+    m_size += size - listedSize;
+}
+
+QString VImageThumbnailCache::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    unsigned long long total = m_hits + m_misses;
+    double hitRate = total > 0 ? m_hits * 100.0 / total : 0;
+    return QString("disk %1/%2 KB hits %3 misses %4 hit rate %5% writes %6")
+                  .arg(m_size / 1024)
+                  .arg(m_maxSize / 1024)
+                  .arg(m_hits)
+                  .arg(m_misses)
+                  .arg(hitRate, 0, 'f', 1)
+                  .arg(m_writes);
+}
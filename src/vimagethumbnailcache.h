@@ -0,0 +1,97 @@
+#ifndef VIMAGETHUMBNAILCACHE_H
+#define VIMAGETHUMBNAILCACHE_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QString>
+#include <QSize>
+#include <QImage>
+
+class VImageThumbnailCache;
+
+// Thread to remove stale thumbnails and keep the cache within its size.
+class VImageThumbnailCleaner : public QThread
+{
+    Q_OBJECT
+public:
+    explicit VImageThumbnailCleaner(VImageThumbnailCache *p_cache);
+
+    void stop();
+
+    bool isAskedToStop() const
+    {
+        return 1 == m_stop.load();
+    }
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QAtomicInt m_stop;
+
+    VImageThumbnailCache *m_cache;
+};
+
+
+// Disk cache of pre-scaled thumbnails of in-place preview images, keyed by
+// the source path, file size, modification time and the target size.
+// It is used by the image decoder threads and is thread-safe.
+class VImageThumbnailCache : public QObject
+{
+    Q_OBJECT
+public:
+    // @p_folder: folder to keep the thumbnails;
+    // @p_maxSize: max size in bytes, non-positive to disable the cache;
+    VImageThumbnailCache(const QString &p_folder, qint64 p_maxSize, QObject *p_parent = nullptr);
+
+    ~VImageThumbnailCache();
+
+    // Return the thumbnail of @p_path at @p_size. Null if missed.
+    QImage find(const QString &p_path, const QSize &p_size);
+
+    // Save @p_image as the thumbnail of @p_path.
+    void insert(const QString &p_path, const QImage &p_image);
+
+    // Whether it is worth caching the thumbnail of @p_path with original size
+    // @p_origSize at @p_size.
+    bool needThumbnail(const QString &p_path,
+                       const QSize &p_origSize,
+                       const QSize &p_size) const;
+
+    // Usage and hit rate for the log.
+    QString statistics() const;
+
+private slots:
+    void startCleaner();
+
+private:
+    // Return the file path of the thumbnail.
+    QString thumbnailFile(const QString &p_path, const QSize &p_size) const;
+
+    // Remove stale thumbnails and the least recently written ones until the
+    // cache is within the size. Called in the cleaner thread.
+    void cleanUp(const VImageThumbnailCleaner *p_cleaner);
+
+    QString m_folder;
+
+    qint64 m_maxSize;
+
+    VImageThumbnailCleaner *m_cleaner;
+
+    // Protect the statistics.
+    mutable QMutex m_mutex;
+
+    // Size of all the thumbnails.
+    qint64 m_size;
+
+    unsigned long long m_hits;
+
+    unsigned long long m_misses;
+
+    unsigned long long m_writes;
+
+    friend class VImageThumbnailCleaner;
+};
+
+#endif // VIMAGETHUMBNAILCACHE_H
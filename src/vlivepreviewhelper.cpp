@@ -1,5 +1,6 @@
 #include "vlivepreviewhelper.h"
 
+#include <QDebug>
 #include <QByteArray>
 #include <QTimer>
 
@@ -12,11 +13,14 @@
 #include "veditarea.h"
 #include "vmathjaxpreviewhelper.h"
 #include "utils/veditutils.h"
+#include "vrenderresultcache.h"
 
 extern VConfigManager *g_config;
 
 extern VMainWindow *g_mainWin;
 
+extern VRenderResultCache *g_renderResultCache;
+
 // Use the highest 4 bits (31-28) to indicate the lang.
 #define LANG_PREFIX_GRAPHVIZ 0x10000000UL
 #define LANG_PREFIX_PLANTUML 0x20000000UL
@@ -30,6 +34,29 @@ extern VMainWindow *g_mainWin;
 
 #define INDEX_MASK 0x00ffffffUL
 
+// Language of @p_lang with the settings of its renderer for the render result
+// cache, since the same text may be rendered differently.
+static QString renderCacheLang(const QString &p_lang)
+{
+    if (p_lang == "puml") {
+        if (g_config->getPlantUMLMode() == PlantUMLMode::OnlinePlantUML) {
+            return "puml@" + g_config->getPlantUMLServer();
+        }
+
+        return QString("puml@%1@%2@%3@%4").arg(g_config->getPlantUMLJar())
+                                          .arg(g_config->getGraphvizDot())
+                                          .arg(g_config->getPlantUMLCmd())
+                                          .arg(g_config->getPlantUMLArgs().join(' '));
+    } else if (p_lang == "dot") {
+        return "dot@" + g_config->getGraphvizDot();
+    } else if (p_lang == "mathjax") {
+        // Like VMathJaxInplacePreviewHelper.
+        return "mathjax@" + g_config->getCssStyleUrl();
+    }
+
+    return p_lang;
+}
+
 CodeBlockPreviewInfo::CodeBlockPreviewInfo()
 {
 }
@@ -102,6 +129,10 @@ VLivePreviewHelper::VLivePreviewHelper(VEditor *p_editor,
     connect(m_editor->object(), SIGNAL(cursorPositionChanged()),
             m_livePreviewTimer, SLOT(start()));
 
+    m_svgRasterizer = new VImageDecoder(this);
+    connect(m_svgRasterizer, &VImageDecoder::imageDecoded,
+            this, &VLivePreviewHelper::svgRasterized);
+
     m_flowchartEnabled = g_config->getEnableFlowchart();
     m_mermaidEnabled = g_config->getEnableMermaid();
     m_wavedromEnabled = g_config->getEnableWavedrom();
@@ -156,6 +187,7 @@ void VLivePreviewHelper::updateCodeBlocks(TimeStamp p_timeStamp, const QVector<V
     int cursorBlock = m_editor->textCursorW().block().blockNumber();
     bool needUpdate = m_livePreviewEnabled;
     bool manualInplacePreview = m_inplacePreviewEnabled;
+    bool hitRenderCache = false;
     m_codeBlocks.clear();
 
     for (int i = 0; i < p_codeBlocks.size(); ++i) {
@@ -184,6 +216,12 @@ void VLivePreviewHelper::updateCodeBlocks(TimeStamp p_timeStamp, const QVector<V
 
             entry->m_ts = m_timeStamp;
             cached = true;
+
+            // Rasterizing may be cancelled before finished.
+            if (entry->needRasterize() && !m_rasterJobs.contains(text)) {
+                rasterizeInBackground(text, entry);
+            }
+
             m_codeBlocks[idx].setImageData(entry->m_imgFormat, entry->m_imgData);
             m_codeBlocks[idx].updateInplacePreview(m_editor,
                                                    m_doc,
@@ -195,8 +233,15 @@ void VLivePreviewHelper::updateCodeBlocks(TimeStamp p_timeStamp, const QVector<V
         if (m_inplacePreviewEnabled
             && inplacePreview
             && (!cached || !m_codeBlocks[idx].inplacePreviewReady())) {
-            manualInplacePreview = false;
-            processForInplacePreview(idx);
+            if (!cached && loadFromRenderCache(idx)) {
+                // Previewed before.
+                hitRenderCache = true;
+                oldCache = true;
+                cached = true;
+            } else {
+                manualInplacePreview = false;
+                processForInplacePreview(idx);
+            }
         }
 
         if (m_livePreviewEnabled
@@ -212,7 +257,7 @@ void VLivePreviewHelper::updateCodeBlocks(TimeStamp p_timeStamp, const QVector<V
         }
     }
 
-    if (manualInplacePreview) {
+    if (manualInplacePreview || hitRenderCache) {
         updateInplacePreview();
     }
 
@@ -281,7 +326,7 @@ void VLivePreviewHelper::updateLivePreview()
                     this, &VLivePreviewHelper::localAsyncResultReady);
         }
 
-        if (!cb.hasImageData()) {
+        if (!cb.hasImageData() && !loadFromRenderCache(m_cbIndex)) {
             m_graphvizHelper->processAsync(m_cbIndex | LANG_PREFIX_GRAPHVIZ | TYPE_LIVE_PREVIEW,
                                            m_timeStamp,
                                            "svg",
@@ -296,7 +341,7 @@ void VLivePreviewHelper::updateLivePreview()
                     this, &VLivePreviewHelper::localAsyncResultReady);
         }
 
-        if (!cb.hasImageData()) {
+        if (!cb.hasImageData() && !loadFromRenderCache(m_cbIndex)) {
             m_plantUMLHelper->processAsync(m_cbIndex | LANG_PREFIX_PLANTUML | TYPE_LIVE_PREVIEW,
                                            m_timeStamp,
                                            "svg",
@@ -327,6 +372,7 @@ void VLivePreviewHelper::setLivePreviewEnabled(bool p_enabled)
         if (!m_inplacePreviewEnabled) {
             m_codeBlocks.clear();
             m_cache.clear();
+            clearRasterizing();
             updateInplacePreview();
         }
     }
@@ -342,6 +388,7 @@ void VLivePreviewHelper::setInplacePreviewEnabled(bool p_enabled)
     if (!m_inplacePreviewEnabled && !m_livePreviewEnabled) {
         m_codeBlocks.clear();
         m_cache.clear();
+        clearRasterizing();
     }
 
     updateInplacePreview();
@@ -389,6 +436,14 @@ void VLivePreviewHelper::localAsyncResultReady(int p_id,
                                                                                 background,
                                                                                 getScaleFactor(cb)));
     m_cache.insert(cb.codeBlock().m_text, entry);
+    rasterizeInBackground(cb.codeBlock().m_text, entry);
+
+    g_renderResultCache->insert(renderCacheLang(lang),
+                                renderFormat(lang),
+                                getScaleFactor(cb),
+                                cb.codeBlock().m_text,
+                                p_format,
+                                p_result.toUtf8());
 
     cb.setImageData(p_format, p_result);
     cb.updateInplacePreview(m_editor, m_doc, entry->m_image, QString(), background);
@@ -519,6 +574,14 @@ void VLivePreviewHelper::mathjaxPreviewResultReady(int p_identitifer,
                                                                                 background,
                                                                                 getScaleFactor(cb)));
     m_cache.insert(vcb.m_text, entry);
+    rasterizeInBackground(vcb.m_text, entry);
+
+    g_renderResultCache->insert(renderCacheLang(vcb.m_lang),
+                                renderFormat(vcb.m_lang),
+                                getScaleFactor(cb),
+                                vcb.m_text,
+                                p_format,
+                                p_data);
 
     cb.updateInplacePreview(m_editor, m_doc, entry->m_image, QString(), background);
 
@@ -529,6 +592,126 @@ void VLivePreviewHelper::mathjaxPreviewResultReady(int p_identitifer,
     updateInplacePreview();
 }
 
+QString VLivePreviewHelper::renderFormat(const QString &p_lang) const
+{
+    // Local renderers are asked for SVG.
+    return isOnlineLivePreview(p_lang) ? QString() : QStringLiteral("svg");
+}
+
+bool VLivePreviewHelper::loadFromRenderCache(int p_idx)
+{
+    CodeBlockPreviewInfo &cb = m_codeBlocks[p_idx];
+    const VCodeBlock &vcb = cb.codeBlock();
+    QString format;
+    QByteArray data;
+    if (!g_renderResultCache->find(renderCacheLang(vcb.m_lang),
+                                   renderFormat(vcb.m_lang),
+                                   getScaleFactor(cb),
+                                   vcb.m_text,
+                                   format,
+                                   data)) {
+        return false;
+    }
+
+    QString background;
+    if (vcb.m_lang == "puml") {
+        background = g_config->getEditorPreviewImageBg();
+    }
+
+    QSharedPointer<CodeBlockImageCacheEntry> entry;
+    if (isOnlineLivePreview(vcb.m_lang)) {
+        entry.reset(new CodeBlockImageCacheEntry(m_timeStamp,
+                                                 format,
+                                                 data,
+                                                 background,
+                                                 getScaleFactor(cb)));
+    } else {
+        // Results of local renderers are used by live preview, too.
+        QString result = QString::fromUtf8(data);
+        entry.reset(new CodeBlockImageCacheEntry(m_timeStamp,
+                                                 format,
+                                                 result,
+                                                 background,
+                                                 getScaleFactor(cb)));
+        cb.setImageData(format, result);
+    }
+
+    m_cache.insert(vcb.m_text, entry);
+    rasterizeInBackground(vcb.m_text, entry);
+
+    cb.updateInplacePreview(m_editor, m_doc, entry->m_image, QString(), background);
+
+    if (cb.inplacePreview()) {
+        entry->m_imageName = cb.inplacePreview()->m_name;
+    }
+
+    return true;
+}
+
+void VLivePreviewHelper::rasterizeInBackground(const QString &p_text,
+                                               const QSharedPointer<CodeBlockImageCacheEntry> &p_entry)
+{
+    if (!p_entry->needRasterize()) {
+        return;
+    }
+
+    VImageDecodeJob job;
+    job.m_name = p_text;
+    job.m_data = p_entry->m_svgToRasterize;
+    job.m_format = "svg";
+    job.m_background = p_entry->m_imageBackground;
+    job.m_scaleFactor = p_entry->m_scaleFactor;
+    m_rasterJobs.insert(p_text, job);
+
+    m_svgRasterizer->decodeAsync(m_rasterJobs.values().toVector());
+}
+
+void VLivePreviewHelper::svgRasterized(const QString &p_text, const QImage &p_image)
+{
+    if (!m_rasterJobs.remove(p_text)) {
+        return;
+    }
+
+    auto it = m_cache.find(p_text);
+    if (it == m_cache.end() || !it.value()->needRasterize()) {
+        return;
+    }
+
+    if (p_image.isNull()) {
+        // Drop it to render again next time instead of caching a null image.
+        qWarning() << "fail to rasterize SVG of code block";
+        m_cache.erase(it);
+        return;
+    }
+
+    QSharedPointer<CodeBlockImageCacheEntry> &entry = it.value();
+    entry->m_svgToRasterize.clear();
+
+    entry->m_image = QPixmap::fromImage(p_image);
+
+    bool updated = false;
+    for (auto &cb : m_codeBlocks) {
+        if (cb.codeBlock().m_text == p_text) {
+            cb.updateInplacePreview(m_editor,
+                                    m_doc,
+                                    entry->m_image,
+                                    entry->m_imageName,
+                                    entry->m_imageBackground);
+            updated = true;
+        }
+    }
+
+    if (updated && m_inplacePreviewEnabled) {
+        updateInplacePreview();
+    }
+}
+
+void VLivePreviewHelper::clearRasterizing()
+{
+    m_rasterJobs.clear();
+    m_svgRasterizer->cancel();
+}
+
 void VLivePreviewHelper::clearObsoleteCache()
 {
     if (m_cache.size() - m_codeBlocks.size() <= CODE_BLOCK_IMAGE_CACHE_SIZE_DIFF) {
@@ -537,6 +720,7 @@ void VLivePreviewHelper::clearObsoleteCache()
 
     for (auto it = m_cache.begin(); it != m_cache.end();) {
         if (m_timeStamp - it.value()->m_ts > CODE_BLOCK_IMAGE_CACHE_TIME_DIFF) {
+            m_rasterJobs.remove(it.key());
             it.value().clear();
             it = m_cache.erase(it);
         } else {
@@ -7,6 +7,7 @@
 #include "pegmarkdownhighlighter.h"
 #include "vpreviewmanager.h"
 #include "vconstants.h"
+#include "vimagedecoder.h"
 
 class VEditor;
 class VDocument;
@@ -154,6 +155,8 @@ private slots:
 
     void localAsyncResultReady(int p_id, TimeStamp p_timeStamp, const QString &p_format, const QString &p_result);
 
+    void svgRasterized(const QString &p_text, const QImage &p_image);
+
     void mathjaxPreviewResultReady(int p_identitifer,
                                    int p_id,
                                    TimeStamp p_timeStamp,
@@ -166,7 +169,8 @@ private:
         #define SCALE_FACTOR_THRESHOLD 1.1
 
         CodeBlockImageCacheEntry()
-            : m_ts(0)
+            : m_ts(0),
+              m_scaleFactor(1)
         {
         }
 
@@ -175,7 +179,8 @@ private:
                                  const QByteArray &p_data,
                                  const QString &p_background,
                                  qreal p_scaleFactor)
-            : m_ts(p_ts)
+            : m_ts(p_ts),
+              m_scaleFactor(1)
         {
             if (!p_data.isEmpty()) {
                 m_imageBackground = p_background;
@@ -185,9 +190,9 @@ private:
                                          p_format.toLocal8Bit().data());
                 } else {
                     if (p_format == "svg") {
-                        m_image = VUtils::svgToPixmap(p_data,
-                                                      m_imageBackground,
-                                                      p_scaleFactor);
+                        // Rasterize it in background.
+                        m_svgToRasterize = p_data;
+                        m_scaleFactor = p_scaleFactor;
                     } else {
                         QPixmap tmpImg;
                         tmpImg.loadFromData(p_data,
@@ -206,7 +211,8 @@ private:
                                  qreal p_scaleFactor)
             : m_ts(p_ts),
               m_imgData(p_data),
-              m_imgFormat(p_format)
+              m_imgFormat(p_format),
+              m_scaleFactor(1)
         {
             if (!p_data.isEmpty()) {
                 m_imageBackground = p_background;
@@ -216,9 +222,9 @@ private:
                                          p_format.toLocal8Bit().data());
                 } else {
                     if (p_format == "svg") {
-                        m_image = VUtils::svgToPixmap(p_data.toUtf8(),
-                                                      m_imageBackground,
-                                                      p_scaleFactor);
+                        // Rasterize it in background.
+                        m_svgToRasterize = p_data.toUtf8();
+                        m_scaleFactor = p_scaleFactor;
                     } else {
                         QPixmap tmpImg;
                         tmpImg.loadFromData(p_data.toUtf8(),
@@ -240,6 +246,11 @@ private:
             return !m_image.isNull();
         }
 
+        bool needRasterize() const
+        {
+            return !m_svgToRasterize.isEmpty();
+        }
+
         TimeStamp m_ts;
 
         // For live preview.
@@ -250,6 +261,10 @@ private:
         QPixmap m_image;
         QString m_imageName;
         QString m_imageBackground;
+
+        // SVG to rasterize into @m_image at @m_scaleFactor in background.
+        QByteArray m_svgToRasterize;
+        qreal m_scaleFactor;
     };
 
     void checkLang(const QString &p_lang, bool &p_livePreview, bool &p_inplacePreview) const;
@@ -257,6 +272,14 @@ private:
     // Get image data for this code block for inplace preview.
     void processForInplacePreview(int p_idx);
 
+    // Load the rendered result of code block @p_idx from the render result
+    // cache. Return true if hit.
+    bool loadFromRenderCache(int p_idx);
+
+    // Format requested from the renderer of @p_lang. Empty if decided by the
+    // renderer.
+    QString renderFormat(const QString &p_lang) const;
+
     // Emit signal to update inplace preview.
     void updateInplacePreview();
 
@@ -268,6 +291,12 @@ private:
 
     bool isOnlineLivePreview(const QString &p_lang) const;
 
+    // Rasterize the SVG of @p_entry of code block @p_text in background.
+    void rasterizeInBackground(const QString &p_text,
+                               const QSharedPointer<CodeBlockImageCacheEntry> &p_entry);
+
+    void clearRasterizing();
+
     // Sorted by m_startBlock in ascending order.
     QVector<CodeBlockPreviewInfo> m_codeBlocks;
 
@@ -312,6 +341,12 @@ private:
 
     QTimer *m_livePreviewTimer;
 
+    // Rasterize SVG of code blocks out of the UI thread.
+    VImageDecoder *m_svgRasterizer;
+
+    // SVG to rasterize indexed by content.
+    QHash<QString, VImageDecodeJob> m_rasterJobs;
+
     LivePreviewInfo m_curLivePreviewInfo;
 };
 
@@ -53,11 +53,30 @@
 #include "vtagexplorer.h"
 #include "vmdeditor.h"
 #include "utils/vSync.h"
+#include "vcodeblockhighlightcache.h"
+#include "vimageresourcemanager2.h"
+#include "vpreviewimagecache.h"
+#include "vimagethumbnailcache.h"
+#include "vrenderresultcache.h"
+#include "vplantumlprocesspool.h"
+#include "vrenderscheduler.h"
 
 extern VConfigManager *g_config;
 
 extern VPalette *g_palette;
 
+extern VCodeBlockHighlightCache *g_codeBlockHighlightCache;
+
+extern VPreviewImageCache *g_previewImageCache;
+
+extern VImageThumbnailCache *g_imageThumbnailCache;
+
+extern VRenderResultCache *g_renderResultCache;
+
+extern VPlantUMLProcessPool *g_plantUMLProcessPool;
+
+extern VRenderScheduler *g_renderScheduler;
+
 VMainWindow *g_mainWin;
 
 VNote *g_vnote;
@@ -2654,16 +2673,30 @@ void VMainWindow::printNote()
         return;
     }
 
-    m_printer = new QPrinter();
-    QPrintDialog dialog(m_printer, this);
-    dialog.setWindowTitle(tr("Print Note"));
-
     V_ASSERT(m_curTab);
 
     VMdTab *mdTab = dynamic_cast<VMdTab *>((VEditTab *)m_curTab);
-    VWebView *webView = mdTab->getWebViewer();
+    if (!mdTab) {
+        return;
+    }
+
+    // The web side may not be created yet in edit mode.
+    QPointer<VMdTab> tab(mdTab);
+    mdTab->prepareWebViewer([this, tab]() {
+                if (tab && !m_printer) {
+                    printWebView(tab->getWebViewer());
+                }
+            });
+}
 
-    V_ASSERT(webView);
+void VMainWindow::printWebView(VWebView *p_webView)
+{
+    Q_ASSERT(!m_printer && p_webView);
+    VWebView *webView = p_webView;
+
+    m_printer = new QPrinter();
+    QPrintDialog dialog(m_printer, this);
+    dialog.setWindowTitle(tr("Print Note"));
 
     if (webView->hasSelection()) {
         dialog.addEnabledOption(QAbstractPrintDialog::PrintSelection);
@@ -3036,6 +3069,14 @@ bool VMainWindow::flushLogFileByCaptain(void *p_target, void *p_data)
     Q_UNUSED(p_target);
     Q_UNUSED(p_data);
 
+    qInfo() << "code block highlight cache" << g_codeBlockHighlightCache->statistics();
+    qInfo() << "preview image store" << VImageResourceManager2::statistics();
+    qInfo() << "preview image cache" << g_previewImageCache->statistics();
+    qInfo() << "preview thumbnail cache" << g_imageThumbnailCache->statistics();
+    qInfo() << "render result cache" << g_renderResultCache->statistics();
+    qInfo() << "PlantUML process pool" << g_plantUMLProcessPool->statistics();
+    qInfo() << "render scheduler" << g_renderScheduler->statistics();
+
 #if defined(QT_NO_DEBUG)
     // Flush g_logFile.
     g_logFile.flush();
@@ -46,6 +46,7 @@ class VHistoryList;
 class VExplorer;
 class VTagExplorer;
 class VSync;
+class VWebView;
 
 #define RESTART_EXIT_CODE   1000
 
@@ -225,6 +226,9 @@ protected:
 private:
     void setupUI();
 
+    // Print the content of @p_webView.
+    void printWebView(VWebView *p_webView);
+
     void setupNaviBox();
 
     void setupNotebookPanel();
@@ -78,3 +78,34 @@ QString VMarkdownConverter::generateToc(const QString &markdown, hoedown_extensi
 
     return toc;
 }
+
+
+VMarkdownConverterWorker::VMarkdownConverterWorker(QObject *p_parent)
+    : QThread(p_parent),
+      m_stop(0),
+      m_timeStamp(0),
+      m_options((hoedown_extensions)0)
+{
+}
+
+void VMarkdownConverterWorker::setData(TimeStamp p_timeStamp,
+                                       const QString &p_text,
+                                       hoedown_extensions p_options)
+{
+    m_timeStamp = p_timeStamp;
+    m_text = p_text;
+    m_options = p_options;
+}
+
+void VMarkdownConverterWorker::stop()
+{
+    m_stop.store(1);
+}
+
+void VMarkdownConverterWorker::run()
+{
+    // Renderers could not be shared among threads.
+    VMarkdownConverter converter;
+    m_html = converter.generateHtml(m_text, m_options, m_toc);
+    m_text.clear();
+}
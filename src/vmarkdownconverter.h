@@ -2,6 +2,10 @@
 #define VMARKDOWNCONVERTER_H
 
 #include <QString>
+#include <QThread>
+#include <QAtomicInt>
+
+#include "vconstants.h"
 
 extern "C" {
 #include <src/html.h>
@@ -28,4 +32,54 @@ private:
     hoedown_renderer *tocRenderer;
 };
 
+// Generate the HTML and TOC of a large note in a background thread.
+class VMarkdownConverterWorker : public QThread
+{
+    Q_OBJECT
+public:
+    explicit VMarkdownConverterWorker(QObject *p_parent = nullptr);
+
+    void setData(TimeStamp p_timeStamp, const QString &p_text, hoedown_extensions p_options);
+
+    TimeStamp timeStamp() const
+    {
+        return m_timeStamp;
+    }
+
+    bool isAskedToStop() const
+    {
+        return m_stop.load() == 1;
+    }
+
+    const QString &html() const
+    {
+        return m_html;
+    }
+
+    const QString &toc() const
+    {
+        return m_toc;
+    }
+
+public slots:
+    // Hoedown could not be interrupted. The result will be abandoned.
+    void stop();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QAtomicInt m_stop;
+
+    TimeStamp m_timeStamp;
+
+    QString m_text;
+
+    hoedown_extensions m_options;
+
+    QString m_html;
+
+    QString m_toc;
+};
+
 #endif // VMARKDOWNCONVERTER_H
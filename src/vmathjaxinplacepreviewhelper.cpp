@@ -7,9 +7,16 @@
 #include "vmainwindow.h"
 #include "veditarea.h"
 #include "vmathjaxpreviewhelper.h"
+#include "vrenderresultcache.h"
+#include "vconfigmanager.h"
+#include "utils/vutils.h"
 
 extern VMainWindow *g_mainWin;
 
+extern VConfigManager *g_config;
+
+extern VRenderResultCache *g_renderResultCache;
+
 MathjaxBlockPreviewInfo::MathjaxBlockPreviewInfo()
 {
 }
@@ -53,6 +60,12 @@ void MathjaxBlockPreviewInfo::updateInplacePreview(const VEditor *p_editor,
 #define MATHJAX_IMAGE_CACHE_SIZE_DIFF 20
 #define MATHJAX_IMAGE_CACHE_TIME_DIFF 5
 
+// The image of a formula depends on the font size of the style and the scale factor.
+static QString renderCacheLang()
+{
+    return "mathjax-inline@" + g_config->getCssStyleUrl();
+}
+
 VMathJaxInplacePreviewHelper::VMathJaxInplacePreviewHelper(VEditor *p_editor,
                                                            VDocument *p_document,
                                                            QObject *p_parent)
@@ -62,16 +75,21 @@ VMathJaxInplacePreviewHelper::VMathJaxInplacePreviewHelper(VEditor *p_editor,
       m_doc(p_editor->documentW()),
       m_enabled(false),
       m_lastInplacePreviewSize(0),
-      m_timeStamp(0)
+      m_timeStamp(0),
+      m_converting(false)
 {
     m_mathJaxHelper = g_mainWin->getEditArea()->getMathJaxPreviewHelper();
     m_mathJaxID = m_mathJaxHelper->registerIdentifier();
-    connect(m_mathJaxHelper, &VMathJaxPreviewHelper::mathjaxPreviewResultReady,
-            this, &VMathJaxInplacePreviewHelper::mathjaxPreviewResultReady);
+    connect(m_mathJaxHelper, &VMathJaxPreviewHelper::mathjaxBatchPreviewResultReady,
+            this, &VMathJaxInplacePreviewHelper::mathjaxBatchPreviewResultReady);
 
     m_documentID = m_document->registerIdentifier();
-    connect(m_document, &VDocument::textToHtmlFinished,
-            this, &VMathJaxInplacePreviewHelper::textToHtmlFinished);
+    connect(m_document, &VDocument::textToHtmlBatchFinished,
+            this, &VMathJaxInplacePreviewHelper::textToHtmlBatchFinished);
+
+    // Web side is ready for formulas not previewed.
+    connect(m_document, &VDocument::readyToTextToHtml,
+            this, &VMathJaxInplacePreviewHelper::processPendingBlocks);
 }
 
 void VMathJaxInplacePreviewHelper::setEnabled(bool p_enabled)
@@ -82,6 +100,7 @@ void VMathJaxInplacePreviewHelper::setEnabled(bool p_enabled)
         if (!m_enabled) {
             m_mathjaxBlocks.clear();
             m_cache.clear();
+            m_converting = false;
         }
 
         updateInplacePreview();
@@ -96,9 +115,12 @@ void VMathJaxInplacePreviewHelper::updateMathjaxBlocks(const QVector<VMathjaxBlo
 
     ++m_timeStamp;
 
+    // Results of pending formulas will be dropped.
+    m_converting = false;
+
     m_mathjaxBlocks.clear();
     m_mathjaxBlocks.reserve(p_blocks.size());
-    bool manualUpdate = true;
+    QVector<int> idxs;
     for (int i = 0; i < p_blocks.size(); ++i) {
         const VMathjaxBlock &vmb = p_blocks[i];
         const QString &text = vmb.m_text;
@@ -117,42 +139,101 @@ void VMathJaxInplacePreviewHelper::updateMathjaxBlocks(const QVector<VMathjaxBlo
                                                         entry->m_imageName);
         }
 
+        if (!cached && !text.isEmpty()) {
+            cached = loadFromRenderCache(m_mathjaxBlocks.size() - 1);
+        }
+
         if (!cached || !m_mathjaxBlocks.last().inplacePreviewReady()) {
-            manualUpdate = false;
-            processForInplacePreview(m_mathjaxBlocks.size() - 1);
+            idxs.append(m_mathjaxBlocks.size() - 1);
         }
     }
 
-    if (manualUpdate) {
-        updateInplacePreview();
-    }
+    processForInplacePreview(idxs);
 
     clearObsoleteCache();
 }
 
-void VMathJaxInplacePreviewHelper::processForInplacePreview(int p_idx)
+void VMathJaxInplacePreviewHelper::processForInplacePreview(const QVector<int> &p_idxs)
 {
-    MathjaxBlockPreviewInfo &mb = m_mathjaxBlocks[p_idx];
-    const VMathjaxBlock &vmb = mb.mathjaxBlock();
-    if (vmb.m_text.isEmpty()) {
-        updateInplacePreview();
-    } else {
-        if (!textToHtmlViaWebView(vmb.m_text, p_idx, m_timeStamp)) {
-            updateInplacePreview();
+    QVariantList ids;
+    QStringList texts;
+    for (auto idx : p_idxs) {
+        const VMathjaxBlock &vmb = m_mathjaxBlocks[idx].mathjaxBlock();
+        if (!vmb.m_text.isEmpty()) {
+            ids.append(idx);
+            texts.append(vmb.m_text);
         }
     }
+
+    if (!ids.isEmpty() && textToHtmlViaWebView(ids, texts, m_timeStamp)) {
+        m_converting = true;
+        return;
+    }
+
+    updateInplacePreview();
+}
+
+void VMathJaxInplacePreviewHelper::processPendingBlocks()
+{
+    if (!m_enabled || m_converting) {
+        return;
+    }
+
+    QVector<int> idxs;
+    for (int i = 0; i < m_mathjaxBlocks.size(); ++i) {
+        const MathjaxBlockPreviewInfo &mb = m_mathjaxBlocks[i];
+        if (!mb.inplacePreviewReady() && !mb.mathjaxBlock().m_text.isEmpty()) {
+            idxs.append(i);
+        }
+    }
+
+    if (!idxs.isEmpty()) {
+        processForInplacePreview(idxs);
+    }
 }
 
-bool VMathJaxInplacePreviewHelper::textToHtmlViaWebView(const QString &p_text,
-                                                        int p_id,
+bool VMathJaxInplacePreviewHelper::loadFromRenderCache(int p_idx)
+{
+    MathjaxBlockPreviewInfo &mb = m_mathjaxBlocks[p_idx];
+    const QString &text = mb.mathjaxBlock().m_text;
+    QString format;
+    QByteArray data;
+    if (!g_renderResultCache->find(renderCacheLang(),
+                                   "png",
+                                   VUtils::calculateScaleFactor(),
+                                   text,
+                                   format,
+                                   data)) {
+        return false;
+    }
+
+    QSharedPointer<MathjaxImageCacheEntry> entry(new MathjaxImageCacheEntry(m_timeStamp,
+                                                                            data,
+                                                                            format));
+    if (entry->m_image.isNull()) {
+        return false;
+    }
+
+    m_cache.insert(text, entry);
+    mb.updateInplacePreview(m_editor, m_doc, entry->m_image, QString());
+    if (mb.inplacePreview()) {
+        entry->m_imageName = mb.inplacePreview()->m_name;
+    }
+
+    return true;
+}
+
+bool VMathJaxInplacePreviewHelper::textToHtmlViaWebView(const QVariantList &p_ids,
+                                                        const QStringList &p_texts,
                                                         int p_timeStamp)
 {
     if (!m_document->isReadyToTextToHtml()) {
         qDebug() << "web side is not ready to convert text to HTML";
+        m_document->requestWebSide();
         return false;
     }
 
-    m_document->textToHtmlAsync(m_documentID, p_id, p_timeStamp, p_text, false);
+    m_document->textToHtmlBatchAsync(m_documentID, p_timeStamp, p_ids, p_texts, false);
     return true;
 }
 
@@ -186,50 +267,73 @@ void VMathJaxInplacePreviewHelper::updateInplacePreview()
     }
 }
 
-void VMathJaxInplacePreviewHelper::mathjaxPreviewResultReady(int p_identitifer,
-                                                             int p_id,
-                                                             TimeStamp p_timeStamp,
-                                                             const QString &p_format,
-                                                             const QByteArray &p_data)
+void VMathJaxInplacePreviewHelper::mathjaxBatchPreviewResultReady(int p_identitifer,
+                                                                  TimeStamp p_timeStamp,
+                                                                  const QVector<int> &p_ids,
+                                                                  const QString &p_format,
+                                                                  const QVector<QByteArray> &p_datas)
 {
     if (p_identitifer != m_mathJaxID || p_timeStamp != m_timeStamp) {
         return;
     }
 
-    if (p_id >= m_mathjaxBlocks.size() || p_data.isEmpty()) {
-        updateInplacePreview();
-        return;
-    }
-
-    MathjaxBlockPreviewInfo &mb = m_mathjaxBlocks[p_id];
-    // Update the cache.
-    QSharedPointer<MathjaxImageCacheEntry> entry(new MathjaxImageCacheEntry(p_timeStamp,
-                                                                            p_data,
-                                                                            p_format));
-    m_cache.insert(mb.mathjaxBlock().m_text, entry);
-    mb.updateInplacePreview(m_editor, m_doc, entry->m_image, QString());
+    const qreal scaleFactor = VUtils::calculateScaleFactor();
+    const QString lang = renderCacheLang();
+    for (int i = 0; i < p_ids.size(); ++i) {
+        int id = p_ids[i];
+        const QByteArray &data = p_datas[i];
+        if (id >= m_mathjaxBlocks.size() || data.isEmpty()) {
+            continue;
+        }
 
-    if (mb.inplacePreview()) {
-        entry->m_imageName = mb.inplacePreview()->m_name;
+        MathjaxBlockPreviewInfo &mb = m_mathjaxBlocks[id];
+        // Update the cache.
+        QSharedPointer<MathjaxImageCacheEntry> entry(new MathjaxImageCacheEntry(p_timeStamp,
+                                                                                data,
+                                                                                p_format));
+        m_cache.insert(mb.mathjaxBlock().m_text, entry);
+        g_renderResultCache->insert(lang,
+                                    "png",
+                                    scaleFactor,
+                                    mb.mathjaxBlock().m_text,
+                                    p_format,
+                                    data);
+
+        mb.updateInplacePreview(m_editor, m_doc, entry->m_image, QString());
+
+        if (mb.inplacePreview()) {
+            entry->m_imageName = mb.inplacePreview()->m_name;
+        }
     }
 
+    // Update all the results at once.
     updateInplacePreview();
 }
 
-void VMathJaxInplacePreviewHelper::textToHtmlFinished(int p_identitifer,
-                                                      int p_id,
-                                                      int p_timeStamp,
-                                                      const QString &p_html)
+void VMathJaxInplacePreviewHelper::textToHtmlBatchFinished(int p_identitifer,
+                                                           int p_timeStamp,
+                                                           const QVariantList &p_ids,
+                                                           const QStringList &p_htmls)
 {
     if (m_documentID != p_identitifer || m_timeStamp != (TimeStamp)p_timeStamp) {
         return;
     }
 
-    Q_ASSERT(p_html.startsWith("<"));
-    m_mathJaxHelper->previewMathJaxFromHtml(m_mathJaxID,
-                                            p_id,
-                                            p_timeStamp,
-                                            p_html);
+    m_converting = false;
+
+    Q_ASSERT(p_ids.size() == p_htmls.size());
+    QVector<int> ids;
+    ids.reserve(p_ids.size());
+    for (auto const &id : p_ids) {
+        ids.append(id.toInt());
+    }
+
+    // Typeset all the formulas in one batch.
+    m_mathJaxHelper->previewMathJaxBatch(m_mathJaxID,
+                                         m_timeStamp,
+                                         ids,
+                                         p_htmls,
+                                         true);
 }
 
 void VMathJaxInplacePreviewHelper::clearObsoleteCache()
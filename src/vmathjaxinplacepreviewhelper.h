@@ -2,6 +2,8 @@
 #define VMATHJAXINPLACEPREVIEWHELPER_H
 
 #include <QObject>
+#include <QStringList>
+#include <QVariantList>
 
 #include "pegmarkdownhighlighter.h"
 #include "vpreviewmanager.h"
@@ -76,13 +78,19 @@ signals:
     void checkBlocksForObsoletePreview(const QList<int> &p_blocks);
 
 private slots:
-    void mathjaxPreviewResultReady(int p_identitifer,
-                                   int p_id,
-                                   TimeStamp p_timeStamp,
-                                   const QString &p_format,
-                                   const QByteArray &p_data);
+    void mathjaxBatchPreviewResultReady(int p_identitifer,
+                                        TimeStamp p_timeStamp,
+                                        const QVector<int> &p_ids,
+                                        const QString &p_format,
+                                        const QVector<QByteArray> &p_datas);
 
-    void textToHtmlFinished(int p_identitifer, int p_id, int p_timeStamp, const QString &p_html);
+    void textToHtmlBatchFinished(int p_identitifer,
+                                 int p_timeStamp,
+                                 const QVariantList &p_ids,
+                                 const QStringList &p_htmls);
+
+    // Process blocks which are not previewed since the web side was not ready.
+    void processPendingBlocks();
 
 private:
     struct MathjaxImageCacheEntry
@@ -108,13 +116,17 @@ private:
     };
 
 
-    void processForInplacePreview(int p_idx);
+    // Convert blocks @p_idxs to HTML in one batch to preview by MathJax.
+    void processForInplacePreview(const QVector<int> &p_idxs);
+
+    // Load the image of @p_idx from the persistent render cache.
+    bool loadFromRenderCache(int p_idx);
 
     // Emit signal to update inplace preview.
     void updateInplacePreview();
 
-    bool textToHtmlViaWebView(const QString &p_text,
-                              int p_id,
+    bool textToHtmlViaWebView(const QVariantList &p_ids,
+                              const QStringList &p_texts,
                               int p_timeStamp);
 
     void clearObsoleteCache();
@@ -143,6 +155,9 @@ private:
 
     // Indexed by content.
     QHash<QString, QSharedPointer<MathjaxImageCacheEntry>> m_cache;
+
+    // Whether a batch of formulas is being converted to HTML.
+    bool m_converting;
 };
 
 #endif // VMATHJAXINPLACEPREVIEWHELPER_H
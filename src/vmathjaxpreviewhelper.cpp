@@ -54,6 +54,28 @@ void VMathJaxPreviewHelper::doInit()
                 emit mathjaxPreviewResultReady(p_identifier, p_id, p_timeStamp, p_format, ba);
             });
 
+    connect(m_webDoc, &VMathJaxWebDocument::mathjaxBatchPreviewResultReady,
+            this, [this](int p_identifier,
+                         TimeStamp p_timeStamp,
+                         const QVariantList &p_ids,
+                         const QString &p_format,
+                         const QStringList &p_datas) {
+                QVector<int> ids;
+                QVector<QByteArray> datas;
+                ids.reserve(p_ids.size());
+                datas.reserve(p_ids.size());
+                for (int i = 0; i < p_ids.size(); ++i) {
+                    ids.append(p_ids[i].toInt());
+                    if (i < p_datas.size()) {
+                        datas.append(QByteArray::fromBase64(p_datas[i].toUtf8()));
+                    } else {
+                        datas.append(QByteArray());
+                    }
+                }
+
+                emit mathjaxBatchPreviewResultReady(p_identifier, p_timeStamp, ids, p_format, datas);
+            });
+
     connect(m_webDoc, &VMathJaxWebDocument::diagramPreviewResultReady,
             this, [this](int p_identifier,
                         int p_id,
@@ -123,6 +145,39 @@ void VMathJaxPreviewHelper::previewMathJaxFromHtml(int p_identifier,
     }
 }
 
+void VMathJaxPreviewHelper::previewMathJaxBatch(int p_identifier,
+                                                TimeStamp p_timeStamp,
+                                                const QVector<int> &p_ids,
+                                                const QStringList &p_texts,
+                                                bool p_isHtml)
+{
+    Q_ASSERT(p_ids.size() == p_texts.size());
+    if (p_ids.isEmpty()) {
+        return;
+    }
+
+    init();
+
+    QVariantList ids;
+    ids.reserve(p_ids.size());
+    for (auto id : p_ids) {
+        ids.append(id);
+    }
+
+    if (!m_webReady) {
+        auto func = std::bind(&VMathJaxWebDocument::previewMathJaxBatch,
+                              m_webDoc,
+                              p_identifier,
+                              p_timeStamp,
+                              ids,
+                              p_texts,
+                              p_isHtml);
+        m_pendingFunc.append(func);
+    } else {
+        m_webDoc->previewMathJaxBatch(p_identifier, p_timeStamp, ids, p_texts, p_isHtml);
+    }
+}
+
 void VMathJaxPreviewHelper::previewDiagram(int p_identifier,
                                            int p_id,
                                            TimeStamp p_timeStamp,
@@ -4,6 +4,7 @@
 #include <QObject>
 #include <functional>
 #include <QVector>
+#include <QStringList>
 
 #include "vconstants.h"
 
@@ -32,6 +33,16 @@ public:
 
     void previewMathJaxFromHtml(int p_identitifer, int p_id, TimeStamp p_timeStamp, const QString &p_html);
 
+    // Preview all @p_texts in one round-trip to the web side and return the
+    // PNG data in one mathjaxBatchPreviewResultReady().
+    // @p_ids: internal ids aligned with @p_texts;
+    // @p_isHtml: whether @p_texts are HTML converted from the raw text.
+    void previewMathJaxBatch(int p_identifier,
+                             TimeStamp p_timeStamp,
+                             const QVector<int> &p_ids,
+                             const QStringList &p_texts,
+                             bool p_isHtml);
+
     // Preview @p_text and return PNG data asynchronously.
     // @p_identifier: identifier the caller registered;
     // @p_id: internal id for each caller;
@@ -50,6 +61,13 @@ signals:
                                    const QString &p_format,
                                    const QByteArray &p_data);
 
+    // @p_datas are aligned with @p_ids, empty for failure.
+    void mathjaxBatchPreviewResultReady(int p_identifier,
+                                        TimeStamp p_timeStamp,
+                                        const QVector<int> &p_ids,
+                                        const QString &p_format,
+                                        const QVector<QByteArray> &p_datas);
+
     void diagramPreviewResultReady(int p_identifier,
                                    int p_id,
                                    TimeStamp p_timeStamp,
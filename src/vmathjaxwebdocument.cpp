@@ -16,6 +16,15 @@ void VMathJaxWebDocument::previewMathJax(int p_identifier,
     emit requestPreviewMathJax(p_identifier, p_id, p_timeStamp, p_text, p_isHtml);
 }
 
+void VMathJaxWebDocument::previewMathJaxBatch(int p_identifier,
+                                              TimeStamp p_timeStamp,
+                                              const QVariantList &p_ids,
+                                              const QStringList &p_texts,
+                                              bool p_isHtml)
+{
+    emit requestPreviewMathJaxBatch(p_identifier, p_timeStamp, p_ids, p_texts, p_isHtml);
+}
+
 void VMathJaxWebDocument::mathjaxResultReady(int p_identifier,
                                              int p_id,
                                              unsigned long long p_timeStamp,
@@ -25,6 +34,15 @@ void VMathJaxWebDocument::mathjaxResultReady(int p_identifier,
     emit mathjaxPreviewResultReady(p_identifier, p_id, p_timeStamp, p_format, p_data);
 }
 
+void VMathJaxWebDocument::mathjaxBatchResultReady(int p_identifier,
+                                                  unsigned long long p_timeStamp,
+                                                  const QVariantList &p_ids,
+                                                  const QString &p_format,
+                                                  const QStringList &p_datas)
+{
+    emit mathjaxBatchPreviewResultReady(p_identifier, p_timeStamp, p_ids, p_format, p_datas);
+}
+
 void VMathJaxWebDocument::diagramResultReady(int p_identifier,
                                              int p_id,
                                              unsigned long long p_timeStamp,
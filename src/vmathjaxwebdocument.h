@@ -2,6 +2,8 @@
 #define VMATHJAXWEBDOCUMENT_H
 
 #include <QObject>
+#include <QStringList>
+#include <QVariantList>
 
 #include "vconstants.h"
 
@@ -17,6 +19,13 @@ public:
                         const QString &p_text,
                         bool p_isHtml);
 
+    // Typeset @p_texts in one round-trip. @p_ids will be passed back as is.
+    void previewMathJaxBatch(int p_identifier,
+                             TimeStamp p_timeStamp,
+                             const QVariantList &p_ids,
+                             const QStringList &p_texts,
+                             bool p_isHtml);
+
     void previewDiagram(int p_identifier,
                         int p_id,
                         TimeStamp p_timeStamp,
@@ -32,6 +41,13 @@ public slots:
                             const QString &p_format,
                             const QString &p_data);
 
+    // @p_datas are aligned with @p_ids, empty for failure.
+    void mathjaxBatchResultReady(int p_identifier,
+                                 unsigned long long p_timeStamp,
+                                 const QVariantList &p_ids,
+                                 const QString &p_format,
+                                 const QStringList &p_datas);
+
     void diagramResultReady(int p_identifier,
                             int p_id,
                             unsigned long long p_timeStamp,
@@ -47,6 +63,12 @@ signals:
                                const QString &p_text,
                                bool p_isHtml);
 
+    void requestPreviewMathJaxBatch(int p_identifier,
+                                    unsigned long long p_timeStamp,
+                                    const QVariantList &p_ids,
+                                    const QStringList &p_texts,
+                                    bool p_isHtml);
+
     void requestPreviewDiagram(int p_identifier,
                                int p_id,
                                unsigned long long p_timeStamp,
@@ -59,6 +81,12 @@ signals:
                                    const QString &p_format,
                                    const QString &p_data);
 
+    void mathjaxBatchPreviewResultReady(int p_identifier,
+                                        TimeStamp p_timeStamp,
+                                        const QVariantList &p_ids,
+                                        const QString &p_format,
+                                        const QStringList &p_datas);
+
     void diagramPreviewResultReady(int p_identifier,
                                    int p_id,
                                    TimeStamp p_timeStamp,
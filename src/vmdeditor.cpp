@@ -53,7 +53,8 @@ VMdEditor::VMdEditor(VFile *p_file,
       m_textToHtmlDialog(NULL),
       m_zoomDelta(0),
       m_editTab(NULL),
-      m_copyTimeStamp(0)
+      m_copyTimeStamp(0),
+      m_wordCountTotal(new VWordCountInfo())
 {
     Q_ASSERT(p_file->getDocType() == DocType::Markdown);
 
@@ -89,6 +90,13 @@ VMdEditor::VMdEditor(VFile *p_file,
     connect(m_pegHighlighter, &PegMarkdownHighlighter::headersUpdated,
             this, &VMdEditor::updateHeaders);
 
+    // Connect after the highlighter so new blocks have been highlighted before
+    // block data is created for them.
+    m_wordCountTotal->m_wordCount = 0;
+    m_wordCountTotal->m_charWithoutSpacesCount = 0;
+    connect(document(), &QTextDocument::contentsChange,
+            this, &VMdEditor::updateWordCount);
+
     // After highlight, the cursor may trun into non-visible. We should make it visible
     // in this case.
     connect(m_pegHighlighter, &PegMarkdownHighlighter::highlightCompleted,
@@ -1040,6 +1048,10 @@ void VMdEditor::updateTextEditConfig()
 
     setEnableExtraBuffer(g_config->getEnableExtraBuffer());
 
+    setLazyLayoutEnabled(g_config->getEnableLazyLayout());
+
+    setImageStoreBudget((qint64)g_config->getPreviewImageCacheSize() * 1024 * 1024);
+
     int lineNumber = g_config->getEditorLineNumber();
     if (lineNumber < (int)LineNumberType::None || lineNumber >= (int)LineNumberType::Invalid) {
         lineNumber = (int)LineNumberType::None;
@@ -1360,44 +1372,34 @@ void VMdEditor::insertImageLink(const QString &p_text, const QString &p_url)
 VWordCountInfo VMdEditor::fetchWordCountInfo() const
 {
     VWordCountInfo info;
-    QTextDocument *doc = document();
-
-    // Char without spaces.
-    int cns = 0;
-    int wc = 0;
+    info.m_mode = VWordCountInfo::Edit;
+    info.m_wordCount = m_wordCountTotal->m_wordCount;
+    info.m_charWithoutSpacesCount = m_wordCountTotal->m_charWithoutSpacesCount;
     // Remove th ending new line.
-    int cc = doc->characterCount() - 1;
-    // 0 - not in word;
-    // 1 - in English word;
-    // 2 - in non-English word;
-    int state = 0;
-
-    for (int i = 0; i < cc; ++i) {
-        QChar ch = doc->characterAt(i);
-        if (ch.isSpace()) {
-            if (state) {
-                state = 0;
-            }
+    info.m_charWithSpacesCount = document()->characterCount() - 1;
+    return info;
+}
 
-            continue;
-        } else if (ch.unicode() < 128) {
-            if (state != 1) {
-                state = 1;
-                ++wc;
-            }
-        } else {
-            state = 2;
-            ++wc;
-        }
+void VMdEditor::updateWordCount(int p_position, int p_charsRemoved, int p_charsAdded)
+{
+    Q_UNUSED(p_charsRemoved);
 
-        ++cns;
+    // Counts of removed blocks are taken off when their data is deleted.
+    QTextDocument *doc = document();
+    QTextBlock block = doc->findBlock(p_position);
+    int lastBlockNum = doc->findBlock(p_position + p_charsAdded).blockNumber();
+    if (lastBlockNum == -1) {
+        lastBlockNum = doc->blockCount() - 1;
     }
 
-    info.m_mode = VWordCountInfo::Edit;
-    info.m_wordCount = wc;
-    info.m_charWithoutSpacesCount = cns;
-    info.m_charWithSpacesCount = cc;
-    return info;
+    while (block.isValid() && block.blockNumber() <= lastBlockNum) {
+        VTextBlockData *data = VTextBlockData::blockData(block);
+        if (data) {
+            data->updateWordCount(block.text(), m_wordCountTotal);
+        }
+
+        block = block.next();
+    }
 }
 
 void VMdEditor::setEditTab(VEditTab *p_editTab)
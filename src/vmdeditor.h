@@ -276,6 +276,9 @@ private slots:
 
     void handleLinkToAttachmentAction(QAction *p_act);
 
+    // Update the word count of blocks within the change.
+    void updateWordCount(int p_position, int p_charsRemoved, int p_charsAdded);
+
 private:
     void updateHeadersHelper(const QVector<VElementRegion> &p_headerRegions, bool p_configChanged);
 
@@ -366,6 +369,9 @@ private:
 
     // Temp file used for ExportAndCopy.
     QSharedPointer<QTemporaryFile> m_exportTempFile;
+
+    // Sum of the word count of all blocks, maintained by the blocks.
+    QSharedPointer<VWordCountInfo> m_wordCountTotal;
 };
 
 inline PegMarkdownHighlighter *VMdEditor::getMarkdownHighlighter() const
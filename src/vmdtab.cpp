@@ -26,11 +26,14 @@
 #include "vmathjaxinplacepreviewhelper.h"
 #include "vdirectory.h"
 #include "vdirectorytree.h"
+#include "vwebviewpool.h"
 
 extern VMainWindow *g_mainWin;
 
 extern VConfigManager *g_config;
 
+extern VWebViewPool *g_webViewPool;
+
 
 VMdTab::VMdTab(VFile *p_file, VEditArea *p_editArea,
                OpenFileMode p_mode, QWidget *p_parent)
@@ -43,7 +46,8 @@ VMdTab::VMdTab(VFile *p_file, VEditArea *p_editArea,
       m_backupFileChecked(false),
       m_mode(Mode::InvalidMode),
       m_livePreviewHelper(NULL),
-      m_mathjaxPreviewHelper(NULL)
+      m_mathjaxPreviewHelper(NULL),
+      m_webViewerPooled(false)
 {
     V_ASSERT(m_file->getDocType() == DocType::Markdown);
 
@@ -110,7 +114,8 @@ void VMdTab::setupUI()
     m_splitter = new QSplitter(this);
     m_splitter->setOrientation(Qt::Horizontal);
 
-    setupMarkdownViewer();
+    // Setup web viewer when we really need it.
+    setupMarkdownDocument();
 
     // Setup editor when we really need it.
     m_editor = NULL;
@@ -127,6 +132,13 @@ void VMdTab::setupUI()
     setLayout(layout);
 }
 
+VMdTab::~VMdTab()
+{
+    if (m_webViewerPooled) {
+        g_webViewPool->recycle(m_webViewer, this);
+    }
+}
+
 void VMdTab::showFileReadMode()
 {
     m_isEditMode = false;
@@ -134,6 +146,8 @@ void VMdTab::showFileReadMode()
     // Will recover the header when web side is ready.
     m_headerFromEditMode = m_currentHeader;
 
+    setupMarkdownViewer();
+
     updateWebView();
 
     setCurrentMode(Mode::Read);
@@ -440,35 +454,14 @@ void VMdTab::discardAndRead()
     readFile();
 }
 
-void VMdTab::setupMarkdownViewer()
+void VMdTab::setupMarkdownDocument()
 {
-    m_webViewer = new VWebView(m_file, this);
-    connect(m_webViewer, &VWebView::editNote,
-            this, &VMdTab::editFile);
-    connect(m_webViewer, &VWebView::requestSavePage,
-            this, &VMdTab::handleSavePageRequested);
-    connect(m_webViewer, &VWebView::selectionChanged,
-            this, &VMdTab::handleWebSelectionChanged);
-    connect(m_webViewer, &VWebView::requestExpandRestorePreviewArea,
-            this, &VMdTab::expandRestorePreviewArea);
-
-    VPreviewPage *page = new VPreviewPage(m_webViewer);
-    m_webViewer->setPage(page);
-    m_webViewer->setZoomFactor(g_config->getWebZoomFactor());
-    connect(page->profile(), &QWebEngineProfile::downloadRequested,
-            this, &VMdTab::handleDownloadRequested);
-    connect(page, &QWebEnginePage::linkHovered,
-            this, &VMdTab::statusMessage);
-
-    // Avoid white flash before loading content.
-    // Setting Qt::transparent will force GrayScale antialias rendering.
-    page->setBackgroundColor(g_config->getBaseBackground());
-
-    m_document = new VDocument(m_file, m_webViewer);
+    m_document = new VDocument(m_file, this);
+    m_document->setNativeRenderEnabled(true);
     m_documentID = m_document->registerIdentifier();
 
-    QWebChannel *channel = new QWebChannel(m_webViewer);
-    channel->registerObject(QStringLiteral("content"), m_document);
+    connect(m_document, &VDocument::webSideRequested,
+            this, &VMdTab::setupMarkdownViewer);
     connect(m_document, &VDocument::tocChanged,
             this, &VMdTab::updateOutlineFromHtml);
     connect(m_document, SIGNAL(headerChanged(const QString &)),
@@ -496,7 +489,7 @@ void VMdTab::setupMarkdownViewer()
                     return;
                 }
 
-                m_editor->textToHtmlFinished(p_id, p_timeStamp, m_webViewer->url(), p_html);
+                m_editor->textToHtmlFinished(p_id, p_timeStamp, m_file->getBaseUrl(), p_html);
             });
     connect(m_document, &VDocument::htmlToTextFinished,
             this, [this](int p_identitifer, int p_id, int p_timeStamp, const QString &p_text) {
@@ -516,11 +509,61 @@ void VMdTab::setupMarkdownViewer()
 
                 emit statusUpdated(info);
             });
+}
 
-    page->setWebChannel(channel);
+void VMdTab::setupMarkdownViewer()
+{
+    if (m_webViewer) {
+        return;
+    }
 
-    m_webViewer->setHtml(VUtils::generateHtmlTemplate(m_mdConType),
-                         m_file->getBaseUrl());
+    VPreviewPage *page = NULL;
+    m_webViewer = g_webViewPool->take(m_mdConType);
+    if (m_webViewer) {
+        m_webViewerPooled = true;
+        m_webViewer->setFile(m_file);
+        page = static_cast<VPreviewPage *>(m_webViewer->page());
+
+        // The template has been loaded with another base URL.
+        m_document->setBaseUrl(m_file->getBaseUrl().toString());
+        page->webChannel()->registerObject(QStringLiteral("content"), m_document);
+        VWebViewPool::initWebChannel(m_webViewer);
+    } else {
+        m_webViewer = new VWebView(m_file, this);
+        page = new VPreviewPage(m_webViewer);
+        m_webViewer->setPage(page);
+
+        // Avoid white flash before loading content.
+        // Setting Qt::transparent will force GrayScale antialias rendering.
+        page->setBackgroundColor(g_config->getBaseBackground());
+
+        QWebChannel *channel = new QWebChannel(m_webViewer);
+        channel->registerObject(QStringLiteral("content"), m_document);
+        page->setWebChannel(channel);
+
+        m_webViewer->setHtml(VUtils::generateHtmlTemplate(m_mdConType),
+                             m_file->getBaseUrl());
+    }
+
+    connect(m_webViewer, &VWebView::editNote,
+            this, &VMdTab::editFile);
+    connect(m_webViewer, &VWebView::requestSavePage,
+            this, &VMdTab::handleSavePageRequested);
+    connect(m_webViewer, &VWebView::selectionChanged,
+            this, &VMdTab::handleWebSelectionChanged);
+    connect(m_webViewer, &VWebView::requestExpandRestorePreviewArea,
+            this, &VMdTab::expandRestorePreviewArea);
+
+    m_webViewer->setZoomFactor(g_config->getWebZoomFactor());
+    connect(page->profile(), &QWebEngineProfile::downloadRequested,
+            this, &VMdTab::handleDownloadRequested);
+    connect(page, &QWebEnginePage::linkHovered,
+            this, &VMdTab::statusMessage);
+
+    // Shown when switching to read mode or live preview.
+    if (m_mode != Mode::Read && m_mode != Mode::EditPreview) {
+        m_webViewer->hide();
+    }
 
     m_splitter->addWidget(m_webViewer);
 }
@@ -938,6 +981,26 @@ VWebView *VMdTab::getWebViewer() const
     return m_webViewer;
 }
 
+void VMdTab::prepareWebViewer(const std::function<void()> &p_func)
+{
+    if (m_ready & TabReady::ReadMode) {
+        p_func();
+        return;
+    }
+
+    setupMarkdownViewer();
+
+    // Call it once when the web side finishes rendering.
+    QSharedPointer<QMetaObject::Connection> conn(new QMetaObject::Connection());
+    *conn = connect(m_document, &VDocument::logicsFinished,
+                    this, [conn, p_func]() {
+                        QObject::disconnect(*conn);
+                        p_func();
+                    });
+
+    updateWebView();
+}
+
 MarkdownConverterType VMdTab::getMarkdownConverterType() const
 {
     return m_mdConType;
@@ -1180,7 +1243,9 @@ void VMdTab::reload()
 
     // Reload web viewer.
     m_ready &= ~TabReady::ReadMode;
-    m_webViewer->reload();
+    if (m_webViewer) {
+        m_webViewer->reload();
+    }
 
     if (!m_isEditMode) {
         VUtils::sleepWait(500);
@@ -1309,8 +1374,14 @@ void VMdTab::handleFileOrDirectoryChange(bool p_isFile, UpdateAction p_act)
 {
     // Reload the web view with new base URL.
     m_headerFromEditMode = m_currentHeader;
-    m_webViewer->setHtml(VUtils::generateHtmlTemplate(m_mdConType),
-                         m_file->getBaseUrl());
+    if (m_webViewerPooled) {
+        m_document->setBaseUrl(m_file->getBaseUrl().toString());
+    }
+
+    if (m_webViewer) {
+        m_webViewer->setHtml(VUtils::generateHtmlTemplate(m_mdConType),
+                             m_file->getBaseUrl());
+    }
 
     if (m_editor) {
         m_editor->updateInitAndInsertedImages(p_isFile, p_act);
@@ -1322,6 +1393,8 @@ void VMdTab::handleFileOrDirectoryChange(bool p_isFile, UpdateAction p_act)
 
 void VMdTab::textToHtmlViaWebView(const QString &p_text, int p_id, int p_timeStamp)
 {
+    setupMarkdownViewer();
+
     int maxRetry = 50;
     while (!m_document->isReadyToTextToHtml() && maxRetry > 0) {
         qDebug() << "wait for web side ready to convert text to HTML";
@@ -1339,6 +1412,8 @@ void VMdTab::textToHtmlViaWebView(const QString &p_text, int p_id, int p_timeSta
 
 void VMdTab::htmlToTextViaWebView(const QString &p_html, int p_id, int p_timeStamp)
 {
+    setupMarkdownViewer();
+
     int maxRetry = 50;
     while (!m_document->isReadyToTextToHtml() && maxRetry > 0) {
         qDebug() << "wait for web side ready to convert HTML to text";
@@ -1458,7 +1533,7 @@ bool VMdTab::executeVimCommandInWebView(const QString &p_cmd)
         msg = tr("Quit");
     } else if (p_cmd == "nohlsearch" || p_cmd == "noh") {
         // :nohlsearch, clear highlight search.
-        m_webViewer->findText("");
+        clearSearchedWordHighlight();
     } else if (p_cmd == "e") {
         // :e, enter edit mode.
         showFileEditMode();
@@ -1621,11 +1696,20 @@ VWordCountInfo VMdTab::fetchWordCountInfo(bool p_editMode) const
         }
     } else {
         // Request to update with current text.
-        if (m_isEditMode) {
+        // Do not create the web side just for the count.
+        if (m_isEditMode && m_webViewer) {
             const_cast<VMdTab *>(this)->updateWebView();
         }
 
-        return m_document->getWordCountInfo();
+        const VWordCountInfo &info = m_document->getWordCountInfo();
+        if (info.isNull() && m_editor) {
+            // The page is not rendered yet. Fall back to the native count.
+            VWordCountInfo editInfo = m_editor->fetchWordCountInfo();
+            editInfo.m_mode = VWordCountInfo::Read;
+            return editInfo;
+        }
+
+        return info;
     }
 
     return VWordCountInfo();
@@ -1637,7 +1721,11 @@ void VMdTab::setCurrentMode(Mode p_mode)
         return;
     }
 
-    qreal factor = m_webViewer->zoomFactor();
+    if (p_mode == Mode::Read || p_mode == Mode::EditPreview) {
+        setupMarkdownViewer();
+    }
+
+    qreal factor = m_webViewer ? m_webViewer->zoomFactor() : g_config->getWebZoomFactor();
     if (m_mode == Mode::Read) {
         m_readWebViewState->m_zoomFactor = factor;
     } else if (m_mode == Mode::EditPreview) {
@@ -1672,7 +1760,10 @@ void VMdTab::setCurrentMode(Mode p_mode)
 
     case Mode::Edit:
         m_document->muteWebView(true);
-        m_webViewer->hide();
+        if (m_webViewer) {
+            m_webViewer->hide();
+        }
+
         m_editor->show();
 
         QCoreApplication::sendPostedEvents();
@@ -3,6 +3,7 @@
 
 #include <QString>
 #include <QPointer>
+#include <functional>
 #include <QSharedPointer>
 #include "vedittab.h"
 #include "vconstants.h"
@@ -27,6 +28,8 @@ class VMdTab : public VEditTab
 public:
     VMdTab(VFile *p_file, VEditArea *p_editArea, OpenFileMode p_mode, QWidget *p_parent = 0);
 
+    ~VMdTab();
+
     // Close current tab.
     // @p_forced: if true, discard the changes.
     bool closeFile(bool p_forced) Q_DECL_OVERRIDE;
@@ -71,6 +74,10 @@ public:
     void clearSearchedWordHighlight() Q_DECL_OVERRIDE;
 
     VWebView *getWebViewer() const;
+
+    // Create the web side on demand and call @p_func once it has rendered the
+    // note, such as in edit mode.
+    void prepareWebViewer(const std::function<void()> &p_func);
     
     // Get the markdown editor. If not init yet, init and return it.
     VMdEditor *getEditor();
@@ -196,7 +203,10 @@ private:
     // Show the file content in edit mode.
     void showFileEditMode();
 
-    // Setup Markdown viewer.
+    // Setup the document bridging to the web side.
+    void setupMarkdownDocument();
+
+    // Setup Markdown viewer if not yet.
     void setupMarkdownViewer();
 
     // Setup Markdown editor.
@@ -289,6 +299,9 @@ private:
     VLivePreviewHelper *m_livePreviewHelper;
     VMathJaxInplacePreviewHelper *m_mathjaxPreviewHelper;
 
+    // Whether m_webViewer is taken from the web view pool.
+    bool m_webViewerPooled;
+
     int m_documentID;
 
     VGithubImageHosting *vGithubImageHosting;
@@ -5,24 +5,40 @@
 
 #include "vconfigmanager.h"
 #include "utils/vprocessutils.h"
+#include "vplantumlprocesspool.h"
+#include "vrenderscheduler.h"
 
 extern VConfigManager *g_config;
 
-#define TaskIdProperty "PlantUMLTaskId"
-#define TaskFormatProperty "PlantUMLTaskFormat"
-#define TaskTimeStampProperty "PlantUMLTaskTimeStamp"
+extern VPlantUMLProcessPool *g_plantUMLProcessPool;
+
+extern VRenderScheduler *g_renderScheduler;
 
 VPlantUMLHelper::VPlantUMLHelper(QObject *p_parent)
-    : QObject(p_parent)
+    : QObject(p_parent),
+      m_usePool(false)
 {
     m_customCmd = g_config->getPlantUMLCmd();
     if (m_customCmd.isEmpty()) {
         prepareCommand(m_program, m_args);
+
+        // Custom command is not guaranteed to support -pipe mode.
+        m_usePool = g_plantUMLProcessPool && g_plantUMLProcessPool->isEnabled();
+        if (m_usePool) {
+            connect(g_plantUMLProcessPool, &VPlantUMLProcessPool::resultReady,
+                    this, &VPlantUMLHelper::handlePoolResult);
+        }
+    }
+
+    if (!m_usePool) {
+        connect(g_renderScheduler, &VRenderScheduler::jobFinished,
+                this, &VPlantUMLHelper::handleJobFinished);
     }
 }
 
 VPlantUMLHelper::VPlantUMLHelper(const QString &p_jar, QObject *p_parent)
-    : QObject(p_parent)
+    : QObject(p_parent),
+      m_usePool(false)
 {
     m_customCmd = g_config->getPlantUMLCmd();
     if (m_customCmd.isEmpty()) {
@@ -30,35 +46,57 @@ VPlantUMLHelper::VPlantUMLHelper(const QString &p_jar, QObject *p_parent)
     }
 }
 
+VPlantUMLHelper::~VPlantUMLHelper()
+{
+    if (m_usePool) {
+        g_plantUMLProcessPool->cancelAll(this);
+    } else {
+        g_renderScheduler->cancelAll(this);
+    }
+}
+
 void VPlantUMLHelper::processAsync(int p_id,
                                    TimeStamp p_timeStamp,
                                    const QString &p_format,
                                    const QString &p_text)
 {
-    QProcess *process = new QProcess(this);
-    process->setProperty(TaskIdProperty, p_id);
-    process->setProperty(TaskTimeStampProperty, p_timeStamp);
-    process->setProperty(TaskFormatProperty, p_format);
-    connect(process, SIGNAL(finished(int, QProcess::ExitStatus)),
-            this, SLOT(handleProcessFinished(int, QProcess::ExitStatus)));
+    if (m_usePool) {
+        // Results of older timestamps will be abandoned anyway.
+        g_plantUMLProcessPool->cancel(this, p_timeStamp);
+
+        QStringList args(m_args);
+        args << "-pipedelimitor" << VPlantUMLProcessPool::pipeDelimiter();
+        args << ("-t" + p_format);
+        g_plantUMLProcessPool->process(this,
+                                       p_id,
+                                       p_timeStamp,
+                                       p_format,
+                                       m_program,
+                                       refineArgsForUse(args),
+                                       p_text);
+        return;
+    }
 
     if (m_customCmd.isEmpty()) {
         QStringList args(m_args);
         args << ("-t" + p_format);
-        qDebug() << m_program << args;
-        process->start(m_program, refineArgsForUse(args));
+        g_renderScheduler->schedule(this,
+                                    p_id,
+                                    p_timeStamp,
+                                    p_format,
+                                    m_program,
+                                    refineArgsForUse(args),
+                                    p_text.toUtf8());
     } else {
         QString cmd(m_customCmd);
         cmd.replace("%0", p_format);
-        qDebug() << cmd;
-        process->start(cmd);
-    }
-
-    if (process->write(p_text.toUtf8()) == -1) {
-        qWarning() << "fail to write to QProcess:" << process->errorString();
+        g_renderScheduler->scheduleCommand(this,
+                                           p_id,
+                                           p_timeStamp,
+                                           p_format,
+                                           cmd,
+                                           p_text.toUtf8());
     }
-
-    process->closeWriteChannel();
 }
 
 void VPlantUMLHelper::prepareCommand(QString &p_program,
@@ -91,16 +129,23 @@ void VPlantUMLHelper::prepareCommand(QString &p_program,
     p_args << g_config->getPlantUMLArgs();
 }
 
-void VPlantUMLHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus)
+void VPlantUMLHelper::handleJobFinished(const QObject *p_owner,
+                                        int p_id,
+                                        TimeStamp p_timeStamp,
+                                        const QString &p_format,
+                                        int p_exitCode,
+                                        QProcess::ExitStatus p_exitStatus,
+                                        const QByteArray &p_out,
+                                        const QByteArray &p_err)
 {
-    QProcess *process = static_cast<QProcess *>(sender());
-    int id = process->property(TaskIdProperty).toInt();
-    QString format = process->property(TaskFormatProperty).toString();
-    TimeStamp timeStamp = process->property(TaskTimeStampProperty).toULongLong();
+    if (p_owner != this) {
+        return;
+    }
+
     qDebug() << QString("PlantUML finished: id %1 timestamp %2 format %3 exitcode %4 exitstatus %5")
-                       .arg(id)
-                       .arg(timeStamp)
-                       .arg(format)
+                       .arg(p_id)
+                       .arg(p_timeStamp)
+                       .arg(p_format)
                        .arg(p_exitCode)
                        .arg(p_exitStatus);
     bool failed = true;
@@ -109,20 +154,18 @@ void VPlantUMLHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus
             qWarning() << "PlantUML fail" << p_exitCode;
         } else {
             failed = false;
-            QByteArray outBa = process->readAllStandardOutput();
-            if (format == "svg") {
-                emit resultReady(id, timeStamp, format, QString::fromLocal8Bit(outBa));
+            if (p_format == "svg") {
+                emit resultReady(p_id, p_timeStamp, p_format, QString::fromLocal8Bit(p_out));
             } else {
-                emit resultReady(id, timeStamp, format, QString::fromLocal8Bit(outBa.toBase64()));
+                emit resultReady(p_id, p_timeStamp, p_format, QString::fromLocal8Bit(p_out.toBase64()));
             }
         }
     } else {
         qWarning() << "fail to start PlantUML process" << p_exitCode << p_exitStatus;
     }
 
-    QByteArray errBa = process->readAllStandardError();
-    if (!errBa.isEmpty()) {
-        QString errStr(QString::fromLocal8Bit(errBa));
+    if (!p_err.isEmpty()) {
+        QString errStr(QString::fromLocal8Bit(p_err));
         if (failed) {
             qWarning() << "PlantUML stderr:" << errStr;
         } else {
@@ -131,10 +174,21 @@ void VPlantUMLHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus
     }
 
     if (failed) {
-        emit resultReady(id, timeStamp, format, "");
+        emit resultReady(p_id, p_timeStamp, p_format, "");
+    }
+}
+
+void VPlantUMLHelper::handlePoolResult(const QObject *p_owner,
+                                       int p_id,
+                                       TimeStamp p_timeStamp,
+                                       const QString &p_format,
+                                       const QString &p_result)
+{
+    if (p_owner != this) {
+        return;
     }
 
-    process->deleteLater();
+    emit resultReady(p_id, p_timeStamp, p_format, p_result);
 }
 
 bool VPlantUMLHelper::testPlantUMLJar(const QString &p_jar, QString &p_msg)
@@ -14,6 +14,8 @@ class VPlantUMLHelper : public QObject
 public:
     explicit VPlantUMLHelper(QObject *p_parent = nullptr);
 
+    ~VPlantUMLHelper();
+
     void processAsync(int p_id,
                       TimeStamp p_timeStamp,
                       const QString &p_format,
@@ -34,7 +36,20 @@ signals:
                      const QString &p_result);
 
 private slots:
-    void handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus);
+    void handleJobFinished(const QObject *p_owner,
+                           int p_id,
+                           TimeStamp p_timeStamp,
+                           const QString &p_format,
+                           int p_exitCode,
+                           QProcess::ExitStatus p_exitStatus,
+                           const QByteArray &p_out,
+                           const QByteArray &p_err);
+
+    void handlePoolResult(const QObject *p_owner,
+                          int p_id,
+                          TimeStamp p_timeStamp,
+                          const QString &p_format,
+                          const QString &p_result);
 
 private:
     VPlantUMLHelper(const QString &p_jar, QObject *p_parent = nullptr);
@@ -49,6 +64,9 @@ private:
 
     // When not empty, @m_program and @m_args will be ignored.
     QString m_customCmd;
+
+    // Whether render via the shared process pool.
+    bool m_usePool;
 };
 
 #endif // VPLANTUMLHELPER_H
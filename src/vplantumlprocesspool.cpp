@@ -0,0 +1,404 @@
+#include "vplantumlprocesspool.h"
+
+#include <QDebug>
+#include <QTimer>
+#include <QRegExp>
+
+// Delimiter printed by PlantUML after each diagram in -pipe mode.
+#define PIPE_DELIMITER "VNOTE_PLANTUML_DELIMITER"
+
+// Kill the process if a request takes longer than this (ms).
+#define REQUEST_TIMEOUT 60000
+
+VPlantUMLProcessPool::VPlantUMLProcessPool(int p_maxProcesses, QObject *p_parent)
+    : QObject(p_parent),
+      m_maxProcesses(p_maxProcesses),
+      m_nrRequests(0),
+      m_nrCancelled(0),
+      m_nrStarted(0)
+{
+}
+
+VPlantUMLProcessPool::~VPlantUMLProcessPool()
+{
+    qInfo() << "PlantUML process pool" << statistics();
+
+    m_requests.clear();
+    while (!m_workers.isEmpty()) {
+        removeWorker(m_workers.first());
+    }
+}
+
+QString VPlantUMLProcessPool::pipeDelimiter()
+{
+    return PIPE_DELIMITER;
+}
+
+void VPlantUMLProcessPool::process(const QObject *p_owner,
+                                   int p_id,
+                                   TimeStamp p_timeStamp,
+                                   const QString &p_format,
+                                   const QString &p_program,
+                                   const QStringList &p_args,
+                                   const QString &p_text)
+{
+    Request req;
+    req.m_owner = p_owner;
+    req.m_id = p_id;
+    req.m_timeStamp = p_timeStamp;
+    req.m_format = p_format;
+    req.m_program = p_program;
+    req.m_args = p_args;
+    req.m_command = p_program + " " + p_args.join(' ');
+
+    req.m_data = closeDiagrams(p_text, req.m_nrDiagrams);
+
+    m_requests.append(req);
+    ++m_nrRequests;
+
+    dispatch();
+}
+
+void VPlantUMLProcessPool::cancel(const QObject *p_owner, TimeStamp p_timeStamp)
+{
+    for (auto it = m_requests.begin(); it != m_requests.end();) {
+        if (it->m_owner == p_owner && it->m_timeStamp < p_timeStamp) {
+            it = m_requests.erase(it);
+            ++m_nrCancelled;
+        } else {
+            ++it;
+        }
+    }
+
+    killWorkers([p_owner, p_timeStamp](const Request &p_req) {
+        return p_req.m_owner == p_owner && p_req.m_timeStamp < p_timeStamp;
+    });
+}
+
+void VPlantUMLProcessPool::cancelAll(const QObject *p_owner)
+{
+    for (auto it = m_requests.begin(); it != m_requests.end();) {
+        if (it->m_owner == p_owner) {
+            it = m_requests.erase(it);
+            ++m_nrCancelled;
+        } else {
+            ++it;
+        }
+    }
+
+    killWorkers([p_owner](const Request &p_req) {
+        return p_req.m_owner == p_owner;
+    });
+}
+
+void VPlantUMLProcessPool::killWorkers(const std::function<bool(const Request &)> &p_obsolete)
+{
+    // A process could not be interrupted in the middle of a request, so it is
+    // killed to make room for the newer ones.
+    bool killed = false;
+    for (int i = m_workers.size() - 1; i >= 0; --i) {
+        Worker *worker = m_workers[i];
+        if (worker->m_busy && p_obsolete(worker->m_request)) {
+            removeWorker(worker);
+            ++m_nrCancelled;
+            killed = true;
+        }
+    }
+
+    if (killed) {
+        dispatch();
+    }
+}
+
+QByteArray VPlantUMLProcessPool::closeDiagrams(const QString &p_text, int &p_nrDiagrams)
+{
+    // A process keeps reading until the @end line, so each diagram must be
+    // closed, including the one being typed.
+    static QRegExp tagReg("^\\s*@(start|end)([a-zA-Z]+)\\b.*$");
+
+    QStringList lines = p_text.split('\n');
+    QStringList outLines;
+    QString openType;
+    p_nrDiagrams = 0;
+    for (auto const &line : lines) {
+        if (tagReg.exactMatch(line)) {
+            if (tagReg.cap(1) == "start") {
+                if (!openType.isEmpty()) {
+                    outLines << ("@end" + openType);
+                }
+
+                openType = tagReg.cap(2);
+                ++p_nrDiagrams;
+            } else if (!openType.isEmpty()) {
+                // Ended by any @end line like PlantUML does.
+                openType.clear();
+            }
+        }
+
+        outLines << line;
+    }
+
+    if (p_nrDiagrams == 0) {
+        p_nrDiagrams = 1;
+        return "@startuml\n" + p_text.toUtf8() + "\n@enduml\n";
+    }
+
+    if (!openType.isEmpty()) {
+        outLines << ("@end" + openType);
+    }
+
+    return outLines.join('\n').toUtf8() + "\n";
+}
+
+void VPlantUMLProcessPool::dispatch()
+{
+    while (!m_requests.isEmpty()) {
+        const Request &req = m_requests.first();
+
+        Worker *worker = NULL;
+        Worker *idleWorker = NULL;
+        for (auto wk : m_workers) {
+            if (wk->m_busy) {
+                continue;
+            }
+
+            if (wk->m_command == req.m_command) {
+                worker = wk;
+                break;
+            }
+
+            idleWorker = wk;
+        }
+
+        if (!worker) {
+            if (m_workers.size() >= m_maxProcesses) {
+                if (!idleWorker) {
+                    // All busy.
+                    return;
+                }
+
+                // Replace an idle process of another format or command.
+                removeWorker(idleWorker);
+            }
+
+            worker = startWorker(req);
+        }
+
+        assign(worker, m_requests.takeFirst());
+    }
+}
+
+VPlantUMLProcessPool::Worker *VPlantUMLProcessPool::startWorker(const Request &p_req)
+{
+    Worker *worker = new Worker();
+    worker->m_command = p_req.m_command;
+    worker->m_process = new QProcess(this);
+    connect(worker->m_process, &QProcess::readyReadStandardOutput,
+            this, &VPlantUMLProcessPool::handleReadyReadStandardOutput);
+    connect(worker->m_process, &QProcess::readyReadStandardError,
+            this, &VPlantUMLProcessPool::handleReadyReadStandardError);
+    connect(worker->m_process, SIGNAL(finished(int, QProcess::ExitStatus)),
+            this, SLOT(handleProcessFinished(int, QProcess::ExitStatus)));
+    connect(worker->m_process, &QProcess::errorOccurred,
+            this, &VPlantUMLProcessPool::handleProcessError);
+
+    worker->m_timer = new QTimer(this);
+    worker->m_timer->setSingleShot(true);
+    worker->m_timer->setInterval(REQUEST_TIMEOUT);
+    connect(worker->m_timer, &QTimer::timeout,
+            this, &VPlantUMLProcessPool::handleTimeout);
+
+    m_workers.append(worker);
+    ++m_nrStarted;
+
+    qDebug() << "start PlantUML process" << p_req.m_program << p_req.m_args;
+    worker->m_process->start(p_req.m_program, p_req.m_args);
+    return worker;
+}
+
+void VPlantUMLProcessPool::assign(Worker *p_worker, const Request &p_req)
+{
+    p_worker->m_busy = true;
+    p_worker->m_request = p_req;
+    p_worker->m_pendingDiagrams = p_req.m_nrDiagrams;
+    p_worker->m_result.clear();
+    p_worker->m_timer->start();
+
+    // Data is buffered until the process is started.
+    if (p_worker->m_process->write(p_req.m_data) == -1) {
+        qWarning() << "fail to write to PlantUML process:" << p_worker->m_process->errorString();
+    }
+}
+
+VPlantUMLProcessPool::Worker *VPlantUMLProcessPool::findWorker(const QObject *p_obj) const
+{
+    for (auto worker : m_workers) {
+        if (worker->m_process == p_obj || worker->m_timer == p_obj) {
+            return worker;
+        }
+    }
+
+    return NULL;
+}
+
+void VPlantUMLProcessPool::handleReadyReadStandardOutput()
+{
+    Worker *worker = findWorker(sender());
+    if (!worker) {
+        return;
+    }
+
+    worker->m_output += worker->m_process->readAllStandardOutput();
+
+    const QByteArray delimiter(PIPE_DELIMITER);
+    while (worker->m_busy) {
+        int idx = worker->m_output.indexOf(delimiter);
+        if (idx == -1) {
+            break;
+        }
+
+        int end = worker->m_output.indexOf('\n', idx + delimiter.size());
+        if (end == -1) {
+            break;
+        }
+
+        worker->m_result += worker->m_output.left(idx);
+        worker->m_output.remove(0, end + 1);
+
+        if (--worker->m_pendingDiagrams <= 0) {
+            finishRequest(worker);
+
+            // May have been replaced by a new request.
+            return;
+        }
+    }
+}
+
+void VPlantUMLProcessPool::handleReadyReadStandardError()
+{
+    Worker *worker = findWorker(sender());
+    if (!worker) {
+        return;
+    }
+
+    QByteArray errBa = worker->m_process->readAllStandardError();
+    if (!errBa.isEmpty()) {
+        qDebug() << "PlantUML stderr:" << QString::fromLocal8Bit(errBa);
+    }
+}
+
+void VPlantUMLProcessPool::handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus)
+{
+    handleProcessExited(static_cast<QProcess *>(sender()), p_exitCode, p_exitStatus);
+}
+
+void VPlantUMLProcessPool::handleProcessExited(QProcess *p_process,
+                                               int p_exitCode,
+                                               QProcess::ExitStatus p_exitStatus)
+{
+    Worker *worker = findWorker(p_process);
+    if (!worker) {
+        return;
+    }
+
+    qWarning() << "PlantUML process exited" << p_exitCode << p_exitStatus;
+
+    // Remove it before notifying so no new request will be assigned to it.
+    bool busy = worker->m_busy;
+    Request req = worker->m_request;
+    removeWorker(worker);
+
+    if (busy && req.m_owner) {
+        emit resultReady(req.m_owner, req.m_id, req.m_timeStamp, req.m_format, QString());
+    }
+
+    dispatch();
+}
+
+void VPlantUMLProcessPool::handleProcessError(QProcess::ProcessError p_error)
+{
+    // finished() will not be emitted if it fails to start.
+    // Handle it later since it may be emitted within start().
+    if (p_error == QProcess::FailedToStart) {
+        qWarning() << "fail to start PlantUML process";
+        QProcess *process = static_cast<QProcess *>(sender());
+        QTimer::singleShot(0, process, [this, process]() {
+            handleProcessExited(process, -1, QProcess::CrashExit);
+        });
+    }
+}
+
+void VPlantUMLProcessPool::handleTimeout()
+{
+    Worker *worker = findWorker(sender());
+    if (!worker || !worker->m_busy) {
+        return;
+    }
+
+    qWarning() << "PlantUML process timed out, id" << worker->m_request.m_id;
+
+    // finished() will be handled.
+    worker->m_process->kill();
+}
+
+void VPlantUMLProcessPool::finishRequest(Worker *p_worker)
+{
+    p_worker->m_timer->stop();
+    p_worker->m_busy = false;
+
+    Request req = p_worker->m_request;
+    p_worker->m_request = Request();
+
+    QByteArray outBa = p_worker->m_result;
+    p_worker->m_result.clear();
+
+    if (req.m_owner) {
+        QString result;
+        if (req.m_format == "svg") {
+            result = QString::fromLocal8Bit(outBa);
+        } else {
+            result = QString::fromLocal8Bit(outBa.toBase64());
+        }
+
+        emit resultReady(req.m_owner, req.m_id, req.m_timeStamp, req.m_format, result);
+    }
+
+    dispatch();
+}
+
+void VPlantUMLProcessPool::removeWorker(Worker *p_worker)
+{
+    m_workers.removeOne(p_worker);
+
+    p_worker->m_process->disconnect(this);
+    p_worker->m_timer->disconnect(this);
+    p_worker->m_timer->stop();
+    if (p_worker->m_process->state() != QProcess::NotRunning) {
+        p_worker->m_process->kill();
+        p_worker->m_process->waitForFinished(1000);
+    }
+
+    // It may be called within the signals of the process.
+    p_worker->m_process->deleteLater();
+    p_worker->m_timer->deleteLater();
+    delete p_worker;
+}
+
+QString VPlantUMLProcessPool::statistics() const
+{
+    int busy = 0;
+    for (auto worker : m_workers) {
+        if (worker->m_busy) {
+            ++busy;
+        }
+    }
+
+    return QString("processes %1/%2 busy %3 started %4 requests %5 queued %6 cancelled %7")
+                  .arg(m_workers.size())
+                  .arg(m_maxProcesses)
+                  .arg(busy)
+                  .arg(m_nrStarted)
+                  .arg(m_nrRequests)
+                  .arg(m_requests.size())
+                  .arg(m_nrCancelled);
+}
@@ -0,0 +1,174 @@
+#ifndef VPLANTUMLPROCESSPOOL_H
+#define VPLANTUMLPROCESSPOOL_H
+
+#include <QObject>
+#include <QList>
+#include <QHash>
+#include <QStringList>
+#include <QByteArray>
+#include <QProcess>
+#include <functional>
+
+#include "vconstants.h"
+
+class QTimer;
+
+// Pool of long-lived PlantUML processes in -pipe mode shared by all the
+// PlantUML helpers, so a JVM is not started for each diagram.
+// Diagrams are written to the stdin of an idle process one at a time and the
+// result is split from stdout by the pipe delimiter.
+class VPlantUMLProcessPool : public QObject
+{
+    Q_OBJECT
+public:
+    // @p_maxProcesses: max number of processes, non-positive to disable the pool.
+    explicit VPlantUMLProcessPool(int p_maxProcesses, QObject *p_parent = nullptr);
+
+    ~VPlantUMLProcessPool();
+
+    bool isEnabled() const;
+
+    // Render @p_text by a process started with @p_program and @p_args, which
+    // should be in -pipe mode with delimiter pipeDelimiter().
+    // resultReady() will be emitted with @p_owner.
+    void process(const QObject *p_owner,
+                 int p_id,
+                 TimeStamp p_timeStamp,
+                 const QString &p_format,
+                 const QString &p_program,
+                 const QStringList &p_args,
+                 const QString &p_text);
+
+    // Drop queued requests of @p_owner older than @p_timeStamp and kill the
+    // processes running them.
+    void cancel(const QObject *p_owner, TimeStamp p_timeStamp);
+
+    // Drop all requests of @p_owner like cancel().
+    void cancelAll(const QObject *p_owner);
+
+    // Usage for the log.
+    QString statistics() const;
+
+    static QString pipeDelimiter();
+
+signals:
+    // @p_result is empty if failed.
+    void resultReady(const QObject *p_owner,
+                     int p_id,
+                     TimeStamp p_timeStamp,
+                     const QString &p_format,
+                     const QString &p_result);
+
+private slots:
+    void handleReadyReadStandardOutput();
+
+    void handleReadyReadStandardError();
+
+    void handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus);
+
+    void handleProcessError(QProcess::ProcessError p_error);
+
+    void handleTimeout();
+
+private:
+    struct Request
+    {
+        Request()
+            : m_owner(NULL),
+              m_id(0),
+              m_timeStamp(0),
+              m_nrDiagrams(1)
+        {
+        }
+
+        const QObject *m_owner;
+
+        int m_id;
+
+        TimeStamp m_timeStamp;
+
+        QString m_format;
+
+        // Program and arguments joined.
+        QString m_command;
+
+        QString m_program;
+
+        QStringList m_args;
+
+        QByteArray m_data;
+
+        // Number of diagrams in @m_data, each followed by a delimiter.
+        int m_nrDiagrams;
+    };
+
+    struct Worker
+    {
+        Worker()
+            : m_process(NULL),
+              m_timer(NULL),
+              m_busy(false),
+              m_pendingDiagrams(0)
+        {
+        }
+
+        QProcess *m_process;
+
+        QTimer *m_timer;
+
+        QString m_command;
+
+        bool m_busy;
+
+        Request m_request;
+
+        // Diagrams not finished of current request.
+        int m_pendingDiagrams;
+
+        QByteArray m_output;
+
+        QByteArray m_result;
+    };
+
+    // Assign queued requests to idle or new processes.
+    void dispatch();
+
+    Worker *startWorker(const Request &p_req);
+
+    void assign(Worker *p_worker, const Request &p_req);
+
+    void finishRequest(Worker *p_worker);
+
+    void handleProcessExited(QProcess *p_process,
+                             int p_exitCode,
+                             QProcess::ExitStatus p_exitStatus);
+
+    void removeWorker(Worker *p_worker);
+
+    // Kill busy workers whose request is @p_obsolete.
+    void killWorkers(const std::function<bool(const Request &)> &p_obsolete);
+
+    // Close unbalanced diagrams of @p_text and wrap it if there is none.
+    // @p_nrDiagrams will be set to the number of diagrams in the result.
+    static QByteArray closeDiagrams(const QString &p_text, int &p_nrDiagrams);
+
+    Worker *findWorker(const QObject *p_obj) const;
+
+    int m_maxProcesses;
+
+    QList<Request> m_requests;
+
+    QList<Worker *> m_workers;
+
+    unsigned long long m_nrRequests;
+
+    unsigned long long m_nrCancelled;
+
+    unsigned long long m_nrStarted;
+};
+
+inline bool VPlantUMLProcessPool::isEnabled() const
+{
+    return m_maxProcesses > 0;
+}
+#endif // VPLANTUMLPROCESSPOOL_H
@@ -0,0 +1,136 @@
+#include "vpreviewimagecache.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QDateTime>
+
+#include "vdownloader.h"
+
+VPreviewImageCache::VPreviewImageCache(int p_maxDownloadSize, QObject *p_parent)
+    : QObject(p_parent),
+      m_downloads(p_maxDownloadSize > 0 ? p_maxDownloadSize : 0),
+      m_hits(0),
+      m_misses(0),
+      m_dedupDownloads(0)
+{
+    m_downloader = new VDownloader(this);
+    connect(m_downloader, &VDownloader::downloadFinished,
+            this, &VPreviewImageCache::handleDownloadFinished);
+}
+
+VPreviewImageCache::~VPreviewImageCache()
+{
+    qInfo() << "preview image cache" << statistics();
+}
+
+QString VPreviewImageCache::localImageKey(const QString &p_path, const QSize &p_size)
+{
+    QFileInfo fi(p_path);
+    QString path = fi.canonicalFilePath();
+    if (path.isEmpty()) {
+        path = fi.absoluteFilePath();
+    }
+
+    return QString("%1|%2|%3x%4").arg(path)
+                                 .arg(fi.lastModified().toMSecsSinceEpoch())
+                                 .arg(p_size.width())
+                                 .arg(p_size.height());
+}
+
+QString VPreviewImageCache::urlImageKey(const QString &p_url, int p_width, int p_height)
+{
+    return QString("%1|%2_%3").arg(p_url).arg(p_width).arg(p_height);
+}
+
+QPixmap VPreviewImageCache::acquire(const QString &p_key)
+{
+    auto it = m_images.find(p_key);
+    if (it == m_images.end()) {
+        ++m_misses;
+        return QPixmap();
+    }
+
+    ++m_hits;
+    ++it.value().m_refs;
+    return it.value().m_image;
+}
+
+QPixmap VPreviewImageCache::insert(const QString &p_key, const QPixmap &p_image)
+{
+    ImageEntry &entry = m_images[p_key];
+    if (entry.m_refs == 0) {
+        entry.m_image = p_image;
+    }
+
+    ++entry.m_refs;
+    return entry.m_image;
+}
+
+void VPreviewImageCache::release(const QString &p_key)
+{
+    auto it = m_images.find(p_key);
+    if (it == m_images.end()) {
+        return;
+    }
+
+    if (--it.value().m_refs <= 0) {
+        m_images.erase(it);
+    }
+}
+
+bool VPreviewImageCache::findDownloaded(const QString &p_url, QByteArray &p_data) const
+{
+    const QByteArray *data = m_downloads.object(p_url);
+    if (!data) {
+        return false;
+    }
+
+    p_data = *data;
+    return true;
+}
+
+void VPreviewImageCache::download(const QString &p_url)
+{
+    if (m_downloading.contains(p_url)) {
+        ++m_dedupDownloads;
+        return;
+    }
+
+    m_downloading.insert(p_url);
+    m_downloader->download(p_url);
+}
+
+void VPreviewImageCache::handleDownloadFinished(const QByteArray &p_data, const QString &p_url)
+{
+    m_downloading.remove(p_url);
+
+    if (!p_data.isEmpty()) {
+        m_downloads.insert(p_url, new QByteArray(p_data), p_data.size());
+    }
+
+    emit downloadFinished(p_data, p_url);
+}
+
+QString VPreviewImageCache::statistics() const
+{
+    qint64 bytes = 0;
+    int refs = 0;
+    for (auto it = m_images.constBegin(); it != m_images.constEnd(); ++it) {
+        const QPixmap &img = it.value().m_image;
+        bytes += (qint64)img.width() * img.height() * img.depth() / 8;
+        refs += it.value().m_refs;
+    }
+
+    unsigned long long total = m_hits + m_misses;
+    double hitRate = total > 0 ? m_hits * 100.0 / total : 0;
+    return QString("images %1 references %2 memory %3 KB hits %4 misses %5 hit rate %6% "
+                   "downloads %7 KB deduplicated downloads %8")
+                  .arg(m_images.size())
+                  .arg(refs)
+                  .arg(bytes / 1024)
+                  .arg(m_hits)
+                  .arg(m_misses)
+                  .arg(hitRate, 0, 'f', 1)
+                  .arg(m_downloads.totalCost() / 1024)
+                  .arg(m_dedupDownloads);
+}
@@ -0,0 +1,89 @@
+#ifndef VPREVIEWIMAGECACHE_H
+#define VPREVIEWIMAGECACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QCache>
+#include <QString>
+#include <QPixmap>
+#include <QByteArray>
+
+class VDownloader;
+
+// Process-wide cache of in-place preview images shared by all the editors.
+// Images are reference counted by the editors using them, so the same image
+// in many notes or splits is decoded and stored once.
+// It also deduplicates downloading of images by URL.
+class VPreviewImageCache : public QObject
+{
+    Q_OBJECT
+public:
+    // @p_maxDownloadSize: max size in bytes of downloaded data to keep.
+    explicit VPreviewImageCache(int p_maxDownloadSize, QObject *p_parent = nullptr);
+
+    ~VPreviewImageCache();
+
+    // Key of local image @p_path displayed at @p_size.
+    static QString localImageKey(const QString &p_path, const QSize &p_size);
+
+    // Key of image @p_url with size specified by the link.
+    static QString urlImageKey(const QString &p_url, int p_width, int p_height);
+
+    // Returns the image and adds one reference if hit.
+    QPixmap acquire(const QString &p_key);
+
+    // Add image @p_key with one reference and return the cached image.
+    // If it already exists, just add one reference.
+    QPixmap insert(const QString &p_key, const QPixmap &p_image);
+
+    // Remove one reference. The image is dropped if no one references it.
+    void release(const QString &p_key);
+
+    // Return true and set @p_data if @p_url has been downloaded.
+    bool findDownloaded(const QString &p_url, QByteArray &p_data) const;
+
+    // Download @p_url if it is not being downloaded.
+    // downloadFinished() will be emitted when it is done.
+    void download(const QString &p_url);
+
+    // Usage and hit rate for the log.
+    QString statistics() const;
+
+signals:
+    void downloadFinished(const QByteArray &p_data, const QString &p_url);
+
+private slots:
+    void handleDownloadFinished(const QByteArray &p_data, const QString &p_url);
+
+private:
+    struct ImageEntry
+    {
+        ImageEntry()
+            : m_refs(0)
+        {
+        }
+
+        QPixmap m_image;
+
+        int m_refs;
+    };
+
+    QHash<QString, ImageEntry> m_images;
+
+    VDownloader *m_downloader;
+
+    // URLs being downloaded.
+    QSet<QString> m_downloading;
+
+    // Downloaded data by URL.
+    QCache<QString, QByteArray> m_downloads;
+
+    unsigned long long m_hits;
+
+    unsigned long long m_misses;
+
+    unsigned long long m_dedupDownloads;
+};
+
+#endif // VPREVIEWIMAGECACHE_H
@@ -5,14 +5,20 @@
 #include <QUrl>
 #include <QVector>
 #include <QTextLayout>
+#include <QImageReader>
 
 #include "vconfigmanager.h"
 #include "utils/vutils.h"
-#include "vdownloader.h"
 #include "pegmarkdownhighlighter.h"
+#include "vpreviewimagecache.h"
 
 extern VConfigManager *g_config;
 
+extern VPreviewImageCache *g_previewImageCache;
+
+// Size of the placeholder of a local image whose size is unknown until decoded.
+#define UNKNOWN_IMAGE_PLACEHOLDER_SIZE 64
+
 VPreviewManager::VPreviewManager(VMdEditor *p_editor, PegMarkdownHighlighter *p_highlighter)
     : QObject(p_editor),
       m_editor(p_editor),
@@ -24,9 +30,25 @@ VPreviewManager::VPreviewManager(VMdEditor *p_editor, PegMarkdownHighlighter *p_
         m_timeStamps[i] = 0;
     }
 
-    m_downloader = new VDownloader(this);
-    connect(m_downloader, &VDownloader::downloadFinished,
+    // Downloads are shared by all the editors.
+    connect(g_previewImageCache, &VPreviewImageCache::downloadFinished,
             this, &VPreviewManager::imageDownloaded);
+
+    m_imageDecoder = new VImageDecoder(this);
+    connect(m_imageDecoder, &VImageDecoder::imageDecoded,
+            this, &VPreviewManager::imageDecoded);
+
+    connect(m_editor, &VTextEdit::imageRequested,
+            this, &VPreviewManager::imageRequested);
+    connect(m_editor, &VTextEdit::imageEvicted,
+            this, &VPreviewManager::imageEvicted);
+}
+
+VPreviewManager::~VPreviewManager()
+{
+    for (auto const &name : m_heldImages) {
+        g_previewImageCache->release(m_imageKeys.value(name));
+    }
 }
 
 void VPreviewManager::updateImageLinks(const QVector<VElementRegion> &p_imageRegions)
@@ -39,30 +61,6 @@ void VPreviewManager::updateImageLinks(const QVector<VElementRegion> &p_imageReg
     previewImages(ts, p_imageRegions);
 }
 
-static QPixmap scalePreviewImage(const QPixmap &p_img, int p_width, int p_height)
-{
-    const Qt::TransformationMode tMode = Qt::SmoothTransformation;
-    qreal sf = VUtils::calculateScaleFactor();
-    if (p_width > 0) {
-        if (p_height > 0) {
-            return p_img.scaled(p_width * sf,
-                                p_height * sf,
-                                Qt::IgnoreAspectRatio,
-                                tMode);
-        } else {
-            return p_img.scaledToWidth(p_width * sf, tMode);
-        }
-    } else if (p_height > 0) {
-        return p_img.scaledToHeight(p_height * sf, tMode);
-    } else {
-        if (sf < 1.1) {
-            return p_img;
-        } else {
-            return p_img.scaledToWidth(p_img.width() * sf, tMode);
-        }
-    }
-}
-
 void VPreviewManager::imageDownloaded(const QByteArray &p_data, const QString &p_url)
 {
     if (!m_previewEnabled) {
@@ -81,15 +79,139 @@ void VPreviewManager::imageDownloaded(const QByteArray &p_data, const QString &p
         return;
     }
 
-    QPixmap image;
-    image.loadFromData(p_data);
-    if (!image.isNull()) {
-        m_editor->addImage(info->m_name,
-                           scalePreviewImage(image, info->m_width, info->m_height));
+    if (p_data.isEmpty()) {
+        return;
+    }
+
+    // Decode it in background. Its size is unknown until decoded.
+    VImageDecodeJob job;
+    job.m_name = info->m_name;
+    job.m_data = p_data;
+    job.m_width = info->m_width;
+    job.m_height = info->m_height;
+    job.m_scaleFactor = VUtils::calculateScaleFactor();
+    m_decodeJobs.insert(job.m_name, job);
+    m_decodingImages.insert(job.m_name, QSize());
+
+    decodeImages();
+}
+
+void VPreviewManager::imageDecoded(const QString &p_name, const QImage &p_image)
+{
+    VImageDecodeJob job = m_decodeJobs.take(p_name);
+
+    auto it = m_decodingImages.find(p_name);
+    if (it == m_decodingImages.end()) {
+        // Obsolete.
+        return;
+    }
+
+    QSize size = it.value();
+    m_decodingImages.erase(it);
+
+    if (!m_previewEnabled || p_image.isNull()) {
+        return;
+    }
+
+    // Share it with other editors.
+    QPixmap image = QPixmap::fromImage(p_image);
+    QString key = m_imageKeys.value(p_name);
+    if (!key.isEmpty() && !m_heldImages.contains(p_name)) {
+        image = g_previewImageCache->insert(key, image);
+        m_heldImages.insert(p_name);
+    }
+
+    // It could be evicted since we could decode it again.
+    m_imageSources.insert(p_name, job);
+    m_editor->addImage(p_name, image, true);
+
+    if (size == p_image.size()) {
+        // The placeholder has been layouted. Just repaint it.
+        updateBlocksOfImage(p_name);
+    } else {
         emit requestUpdateImageLinks();
     }
 }
 
+void VPreviewManager::imageRequested(const QString &p_name)
+{
+    // Other editors may still hold it.
+    QString key = m_imageKeys.value(p_name);
+    if (!key.isEmpty() && !m_heldImages.contains(p_name)) {
+        QPixmap image = g_previewImageCache->acquire(key);
+        if (!image.isNull()) {
+            m_heldImages.insert(p_name);
+            m_editor->addImage(p_name, image, true);
+            updateBlocksOfImage(p_name);
+            return;
+        }
+    }
+
+    auto it = m_imageSources.constFind(p_name);
+    if (it == m_imageSources.constEnd() || m_decodingImages.contains(p_name)) {
+        return;
+    }
+
+    // Keep the layout and decode it again.
+    VImageDecodeJob job = it.value();
+    job.m_priority = -1;
+    m_decodeJobs.insert(p_name, job);
+    m_decodingImages.insert(p_name, m_editor->imageSize(p_name));
+
+    decodeImages();
+}
+
+void VPreviewManager::imageEvicted(const QString &p_name)
+{
+    // Let the shared cache drop it if no one else uses it.
+    if (m_heldImages.remove(p_name)) {
+        g_previewImageCache->release(m_imageKeys.value(p_name));
+    }
+}
+
+void VPreviewManager::releaseSharedImage(const QString &p_name)
+{
+    if (m_heldImages.remove(p_name)) {
+        g_previewImageCache->release(m_imageKeys.value(p_name));
+    }
+
+    m_imageKeys.remove(p_name);
+}
+
+void VPreviewManager::decodeImages()
+{
+    QVector<VImageDecodeJob> jobs;
+    jobs.reserve(m_decodeJobs.size());
+    for (auto it = m_decodeJobs.constBegin(); it != m_decodeJobs.constEnd(); ++it) {
+        jobs.append(it.value());
+    }
+
+    m_imageDecoder->decodeAsync(jobs);
+}
+
+void VPreviewManager::updateBlocksOfImage(const QString &p_name)
+{
+    const QSet<int> &blocks = m_highlighter->getPossiblePreviewBlocks();
+    for (auto i : blocks) {
+        QTextBlock block = m_document->findBlockByNumber(i);
+        if (!block.isValid()) {
+            continue;
+        }
+
+        VTextBlockData *blockData = static_cast<VTextBlockData *>(block.userData());
+        if (!blockData) {
+            continue;
+        }
+
+        for (auto const & info : blockData->getPreviews()) {
+            if (info->m_imageInfo.m_imageName == p_name) {
+                m_editor->updateBlockByNumber(i);
+                break;
+            }
+        }
+    }
+}
+
 void VPreviewManager::setPreviewEnabled(bool p_enabled)
 {
     if (m_previewEnabled != p_enabled) {
@@ -107,6 +229,18 @@ void VPreviewManager::setPreviewEnabled(bool p_enabled)
 
 void VPreviewManager::clearPreview()
 {
+    m_decodeJobs.clear();
+    m_decodingImages.clear();
+    m_imageSources.clear();
+    m_imageDecoder->cancel();
+
+    for (auto const &name : m_heldImages) {
+        g_previewImageCache->release(m_imageKeys.value(name));
+    }
+
+    m_heldImages.clear();
+    m_imageKeys.clear();
+
     OrderedIntSet affectedBlocks;
     for (int i = 0; i < (int)PreviewSource::MaxNumberOfSources; ++i) {
         TS ts = ++timeStamp(static_cast<PreviewSource>(i));
@@ -122,6 +256,16 @@ void VPreviewManager::previewImages(TS p_timeStamp, const QVector<VElementRegion
     QVector<ImageLinkInfo> imageLinks;
     fetchImageLinksFromRegions(p_imageRegions, imageLinks);
 
+    // Local images still in use will be added back with new priority.
+    // Evicted images being decoded again are kept.
+    for (auto it = m_decodeJobs.begin(); it != m_decodeJobs.end();) {
+        if (it.value().m_data.isEmpty() && !m_editor->containsImage(it.key())) {
+            it = m_decodeJobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
     OrderedIntSet affectedBlocks;
 
     updateBlockPreviewInfo(p_timeStamp, imageLinks, affectedBlocks);
@@ -130,6 +274,17 @@ void VPreviewManager::previewImages(TS p_timeStamp, const QVector<VElementRegion
 
     clearObsoleteImages(p_timeStamp, PreviewSource::ImageLink);
 
+    // Abandon obsolete images being decoded.
+    for (auto it = m_decodingImages.begin(); it != m_decodingImages.end();) {
+        if (!m_decodeJobs.contains(it.key())) {
+            it = m_decodingImages.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    decodeImages();
+
     relayout(affectedBlocks);
 }
 
@@ -234,7 +389,14 @@ void VPreviewManager::fetchImageInfoToPreview(const QString &p_text, ImageLinkIn
     p_info.m_linkUrl = VUtils::linkUrlToPath(file->fetchBasePath(), surl);
 }
 
-QString VPreviewManager::imageResourceName(const ImageLinkInfo &p_link)
+QSize VPreviewManager::placeholderSize(const ImageLinkInfo &p_link, qreal p_scaleFactor)
+{
+    int width = p_link.m_width > 0 ? p_link.m_width : UNKNOWN_IMAGE_PLACEHOLDER_SIZE;
+    int height = p_link.m_height > 0 ? p_link.m_height : UNKNOWN_IMAGE_PLACEHOLDER_SIZE;
+    return QSize(width * p_scaleFactor, height * p_scaleFactor);
+}
+
+QString VPreviewManager::imageResourceName(const ImageLinkInfo &p_link, int p_priority)
 {
     // Add size info to the name.
     QString name = QString("%1_%2_%3").arg(p_link.m_linkShortUrl)
@@ -244,31 +406,82 @@ QString VPreviewManager::imageResourceName(const ImageLinkInfo &p_link)
         return name;
     }
 
-    // Add it to the resource.
-    QPixmap image;
     QString imgPath = p_link.m_linkUrl;
     if (QFileInfo::exists(imgPath)) {
-        // Local file.
-        image = VUtils::pixmapFromFile(imgPath);
-        if (image.isNull()) {
-            return QString();
+        // Local file. Decode it in background while a placeholder of the same
+        // size is layouted.
+        VImageDecodeJob job;
+        job.m_name = name;
+        job.m_path = imgPath;
+        job.m_width = p_link.m_width;
+        job.m_height = p_link.m_height;
+        job.m_scaleFactor = VUtils::calculateScaleFactor();
+        job.m_priority = p_priority;
+
+        QSize size;
+        auto it = m_decodingImages.find(name);
+        if (it != m_decodingImages.end()) {
+            size = it.value();
+        } else {
+            // Only read the header.
+            QImageReader reader(imgPath);
+            reader.setDecideFormatFromContent(true);
+            size = VImageDecoder::previewSize(reader.size(),
+                                              p_link.m_width,
+                                              p_link.m_height,
+                                              job.m_scaleFactor);
+            if (!size.isValid()) {
+                // Unknown until decoded. Layout a placeholder and correct it
+                // then.
+                size = placeholderSize(p_link, job.m_scaleFactor);
+            } else {
+                // Other editors may have decoded it.
+                QString key = VPreviewImageCache::localImageKey(imgPath, size);
+                m_imageKeys.insert(name, key);
+                QPixmap image = g_previewImageCache->acquire(key);
+                if (!image.isNull()) {
+                    m_heldImages.insert(name);
+                    m_imageSources.insert(name, job);
+                    m_editor->addImage(name, image, true);
+                    return name;
+                }
+            }
+
+            m_decodingImages.insert(name, size);
         }
+
+        m_decodeJobs.insert(name, job);
+
+        return name;
     } else {
-        // URL. Try to download it.
-        // qrc:// files will touch this path.
-        m_downloader->download(imgPath);
+        QString key = VPreviewImageCache::urlImageKey(imgPath, p_link.m_width, p_link.m_height);
+        m_imageKeys.insert(name, key);
+        if (!m_heldImages.contains(name)) {
+            QPixmap image = g_previewImageCache->acquire(key);
+            if (!image.isNull()) {
+                m_heldImages.insert(name);
+                m_editor->addImage(name, image, false);
+                return name;
+            }
+        }
 
         QSharedPointer<UrlImageInfo> info(new UrlImageInfo(name,
                                                            p_link.m_width,
                                                            p_link.m_height));
         m_urlMap.insert(imgPath, info);
 
+        QByteArray data;
+        if (g_previewImageCache->findDownloaded(imgPath, data)) {
+            // Downloaded by other editors.
+            imageDownloaded(data, imgPath);
+        } else {
+            // URL. Try to download it.
+            // qrc:// files will touch this path.
+            g_previewImageCache->download(imgPath);
+        }
+
         return QString();
     }
-
-    m_editor->addImage(name,
-                       scalePreviewImage(image, p_link.m_width, p_link.m_height));
-    return name;
 }
 
 QString VPreviewManager::imageResourceNameForSource(PreviewSource p_source,
@@ -337,17 +550,33 @@ void VPreviewManager::updateBlockPreviewInfo(TS p_timeStamp,
                                              const QVector<ImageLinkInfo> &p_imageLinks,
                                              OrderedIntSet &p_affectedBlocks)
 {
+    // Decode images closest to the viewport first.
+    int firstVisible, lastVisible;
+    m_editor->visibleBlockRange(firstVisible, lastVisible);
+
     for (auto const & link : p_imageLinks) {
         QTextBlock block = m_document->findBlockByNumber(link.m_blockNumber);
         if (!block.isValid()) {
             continue;
         }
 
-        QString name = imageResourceName(link);
+        int priority = 0;
+        if (link.m_blockNumber < firstVisible) {
+            priority = firstVisible - link.m_blockNumber;
+        } else if (link.m_blockNumber > lastVisible) {
+            priority = link.m_blockNumber - lastVisible;
+        }
+
+        QString name = imageResourceName(link, priority);
         if (name.isEmpty()) {
             continue;
         }
 
+        // Placeholder of image being decoded.
+        auto decodingIt = m_decodingImages.constFind(name);
+        QSize imageSize = decodingIt != m_decodingImages.constEnd() ? decodingIt.value()
+                                                                    : m_editor->imageSize(name);
+
         VTextBlockData *blockData = static_cast<VTextBlockData *>(block.userData());
         if (!blockData) {
             continue;
@@ -360,7 +589,7 @@ void VPreviewManager::updateBlockPreviewInfo(TS p_timeStamp,
                                               link.m_padding,
                                               !link.m_isBlock,
                                               name,
-                                              m_editor->imageSize(name),
+                                              imageSize,
                                               QString());
         bool tsUpdated = blockData->insertPreviewInfo(info);
         imageCache(PreviewSource::ImageLink).insert(name, p_timeStamp);
@@ -423,6 +652,10 @@ void VPreviewManager::clearObsoleteImages(long long p_timeStamp, PreviewSource p
     for (auto it = cache.begin(); it != cache.end();) {
         if (it.value() < p_timeStamp) {
             m_editor->removeImage(it.key());
+            releaseSharedImage(it.key());
+            m_imageSources.remove(it.key());
+            m_decodeJobs.remove(it.key());
+            m_decodingImages.remove(it.key());
             it = cache.erase(it);
         } else {
             ++it;
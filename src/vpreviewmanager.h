@@ -7,12 +7,13 @@
 #include <QHash>
 #include <QVector>
 #include <QSharedPointer>
+#include <QSet>
 
 #include "markdownhighlighterdata.h"
 #include "vmdeditor.h"
 #include "vtextblockdata.h"
+#include "vimagedecoder.h"
 
-class VDownloader;
 
 typedef long long TS;
 
@@ -61,6 +62,8 @@ class VPreviewManager : public QObject
 public:
     VPreviewManager(VMdEditor *p_editor, PegMarkdownHighlighter *p_highlighter);
 
+    ~VPreviewManager();
+
     void setPreviewEnabled(bool p_enabled);
 
     // Clear all the preview.
@@ -96,6 +99,13 @@ private slots:
     // Non-local image downloaded for preview.
     void imageDownloaded(const QByteArray &p_data, const QString &p_url);
 
+    void imageDecoded(const QString &p_name, const QImage &p_image);
+
+    // Evicted image @p_name is needed again.
+    void imageRequested(const QString &p_name);
+
+    void imageEvicted(const QString &p_name);
+
 private:
     struct ImageLinkInfo
     {
@@ -208,9 +218,24 @@ private:
                                 OrderedIntSet &p_affectedBlocks);
 
     // Get the name of the image in the resource manager.
-    // Will add the image to the resource manager if not exists.
-    // Returns empty if fail to add the image to the resource manager.
-    QString imageResourceName(const ImageLinkInfo &p_link);
+    // Will decode the image in background if not exists. The image will be
+    // added to the resource manager after decoded.
+    // Returns empty if the image is not available and its size is unknown.
+    // A local image of unknown size gets a placeholder until decoded.
+    // @p_priority: priority to decode the image, smaller one first.
+    QString imageResourceName(const ImageLinkInfo &p_link, int p_priority);
+
+    // Size to layout for image of @p_link before its size is known.
+    static QSize placeholderSize(const ImageLinkInfo &p_link, qreal p_scaleFactor);
+
+    // Decode images of m_decodeJobs in background.
+    void decodeImages();
+
+    // Request to repaint blocks previewing image @p_name.
+    void updateBlocksOfImage(const QString &p_name);
+
+    // Release the reference of image @p_name in the shared cache.
+    void releaseSharedImage(const QString &p_name);
 
     QString imageResourceNameForSource(PreviewSource p_source, const QSharedPointer<VImageToPreview> &p_image);
 
@@ -234,8 +259,6 @@ private:
 
     PegMarkdownHighlighter *m_highlighter;
 
-    VDownloader *m_downloader;
-
     // Whether preview is enabled.
     bool m_previewEnabled;
 
@@ -243,6 +266,24 @@ private:
     // Used for downloading images.
     QHash<QString, QSharedPointer<UrlImageInfo>> m_urlMap;
 
+    VImageDecoder *m_imageDecoder;
+
+    // Images being decoded. Map from name to the size to display, which is
+    // invalid if unknown before decoding.
+    QHash<QString, QSize> m_decodingImages;
+
+    // Images to decode.
+    QHash<QString, VImageDecodeJob> m_decodeJobs;
+
+    // Sources of decoded images to decode them again after evicted.
+    QHash<QString, VImageDecodeJob> m_imageSources;
+
+    // Map from name to the key in the shared image cache.
+    QHash<QString, QString> m_imageKeys;
+
+    // Names of images referenced in the shared image cache.
+    QSet<QString> m_heldImages;
+
     // Timestamp per each preview source.
     TS m_timeStamps[(int)PreviewSource::MaxNumberOfSources];
 
@@ -0,0 +1,327 @@
+#include "vrenderresultcache.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QVector>
+#include <QPair>
+#include <QStringList>
+#include <QTimer>
+
+#include <algorithm>
+
+#include "utils/vutils.h"
+
+// "VRRC".
+#define CACHE_FILE_MAGIC 0x56525243
+
+#define CACHE_FILE_VERSION 1
+
+#define INDEX_FILE_NAME "index"
+
+// Disk overhead of one entry besides the data.
+#define ENTRY_OVERHEAD 64
+
+// Evict to this ratio of the max size to avoid evicting frequently.
+#define EVICTION_SIZE_RATIO 0.8
+
+// Wait for more changes before saving the index (ms).
+#define SAVE_INDEX_DELAY 5000
+
+VRenderResultCache::VRenderResultCache(const QString &p_folder, qint64 p_maxSize, QObject *p_parent)
+    : QObject(p_parent),
+      m_folder(p_folder),
+      m_maxSize(p_maxSize),
+      m_size(0),
+      m_dirty(false),
+      m_hits(0),
+      m_misses(0),
+      m_evictions(0)
+{
+    m_saveTimer = new QTimer(this);
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(SAVE_INDEX_DELAY);
+    connect(m_saveTimer, &QTimer::timeout,
+            this, &VRenderResultCache::saveIndex);
+
+    load();
+}
+
+VRenderResultCache::~VRenderResultCache()
+{
+    qInfo() << "render result cache" << statistics();
+
+    m_saveTimer->stop();
+    saveIndex();
+}
+
+void VRenderResultCache::markDirty()
+{
+    m_dirty = true;
+    if (!m_saveTimer->isActive()) {
+        m_saveTimer->start();
+    }
+}
+
+void VRenderResultCache::saveIndex()
+{
+    if (m_dirty && save()) {
+        m_dirty = false;
+    }
+}
+
+QString VRenderResultCache::hashKey(const QString &p_lang,
+                                    const QString &p_format,
+                                    qreal p_scaleFactor,
+                                    const QString &p_text)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(p_lang.toUtf8());
+    hash.addData("\n", 1);
+    hash.addData(p_format.toUtf8());
+    hash.addData("\n", 1);
+    hash.addData(QByteArray::number(p_scaleFactor, 'f', 2));
+    hash.addData("\n", 1);
+    hash.addData(p_text.toUtf8());
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QString VRenderResultCache::entryFile(const QString &p_key) const
+{
+    return QDir(m_folder).filePath(p_key);
+}
+
+bool VRenderResultCache::find(const QString &p_lang,
+                              const QString &p_format,
+                              qreal p_scaleFactor,
+                              const QString &p_text,
+                              QString &p_resultFormat,
+                              QByteArray &p_data)
+{
+    if (m_maxSize <= 0) {
+        return false;
+    }
+
+    QString key = hashKey(p_lang, p_format, p_scaleFactor, p_text);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        ++m_misses;
+        return false;
+    }
+
+    QFile file(entryFile(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        ++m_misses;
+        removeEntry(key);
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_9);
+
+    quint32 magic = 0, version = 0;
+    in >> magic >> version >> p_resultFormat >> p_data;
+    if (magic != CACHE_FILE_MAGIC
+        || version != CACHE_FILE_VERSION
+        || in.status() != QDataStream::Ok) {
+        qWarning() << "corrupted render result" << file.fileName();
+        file.close();
+        ++m_misses;
+        removeEntry(key);
+        return false;
+    }
+
+    ++m_hits;
+    it.value().m_lastUsed = QDateTime::currentMSecsSinceEpoch();
+    markDirty();
+    return true;
+}
+
+void VRenderResultCache::insert(const QString &p_lang,
+                                const QString &p_format,
+                                qreal p_scaleFactor,
+                                const QString &p_text,
+                                const QString &p_resultFormat,
+                                const QByteArray &p_data)
+{
+    if (m_maxSize <= 0 || p_data.isEmpty()) {
+        return;
+    }
+
+    if (!VUtils::makePath(m_folder)) {
+        qWarning() << "fail to create folder for render result cache" << m_folder;
+        return;
+    }
+
+    QString key = hashKey(p_lang, p_format, p_scaleFactor, p_text);
+    QSaveFile file(entryFile(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to save render result" << file.fileName();
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_9);
+    out << quint32(CACHE_FILE_MAGIC) << quint32(CACHE_FILE_VERSION) << p_resultFormat << p_data;
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        qWarning() << "fail to save render result" << file.fileName();
+        return;
+    }
+
+    Entry &entry = m_entries[key];
+    m_size -= entry.m_size;
+    entry.m_size = ENTRY_OVERHEAD + p_resultFormat.size() + p_data.size();
+    entry.m_lastUsed = QDateTime::currentMSecsSinceEpoch();
+    m_size += entry.m_size;
+
+    evict();
+
+    markDirty();
+}
+
+void VRenderResultCache::removeEntry(const QString &p_key)
+{
+    auto it = m_entries.find(p_key);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    m_size -= it.value().m_size;
+    m_entries.erase(it);
+    QFile::remove(entryFile(p_key));
+
+    markDirty();
+}
+
+void VRenderResultCache::evict()
+{
+    if (m_size <= m_maxSize) {
+        return;
+    }
+
+    QVector<QPair<qint64, QString>> entries;
+    entries.reserve(m_entries.size());
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        entries.append(qMakePair(it.value().m_lastUsed, it.key()));
+    }
+
+    std::sort(entries.begin(), entries.end());
+
+    qint64 target = m_maxSize * EVICTION_SIZE_RATIO;
+    for (auto const &ent : entries) {
+        if (m_size <= target) {
+            break;
+        }
+
+        removeEntry(ent.second);
+        ++m_evictions;
+    }
+}
+
+void VRenderResultCache::load()
+{
+    if (m_maxSize <= 0) {
+        return;
+    }
+
+    loadIndex();
+
+    // Remove results missing in the index, such as those written before a crash.
+    QDir dir(m_folder);
+    const QStringList files = dir.entryList(QDir::Files | QDir::NoDotAndDotDot);
+    for (auto const &name : files) {
+        if (name != INDEX_FILE_NAME && !m_entries.contains(name)) {
+            dir.remove(name);
+        }
+    }
+
+    // The max size may be changed.
+    evict();
+
+    qDebug() << "render result cache loaded" << m_entries.size() << m_size;
+}
+
+void VRenderResultCache::loadIndex()
+{
+    QFile file(entryFile(INDEX_FILE_NAME));
+    if (!file.exists()) {
+        return;
+    }
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "fail to open render result cache index" << file.fileName();
+        return;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_9);
+
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if (magic != CACHE_FILE_MAGIC || version != CACHE_FILE_VERSION) {
+        qDebug() << "abandon obsolete render result cache index" << file.fileName();
+        return;
+    }
+
+    for (quint32 i = 0; i < count; ++i) {
+        QString key;
+        Entry entry;
+        in >> key >> entry.m_size >> entry.m_lastUsed;
+        if (in.status() != QDataStream::Ok) {
+            qWarning() << "corrupted render result cache index" << file.fileName();
+            m_entries.clear();
+            m_size = 0;
+            return;
+        }
+
+        m_entries.insert(key, entry);
+        m_size += entry.m_size;
+    }
+}
+
+bool VRenderResultCache::save() const
+{
+    // An empty index is still written to drop the stale one.
+    if (m_maxSize <= 0) {
+        return false;
+    }
+
+    if (!VUtils::makePath(m_folder)) {
+        qWarning() << "fail to create folder for render result cache" << m_folder;
+        return false;
+    }
+
+    QSaveFile file(entryFile(INDEX_FILE_NAME));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to save render result cache index" << file.fileName();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_9);
+
+    out << quint32(CACHE_FILE_MAGIC) << quint32(CACHE_FILE_VERSION) << quint32(m_entries.size());
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        out << it.key() << it.value().m_size << it.value().m_lastUsed;
+    }
+
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+QString VRenderResultCache::statistics() const
+{
+    unsigned long long total = m_hits + m_misses;
+    double hitRate = total > 0 ? m_hits * 100.0 / total : 0;
+    return QString("entries %1 disk %2/%3 KB hits %4 misses %5 hit rate %6% evictions %7")
+                  .arg(m_entries.size())
+                  .arg(m_size / 1024)
+                  .arg(m_maxSize / 1024)
+                  .arg(m_hits)
+                  .arg(m_misses)
+                  .arg(hitRate, 0, 'f', 1)
+                  .arg(m_evictions);
+}
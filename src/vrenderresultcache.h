@@ -0,0 +1,106 @@
+#ifndef VRENDERRESULTCACHE_H
+#define VRENDERRESULTCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+
+class QTimer;
+
+// Size-bounded LRU disk cache of rendered results of code blocks, such as
+// PlantUML, Graphviz and MathJax, shared by all the editors.
+// Results are content-addressed by the hash of the language, the source text,
+// the requested format and the scale factor. Callers should put the settings
+// of the renderer in the language.
+// The index is saved a while after changes so it survives a crash.
+class VRenderResultCache : public QObject
+{
+    Q_OBJECT
+public:
+    // @p_folder: folder to keep the results;
+    // @p_maxSize: max size in bytes, non-positive to disable the cache;
+    VRenderResultCache(const QString &p_folder, qint64 p_maxSize, QObject *p_parent = nullptr);
+
+    ~VRenderResultCache();
+
+    // Return true and set @p_resultFormat and @p_data if hit.
+    // @p_format: requested format, empty if decided by the renderer.
+    bool find(const QString &p_lang,
+              const QString &p_format,
+              qreal p_scaleFactor,
+              const QString &p_text,
+              QString &p_resultFormat,
+              QByteArray &p_data);
+
+    void insert(const QString &p_lang,
+                const QString &p_format,
+                qreal p_scaleFactor,
+                const QString &p_text,
+                const QString &p_resultFormat,
+                const QByteArray &p_data);
+
+    // Usage and hit rate for the log.
+    QString statistics() const;
+
+private slots:
+    // Save the index if changed.
+    void saveIndex();
+
+private:
+    struct Entry
+    {
+        Entry()
+            : m_size(0),
+              m_lastUsed(0)
+        {
+        }
+
+        qint64 m_size;
+
+        // Msecs since epoch.
+        qint64 m_lastUsed;
+    };
+
+    static QString hashKey(const QString &p_lang,
+                           const QString &p_format,
+                           qreal p_scaleFactor,
+                           const QString &p_text);
+
+    QString entryFile(const QString &p_key) const;
+
+    void removeEntry(const QString &p_key);
+
+    // Schedule a save of the index.
+    void markDirty();
+
+    // Remove least recently used results until the cache is within the size.
+    void evict();
+
+    void load();
+
+    // Load the index of the results.
+    void loadIndex();
+
+    bool save() const;
+
+    QString m_folder;
+
+    qint64 m_maxSize;
+
+    QHash<QString, Entry> m_entries;
+
+    qint64 m_size;
+
+    QTimer *m_saveTimer;
+
+    bool m_dirty;
+
+    unsigned long long m_hits;
+
+    unsigned long long m_misses;
+
+    unsigned long long m_evictions;
+};
+
+#endif // VRENDERRESULTCACHE_H
@@ -0,0 +1,222 @@
+#include "vrenderscheduler.h"
+
+#include <QDebug>
+#include <QThread>
+#include <QTimer>
+
+VRenderScheduler::VRenderScheduler(QObject *p_parent)
+    : QObject(p_parent),
+      m_nrJobs(0),
+      m_nrCoalesced(0),
+      m_nrKilled(0),
+      m_maxQueueDepth(0)
+{
+    m_maxRunning = QThread::idealThreadCount();
+    if (m_maxRunning < 1) {
+        m_maxRunning = 1;
+    }
+}
+
+VRenderScheduler::~VRenderScheduler()
+{
+    qInfo() << "render scheduler" << statistics();
+
+    m_queue.clear();
+
+    const QList<QProcess *> processes = m_running.keys();
+    for (auto process : processes) {
+        killProcess(process);
+    }
+}
+
+void VRenderScheduler::schedule(const QObject *p_owner,
+                                int p_id,
+                                TimeStamp p_timeStamp,
+                                const QString &p_format,
+                                const QString &p_program,
+                                const QStringList &p_args,
+                                const QByteArray &p_input)
+{
+    Job job;
+    job.m_owner = p_owner;
+    job.m_id = p_id;
+    job.m_timeStamp = p_timeStamp;
+    job.m_format = p_format;
+    job.m_program = p_program;
+    job.m_args = p_args;
+    job.m_input = p_input;
+    enqueue(job);
+}
+
+void VRenderScheduler::scheduleCommand(const QObject *p_owner,
+                                       int p_id,
+                                       TimeStamp p_timeStamp,
+                                       const QString &p_format,
+                                       const QString &p_command,
+                                       const QByteArray &p_input)
+{
+    Job job;
+    job.m_owner = p_owner;
+    job.m_id = p_id;
+    job.m_timeStamp = p_timeStamp;
+    job.m_format = p_format;
+    job.m_command = p_command;
+    job.m_input = p_input;
+    enqueue(job);
+}
+
+void VRenderScheduler::enqueue(const Job &p_job)
+{
+    ++m_nrJobs;
+
+    for (auto it = m_queue.begin(); it != m_queue.end();) {
+        if (it->isObsoletedBy(p_job)) {
+            it = m_queue.erase(it);
+            ++m_nrCoalesced;
+        } else {
+            ++it;
+        }
+    }
+
+    QList<QProcess *> obsoleteProcesses;
+    for (auto it = m_running.constBegin(); it != m_running.constEnd(); ++it) {
+        if (it.value().isObsoletedBy(p_job)) {
+            obsoleteProcesses.append(it.key());
+        }
+    }
+
+    for (auto process : obsoleteProcesses) {
+        killProcess(process);
+        ++m_nrKilled;
+    }
+
+    m_queue.append(p_job);
+    if (m_queue.size() > m_maxQueueDepth) {
+        m_maxQueueDepth = m_queue.size();
+    }
+
+    dispatch();
+}
+
+void VRenderScheduler::cancelAll(const QObject *p_owner)
+{
+    for (auto it = m_queue.begin(); it != m_queue.end();) {
+        if (it->m_owner == p_owner) {
+            it = m_queue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    QList<QProcess *> processes;
+    for (auto it = m_running.constBegin(); it != m_running.constEnd(); ++it) {
+        if (it.value().m_owner == p_owner) {
+            processes.append(it.key());
+        }
+    }
+
+    for (auto process : processes) {
+        killProcess(process);
+    }
+
+    dispatch();
+}
+
+void VRenderScheduler::dispatch()
+{
+    while (m_running.size() < m_maxRunning && !m_queue.isEmpty()) {
+        Job job = m_queue.takeFirst();
+
+        QProcess *process = new QProcess(this);
+        connect(process, SIGNAL(finished(int, QProcess::ExitStatus)),
+                this, SLOT(handleProcessFinished(int, QProcess::ExitStatus)));
+        connect(process, &QProcess::errorOccurred,
+                this, &VRenderScheduler::handleProcessError);
+
+        if (job.m_command.isEmpty()) {
+            qDebug() << job.m_program << job.m_args;
+            process->start(job.m_program, job.m_args);
+        } else {
+            qDebug() << job.m_command;
+            process->start(job.m_command);
+        }
+
+        if (process->write(job.m_input) == -1) {
+            qWarning() << "fail to write to QProcess:" << process->errorString();
+        }
+
+        process->closeWriteChannel();
+
+        job.m_input.clear();
+        m_running.insert(process, job);
+    }
+}
+
+void VRenderScheduler::killProcess(QProcess *p_process)
+{
+    m_running.remove(p_process);
+
+    p_process->disconnect(this);
+    p_process->kill();
+
+    // It may be called within the signals of the process.
+    p_process->deleteLater();
+}
+
+void VRenderScheduler::handleProcessError(QProcess::ProcessError p_error)
+{
+    // finished() will not be emitted if it fails to start.
+    // Handle it later since it may be emitted within start().
+    if (p_error == QProcess::FailedToStart) {
+        QProcess *process = static_cast<QProcess *>(sender());
+        QTimer::singleShot(0, process, [this, process]() {
+            handleProcessExited(process, -1, QProcess::CrashExit);
+        });
+    }
+}
+
+void VRenderScheduler::handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus)
+{
+    handleProcessExited(static_cast<QProcess *>(sender()), p_exitCode, p_exitStatus);
+}
+
+void VRenderScheduler::handleProcessExited(QProcess *p_process,
+                                           int p_exitCode,
+                                           QProcess::ExitStatus p_exitStatus)
+{
+    auto it = m_running.find(p_process);
+    if (it == m_running.end()) {
+        return;
+    }
+
+    Job job = it.value();
+    m_running.erase(it);
+
+    QByteArray out = p_process->readAllStandardOutput();
+    QByteArray err = p_process->readAllStandardError();
+    p_process->deleteLater();
+
+    // Start the next one before handling the result.
+    dispatch();
+
+    emit jobFinished(job.m_owner,
+                     job.m_id,
+                     job.m_timeStamp,
+                     job.m_format,
+                     p_exitCode,
+                     p_exitStatus,
+                     out,
+                     err);
+}
+
+QString VRenderScheduler::statistics() const
+{
+    return QString("running %1/%2 queued %3 max queued %4 jobs %5 coalesced %6 killed %7")
+                  .arg(m_running.size())
+                  .arg(m_maxRunning)
+                  .arg(m_queue.size())
+                  .arg(m_maxQueueDepth)
+                  .arg(m_nrJobs)
+                  .arg(m_nrCoalesced)
+                  .arg(m_nrKilled);
+}
@@ -0,0 +1,126 @@
+#ifndef VRENDERSCHEDULER_H
+#define VRENDERSCHEDULER_H
+
+#include <QObject>
+#include <QList>
+#include <QHash>
+#include <QStringList>
+#include <QByteArray>
+#include <QProcess>
+
+#include "vconstants.h"
+
+// Bounded queue of external render processes, such as dot and PlantUML,
+// shared by all the helpers.
+// At most idealThreadCount() processes run at the same time. A new job
+// replaces the queued and running jobs of the same owner and id, and those of
+// the same owner with an older timestamp, since their results will be dropped.
+class VRenderScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VRenderScheduler(QObject *p_parent = nullptr);
+
+    ~VRenderScheduler();
+
+    // Run @p_program with @p_args and write @p_input to its stdin.
+    // jobFinished() will be emitted with @p_owner.
+    void schedule(const QObject *p_owner,
+                  int p_id,
+                  TimeStamp p_timeStamp,
+                  const QString &p_format,
+                  const QString &p_program,
+                  const QStringList &p_args,
+                  const QByteArray &p_input);
+
+    // Run command line @p_command.
+    void scheduleCommand(const QObject *p_owner,
+                         int p_id,
+                         TimeStamp p_timeStamp,
+                         const QString &p_format,
+                         const QString &p_command,
+                         const QByteArray &p_input);
+
+    // Drop all the jobs of @p_owner.
+    void cancelAll(const QObject *p_owner);
+
+    // Queue depth and usage for the log.
+    QString statistics() const;
+
+signals:
+    void jobFinished(const QObject *p_owner,
+                     int p_id,
+                     TimeStamp p_timeStamp,
+                     const QString &p_format,
+                     int p_exitCode,
+                     QProcess::ExitStatus p_exitStatus,
+                     const QByteArray &p_out,
+                     const QByteArray &p_err);
+
+private slots:
+    void handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus);
+
+    void handleProcessError(QProcess::ProcessError p_error);
+
+private:
+    struct Job
+    {
+        Job()
+            : m_owner(NULL),
+              m_id(0),
+              m_timeStamp(0)
+        {
+        }
+
+        // Whether this job is obsoleted by @p_job.
+        bool isObsoletedBy(const Job &p_job) const
+        {
+            return m_owner == p_job.m_owner
+                   && (m_id == p_job.m_id || m_timeStamp < p_job.m_timeStamp);
+        }
+
+        const QObject *m_owner;
+
+        int m_id;
+
+        TimeStamp m_timeStamp;
+
+        QString m_format;
+
+        QString m_program;
+
+        QStringList m_args;
+
+        // When not empty, @m_program and @m_args will be ignored.
+        QString m_command;
+
+        QByteArray m_input;
+    };
+
+    void enqueue(const Job &p_job);
+
+    // Start queued jobs within the limit.
+    void dispatch();
+
+    void killProcess(QProcess *p_process);
+
+    void handleProcessExited(QProcess *p_process,
+                             int p_exitCode,
+                             QProcess::ExitStatus p_exitStatus);
+
+    int m_maxRunning;
+
+    QList<Job> m_queue;
+
+    QHash<QProcess *, Job> m_running;
+
+    unsigned long long m_nrJobs;
+
+    unsigned long long m_nrCoalesced;
+
+    unsigned long long m_nrKilled;
+
+    int m_maxQueueDepth;
+};
+
+#endif // VRENDERSCHEDULER_H
@@ -1,16 +1,25 @@
 #include "vtextblockdata.h"
 
+#include "utils/vutils.h"
+
 VTextBlockData::VTextBlockData()
     : QTextBlockUserData(),
       m_timeStamp(0),
       m_codeBlockTimeStamp(0),
       m_cacheValid(false),
-      m_codeBlockIndentation(-1)
+      m_codeBlockIndentation(-1),
+      m_wordCount(0),
+      m_charWithoutSpacesCount(0)
 {
 }
 
 VTextBlockData::~VTextBlockData()
 {
+    if (m_wordCountTotal) {
+        m_wordCountTotal->m_wordCount -= m_wordCount;
+        m_wordCountTotal->m_charWithoutSpacesCount -= m_charWithoutSpacesCount;
+    }
+
     for (auto it : m_previews) {
         delete it;
     }
@@ -99,3 +108,20 @@ bool VTextBlockData::clearObsoletePreview(long long p_timeStamp, PreviewSource p
 
     return deleted;
 }
+
+void VTextBlockData::updateWordCount(const QString &p_text,
+                                     const QSharedPointer<VWordCountInfo> &p_total)
+{
+    if (m_wordCountTotal) {
+        m_wordCountTotal->m_wordCount -= m_wordCount;
+        m_wordCountTotal->m_charWithoutSpacesCount -= m_charWithoutSpacesCount;
+    }
+
+    VUtils::countWords(p_text, m_wordCount, m_charWithoutSpacesCount);
+
+    m_wordCountTotal = p_total;
+    if (m_wordCountTotal) {
+        m_wordCountTotal->m_wordCount += m_wordCount;
+        m_wordCountTotal->m_charWithoutSpacesCount += m_charWithoutSpacesCount;
+    }
+}
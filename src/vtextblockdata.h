@@ -3,11 +3,13 @@
 
 #include <QTextBlockUserData>
 #include <QVector>
+#include <QSharedPointer>
 #include <QDebug>
 
 #include "vconstants.h"
 #include "markdownhighlighterdata.h"
 #include "vtextdocumentlayoutdata.h"
+#include "vwordcountinfo.h"
 
 // Sources of the preview.
 enum class PreviewSource
@@ -197,6 +199,11 @@ public:
 
     void setCacheValid(bool p_valid);
 
+    // Count words of this block with @p_text and apply the difference to
+    // @p_total, which will also be updated when this block is deleted.
+    void updateWordCount(const QString &p_text,
+                         const QSharedPointer<VWordCountInfo> &p_total);
+
     static VTextBlockData *blockData(const QTextBlock &p_block);
 
     static BlockLayoutInfo *layoutInfo(const QTextBlock &p_block);
@@ -228,6 +235,15 @@ private:
     int m_codeBlockIndentation;
 
     BlockLayoutInfo m_layoutInfo;
+
+    // Word count of this block.
+    int m_wordCount;
+
+    // Char without spaces count of this block.
+    int m_charWithoutSpacesCount;
+
+    // Word count of the whole document this block counted into.
+    QSharedPointer<VWordCountInfo> m_wordCountTotal;
 };
 
 inline const QVector<VPreviewInfo *> &VTextBlockData::getPreviews() const
@@ -8,6 +8,9 @@
 #include <QFontMetrics>
 #include <QFont>
 #include <QPainter>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QtMath>
 
 #include "vimageresourcemanager2.h"
 #include "vtextedit.h"
@@ -16,6 +19,13 @@
 #define MARKER_THICKNESS        2
 #define MAX_INLINE_IMAGE_HEIGHT 400
 
+// Changes involving more blocks than this will be layouted lazily in lazy
+// layout mode.
+#define LAZY_LAYOUT_BLOCK_THRESHOLD 100
+
+// Time slice (ms) of background relayout in one event loop iteration.
+#define RELAYOUT_TIME_SLICE 8
+
 inline static bool realEqual(qreal p_a, qreal p_b)
 {
     return qAbs(p_a - p_b) < 1e-8;
@@ -42,8 +52,24 @@ VTextDocumentLayout::VTextDocumentLayout(QTextDocument *p_doc,
       m_highlightCursorLineBlock(false),
       m_cursorLineBlockBg("#C0C0C0"),
       m_cursorLineBlockNumber(-1),
-      m_extraBufferHeight(0)
+      m_extraBufferHeight(0),
+      m_lazyLayout(false),
+      m_estimatedLineHeight(0),
+      m_estimatedCharWidth(0),
+      m_layoutGeneration(0),
+      m_relayoutNext(-1)
 {
+    m_correctionTimer = new QTimer(this);
+    m_correctionTimer->setSingleShot(true);
+    m_correctionTimer->setInterval(0);
+    connect(m_correctionTimer, &QTimer::timeout,
+            this, &VTextDocumentLayout::flushHeightCorrections);
+
+    m_relayoutTimer = new QTimer(this);
+    m_relayoutTimer->setSingleShot(true);
+    m_relayoutTimer->setInterval(0);
+    connect(m_relayoutTimer, &QTimer::timeout,
+            this, &VTextDocumentLayout::relayoutInBackground);
 }
 
 static void fillBackground(QPainter *p_painter,
@@ -69,52 +95,6 @@ static void fillBackground(QPainter *p_painter,
     p_painter->restore();
 }
 
-void VTextDocumentLayout::blockRangeFromRect(const QRectF &p_rect,
-                                             int &p_first,
-                                             int &p_last) const
-{
-    if (p_rect.isNull()) {
-        p_first = 0;
-        p_last = document()->blockCount() - 1;
-        return;
-    }
-
-    p_first = -1;
-    p_last = document()->blockCount() - 1;
-    int y = p_rect.y();
-    QTextBlock block = document()->firstBlock();
-    while (block.isValid()) {
-        const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
-        V_ASSERT(info->hasOffset());
-
-        if (info->top() == y
-            || (info->top() < y && info->bottom() >= y)) {
-            p_first = block.blockNumber();
-            break;
-        }
-
-        block = block.next();
-    }
-
-    if (p_first == -1) {
-        p_last = -1;
-        return;
-    }
-
-    y += p_rect.height();
-    while (block.isValid()) {
-        const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
-        V_ASSERT(info->hasOffset());
-
-        if (info->bottom() > y) {
-            p_last = block.blockNumber();
-            break;
-        }
-
-        block = block.next();
-    }
-}
-
 void VTextDocumentLayout::blockRangeFromRectBS(const QRectF &p_rect,
                                                int &p_first,
                                                int &p_last) const
@@ -131,64 +111,19 @@ void VTextDocumentLayout::blockRangeFromRectBS(const QRectF &p_rect,
         return;
     }
 
-    int y = p_rect.bottom();
-    QTextBlock block = document()->findBlockByNumber(p_first);
-    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
-    if (realEqual(info->top(), p_rect.top()) && p_first > 0) {
+    if (realEqual(blockTop(p_first), p_rect.top()) && p_first > 0) {
         --p_first;
     }
 
-    p_last = document()->blockCount() - 1;
-    while (block.isValid()) {
-        const BlockLayoutInfo *tinfo = VTextBlockData::layoutInfo(block);
-        if (!tinfo->hasOffset()) {
-            qWarning() << "block without offset"
-                       << block.blockNumber() << tinfo->m_offset
-                       << tinfo->m_rect << tinfo->m_rect.isNull();
-        }
-
-        V_ASSERT(tinfo->hasOffset());
-
-        if (tinfo->bottom() > y) {
-            p_last = block.blockNumber();
-            break;
-        }
-
-        block = block.next();
-    }
+    p_last = findBlockByPosition(QPointF(p_rect.left(), p_rect.bottom()));
 }
 
 int VTextDocumentLayout::findBlockByPosition(const QPointF &p_point) const
 {
-    QTextDocument *doc = document();
-    int first = 0, last = doc->blockCount() - 1;
-    int y = p_point.y();
-    while (first <= last) {
-        int mid = (first + last) / 2;
-        QTextBlock blk = doc->findBlockByNumber(mid);
-        const BlockLayoutInfo *info = VTextBlockData::layoutInfo(blk);
-        if (!info) {
-            return -1;
-        }
+    const_cast<VTextDocumentLayout *>(this)->ensureBlockHeights();
 
-        V_ASSERT(info->hasOffset());
-        if (info->top() <= y && info->bottom() > y) {
-            // Found it.
-            return mid;
-        } else if (info->top() > y) {
-            last = mid - 1;
-        } else {
-            first = mid + 1;
-        }
-    }
-
-    QTextBlock blk = doc->lastBlock();
-    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(blk);
-    if (y >= info->bottom()) {
-        return blk.blockNumber();
-    }
-
-    return 0;
+    int y = p_point.y();
+    return m_blockHeights.find(y);
 }
 
 void VTextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_context)
@@ -200,9 +135,15 @@ void VTextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_contex
         return;
     }
 
+    // Layout blocks without layout or with stale layout first.
+    // Real heights may differ from the old ones and then change the block range.
+    while (layoutPendingBlocks(first, last)) {
+        blockRangeFromRectBS(p_context.clip, first, last);
+    }
+
     QTextDocument *doc = document();
     QTextBlock block = doc->findBlockByNumber(first);
-    QPointF offset(m_margin, VTextBlockData::layoutInfo(block)->top());
+    QPointF offset(m_margin, blockTop(first));
     QTextBlock lastBlock = doc->findBlockByNumber(last);
 
     QPen oldPen = p_painter->pen();
@@ -210,7 +151,7 @@ void VTextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_contex
 
     while (block.isValid()) {
         const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
-        V_ASSERT(info->hasOffset());
+        V_ASSERT(!info->isNull());
 
         const QRectF &rect = info->m_rect;
         QTextLayout *layout = block.layout();
@@ -401,9 +342,13 @@ int VTextDocumentLayout::hitTest(const QPointF &p_point, Qt::HitTestAccuracy p_a
 
     QTextBlock block = document()->findBlockByNumber(bn);
     V_ASSERT(block.isValid());
+    if (isPendingBlock(block)) {
+        const_cast<VTextDocumentLayout *>(this)->layoutPendingBlock(block);
+    }
+
     QTextLayout *layout = block.layout();
     int off = 0;
-    QPointF pos = p_point - QPointF(m_margin, VTextBlockData::layoutInfo(block)->top());
+    QPointF pos = p_point - QPointF(m_margin, blockTop(bn));
     for (int i = 0; i < layout->lineCount(); ++i) {
         QTextLine line = layout->lineAt(i);
         const QRectF lr = line.naturalTextRect();
@@ -425,6 +370,7 @@ int VTextDocumentLayout::pageCount() const
     return 1;
 }
 
+// O(1). m_height is updated along with m_blockHeights.
 QSizeF VTextDocumentLayout::documentSize() const
 {
     return QSizeF(m_width, m_height + m_extraBufferHeight);
@@ -445,15 +391,15 @@ QRectF VTextDocumentLayout::blockBoundingRect(const QTextBlock &p_block) const
     }
 
     const BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
-    if (!info->hasOffset()) {
-        if (info->isNull()) {
-            const_cast<VTextDocumentLayout *>(this)->layoutBlockAndUpdateOffset(p_block);
-        } else {
-            const_cast<VTextDocumentLayout *>(this)->updateOffset(p_block);
-        }
+    VTextDocumentLayout *layout = const_cast<VTextDocumentLayout *>(this);
+    if (isPendingBlock(p_block)) {
+        layout->layoutPendingBlock(p_block);
     }
 
-    QRectF geo = info->m_rect.adjusted(0, info->m_offset, 0, info->m_offset);
+    layout->ensureBlockHeights();
+
+    qreal offset = blockTop(p_block.blockNumber());
+    QRectF geo = info->m_rect.adjusted(0, offset, 0, offset);
     return geo;
 }
 
@@ -495,7 +441,7 @@ void VTextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_
             needRelayout = false;
             QRectF oldBr = blockBoundingRect(block);
             clearBlockLayout(block);
-            layoutBlockAndUpdateOffset(block);
+            layoutBlock(block);
             QRectF newBr = blockBoundingRect(block);
             // Only one block is affected.
             if (newBr.height() == oldBr.height()) {
@@ -508,32 +454,104 @@ void VTextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_
         }
     }
 
+    if (needRelayout
+        && p_from == 0
+        && p_charsRemoved == 0
+        && p_charsAdded == doc->characterCount()
+        && newBlockCount == m_blockCount
+        && m_blockHeights.size() == m_blockCount) {
+        // Page size or default font is changed while the text is not.
+        relayout();
+        return;
+    }
+
+    // Blocks may be inserted or removed before it.
+    if (m_relayoutNext > changeStartBlock.blockNumber()) {
+        m_relayoutNext = changeStartBlock.blockNumber();
+    }
+
+    // Whether m_blockHeights still holds the heights of the blocks before
+    // this change.
+    bool heightsOutdated = m_blockHeights.size() == m_blockCount
+                           && newBlockCount != m_blockCount;
+    bool fullSizeCheck = !heightsOutdated && newBlockCount != m_blockCount;
+
+    // Leave the layout of changed blocks to draw() if there are too many.
+    bool lazy = false;
+    if (needRelayout && m_lazyLayout) {
+        int lastNumber = changeEndBlock.isValid() ? changeEndBlock.blockNumber()
+                                                  : newBlockCount - 1;
+        lazy = lastNumber - changeStartBlock.blockNumber() + 1 > LAZY_LAYOUT_BLOCK_THRESHOLD;
+        if (lazy) {
+            updateEstimationMetrics();
+        }
+    }
+
+    QVector<QTextBlock> changedBlocks;
     if (needRelayout) {
         QTextBlock block = changeStartBlock;
         do {
             clearBlockLayout(block);
-            layoutBlock(block);
+            if (!lazy) {
+                layoutBlock(block);
+            }
+
+            changedBlocks.append(block);
             if (block == changeEndBlock) {
                 break;
             }
 
             block = block.next();
         } while(block.isValid());
+    } else {
+        changedBlocks.append(changeStartBlock);
+    }
+
+    if (heightsOutdated) {
+        // Blocks are inserted or removed. Replace the heights of the changed
+        // blocks and shift the following ones.
+        int firstNumber = changeStartBlock.blockNumber();
+        int delta = newBlockCount - m_blockCount;
+        int removed = changedBlocks.size() - delta;
+        if (removed < 0 || firstNumber + removed > m_blockHeights.size()) {
+            // Should not happen. Rebuild it anyway.
+            m_blockHeights.reset(QVector<qreal>());
+            ensureBlockHeights();
+            fullSizeCheck = true;
+        } else {
+            QVector<qreal> heights;
+            heights.reserve(changedBlocks.size());
+            for (auto const &blk : changedBlocks) {
+                const BlockLayoutInfo *info = VTextBlockData::layoutInfo(blk);
+                heights.append(info->isNull() ? estimateBlockHeight(blk)
+                                              : info->m_rect.height());
+            }
 
-        updateOffset(changeStartBlock);
+            m_blockHeights.replace(firstNumber, removed, heights);
+
+            if (m_maximumWidthBlockNumber >= firstNumber + removed) {
+                m_maximumWidthBlockNumber += delta;
+            } else if (m_maximumWidthBlockNumber >= firstNumber) {
+                // The widest block is changed.
+                fullSizeCheck = true;
+            }
+        }
     }
 
     m_blockCount = newBlockCount;
 
-    updateDocumentSize();
+    if (fullSizeCheck) {
+        updateDocumentSize();
+    } else {
+        updateDocumentSizeWithBlocksChanged(changedBlocks);
+    }
 
     // TODO: Update the view of all the blocks after changeStartBlock.
-    qreal offset = VTextBlockData::layoutInfo(changeStartBlock)->m_offset;
+    qreal offset = blockTop(changeStartBlock.blockNumber());
     emit update(QRectF(0., offset, 1000000000., 1000000000.));
 }
 
 // MUST layout out the block after clearBlockLayout().
-// TODO: Do we need to clear all the offset after @p_block?
 void VTextDocumentLayout::clearBlockLayout(QTextBlock &p_block)
 {
     p_block.clearLayout();
@@ -609,73 +627,211 @@ void VTextDocumentLayout::layoutBlock(const QTextBlock &p_block)
 
     // Update the info about this block.
     finishBlockLayout(p_block, markers, images);
+
+    updateBlockHeight(p_block);
 }
 
-void VTextDocumentLayout::updateOffsetBefore(const QTextBlock &p_block)
+void VTextDocumentLayout::updateBlockHeight(const QTextBlock &p_block)
 {
-    BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
-    V_ASSERT(!info->isNull());
+    int num = p_block.blockNumber();
+    if (m_blockHeights.size() != document()->blockCount()
+        || num < 0
+        || num >= m_blockHeights.size()) {
+        // Will be handled in documentChanged() or ensureBlockHeights().
+        return;
+    }
 
-    const int blockNum = p_block.blockNumber();
-    if (blockNum == 0) {
-        info->m_offset = 0;
-    } else {
-        QTextBlock blk = p_block.previous();
-        while (blk.isValid()) {
-            BlockLayoutInfo *pinfo = VTextBlockData::layoutInfo(blk);
-            if (!pinfo->hasOffset()) {
-                int num = blk.blockNumber();
-                if (pinfo->isNull()) {
-                    layoutBlock(blk);
-                }
+    m_blockHeights.setHeight(num, VTextBlockData::layoutInfo(p_block)->m_rect.height());
+}
 
-                if (num == 0) {
-                    pinfo->m_offset = 0;
-                } else {
-                    blk = blk.previous();
-                    continue;
-                }
-            }
+void VTextDocumentLayout::ensureBlockHeights()
+{
+    QTextDocument *doc = document();
+    if (m_blockHeights.size() == doc->blockCount()) {
+        return;
+    }
 
-            // Now we reach a block with offset.
-            qreal offset = pinfo->bottom();
-            blk = blk.next();
-            while (blk.isValid() && blk.blockNumber() <= blockNum) {
-                BlockLayoutInfo *ninfo = VTextBlockData::layoutInfo(blk);
-                V_ASSERT(!ninfo->isNull());
-                ninfo->m_offset = offset;
-                offset = ninfo->bottom();
-                blk = blk.next();
-            }
+    if (m_lazyLayout) {
+        updateEstimationMetrics();
+    }
 
-            break;
+    QVector<qreal> heights;
+    heights.reserve(doc->blockCount());
+    QTextBlock block = doc->firstBlock();
+    while (block.isValid()) {
+        const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
+        if (!info->isNull()) {
+            heights.append(info->m_rect.height());
+        } else if (m_lazyLayout) {
+            heights.append(estimateBlockHeight(block));
+        } else {
+            layoutBlock(block);
+            heights.append(info->m_rect.height());
         }
 
-        V_ASSERT(info->hasOffset());
+        block = block.next();
     }
+
+    m_blockHeights.reset(heights);
 }
 
-// NOTICE: It will skip non-layouted or offset-non-changed blocks.
-// So if you relayout separated blocks, you need to updateOffsetAfter() for each of them.
-void VTextDocumentLayout::updateOffsetAfter(const QTextBlock &p_block)
+bool VTextDocumentLayout::isPendingBlock(const QTextBlock &p_block) const
 {
-    BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
-    V_ASSERT(info->hasOffset());
-    qreal offset = info->bottom();
-    QTextBlock blk = p_block.next();
-    while (blk.isValid()) {
-        BlockLayoutInfo *ninfo = VTextBlockData::layoutInfo(blk);
-        if (ninfo->isNull()) {
-            break;
+    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
+    return info->isNull() || info->m_generation != m_layoutGeneration;
+}
+
+void VTextDocumentLayout::layoutPendingBlock(const QTextBlock &p_block)
+{
+    int num = p_block.blockNumber();
+    bool inSync = m_blockHeights.size() == document()->blockCount();
+    qreal top = 0, oldHeight = 0;
+    if (inSync) {
+        top = blockTop(num);
+        oldHeight = m_blockHeights.height(num);
+    }
+
+    if (!VTextBlockData::layoutInfo(p_block)->isNull()) {
+        QTextBlock block(p_block);
+        clearBlockLayout(block);
+    }
+
+    layoutBlock(p_block);
+
+    if (!inSync) {
+        // Document size will be updated later.
+        return;
+    }
+
+    const QRectF &rect = VTextBlockData::layoutInfo(p_block)->m_rect;
+    bool changed = false;
+    if (rect.width() > m_width) {
+        m_width = rect.width();
+        m_maximumWidthBlockNumber = num;
+        changed = true;
+    }
+
+    qreal delta = rect.height() - oldHeight;
+    if (!realEqual(delta, 0)) {
+        m_heightCorrections.append(qMakePair(top, delta));
+        changed = true;
+    }
+
+    if (changed) {
+        m_correctionTimer->start();
+    }
+}
+
+bool VTextDocumentLayout::layoutPendingBlocks(int p_first, int p_last)
+{
+    bool layouted = false;
+    QTextBlock block = document()->findBlockByNumber(p_first);
+    while (block.isValid() && block.blockNumber() <= p_last) {
+        if (isPendingBlock(block)) {
+            layoutPendingBlock(block);
+            layouted = true;
         }
 
-        if (realEqual(ninfo->m_offset, offset)) {
-            break;
+        block = block.next();
+    }
+
+    return layouted;
+}
+
+void VTextDocumentLayout::relayoutInBackground()
+{
+    if (m_relayoutNext < 0) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QTextBlock block = document()->findBlockByNumber(m_relayoutNext);
+    while (block.isValid()) {
+        if (isPendingBlock(block)) {
+            layoutPendingBlock(block);
+
+            if (timer.elapsed() >= RELAYOUT_TIME_SLICE) {
+                block = block.next();
+                break;
+            }
         }
 
-        ninfo->m_offset = offset;
-        offset = ninfo->bottom();
-        blk = blk.next();
+        block = block.next();
+    }
+
+    if (block.isValid()) {
+        m_relayoutNext = block.blockNumber();
+        m_relayoutTimer->start();
+    } else {
+        // Done. Widths of blocks may shrink.
+        m_relayoutNext = -1;
+        updateDocumentSize();
+    }
+}
+
+void VTextDocumentLayout::updateEstimationMetrics()
+{
+    QFontMetricsF fm(document()->defaultFont());
+    m_estimatedLineHeight = fm.height();
+    m_estimatedCharWidth = fm.averageCharWidth();
+}
+
+qreal VTextDocumentLayout::estimateBlockHeight(const QTextBlock &p_block) const
+{
+    qreal availableWidth = document()->pageSize().width();
+    if (availableWidth <= 0) {
+        availableWidth = qreal(INT_MAX);
+    }
+
+    availableWidth -= (2 * m_margin + m_cursorMargin + m_cursorWidth);
+
+    // Exclude the paragraph separator.
+    int len = p_block.length() - 1;
+    int lines = 1;
+    if (len > 0 && availableWidth > 0) {
+        lines = qMax(1, qCeil(len * m_estimatedCharWidth / availableWidth));
+    }
+
+    qreal height = lines * (m_estimatedLineHeight + m_lineLeading);
+
+    // Add bottom margin.
+    if (!p_block.next().isValid()) {
+        height += m_margin;
+    }
+
+    return height;
+}
+
+void VTextDocumentLayout::flushHeightCorrections()
+{
+    if (m_blockHeights.size() != document()->blockCount()) {
+        // documentChanged() will update the document size.
+        m_heightCorrections.clear();
+        return;
+    }
+
+    m_height = m_blockHeights.total();
+    emit documentSizeChanged(documentSize());
+
+    if (!m_heightCorrections.isEmpty()) {
+        QVector<QPair<qreal, qreal>> corrections;
+        corrections.swap(m_heightCorrections);
+        emit blockHeightsCorrected(corrections);
+    }
+}
+
+void VTextDocumentLayout::setLazyLayoutEnabled(bool p_enabled)
+{
+    if (m_lazyLayout == p_enabled) {
+        return;
+    }
+
+    m_lazyLayout = p_enabled;
+    if (!m_lazyLayout) {
+        // Replace all the estimated heights.
+        relayout();
     }
 }
 
@@ -790,6 +946,7 @@ void VTextDocumentLayout::finishBlockLayout(const QTextBlock &p_block,
     V_ASSERT(info->isNull());
     info->reset();
     info->m_rect = blockRectFromTextLayout(p_block, &ipi);
+    info->m_generation = m_layoutGeneration;
     V_ASSERT(!info->m_rect.isNull());
 
     bool hasImage = false;
@@ -813,31 +970,27 @@ void VTextDocumentLayout::finishBlockLayout(const QTextBlock &p_block,
         mk.m_end = QPointF(-1, info->m_rect.height());
 
         info->m_markers.append(mk);
+
+        for (auto const &img : info->m_images) {
+            m_imageMgr->setImageBlock(img.m_name, p_block.blockNumber());
+        }
     }
 }
 
 void VTextDocumentLayout::updateDocumentSize()
 {
-    QTextBlock block = document()->lastBlock();
-    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
-    if (!info->hasOffset()) {
-        if (info->isNull()) {
-            layoutBlock(block);
-        }
-
-        updateOffsetBefore(block);
-    }
+    ensureBlockHeights();
 
     int oldHeight = m_height;
     int oldWidth = m_width;
 
-    m_height = info->bottom();
+    m_height = m_blockHeights.total();
 
     m_width = 0;
     QTextBlock blk = document()->firstBlock();
     while (blk.isValid()) {
         const BlockLayoutInfo *ninfo = VTextBlockData::layoutInfo(blk);
-        V_ASSERT(ninfo->hasOffset());
+        // Blocks without layout in lazy layout mode have no width yet.
         if (m_width < ninfo->m_rect.width()) {
             m_width = ninfo->m_rect.width();
             m_maximumWidthBlockNumber = blk.blockNumber();
@@ -915,15 +1068,32 @@ QRectF VTextDocumentLayout::blockRectFromTextLayout(const QTextBlock &p_block,
 
 void VTextDocumentLayout::updateDocumentSizeWithOneBlockChanged(const QTextBlock &p_block)
 {
-    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
-    qreal width = info->m_rect.width();
-    if (width > m_width) {
-        m_width = width;
-        m_maximumWidthBlockNumber = p_block.blockNumber();
+    updateDocumentSizeWithBlocksChanged(QVector<QTextBlock>() << p_block);
+}
+
+void VTextDocumentLayout::updateDocumentSizeWithBlocksChanged(const QVector<QTextBlock> &p_blocks)
+{
+    int oldHeight = m_height;
+    int oldWidth = m_width;
+
+    for (auto const &blk : p_blocks) {
+        qreal width = VTextBlockData::layoutInfo(blk)->m_rect.width();
+        if (width > m_width) {
+            m_width = width;
+            m_maximumWidthBlockNumber = blk.blockNumber();
+        } else if (width < m_width && blk.blockNumber() == m_maximumWidthBlockNumber) {
+            // Shrink the longest block.
+            updateDocumentSize();
+            return;
+        }
+    }
+
+    ensureBlockHeights();
+    m_height = m_blockHeights.total();
+
+    if (oldHeight != m_height
+        || oldWidth != m_width) {
         emit documentSizeChanged(documentSize());
-    } else if (width < m_width && p_block.blockNumber() == m_maximumWidthBlockNumber) {
-        // Shrink the longest block.
-        updateDocumentSize();
     }
 }
 
@@ -991,6 +1161,9 @@ void VTextDocumentLayout::drawImages(QPainter *p_painter,
     }
 
     for (auto const & img : images) {
+        // Block numbers may be shifted since layouted.
+        m_imageMgr->setImageBlock(img.m_name, p_block.blockNumber());
+
         const QPixmap *image = m_imageMgr->findImage(img.m_name);
         if (!image) {
             continue;
@@ -1039,18 +1212,20 @@ void VTextDocumentLayout::relayout()
     // Update the margin.
     m_margin = doc->documentMargin();
 
-    QTextBlock block = doc->firstBlock();
-    while (block.isValid()) {
-        clearBlockLayout(block);
-        layoutBlock(block);
+    // Make all the layouts stale. Current heights are kept until the blocks are
+    // relayouted, which keeps the view around current position.
+    ++m_layoutGeneration;
 
-        block = block.next();
+    if (m_lazyLayout) {
+        // Stale blocks will be relayouted when they are painted or queried.
+        m_relayoutNext = -1;
+        m_relayoutTimer->stop();
+    } else {
+        // Supersede the one in progress.
+        m_relayoutNext = 0;
+        m_relayoutTimer->start();
     }
 
-    updateOffset(doc->firstBlock());
-
-    updateDocumentSize();
-
     emit update(QRectF(0., 0., 1000000000., 1000000000.));
 }
 
@@ -1062,7 +1237,6 @@ void VTextDocumentLayout::relayout(const OrderedIntSet &p_blocks)
 
     QTextDocument *doc = document();
 
-    // Need to relayout and update blocks in ascending order.
     QVector<QTextBlock> blocks;
     blocks.reserve(p_blocks.size());
     for (auto bn = p_blocks.keyBegin(); bn != p_blocks.keyEnd(); ++bn) {
@@ -1078,16 +1252,9 @@ void VTextDocumentLayout::relayout(const OrderedIntSet &p_blocks)
         return;
     }
 
-    // Need to update offset for each of these discontinuous blocks, because
-    // the offset of the non-touched blocks may be the same but there are still
-    // touched blocks after them.
-    for (auto & blk : blocks) {
-        updateOffset(blk);
-    }
-
-    updateDocumentSize();
+    updateDocumentSizeWithBlocksChanged(blocks);
 
-    qreal offset = VTextBlockData::layoutInfo(blocks.first())->m_offset;
+    qreal offset = blockTop(blocks.first().blockNumber());
     emit update(QRectF(0., offset, 1000000000., 1000000000.));
 }
 
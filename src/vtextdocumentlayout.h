@@ -5,10 +5,12 @@
 #include <QVector>
 #include <QSize>
 #include <QMap>
+#include <QPair>
 
 #include "vconstants.h"
 #include "vtextdocumentlayoutdata.h"
 
+class QTimer;
 class VImageResourceManager2;
 struct VPreviewedImageInfo;
 struct VPreviewInfo;
@@ -55,6 +57,8 @@ public:
     void setBlockImageEnabled(bool p_enabled);
 
     // Relayout all the blocks.
+    // Visible blocks are relayouted when painted and the others in background
+    // time slices. A new call supersedes the one in progress.
     void relayout();
 
     // Relayout @p_blocks.
@@ -79,29 +83,59 @@ public:
 
     void setExtraBufferHeight(int p_height);
 
+    // In lazy layout mode, blocks without layout use estimated heights and
+    // are layouted only when they are painted or queried exactly.
+    void setLazyLayoutEnabled(bool p_enabled);
+
 signals:
     // Emit to update current cursor block width if m_cursorBlockMode is enabled.
     void cursorBlockWidthUpdated(int p_width);
 
+    // Emit after estimated heights are replaced by real ones.
+    // Each correction is (top of the block before correction, height delta),
+    // in the order they happen.
+    void blockHeightsCorrected(const QVector<QPair<qreal, qreal>> &p_corrections);
+
 protected:
     void documentChanged(int p_from, int p_charsRemoved, int p_charsAdded) Q_DECL_OVERRIDE;
 
 private:
     // Layout one block.
-    // Only update the rect of the block. Offset is not updated yet.
+    // Update the rect of the block and its height in m_blockHeights.
     void layoutBlock(const QTextBlock &p_block);
 
-    // Update the offset of @p_block.
-    // @p_block has a valid layout.
-    // After the call, all block before @p_block will have the correct layout and offset.
-    void updateOffsetBefore(const QTextBlock &p_block);
+    // Update the height of @p_block in m_blockHeights if it is in sync with
+    // the document.
+    void updateBlockHeight(const QTextBlock &p_block);
+
+    // Make sure m_blockHeights is in sync with the document.
+    // Otherwise, rebuild it from all the blocks, layouting those without layout.
+    void ensureBlockHeights();
+
+    // Y offset of block @p_blockNumber.
+    qreal blockTop(int p_blockNumber) const;
+
+    // Whether @p_block has no layout or a stale one.
+    bool isPendingBlock(const QTextBlock &p_block) const;
+
+    // Layout pending @p_block and record the correction of its height in
+    // m_blockHeights.
+    void layoutPendingBlock(const QTextBlock &p_block);
 
-    // Update the offset of blocks after @p_block if they are layouted.
-    void updateOffsetAfter(const QTextBlock &p_block);
+    // Layout pending blocks within [@p_first, @p_last].
+    // Returns true if any block is layouted.
+    bool layoutPendingBlocks(int p_first, int p_last);
 
-    void updateOffset(const QTextBlock &p_block);
+    // Relayout stale blocks from m_relayoutNext within one time slice.
+    void relayoutInBackground();
 
-    void layoutBlockAndUpdateOffset(const QTextBlock &p_block);
+    // Estimate the height of @p_block from its length without layouting it.
+    qreal estimateBlockHeight(const QTextBlock &p_block) const;
+
+    void updateEstimationMetrics();
+
+    // Update document size and emit the pending height corrections.
+    void flushHeightCorrections();
 
     // Returns the total height of this block after layouting lines and inline
     // images.
@@ -136,7 +170,6 @@ private:
                                       QVector<QPair<qreal, qreal>> &p_imageRange);
 
     // Clear the layout of @p_block.
-    // Also clear all the offset behind this block.
     void clearBlockLayout(QTextBlock &p_block);
 
     // Update rect of a block.
@@ -144,6 +177,7 @@ private:
                            const QVector<Marker> &p_markers,
                            const QVector<ImagePaintInfo> &p_images);
 
+    // Update document size by checking all the blocks.
     void updateDocumentSize();
 
     QVector<QTextLayout::FormatRange> formatRangeFromSelection(const QTextBlock &p_block,
@@ -152,9 +186,6 @@ private:
     // Get the block range [first, last] by rect @p_rect.
     // @p_rect: a clip region in document coordinates. If null, returns all the blocks.
     // Return [-1, -1] if no valid block range found.
-    void blockRangeFromRect(const QRectF &p_rect, int &p_first, int &p_last) const;
-
-    // Binary search to get the block range [first, last] by @p_rect.
     void blockRangeFromRectBS(const QRectF &p_rect, int &p_first, int &p_last) const;
 
     // Return a rect from the layout.
@@ -164,10 +195,13 @@ private:
     QRectF blockRectFromTextLayout(const QTextBlock &p_block,
                                    ImagePaintInfo *p_image = NULL);
 
-    // Update document size when only @p_block is changed and the height
-    // remains the same.
+    // Update document size when only @p_block is changed.
     void updateDocumentSizeWithOneBlockChanged(const QTextBlock &p_block);
 
+    // Update document size when only @p_blocks are changed.
+    // The width of other blocks is checked only if the widest block shrinks.
+    void updateDocumentSizeWithBlocksChanged(const QVector<QTextBlock> &p_blocks);
+
     void adjustImagePaddingAndSize(const VPreviewedImageInfo *p_info,
                                    int p_maximumWidth,
                                    int &p_padding,
@@ -207,6 +241,9 @@ private:
     // Block count of the document.
     int m_blockCount;
 
+    // Heights of all the blocks to get the offset of blocks.
+    BlockHeightTree m_blockHeights;
+
     // Width of the cursor.
     int m_cursorWidth;
 
@@ -242,6 +279,27 @@ private:
 
     // Extra buffer height in document size.
     int m_extraBufferHeight;
+
+    bool m_lazyLayout;
+
+    // Line height and character width of the default font for estimation.
+    qreal m_estimatedLineHeight;
+
+    qreal m_estimatedCharWidth;
+
+    // Pending corrections of estimated heights.
+    QVector<QPair<qreal, qreal>> m_heightCorrections;
+
+    // Timer to coalesce the corrections in one event loop.
+    QTimer *m_correctionTimer;
+
+    // Bumped by relayout() to make all current layouts stale.
+    int m_layoutGeneration;
+
+    // Next block to check in background relayout. -1 if there is none.
+    int m_relayoutNext;
+
+    QTimer *m_relayoutTimer;
 };
 
 inline qreal VTextDocumentLayout::getLineLeading() const
@@ -319,16 +377,9 @@ inline int VTextDocumentLayout::cursorWidth() const
     return m_cursorWidth;
 }
 
-inline void VTextDocumentLayout::layoutBlockAndUpdateOffset(const QTextBlock &p_block)
-{
-    layoutBlock(p_block);
-    updateOffset(p_block);
-}
-
-inline void VTextDocumentLayout::updateOffset(const QTextBlock &p_block)
+inline qreal VTextDocumentLayout::blockTop(int p_blockNumber) const
 {
-    updateOffsetBefore(p_block);
-    updateOffsetAfter(p_block);
+    return m_blockHeights.offset(p_blockNumber);
 }
 
 inline void VTextDocumentLayout::setExtraBufferHeight(int p_height)
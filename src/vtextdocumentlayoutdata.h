@@ -35,13 +35,12 @@ struct ImagePaintInfo
 struct BlockLayoutInfo
 {
     BlockLayoutInfo()
-        : m_offset(-1)
+        : m_generation(0)
     {
     }
 
     void reset()
     {
-        m_offset = -1;
         m_rect = QRectF();
         m_markers.clear();
         m_images.clear();
@@ -52,37 +51,339 @@ struct BlockLayoutInfo
         return m_rect.isNull();
     }
 
-    bool hasOffset() const
+    // The bounding rect of this block, including the margins.
+    // Y offset of this block is maintained by BlockHeightTree.
+    // Null for invalid.
+    QRectF m_rect;
+
+    // Markers to draw for this block.
+    // Y is the offset within this block.
+    QVector<Marker> m_markers;
+
+    // Images to draw for this block.
+    // Y is the offset within this block.
+    QVector<ImagePaintInfo> m_images;
+
+    // Layout generation when this block is layouted.
+    // The layout is stale if it differs from the generation of the layout.
+    int m_generation;
+};
+
+// Implicit treap of the heights of all the blocks indexed by block number.
+// Each node keeps the size and total height of its subtree, so getting or
+// updating the height of one block, getting the offset of a block and finding
+// the block at an offset are all O(log n) expected, and inserting or removing
+// k blocks is O(k + log n) expected.
+class BlockHeightTree
+{
+public:
+    BlockHeightTree()
+        : m_root(-1),
+          m_seed(0x9e3779b9)
     {
-        return m_offset > -1 && !m_rect.isNull();
     }
 
-    qreal top() const
+    int size() const
     {
-        V_ASSERT(hasOffset());
-        return m_offset;
+        return nodeSize(m_root);
     }
 
-    qreal bottom() const
+    // O(log n).
+    qreal height(int p_idx) const
     {
-        V_ASSERT(hasOffset());
-        return m_offset + m_rect.height();
+        int t = m_root;
+        while (t != -1) {
+            const Node &node = m_nodes[t];
+            int ls = nodeSize(node.m_left);
+            if (p_idx < ls) {
+                t = node.m_left;
+            } else if (p_idx == ls) {
+                return node.m_height;
+            } else {
+                p_idx -= ls + 1;
+                t = node.m_right;
+            }
+        }
+
+        Q_ASSERT(false);
+        return 0;
     }
 
-    // Y offset of this block.
-    // -1 for invalid.
-    qreal m_offset;
+    // Reset all the heights. O(n).
+    void reset(const QVector<qreal> &p_heights)
+    {
+        m_nodes.clear();
+        m_free.clear();
+        m_root = build(p_heights);
+    }
 
-    // The bounding rect of this block, including the margins.
-    // Null for invalid.
-    QRectF m_rect;
+    // Replace @p_removed heights from @p_idx with @p_heights when blocks are
+    // inserted or removed. O(k + log n), k for the number of the changed blocks.
+    void replace(int p_idx, int p_removed, const QVector<qreal> &p_heights)
+    {
+        int left = -1, mid = -1, right = -1, rest = -1;
+        split(m_root, p_idx, left, rest);
+        split(rest, p_removed, mid, right);
+        release(mid);
+        m_root = merge(merge(left, build(p_heights)), right);
+    }
 
-    // Markers to draw for this block.
-    // Y is the offset within this block.
-    QVector<Marker> m_markers;
+    // O(log n).
+    void setHeight(int p_idx, qreal p_height)
+    {
+        setHeight(m_root, p_idx, p_height);
+    }
 
-    // Images to draw for this block.
-    // Y is the offset within this block.
-    QVector<ImagePaintInfo> m_images;
+    // Sum of the heights of [0, @p_idx). O(log n).
+    qreal offset(int p_idx) const
+    {
+        qreal sum = 0;
+        int t = m_root;
+        while (t != -1 && p_idx > 0) {
+            const Node &node = m_nodes[t];
+            int ls = nodeSize(node.m_left);
+            if (p_idx <= ls) {
+                t = node.m_left;
+            } else {
+                sum += nodeSum(node.m_left) + node.m_height;
+                p_idx -= ls + 1;
+                t = node.m_right;
+            }
+        }
+
+        return sum;
+    }
+
+    qreal total() const
+    {
+        return nodeSum(m_root);
+    }
+
+    // Return the index of the item containing @p_offset, that is
+    // offset(idx) <= @p_offset < offset(idx + 1).
+    // Return the first/last one if @p_offset is out of range, or -1 if empty.
+    // O(log n).
+    int find(qreal p_offset) const
+    {
+        const int n = size();
+        if (n == 0) {
+            return -1;
+        }
+
+        int pos = 0;
+        qreal remain = p_offset;
+        int t = m_root;
+        while (t != -1) {
+            const Node &node = m_nodes[t];
+            qreal leftSum = nodeSum(node.m_left);
+            if (node.m_left != -1 && remain < leftSum) {
+                t = node.m_left;
+                continue;
+            }
+
+            remain -= leftSum;
+            if (remain < node.m_height) {
+                return pos + nodeSize(node.m_left);
+            }
+
+            remain -= node.m_height;
+            pos += nodeSize(node.m_left) + 1;
+            t = node.m_right;
+        }
+
+        return n - 1;
+    }
+
+private:
+    struct Node
+    {
+        qreal m_height;
+
+        // Sum of the heights of this subtree.
+        qreal m_sum;
+
+        // Number of nodes of this subtree.
+        int m_size;
+
+        // Parent has a higher priority than its children.
+        quint32 m_priority;
+
+        int m_left;
+
+        int m_right;
+    };
+
+    int nodeSize(int p_node) const
+    {
+        return p_node == -1 ? 0 : m_nodes[p_node].m_size;
+    }
+
+    qreal nodeSum(int p_node) const
+    {
+        return p_node == -1 ? 0 : m_nodes[p_node].m_sum;
+    }
+
+    void pull(int p_node)
+    {
+        Node &node = m_nodes[p_node];
+        node.m_size = 1 + nodeSize(node.m_left) + nodeSize(node.m_right);
+        node.m_sum = node.m_height + nodeSum(node.m_left) + nodeSum(node.m_right);
+    }
+
+    // Xorshift, which is enough to balance the tree.
+    quint32 nextPriority()
+    {
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+        return m_seed;
+    }
+
+    int newNode(qreal p_height)
+    {
+        Node node;
+        node.m_height = p_height;
+        node.m_sum = p_height;
+        node.m_size = 1;
+        node.m_priority = nextPriority();
+        node.m_left = node.m_right = -1;
+
+        if (!m_free.isEmpty()) {
+            int idx = m_free.takeLast();
+            m_nodes[idx] = node;
+            return idx;
+        }
+
+        m_nodes.append(node);
+        return m_nodes.size() - 1;
+    }
+
+    // Free all the nodes of subtree @p_node.
+    void release(int p_node)
+    {
+        if (p_node == -1) {
+            return;
+        }
+
+        release(m_nodes[p_node].m_left);
+        release(m_nodes[p_node].m_right);
+        m_free.append(p_node);
+    }
+
+    // Build a tree of @p_heights in O(n) and return its root.
+    int build(const QVector<qreal> &p_heights)
+    {
+        // Right spine of the tree built so far.
+        QVector<int> spine;
+        for (auto height : p_heights) {
+            int node = newNode(height);
+            int last = -1;
+            while (!spine.isEmpty()
+                   && m_nodes[spine.last()].m_priority < m_nodes[node].m_priority) {
+                last = spine.takeLast();
+            }
+
+            m_nodes[node].m_left = last;
+            if (!spine.isEmpty()) {
+                m_nodes[spine.last()].m_right = node;
+            }
+
+            spine.append(node);
+        }
+
+        if (spine.isEmpty()) {
+            return -1;
+        }
+
+        int root = spine.first();
+        update(root);
+        return root;
+    }
+
+    // Recompute the sizes and sums of subtree @p_node.
+    void update(int p_node)
+    {
+        if (p_node == -1) {
+            return;
+        }
+
+        update(m_nodes[p_node].m_left);
+        update(m_nodes[p_node].m_right);
+        pull(p_node);
+    }
+
+    // Split the first @p_count nodes of @p_node into @p_left and the rest into
+    // @p_right.
+    void split(int p_node, int p_count, int &p_left, int &p_right)
+    {
+        if (p_node == -1) {
+            p_left = p_right = -1;
+            return;
+        }
+
+        Node &node = m_nodes[p_node];
+        int ls = nodeSize(node.m_left);
+        if (p_count <= ls) {
+            int left = node.m_left;
+            split(left, p_count, p_left, m_nodes[p_node].m_left);
+            p_right = p_node;
+        } else {
+            int right = node.m_right;
+            split(right, p_count - ls - 1, m_nodes[p_node].m_right, p_right);
+            p_left = p_node;
+        }
+
+        pull(p_node);
+    }
+
+    int merge(int p_left, int p_right)
+    {
+        if (p_left == -1) {
+            return p_right;
+        } else if (p_right == -1) {
+            return p_left;
+        }
+
+        if (m_nodes[p_left].m_priority > m_nodes[p_right].m_priority) {
+            int right = merge(m_nodes[p_left].m_right, p_right);
+            m_nodes[p_left].m_right = right;
+            pull(p_left);
+            return p_left;
+        } else {
+            int left = merge(p_left, m_nodes[p_right].m_left);
+            m_nodes[p_right].m_left = left;
+            pull(p_right);
+            return p_right;
+        }
+    }
+
+    void setHeight(int p_node, int p_idx, qreal p_height)
+    {
+        Q_ASSERT(p_node != -1);
+        int ls = nodeSize(m_nodes[p_node].m_left);
+        if (p_idx < ls) {
+            setHeight(m_nodes[p_node].m_left, p_idx, p_height);
+        } else if (p_idx == ls) {
+            if (m_nodes[p_node].m_height == p_height) {
+                return;
+            }
+
+            m_nodes[p_node].m_height = p_height;
+        } else {
+            setHeight(m_nodes[p_node].m_right, p_idx - ls - 1, p_height);
+        }
+
+        pull(p_node);
+    }
+
+    // Nodes are stored in an array and linked by index. -1 for null.
+    QVector<Node> m_nodes;
+
+    // Indexes of free nodes in m_nodes.
+    QVector<int> m_free;
+
+    int m_root;
+
+    quint32 m_seed;
 };
 #endif // VTEXTDOCUMENTLAYOUTDATA_H
@@ -55,6 +55,10 @@ void VTextEdit::init()
     m_enableExtraBuffer = false;
 
     m_imageMgr = new VImageResourceManager2();
+    connect(m_imageMgr, &VImageResourceManager2::imageRequested,
+            this, &VTextEdit::imageRequested);
+    connect(m_imageMgr, &VImageResourceManager2::imageEvicted,
+            this, &VTextEdit::imageEvicted);
 
     QTextDocument *doc = document();
     VTextDocumentLayout *docLayout = new VTextDocumentLayout(doc, m_imageMgr);
@@ -72,6 +76,8 @@ void VTextEdit::init()
                     setCursorWidth(p_width);
                 }
             });
+    connect(docLayout, &VTextDocumentLayout::blockHeightsCorrected,
+            this, &VTextEdit::handleBlockHeightsCorrected);
 
     m_lineNumberArea = new VLineNumberArea(this,
                                            document(),
@@ -121,6 +127,16 @@ void VTextEdit::resizeEvent(QResizeEvent *p_event)
     }
 }
 
+void VTextEdit::paintEvent(QPaintEvent *p_event)
+{
+    // Images in the viewport will not be evicted.
+    int first, last;
+    visibleBlockRange(first, last);
+    m_imageMgr->setViewport(first, last);
+
+    QTextEdit::paintEvent(p_event);
+}
+
 void VTextEdit::paintLineNumberArea(QPaintEvent *p_event)
 {
     if (m_lineNumberType == LineNumberType::None) {
@@ -320,6 +336,28 @@ int VTextEdit::contentOffsetY() const
     return -(sb->value());
 }
 
+void VTextEdit::handleBlockHeightsCorrected(const QVector<QPair<qreal, qreal>> &p_corrections)
+{
+    QScrollBar *sb = verticalScrollBar();
+    qreal y = sb->value();
+    for (auto const &cor : p_corrections) {
+        // Only blocks starting above the viewport move the content in it.
+        if (cor.first < y) {
+            y += cor.second;
+        }
+    }
+
+    int val = qRound(y);
+    if (val != sb->value()) {
+        sb->setValue(val);
+    }
+}
+
+void VTextEdit::setLazyLayoutEnabled(bool p_enabled)
+{
+    getLayout()->setLazyLayoutEnabled(p_enabled);
+}
+
 void VTextEdit::clearBlockImages()
 {
     m_imageMgr->clear();
@@ -353,6 +391,11 @@ void VTextEdit::relayoutVisibleBlocks()
     updateLineNumberArea();
 }
 
+void VTextEdit::updateBlockByNumber(int p_blockNumber)
+{
+    getLayout()->updateBlockByNumber(p_blockNumber);
+}
+
 bool VTextEdit::containsImage(const QString &p_imageName) const
 {
     return m_imageMgr->contains(p_imageName);
@@ -360,12 +403,7 @@ bool VTextEdit::containsImage(const QString &p_imageName) const
 
 QSize VTextEdit::imageSize(const QString &p_imageName) const
 {
-    const QPixmap *img = m_imageMgr->findImage(p_imageName);
-    if (img) {
-        return img->size();
-    }
-
-    return QSize();
+    return m_imageMgr->imageSize(p_imageName);
 }
 
 const QPixmap *VTextEdit::findImage(const QString &p_name) const
@@ -373,13 +411,18 @@ const QPixmap *VTextEdit::findImage(const QString &p_name) const
     return m_imageMgr->findImage(p_name);
 }
 
-void VTextEdit::addImage(const QString &p_imageName, const QPixmap &p_image)
+void VTextEdit::addImage(const QString &p_imageName, const QPixmap &p_image, bool p_evictable)
 {
     if (m_blockImageEnabled) {
-        m_imageMgr->addImage(p_imageName, p_image);
+        m_imageMgr->addImage(p_imageName, p_image, p_evictable);
     }
 }
 
+void VTextEdit::setImageStoreBudget(qint64 p_budget)
+{
+    m_imageMgr->setBudget(p_budget);
+}
+
 void VTextEdit::removeImage(const QString &p_imageName)
 {
     m_imageMgr->removeImage(p_imageName);
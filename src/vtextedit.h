@@ -53,7 +53,10 @@ public:
     const QPixmap *findImage(const QString &p_name) const;
 
     // Add an image to the resources.
-    void addImage(const QString &p_imageName, const QPixmap &p_image);
+    // @p_evictable: whether the image could be evicted when the image store
+    // exceeds its budget. imageRequested() will be emitted when it is needed
+    // again.
+    void addImage(const QString &p_imageName, const QPixmap &p_image, bool p_evictable = false);
 
     // Remove an image from the resources.
     void removeImage(const QString &p_imageName);
@@ -76,13 +79,29 @@ public:
 
     void relayoutVisibleBlocks();
 
+    // Request to repaint block @p_blockNumber.
+    void updateBlockByNumber(int p_blockNumber);
+
     void setDisplayScaleFactor(qreal p_factor);
 
     void setEnableExtraBuffer(bool p_enable);
 
+    void setLazyLayoutEnabled(bool p_enabled);
+
+    // Budget in bytes of the image store.
+    void setImageStoreBudget(qint64 p_budget);
+
+signals:
+    // Evicted image @p_imageName is needed again.
+    void imageRequested(const QString &p_imageName);
+
+    void imageEvicted(const QString &p_imageName);
+
 protected:
     void resizeEvent(QResizeEvent *p_event) Q_DECL_OVERRIDE;
 
+    void paintEvent(QPaintEvent *p_event) Q_DECL_OVERRIDE;
+
     // Return the Y offset of the content via the scrollbar.
     int contentOffsetY() const;
 
@@ -96,6 +115,10 @@ private slots:
     // Update viewport margin to hold the line number area.
     void updateLineNumberAreaMargin();
 
+    // Keep the content in the viewport still when heights of blocks above it
+    // are corrected.
+    void handleBlockHeightsCorrected(const QVector<QPair<qreal, qreal>> &p_corrections);
+
     void updateLineNumberArea();
 
 private:
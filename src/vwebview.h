@@ -17,6 +17,9 @@ public:
 
     void setInPreview(bool p_preview);
 
+    // @p_file could be NULL.
+    void setFile(VFile *p_file);
+
 signals:
     void editNote();
 
@@ -79,4 +82,9 @@ inline void VWebView::setInPreview(bool p_preview)
 {
     m_inPreview = p_preview;
 }
+
+inline void VWebView::setFile(VFile *p_file)
+{
+    m_file = p_file;
+}
 #endif // VWEBVIEW_H
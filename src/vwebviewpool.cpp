@@ -0,0 +1,224 @@
+#include "vwebviewpool.h"
+
+#include <QDebug>
+#include <QTimer>
+#include <QUrl>
+#include <QDir>
+#include <QWebChannel>
+#include <QWebEngineScript>
+#include <QWebEngineScriptCollection>
+
+#include "vwebview.h"
+#include "vpreviewpage.h"
+#include "vconfigmanager.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+// Wait this long (ms) before creating the next idle view, so it will not
+// compete with the loading of the opened tabs.
+#define FILL_INTERVAL 1000
+
+#define POOLED_SCRIPT_NAME "vnote_pooled_page"
+
+// Mark the page of @p_view as loaded in advance, so it will not initialize
+// the web channel until initWebChannel() is called.
+static void markPooled(VWebView *p_view, bool p_pooled)
+{
+    QWebEngineScriptCollection &scripts = p_view->page()->scripts();
+    QWebEngineScript script = scripts.findScript(POOLED_SCRIPT_NAME);
+    if (!script.isNull()) {
+        scripts.remove(script);
+    }
+
+    if (p_pooled) {
+        script.setName(POOLED_SCRIPT_NAME);
+        script.setInjectionPoint(QWebEngineScript::DocumentCreation);
+        script.setWorldId(QWebEngineScript::MainWorld);
+        script.setSourceCode("var VPooledPage = true;");
+        scripts.insert(script);
+    }
+}
+
+VWebViewPool::VWebViewPool(int p_size, QObject *p_parent)
+    : QObject(p_parent),
+      m_size(p_size),
+      m_nrCreated(0),
+      m_nrTaken(0),
+      m_nrMissed(0),
+      m_nrRecycled(0)
+{
+    m_fillTimer = new QTimer(this);
+    m_fillTimer->setSingleShot(true);
+    m_fillTimer->setInterval(FILL_INTERVAL);
+    connect(m_fillTimer, &QTimer::timeout,
+            this, &VWebViewPool::fill);
+
+    // Views are created after the first take(), so no renderer is started
+    // until a note is viewed.
+}
+
+VWebViewPool::~VWebViewPool()
+{
+    qInfo() << "web view pool" << statistics();
+
+    for (auto const & entry : m_entries) {
+        delete entry.m_view;
+    }
+
+    m_entries.clear();
+}
+
+void VWebViewPool::scheduleFill()
+{
+    if (isEnabled() && m_entries.size() < m_size) {
+        m_fillTimer->start();
+    }
+}
+
+void VWebViewPool::fill()
+{
+    if (m_entries.size() >= m_size) {
+        return;
+    }
+
+    Entry entry;
+    entry.m_view = new VWebView(NULL);
+
+    VPreviewPage *page = new VPreviewPage(entry.m_view);
+    entry.m_view->setPage(page);
+
+    // Avoid white flash before loading content.
+    page->setBackgroundColor(g_config->getBaseBackground());
+
+    QWebChannel *channel = new QWebChannel(entry.m_view);
+    page->setWebChannel(channel);
+
+    markPooled(entry.m_view, true);
+    load(entry);
+    m_entries.append(entry);
+    ++m_nrCreated;
+
+    scheduleFill();
+}
+
+void VWebViewPool::load(Entry &p_entry)
+{
+    p_entry.m_loaded = false;
+    p_entry.m_conType = g_config->getMdConverterType();
+    p_entry.m_template = VUtils::generateHtmlTemplate(p_entry.m_conType);
+
+    connect(p_entry.m_view, &QWebEngineView::loadFinished,
+            this, &VWebViewPool::handleLoadFinished);
+
+    // The config folder is a local folder, so local files could be accessed.
+    QUrl baseUrl = QUrl::fromLocalFile(g_config->getConfigFolder() + QDir::separator());
+    p_entry.m_view->setHtml(p_entry.m_template, baseUrl);
+}
+
+void VWebViewPool::handleLoadFinished(bool p_ok)
+{
+    QObject *view = sender();
+    for (int i = 0; i < m_entries.size(); ++i) {
+        Entry &entry = m_entries[i];
+        if (entry.m_view != view) {
+            continue;
+        }
+
+        entry.m_view->disconnect(this);
+        if (p_ok) {
+            entry.m_loaded = true;
+        } else {
+            qWarning() << "fail to load template of pooled web view";
+            entry.m_view->deleteLater();
+            m_entries.removeAt(i);
+        }
+
+        break;
+    }
+}
+
+VWebView *VWebViewPool::take(MarkdownConverterType p_conType)
+{
+    if (!isEnabled()) {
+        return NULL;
+    }
+
+    VWebView *view = NULL;
+    QString templ = VUtils::generateHtmlTemplate(p_conType);
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->m_conType != p_conType || it->m_template != templ) {
+            // Configuration changed.
+            it->m_view->deleteLater();
+            it = m_entries.erase(it);
+            continue;
+        }
+
+        if (!it->m_loaded) {
+            ++it;
+            continue;
+        }
+
+        view = it->m_view;
+        m_entries.erase(it);
+        break;
+    }
+
+    if (view) {
+        // Reloads by the taker should initialize the channel by themselves.
+        markPooled(view, false);
+        ++m_nrTaken;
+    } else {
+        ++m_nrMissed;
+    }
+
+    scheduleFill();
+    return view;
+}
+
+void VWebViewPool::recycle(VWebView *p_view, const QObject *p_owner)
+{
+    p_view->disconnect(p_owner);
+    p_view->page()->disconnect(p_owner);
+
+    // It will be hidden.
+    p_view->setParent(NULL);
+    p_view->setFile(NULL);
+    p_view->setInPreview(false);
+
+    if (m_entries.size() >= m_size) {
+        p_view->deleteLater();
+        return;
+    }
+
+    // The objects are owned by the taker.
+    QWebChannel *channel = p_view->page()->webChannel();
+    const auto objects = channel->registeredObjects();
+    for (auto obj : objects) {
+        channel->deregisterObject(obj);
+    }
+
+    markPooled(p_view, true);
+
+    Entry entry;
+    entry.m_view = p_view;
+    load(entry);
+    m_entries.append(entry);
+    ++m_nrRecycled;
+}
+
+void VWebViewPool::initWebChannel(VWebView *p_view)
+{
+    p_view->page()->runJavaScript("initWebChannel();");
+}
+
+QString VWebViewPool::statistics() const
+{
+    return QString("idle %1/%2 created %3 taken %4 missed %5 recycled %6")
+                  .arg(m_entries.size())
+                  .arg(m_size)
+                  .arg(m_nrCreated)
+                  .arg(m_nrTaken)
+                  .arg(m_nrMissed)
+                  .arg(m_nrRecycled);
+}
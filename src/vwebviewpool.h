@@ -0,0 +1,97 @@
+#ifndef VWEBVIEWPOOL_H
+#define VWEBVIEWPOOL_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+
+#include "vconstants.h"
+
+class QTimer;
+class VWebView;
+
+// Pool of preview web views with the HTML template loaded in advance, handed
+// out to new Markdown tabs and recycled when tabs are closed.
+// Pooled pages are loaded with a common base URL and an empty web channel.
+// The taker should register its VDocument with the base URL of the note in
+// the channel of the page and then call initWebChannel(), which initializes
+// the channel of the page only once.
+// Views are created only after the first take().
+class VWebViewPool : public QObject
+{
+    Q_OBJECT
+public:
+    // @p_size: max number of idle views, non-positive to disable the pool.
+    explicit VWebViewPool(int p_size, QObject *p_parent = nullptr);
+
+    ~VWebViewPool();
+
+    bool isEnabled() const;
+
+    // Take a loaded idle view with template of @p_conType.
+    // Return NULL if there is none.
+    VWebView *take(MarkdownConverterType p_conType);
+
+    // Give back @p_view taken before.
+    // Connections from it to @p_owner will be removed.
+    void recycle(VWebView *p_view, const QObject *p_owner);
+
+    // Usage for the log.
+    QString statistics() const;
+
+    // Initialize the web channel of the page of @p_view after the objects
+    // are registered.
+    static void initWebChannel(VWebView *p_view);
+
+private slots:
+    // Create one idle view at a time.
+    void fill();
+
+    void handleLoadFinished(bool p_ok);
+
+private:
+    struct Entry
+    {
+        Entry()
+            : m_view(NULL),
+              m_conType(MarkdownConverterType::MarkdownIt),
+              m_loaded(false)
+        {
+        }
+
+        VWebView *m_view;
+
+        MarkdownConverterType m_conType;
+
+        // Template loaded in the page.
+        QString m_template;
+
+        bool m_loaded;
+    };
+
+    // Load the template in @p_entry's view.
+    void load(Entry &p_entry);
+
+    void scheduleFill();
+
+    int m_size;
+
+    // Idle views.
+    QList<Entry> m_entries;
+
+    QTimer *m_fillTimer;
+
+    unsigned long long m_nrCreated;
+
+    unsigned long long m_nrTaken;
+
+    unsigned long long m_nrMissed;
+
+    unsigned long long m_nrRecycled;
+};
+
+inline bool VWebViewPool::isEnabled() const
+{
+    return m_size > 0;
+}
+#endif // VWEBVIEWPOOL_H